@@ -0,0 +1,172 @@
+#include "BenchmarkRegistry.h"
+#include "BenchmarkState.h"
+#include "Utility/Profiler.h"
+#include "Utility/HardwareCounters.h"
+#include "Utility/Platform.h"
+
+#include <assert.h>
+#include <cstdio>
+#include <cstring>
+
+
+const int BenchmarkRegistry::s_ParticlesCounts[] = { 10000, 100000, 1000000, 8000000 };
+const int BenchmarkRegistry::s_ParticlesCountsCount = sizeof(s_ParticlesCounts) / sizeof(s_ParticlesCounts[0]);
+
+BenchmarkRegistry* BenchmarkRegistry::GetInstance()
+{
+    // Built before the registrars of the other files use it
+    static BenchmarkRegistry s_Registry;
+    return &s_Registry;
+}
+
+void BenchmarkRegistry::Register(const char *name, BenchmarkFunction function, int maxParticlesCount)
+{
+    assert(name != NULL && function != NULL);
+
+    Case benchmarkCase;
+    benchmarkCase.m_Name                = name;
+    benchmarkCase.m_Function            = function;
+    benchmarkCase.m_MaxParticlesCount   = maxParticlesCount;
+    m_Cases.push_back(benchmarkCase);
+}
+
+void BenchmarkRegistry::List() const
+{
+    for (size_t i = 0; i < m_Cases.size(); i++)
+    {
+        printf("%s\n", m_Cases[i].m_Name);
+    }
+}
+
+namespace
+{
+    // Counters by item, IPC and the estimated memory bandwidth
+    struct CountersReport
+    {
+        double m_CyclesByItem;
+        double m_InstructionsByCycle;
+        double m_CacheMissesByItem;
+        double m_BranchMissesByItem;
+        double m_Bandwidth;
+
+        explicit CountersReport(const BenchmarkState& state)
+        {
+            const double itemsCount = static_cast<double>(state.GetItemsProcessed()) * state.GetIterationsCount();
+            const double cycles = static_cast<double>(state.GetCounter(HardwareCounters::eCycles));
+            const long long cacheMisses = state.GetCounter(HardwareCounters::eLastLevelCacheMisses);
+
+            m_CyclesByItem          = itemsCount > 0.0 ? cycles / itemsCount : 0.0;
+            m_InstructionsByCycle   = cycles > 0.0 ? state.GetCounter(HardwareCounters::eInstructions) / cycles : 0.0;
+            m_CacheMissesByItem     = itemsCount > 0.0 ? cacheMisses / itemsCount : 0.0;
+            m_BranchMissesByItem    = itemsCount > 0.0 ? state.GetCounter(HardwareCounters::eBranchMisses) / itemsCount : 0.0;
+            m_Bandwidth             = HardwareCounters::GetBandwidth(cacheMisses, state.GetTime());
+        }
+    };
+}
+
+int BenchmarkRegistry::Run(const BenchmarkOptions& options) const
+{
+    bool isCountingHardware = false;
+    if (options.m_IsUsingHardwareCounters)
+    {
+        // Before the cases start the thread pool, its workers are counted
+        isCountingHardware = Profiler::GetInstance()->SetEnableHardwareCounters(true);
+        if ( ! isCountingHardware)
+        {
+            fprintf(stderr, "Hardware counters are unavailable, check perf_event_paranoid\n");
+        }
+    }
+
+    FILE *csvFile = NULL;
+    if (options.m_CsvFileName != NULL)
+    {
+        csvFile = OpenFile(options.m_CsvFileName, "w");
+        if (csvFile == NULL)
+        {
+            fprintf(stderr, "Can't open %s\n", options.m_CsvFileName);
+            return 1;
+        }
+        fprintf(csvFile, "name,particles,iterations,mean_ms,min_ms,items_per_second%s\n",
+                isCountingHardware ? ",cycles_per_item,ipc,llc_misses_per_item,branch_misses_per_item,gb_per_second" : "");
+    }
+
+    printf("%-40s %10s %10s %12s %12s %14s", "Benchmark", "Particles", "Iterations", "Mean (ms)", "Min (ms)", "Items/s");
+    if (isCountingHardware)
+    {
+        printf(" %12s %6s %12s %12s %8s", "Cycles/item", "IPC", "LLC miss/it", "Br miss/it", "GB/s");
+    }
+    printf("\n");
+
+    int failedCount = 0;
+    for (size_t i = 0; i < m_Cases.size(); i++)
+    {
+        const Case& benchmarkCase = m_Cases[i];
+        if (options.m_Filter != NULL && strstr(benchmarkCase.m_Name, options.m_Filter) == NULL)
+            continue;
+
+        for (int j = 0; j < s_ParticlesCountsCount; j++)
+        {
+            const int particlesCount = s_ParticlesCounts[j];
+            if (particlesCount < options.m_MinParticlesCount || particlesCount > options.m_MaxParticlesCount ||
+                particlesCount > benchmarkCase.m_MaxParticlesCount)
+            {
+                continue;
+            }
+
+            BenchmarkState state(particlesCount, options.m_MinTime, options.m_MaxIterationsCount);
+            benchmarkCase.m_Function(state);
+
+            // The zones recorded by the stages are not kept from a case to the next
+            Profiler::GetInstance()->EndFrame();
+
+            if (state.GetSkipMessage() != NULL)
+            {
+                printf("%-40s %10d skipped: %s\n", benchmarkCase.m_Name, particlesCount, state.GetSkipMessage());
+                continue;
+            }
+
+            if (state.GetIterationsCount() == 0)
+            {
+                printf("%-40s %10d failed: no iteration\n", benchmarkCase.m_Name, particlesCount);
+                failedCount++;
+                continue;
+            }
+
+            const double meanTime = state.GetMeanTime();
+            const double itemsPerSecond = meanTime > 0.0 ? state.GetItemsProcessed() * 1000.0 / meanTime : 0.0;
+            printf("%-40s %10d %10d %12.3f %12.3f %14.4g", benchmarkCase.m_Name, particlesCount,
+                    state.GetIterationsCount(), meanTime, state.GetMinTime(), itemsPerSecond);
+            if (isCountingHardware)
+            {
+                const CountersReport report(state);
+                printf(" %12.2f %6.2f %12.4f %12.4f %8.2f", report.m_CyclesByItem, report.m_InstructionsByCycle,
+                        report.m_CacheMissesByItem, report.m_BranchMissesByItem, report.m_Bandwidth);
+            }
+            printf("\n");
+            fflush(stdout);
+
+            if (csvFile != NULL)
+            {
+                fprintf(csvFile, "%s,%d,%d,%.6f,%.6f,%.6g", benchmarkCase.m_Name, particlesCount,
+                        state.GetIterationsCount(), meanTime, state.GetMinTime(), itemsPerSecond);
+                if (isCountingHardware)
+                {
+                    const CountersReport report(state);
+                    fprintf(csvFile, ",%.6f,%.6f,%.6f,%.6f,%.6f", report.m_CyclesByItem, report.m_InstructionsByCycle,
+                            report.m_CacheMissesByItem, report.m_BranchMissesByItem, report.m_Bandwidth);
+                }
+                fprintf(csvFile, "\n");
+            }
+        }
+    }
+
+    if (csvFile != NULL)
+    {
+        fclose(csvFile);
+    }
+    if (isCountingHardware)
+    {
+        Profiler::GetInstance()->SetEnableHardwareCounters(false);
+    }
+    return failedCount;
+}
@@ -0,0 +1,78 @@
+#ifndef BENCHMARK_REGISTRY
+#define BENCHMARK_REGISTRY
+
+#include <cstddef>
+#include <vector>
+
+class BenchmarkState;
+
+typedef void (*BenchmarkFunction)(BenchmarkState& state);
+
+struct BenchmarkOptions
+{
+    // Only the cases whose name contains the filter are run, all of them when NULL
+    const char  *m_Filter;
+    int         m_MinParticlesCount;
+    int         m_MaxParticlesCount;
+    // Milliseconds by case and count
+    double      m_MinTime;
+    int         m_MaxIterationsCount;
+    // Results also written as CSV when not NULL
+    const char  *m_CsvFileName;
+    // Hardware counters reported by item next to the times
+    bool        m_IsUsingHardwareCounters;
+
+    BenchmarkOptions() :    m_Filter(NULL),
+                            m_MinParticlesCount(0),
+                            m_MaxParticlesCount(8 * 1000 * 1000),
+                            m_MinTime(500.0),
+                            m_MaxIterationsCount(1000),
+                            m_CsvFileName(NULL),
+                            m_IsUsingHardwareCounters(false)
+    {
+    }
+};
+
+// Cases registered by BENCHMARK_STAGE, each one is run at the standard particles counts,
+// from 10k to 8M particles
+class BenchmarkRegistry
+{
+public:
+    static BenchmarkRegistry* GetInstance();
+
+    // The name must outlive the registry, a case is not run above its maximum count
+    void Register(const char *name, BenchmarkFunction function, int maxParticlesCount);
+
+    // Returns the count of failed cases
+    int Run(const BenchmarkOptions& options) const;
+    void List() const;
+
+    static const int s_ParticlesCounts[];
+    static const int s_ParticlesCountsCount;
+
+private:
+    struct Case
+    {
+        const char          *m_Name;
+        BenchmarkFunction   m_Function;
+        int                 m_MaxParticlesCount;
+    };
+
+    std::vector<Case> m_Cases;
+};
+
+struct BenchmarkRegistrar
+{
+    BenchmarkRegistrar(const char *name, BenchmarkFunction function, int maxParticlesCount)
+    {
+        BenchmarkRegistry::GetInstance()->Register(name, function, maxParticlesCount);
+    }
+};
+
+#define BENCHMARK_CONCATENATE_LINE(name, line) name##line
+#define BENCHMARK_CONCATENATE(name, line) BENCHMARK_CONCATENATE_LINE(name, line)
+
+#define BENCHMARK_STAGE(name, function, maxParticlesCount) \
+    static const BenchmarkRegistrar BENCHMARK_CONCATENATE(s_BenchmarkRegistrar, __LINE__)(name, function, maxParticlesCount)
+
+#endif // BENCHMARK_REGISTRY
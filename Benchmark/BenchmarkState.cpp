@@ -0,0 +1,150 @@
+#include "BenchmarkState.h"
+#include "Utility/Profiler.h"
+
+#include <assert.h>
+#include <cstring>
+
+
+BenchmarkState::BenchmarkState(int particlesCount, double minTime, int maxIterationsCount) :
+                                    m_ParticlesCount(particlesCount),
+                                    m_MinTotalTime(minTime),
+                                    m_MaxIterationsCount(maxIterationsCount),
+                                    m_ItemsCount(particlesCount),
+                                    m_SkipMessage(NULL),
+                                    m_IterationsCount(0),
+                                    m_IsRunning(false),
+                                    m_IsPaused(false),
+                                    m_IterationStart(0),
+                                    m_IterationTicks(0),
+                                    m_TotalTicks(0),
+                                    m_MinIterationTicks(0),
+                                    m_IsCountingHardware(Profiler::GetInstance()->IsUsingHardwareCounters())
+{
+    assert(particlesCount > 0);
+    assert(maxIterationsCount > 0);
+    memset(m_StartCounters, 0, sizeof(m_StartCounters));
+    memset(m_TotalCounters, 0, sizeof(m_TotalCounters));
+}
+
+int BenchmarkState::GetParticlesCount() const
+{
+    return m_ParticlesCount;
+}
+
+// Counters are read out of the timed interval
+void BenchmarkState::StartInterval()
+{
+    if (m_IsCountingHardware)
+    {
+        Profiler::GetInstance()->GetHardwareCounters().Read(m_StartCounters);
+    }
+    m_IterationStart = Profiler::GetTicks();
+}
+
+void BenchmarkState::StopInterval()
+{
+    m_IterationTicks += Profiler::GetTicks() - m_IterationStart;
+    if (m_IsCountingHardware)
+    {
+        long long counters[HardwareCounters::eCountersCount];
+        Profiler::GetInstance()->GetHardwareCounters().Read(counters);
+        for (int i = 0; i < HardwareCounters::eCountersCount; i++)
+        {
+            m_TotalCounters[i] += counters[i] - m_StartCounters[i];
+        }
+    }
+}
+
+bool BenchmarkState::KeepRunning()
+{
+    assert( ! m_IsPaused && "KeepRunning called while the timing is paused.");
+
+    if (m_IsRunning)
+    {
+        // End of the iteration
+        StopInterval();
+        m_TotalTicks += m_IterationTicks;
+        if (m_IterationsCount == 0 || m_IterationTicks < m_MinIterationTicks)
+        {
+            m_MinIterationTicks = m_IterationTicks;
+        }
+        m_IterationsCount++;
+        m_IsRunning = false;
+    }
+
+    if (m_SkipMessage != NULL || m_IterationsCount >= m_MaxIterationsCount ||
+        (m_IterationsCount > 0 && GetTime() >= m_MinTotalTime))
+    {
+        return false;
+    }
+
+    m_IsRunning = true;
+    m_IterationTicks = 0;
+    StartInterval();
+    return true;
+}
+
+void BenchmarkState::PauseTiming()
+{
+    assert(m_IsRunning && ! m_IsPaused);
+    StopInterval();
+    m_IsPaused = true;
+}
+
+void BenchmarkState::ResumeTiming()
+{
+    assert(m_IsRunning && m_IsPaused);
+    m_IsPaused = false;
+    StartInterval();
+}
+
+void BenchmarkState::SetItemsProcessed(long long itemsCount)
+{
+    m_ItemsCount = itemsCount;
+}
+
+long long BenchmarkState::GetItemsProcessed() const
+{
+    return m_ItemsCount;
+}
+
+void BenchmarkState::SkipWithMessage(const char *message)
+{
+    m_SkipMessage = message;
+}
+
+const char* BenchmarkState::GetSkipMessage() const
+{
+    return m_SkipMessage;
+}
+
+int BenchmarkState::GetIterationsCount() const
+{
+    return m_IterationsCount;
+}
+
+double BenchmarkState::GetTime() const
+{
+    return m_TotalTicks / Profiler::GetTicksPerMillisecond();
+}
+
+double BenchmarkState::GetMinTime() const
+{
+    return m_MinIterationTicks / Profiler::GetTicksPerMillisecond();
+}
+
+double BenchmarkState::GetMeanTime() const
+{
+    return m_IterationsCount > 0 ? GetTime() / m_IterationsCount : 0.0;
+}
+
+bool BenchmarkState::IsCountingHardware() const
+{
+    return m_IsCountingHardware;
+}
+
+long long BenchmarkState::GetCounter(int counter) const
+{
+    assert(counter >= 0 && counter < HardwareCounters::eCountersCount);
+    return m_TotalCounters[counter];
+}
@@ -0,0 +1,64 @@
+#ifndef BENCHMARK_STATE
+#define BENCHMARK_STATE
+
+#include "Utility/HardwareCounters.h"
+
+// Measure of one benchmark case at one particles count, used like a Google Benchmark state:
+//     while (state.KeepRunning()) { stage to measure }
+// Iterations run until the minimum time is reached, the setup can be excluded
+// with PauseTiming and ResumeTiming. The hardware counters of the profiler, when enabled,
+// are sampled over the same timed intervals
+class BenchmarkState
+{
+public:
+    BenchmarkState(int particlesCount, double minTime, int maxIterationsCount);
+
+    int GetParticlesCount() const;
+
+    bool KeepRunning();
+    void PauseTiming();
+    void ResumeTiming();
+
+    // Items processed by an iteration, particles by default
+    void SetItemsProcessed(long long itemsCount);
+    long long GetItemsProcessed() const;
+
+    // A case skipped for this count, like a scene too big for the stage
+    void SkipWithMessage(const char *message);
+    const char* GetSkipMessage() const;
+
+    // Times are in milliseconds
+    int GetIterationsCount() const;
+    double GetTime() const;
+    double GetMinTime() const;
+    double GetMeanTime() const;
+
+    // Sums over the timed intervals of every iteration, 0 without the counters
+    bool IsCountingHardware() const;
+    long long GetCounter(int counter) const;
+
+private:
+    void StartInterval();
+    void StopInterval();
+
+    int         m_ParticlesCount;
+    double      m_MinTotalTime;
+    int         m_MaxIterationsCount;
+
+    long long   m_ItemsCount;
+    const char  *m_SkipMessage;
+
+    int         m_IterationsCount;
+    bool        m_IsRunning;
+    bool        m_IsPaused;
+    long long   m_IterationStart;
+    long long   m_IterationTicks;
+    long long   m_TotalTicks;
+    long long   m_MinIterationTicks;
+
+    bool        m_IsCountingHardware;
+    long long   m_StartCounters[HardwareCounters::eCountersCount];
+    long long   m_TotalCounters[HardwareCounters::eCountersCount];
+};
+
+#endif // BENCHMARK_STATE
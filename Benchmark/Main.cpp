@@ -0,0 +1,75 @@
+#include "BenchmarkRegistry.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+
+// Headless benchmark of the engine stages, no window nor OpenCL device is needed.
+//     particle_bench [--filter=<text>] [--min_particles=<count>] [--max_particles=<count>]
+//                    [--min_time=<ms>] [--max_iterations=<count>] [--csv=<file>] [--counters] [--list]
+// --counters reports the hardware counters by item, Linux perf_event only
+namespace
+{
+    const char* GetValue(const char *argument, const char *option)
+    {
+        const size_t length = strlen(option);
+        return strncmp(argument, option, length) == 0 ? argument + length : NULL;
+    }
+
+    void PrintUsage()
+    {
+        printf( "particle_bench [--filter=<text>] [--min_particles=<count>] [--max_particles=<count>]\n"
+                "               [--min_time=<ms>] [--max_iterations=<count>] [--csv=<file>] [--counters] [--list]\n");
+    }
+}
+
+int main(int argc, char **argv)
+{
+    BenchmarkOptions options;
+    for (int i = 1; i < argc; i++)
+    {
+        const char *argument = argv[i];
+        const char *value = NULL;
+        if ((value = GetValue(argument, "--filter=")) != NULL)
+        {
+            options.m_Filter = value;
+        }
+        else if ((value = GetValue(argument, "--min_particles=")) != NULL)
+        {
+            options.m_MinParticlesCount = atoi(value);
+        }
+        else if ((value = GetValue(argument, "--max_particles=")) != NULL)
+        {
+            options.m_MaxParticlesCount = atoi(value);
+        }
+        else if ((value = GetValue(argument, "--min_time=")) != NULL)
+        {
+            options.m_MinTime = atof(value);
+        }
+        else if ((value = GetValue(argument, "--max_iterations=")) != NULL)
+        {
+            options.m_MaxIterationsCount = atoi(value) > 0 ? atoi(value) : 1;
+        }
+        else if ((value = GetValue(argument, "--csv=")) != NULL)
+        {
+            options.m_CsvFileName = value;
+        }
+        else if (strcmp(argument, "--counters") == 0)
+        {
+            options.m_IsUsingHardwareCounters = true;
+        }
+        else if (strcmp(argument, "--list") == 0)
+        {
+            BenchmarkRegistry::GetInstance()->List();
+            return 0;
+        }
+        else
+        {
+            PrintUsage();
+            return strcmp(argument, "--help") == 0 ? 0 : 1;
+        }
+    }
+
+    return BenchmarkRegistry::GetInstance()->Run(options) == 0 ? 0 : 1;
+}
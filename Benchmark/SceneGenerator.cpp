@@ -0,0 +1,173 @@
+#include "SceneGenerator.h"
+
+#include <assert.h>
+#include <cmath>
+
+
+namespace
+{
+    // Same sequence on every platform, unlike rand
+    class Random
+    {
+    public:
+        Random() : m_State(12345u) {}
+        // In [0; modulo[
+        int Next(int modulo)
+        {
+            m_State = m_State * 1664525u + 1013904223u;
+            return static_cast<int>((m_State >> 8) % static_cast<unsigned int>(modulo));
+        }
+
+    private:
+        unsigned int m_State;
+    };
+
+    int CeilCubeRoot(int value)
+    {
+        int root = static_cast<int>(std::pow(static_cast<double>(value), 1.0 / 3.0));
+        while (root * root * root < value)
+        {
+            root++;
+        }
+        return root;
+    }
+}
+
+Aabb SceneGenerator::CreateWaterBlock(slmath::vec4 *positions, int particlesCount)
+{
+    assert(particlesCount > 0);
+    const float spaceBetweenParticles = 0.9f;
+    const int sideBox = CeilCubeRoot(particlesCount);
+    const int halfSideBox = sideBox / 2;
+
+    Random random;
+    int index = 0;
+    for (int j = 0; index < particlesCount; j++)
+    {
+        for (int i = 0; i < sideBox && index < particlesCount; i++)
+        {
+            for (int k = 0; k < sideBox && index < particlesCount; k++)
+            {
+                const float noiseI = (random.Next(100) - 50) * 0.0001f;
+                const float noiseJ = (random.Next(100) - 50) * 0.0001f;
+                const float noiseK = (random.Next(100) - 50) * 0.0001f;
+
+                positions[index++] = slmath::vec4(  (i - halfSideBox + noiseI) * spaceBetweenParticles,
+                                                    (j + 5 + noiseJ) * spaceBetweenParticles,
+                                                    (k - halfSideBox + noiseK) * spaceBetweenParticles,
+                                                    0.0f);
+            }
+        }
+    }
+
+    // Room above the block for the splashes
+    Aabb box;
+    box.m_Min = slmath::vec4(-halfSideBox - 1.0f, 0.0f, -halfSideBox - 1.0f, 0.0f) * spaceBetweenParticles;
+    box.m_Max = slmath::vec4(sideBox - halfSideBox + 1.0f, 2.0f * (positions[particlesCount - 1].y + 5.0f),
+                                sideBox - halfSideBox + 1.0f, 0.0f) * spaceBetweenParticles;
+    return box;
+}
+
+void SceneGenerator::CreateRainShell(slmath::vec4 *positions, int particlesCount)
+{
+    assert(particlesCount > 0);
+    int length = static_cast<int>(std::sqrt(static_cast<double>(particlesCount)));
+    while (length * length < particlesCount)
+    {
+        length++;
+    }
+
+    const float spaceBetweenParticle = 10.0f;
+    const float pi = 3.14159265f;
+    int index = 0;
+    for (int i = 0; i < length && index < particlesCount; i++)
+    {
+        for (int j = 0; j < length && index < particlesCount; j++)
+        {
+            const float s = float(i) / float(length);
+            const float t = float(j) / float(length);
+
+            const float x = 2.0f * (1.0f - std::pow(2.73f, s)) * std::cos(s * 6 * pi) * std::cos(t * pi) * std::cos(t * pi);
+            const float y = 2.0f * (-1.0f + std::pow(2.73f, s)) * std::sin(s * 6 * pi) * std::cos(t * pi) * std::cos(t * pi);
+            const float z = 1.0f - std::pow(2.73f, 2.0f * s) - std::sin(t * 2 * pi) + std::pow(2.73f, s) * std::sin(t * 2 * pi);
+
+            positions[index++] = slmath::vec4(x, 5.0f - z, y, 0.0f) * spaceBetweenParticle;
+        }
+    }
+}
+
+void SceneGenerator::CreateGalaxyClusters(slmath::vec4 *positions, int particlesCount)
+{
+    assert(particlesCount > 0);
+    const int length = 4;
+    const float spaceBetweenParticles = 0.2f;
+    const int sideBox = CeilCubeRoot((particlesCount + length - 1) / length);
+    const int halfSideBox = sideBox / 2;
+
+    Random random;
+    int index = 0;
+    for (int i = 0; i < sideBox && index < particlesCount; i++)
+    {
+        for (int j = 0; j < length * sideBox && index < particlesCount; j++)
+        {
+            for (int k = 0; k < sideBox && index < particlesCount; k++)
+            {
+                slmath::vec4 position(  (i - halfSideBox) * spaceBetweenParticles + random.Next(10) * 3.1f,
+                                        (j - halfSideBox) * spaceBetweenParticles + random.Next(10) * 3.1f,
+                                        (k - halfSideBox) * spaceBetweenParticles + random.Next(10) * 3.1f,
+                                        0.0f);
+                position += slmath::vec4((random.Next(100) - 50) * 0.1f);
+                position.w = 0.0f;
+                positions[index++] = position;
+            }
+        }
+    }
+}
+
+void SceneGenerator::CreateCloths(slmath::vec4 *positions, int particlesCount, std::vector<Spring>& springs)
+{
+    assert(particlesCount > 0);
+    const float spaceBetweenParticlesForRose[s_SideCloth] = {   9.0f, 12.25f, 13.5f, 15.0f,
+                                                                15.5f, 15.75f, 16.0f, 15.75f,
+                                                                15.50f, 15.25f, 15.0f, 10.0f,
+                                                                8.0f, 5.75f, 4.0f, 1.0f
+                                                            };
+    const float spaceBetweenCloth = 20.0f;
+    const int particlesByCloth = s_SideCloth * s_SideCloth;
+    const int halfSideCloth = s_SideCloth / 2;
+    const int clothCount = (particlesCount + particlesByCloth - 1) / particlesByCloth;
+    const int clothsBySide = static_cast<int>(std::sqrt(static_cast<double>(clothCount))) + 1;
+
+    for (int index = 0; index < particlesCount; index++)
+    {
+        const int k = index / particlesByCloth;
+        const int i = (index % particlesByCloth) / s_SideCloth;
+        const int j = index % s_SideCloth;
+
+        const slmath::vec4 clothPosition(50.0f, (-k % clothsBySide) * spaceBetweenCloth, (-k / clothsBySide) * spaceBetweenCloth, 0.0f);
+        const slmath::vec4 particlePosition(float(i - halfSideCloth), 0.0f,
+                                            float(j - halfSideCloth) * spaceBetweenParticlesForRose[i] / s_SideCloth, 0.0f);
+        positions[index] = clothPosition + particlePosition;
+    }
+
+    // Structural springs, to the next particle of the row and of the column in the same cloth
+    springs.clear();
+    for (int index = 0; index < particlesCount; index++)
+    {
+        const int clothIndex = index % particlesByCloth;
+        const int neighbors[2] = {  (clothIndex % s_SideCloth != s_SideCloth - 1) ? index + 1 : -1,
+                                    (clothIndex / s_SideCloth != s_SideCloth - 1) ? index + s_SideCloth : -1 };
+        for (int n = 0; n < 2; n++)
+        {
+            if (neighbors[n] < 0 || neighbors[n] >= particlesCount)
+                continue;
+
+            Spring spring;
+            spring.m_ParticleIndex1 = index;
+            spring.m_ParticleIndex2 = neighbors[n];
+            spring.m_Distance       = slmath::length(slmath::vec3(positions[neighbors[n]] - positions[index]));
+            spring.m_Pad            = 0.0f;
+            springs.push_back(spring);
+        }
+    }
+}
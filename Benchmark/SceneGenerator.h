@@ -0,0 +1,30 @@
+#ifndef SCENE_GENERATOR
+#define SCENE_GENERATOR
+
+#include <vector>
+#include <slmath/slmath.h>
+#include "ParticleEngine/ParticlesCollider.h"
+#include "ParticleEngine/ParticlesSpring.h"
+
+// Scenes of the demos at any particles count. The random jitter comes from a fixed
+// seed, a scene is the same from a run to the next
+class SceneGenerator
+{
+public:
+    // Water demo, a block of particles 0.9 apart. Returns the box the particles are kept in
+    static Aabb CreateWaterBlock(slmath::vec4 *positions, int particlesCount);
+
+    // Rain demo, particles spread on a spiral shell
+    static void CreateRainShell(slmath::vec4 *positions, int particlesCount);
+
+    // Galaxy demo, overlapping clusters of particles
+    static void CreateGalaxyClusters(slmath::vec4 *positions, int particlesCount);
+
+    // Cloth demo, cloths of 16x16 particles with their structural springs
+    static void CreateCloths(slmath::vec4 *positions, int particlesCount, std::vector<Spring>& springs);
+
+private:
+    static const int s_SideCloth = 16;
+};
+
+#endif // SCENE_GENERATOR
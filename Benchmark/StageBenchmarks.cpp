@@ -0,0 +1,298 @@
+#include "BenchmarkRegistry.h"
+#include "BenchmarkState.h"
+#include "SceneGenerator.h"
+
+#include "ParticleEngine/Grid3D.h"
+#include "ParticleEngine/SmoothedParticleHydrodynamics.h"
+#include "ParticleEngine/VerletIntegration.h"
+#include "ParticleEngine/ParticlesCollider.h"
+#include "ParticleEngine/ParticlesSpring.h"
+#include "ParticleEngine/ParticlesAccelerator.h"
+
+#include <slmath/slmath.h>
+#include <algorithm>
+#include <vector>
+
+
+// Engine stages on the CPU, each case builds its scene before the timed loop.
+// Positions moved by a stage are not reset, a step is measured from the previous one
+// like in a simulation
+namespace
+{
+    const int s_AllCounts = 8 * 1000 * 1000;
+
+    // Queries of an iteration of the neighbors cases, spread over the particles
+    const int s_NeighborsQueriesCount = 65536;
+    // Enough for the folded cells of the full grid
+    const int s_NeighborsMaxCount = 16384;
+
+    // The queries are wrapped in functions, some of them are const members
+    typedef int (*NeighborsQuery)(Grid3D& grid, int currentIndex, int *neighbors, int neighborsMaxCount);
+
+    enum SceneType
+    {
+        WATER_SCENE,
+        GALAXY_SCENE,
+        RAIN_SCENE
+    };
+
+    void CreateScene(SceneType sceneType, slmath::vec4 *positions, int particlesCount)
+    {
+        switch (sceneType)
+        {
+        case WATER_SCENE:
+            SceneGenerator::CreateWaterBlock(positions, particlesCount);
+            break;
+        case GALAXY_SCENE:
+            SceneGenerator::CreateGalaxyClusters(positions, particlesCount);
+            break;
+        case RAIN_SCENE:
+            SceneGenerator::CreateRainShell(positions, particlesCount);
+            break;
+        }
+    }
+
+    void BenchmarkCreateGrid(BenchmarkState& state, SceneType sceneType)
+    {
+        const int particlesCount = state.GetParticlesCount();
+        slmath::vec4 *positions = new slmath::vec4[particlesCount];
+        CreateScene(sceneType, positions, particlesCount);
+
+        Grid3D grid;
+        while (state.KeepRunning())
+        {
+            grid.Initialize(positions, particlesCount);
+        }
+
+        delete[] positions;
+    }
+
+    void BenchmarkCreateGridWater(BenchmarkState& state)    { BenchmarkCreateGrid(state, WATER_SCENE); }
+    void BenchmarkCreateGridGalaxy(BenchmarkState& state)   { BenchmarkCreateGrid(state, GALAXY_SCENE); }
+    void BenchmarkCreateGridRain(BenchmarkState& state)     { BenchmarkCreateGrid(state, RAIN_SCENE); }
+
+    void BenchmarkCreateFullGrid(BenchmarkState& state)
+    {
+        const int particlesCount = state.GetParticlesCount();
+        slmath::vec4 *positions = new slmath::vec4[particlesCount];
+        SceneGenerator::CreateWaterBlock(positions, particlesCount);
+
+        Grid3D grid;
+        while (state.KeepRunning())
+        {
+            grid.InitializeFullGrid(positions, particlesCount);
+        }
+
+        delete[] positions;
+    }
+
+    int ByParticleOrderNeighbors(Grid3D& grid, int currentIndex, int *neighbors, int neighborsMaxCount)
+    {
+        return grid.GetNeighborsByParticleOrder(currentIndex, neighbors, neighborsMaxCount);
+    }
+
+    int HeuristicNeighbors(Grid3D& grid, int currentIndex, int *neighbors, int neighborsMaxCount)
+    {
+        return grid.GetNeighborsByParticleOrderHeuristic(currentIndex, neighbors, neighborsMaxCount);
+    }
+
+    int FullGridNeighbors(Grid3D& grid, int currentIndex, int *neighbors, int neighborsMaxCount)
+    {
+        return grid.GetNeighborsByParticleOrderFullGrid(currentIndex, neighbors, neighborsMaxCount);
+    }
+
+    int HashNeighbors(Grid3D& grid, int currentIndex, int *neighbors, int neighborsMaxCount)
+    {
+        return grid.ComputeHashNeighbors(currentIndex, neighbors, neighborsMaxCount);
+    }
+
+    // Neighbors of particles taken in the cell order, the grid is built once
+    void BenchmarkNeighbors(BenchmarkState& state, NeighborsQuery query, bool isUsingFullGrid)
+    {
+        const int particlesCount = state.GetParticlesCount();
+        slmath::vec4 *positions = new slmath::vec4[particlesCount];
+        SceneGenerator::CreateWaterBlock(positions, particlesCount);
+
+        Grid3D grid;
+        if (isUsingFullGrid)
+        {
+            grid.InitializeFullGrid(positions, particlesCount);
+        }
+        else
+        {
+            grid.Initialize(positions, particlesCount);
+        }
+
+        const int queriesCount = std::min(particlesCount, s_NeighborsQueriesCount);
+        const int stride = particlesCount / queriesCount;
+        int *neighbors = new int[s_NeighborsMaxCount];
+
+        long long neighborsCount = 0;
+        while (state.KeepRunning())
+        {
+            for (int i = 0; i < queriesCount; i++)
+            {
+                neighborsCount += query(grid, i * stride, neighbors, s_NeighborsMaxCount);
+            }
+        }
+        state.SetItemsProcessed(queriesCount);
+
+        // Keeps the queries from being optimized away
+        if (neighborsCount < 0)
+        {
+            state.SkipWithMessage("no neighbors");
+        }
+
+        delete[] neighbors;
+        delete[] positions;
+    }
+
+    void BenchmarkNeighborsByParticleOrder(BenchmarkState& state)   { BenchmarkNeighbors(state, ByParticleOrderNeighbors, false); }
+    void BenchmarkNeighborsHeuristic(BenchmarkState& state)         { BenchmarkNeighbors(state, HeuristicNeighbors, false); }
+    void BenchmarkNeighborsFullGrid(BenchmarkState& state)          { BenchmarkNeighbors(state, FullGridNeighbors, true); }
+    void BenchmarkNeighborsHash(BenchmarkState& state)              { BenchmarkNeighbors(state, HashNeighbors, false); }
+
+    void BenchmarkSPH(BenchmarkState& state)
+    {
+        const int particlesCount = state.GetParticlesCount();
+        slmath::vec4 *positions = new slmath::vec4[particlesCount];
+        SceneGenerator::CreateWaterBlock(positions, particlesCount);
+
+        // Parameters of the water demo
+        Grid3D grid;
+        SmoothedParticleHydrodynamics sph(&grid);
+        sph.SetParticlesMuViscosityt(10.0f);
+        sph.SetParticlesGazConstant(150.0f);
+        sph.SetParticlesMass(10.0f);
+        sph.Initialize(positions, particlesCount);
+
+        while (state.KeepRunning())
+        {
+            // The particles moved by the previous step are binned again, as the simulation does
+            state.PauseTiming();
+            grid.Initialize(positions, particlesCount);
+            state.ResumeTiming();
+
+            sph.Simulate(positions, particlesCount);
+        }
+
+        delete[] positions;
+    }
+
+    void BenchmarkIntegration(BenchmarkState& state)
+    {
+        const int particlesCount = state.GetParticlesCount();
+        slmath::vec4 *positions = new slmath::vec4[particlesCount];
+        SceneGenerator::CreateWaterBlock(positions, particlesCount);
+
+        VerletIntegration verlet;
+        verlet.Initialize(positions, particlesCount);
+        verlet.SetCommonAcceleration(slmath::vec4(0.0f, -9.8f, 0.0f, 0.0f));
+        verlet.SetDamping(0.99f);
+        verlet.SetDeltaT(1.0f / 60.0f);
+
+        while (state.KeepRunning())
+        {
+            verlet.Integration();
+        }
+
+        delete[] positions;
+    }
+
+    void BenchmarkCollision(BenchmarkState& state)
+    {
+        const int particlesCount = state.GetParticlesCount();
+        slmath::vec4 *positions = new slmath::vec4[particlesCount];
+        const Aabb box = SceneGenerator::CreateWaterBlock(positions, particlesCount);
+
+        // The box of the water demo and the spheres it used to have, set in the particles
+        ParticlesCollider collider;
+        collider.AddInsideAabb(box);
+        for (int i = 0; i < 9; i++)
+        {
+            Sphere sphere;
+            sphere.m_Position = slmath::vec3(   box.m_Min.x + (i % 3 + 1) * (box.m_Max.x - box.m_Min.x) / 4.0f,
+                                                5.0f,
+                                                box.m_Min.z + (i / 3 + 1) * (box.m_Max.z - box.m_Min.z) / 4.0f);
+            sphere.m_Radius = 5.0f;
+            collider.AddOutsideSphere(sphere);
+        }
+
+        while (state.KeepRunning())
+        {
+            collider.SatisfyCollisions(positions, particlesCount);
+        }
+
+        delete[] positions;
+    }
+
+    void BenchmarkSpring(BenchmarkState& state)
+    {
+        const int particlesCount = state.GetParticlesCount();
+        slmath::vec4 *positions = new slmath::vec4[particlesCount];
+        std::vector<Spring> springs;
+        SceneGenerator::CreateCloths(positions, particlesCount, springs);
+
+        ParticlesSpring particlesSpring;
+        for (size_t i = 0; i < springs.size(); i++)
+        {
+            particlesSpring.AddSpring(springs[i]);
+        }
+
+        while (state.KeepRunning())
+        {
+            particlesSpring.Solve(positions, particlesCount);
+        }
+        state.SetItemsProcessed(static_cast<long long>(springs.size()));
+
+        delete[] positions;
+    }
+
+    void BenchmarkAccelerator(BenchmarkState& state)
+    {
+        const int particlesCount = state.GetParticlesCount();
+        slmath::vec4 *positions = new slmath::vec4[particlesCount];
+        SceneGenerator::CreateGalaxyClusters(positions, particlesCount);
+
+        // Attraction of the galaxy demo and a force field across the clusters
+        ParticlesAccelerator accelerator;
+        accelerator.AllocateAccelerations(particlesCount);
+        accelerator.Initialize();
+
+        Accelerator attraction;
+        attraction.m_Position   = slmath::vec4(0.0f);
+        attraction.m_Direction  = slmath::vec4(0.0f);
+        attraction.m_Radius     = 1000.0f;
+        attraction.m_Type       = 3;
+        accelerator.AddAccelerator(attraction);
+
+        Accelerator forceField;
+        forceField.m_Position   = slmath::vec4(20.0f, 0.0f, 0.0f, 0.0f);
+        forceField.m_Direction  = slmath::vec4(-10.0f, 0.0f, 0.0f, 0.0f);
+        forceField.m_Radius     = 50.0f;
+        forceField.m_Type       = 0;
+        accelerator.AddAccelerator(forceField);
+
+        while (state.KeepRunning())
+        {
+            accelerator.Accelerate(positions, particlesCount);
+        }
+
+        delete[] positions;
+    }
+}
+
+BENCHMARK_STAGE("Grid3D/Initialize/Water",                  BenchmarkCreateGridWater,           s_AllCounts);
+BENCHMARK_STAGE("Grid3D/Initialize/Galaxy",                 BenchmarkCreateGridGalaxy,          s_AllCounts);
+BENCHMARK_STAGE("Grid3D/Initialize/Rain",                   BenchmarkCreateGridRain,            s_AllCounts);
+BENCHMARK_STAGE("Grid3D/InitializeFullGrid/Water",          BenchmarkCreateFullGrid,            s_AllCounts);
+BENCHMARK_STAGE("Neighbors/ByParticleOrder/Water",          BenchmarkNeighborsByParticleOrder,  s_AllCounts);
+BENCHMARK_STAGE("Neighbors/ByParticleOrderHeuristic/Water", BenchmarkNeighborsHeuristic,        s_AllCounts);
+BENCHMARK_STAGE("Neighbors/ByParticleOrderFullGrid/Water",  BenchmarkNeighborsFullGrid,         s_AllCounts);
+// The search of an empty cell walks the sorted cells, too slow for the biggest scenes
+BENCHMARK_STAGE("Neighbors/ComputeHashNeighbors/Water",     BenchmarkNeighborsHash,             100000);
+BENCHMARK_STAGE("SPH/Simulate/Water",                       BenchmarkSPH,                       s_AllCounts);
+BENCHMARK_STAGE("Verlet/Integration/Water",                 BenchmarkIntegration,               s_AllCounts);
+BENCHMARK_STAGE("Collider/SatisfyCollisions/Water",         BenchmarkCollision,                 s_AllCounts);
+BENCHMARK_STAGE("Spring/Solve/Cloth",                       BenchmarkSpring,                    s_AllCounts);
+BENCHMARK_STAGE("Accelerator/Accelerate/Galaxy",            BenchmarkAccelerator,               s_AllCounts);
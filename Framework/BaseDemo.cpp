@@ -19,65 +19,57 @@
 
 
 
-slmath::vec4 BaseDemo::s_Colors[] = {   slmath::vec4(1.0f, 0.1f, 0.1f, 0.45f),
-                                        slmath::vec4(0.1f, 1.0f, 0.1f, 0.45f),
-                                        slmath::vec4(0.1f, 0.1f, 1.0f, 0.45f),
-                                        slmath::vec4(1.0f, 1.0f, 0.1f, 0.45f),
-                                        slmath::vec4(1.0f, 0.1f, 1.0f, 0.45f),
-                                        slmath::vec4(0.1f, 1.0f, 1.0f, 0.45f)
-                                    };
-
-const int BaseDemo::s_ColorCount = 6;
-
-BaseDemo::BaseDemo() : m_LightPosition(0.0f)
+BaseDemo::BaseDemo(BaseScene *scene) : m_Scene(scene)
 {
+    assert(m_Scene != NULL && "BaseDemo::BaseDemo failed.");
 }
 
-void BaseDemo::Simulate(float /*delatT = 1 / 60.0f*/)
+BaseDemo::~BaseDemo()
 {
-    m_PhysicsParticle.Simulate();
+    delete m_Scene;
 }
 
-void BaseDemo::IputKey(unsigned int /*wParam*/)
+void BaseDemo::Initialize()
 {
+    m_Scene->Initialize();
 }
 
-void BaseDemo::Release()
+void BaseDemo::Simulate(float delatT /*= 1 / 60.0f*/)
 {
-    m_PhysicsParticle.Release();
+    m_Scene->Simulate(delatT);
 }
 
-slmath::vec4 *BaseDemo::GetParticlePositions() const
+void BaseDemo::IputKey(unsigned int wParam)
 {
-    return reinterpret_cast<slmath::vec4 *>(m_PhysicsParticle.GetParticlePositions());
+    m_Scene->IputKey(wParam);
 }
 
-int BaseDemo::GetParticlesCount() const
+void BaseDemo::Release()
 {
-    return m_PhysicsParticle.GetParticlesCount();
+    m_Scene->Release();
 }
 
-bool BaseDemo::IsUsingInteroperability() const
+const slmath::vec3& BaseDemo::GetLightPosition() const
 {
-    return false;
+    return m_Scene->GetLightPosition();
 }
 
-const slmath::vec3& BaseDemo::GetLightPosition() const
+void BaseDemo::SetCamera(Camera *camera)
 {
-    return m_LightPosition;
+    m_Scene->SetCamera(camera);
 }
 
 void BaseDemo::InitializeGraphicsObjectToRender(DX11Renderer &renderer)
 {
-    renderer.InitializeParticles(GetParticlePositions(), GetParticlesCount(), 0, 0);
+    renderer.InitializeParticles(m_Scene->GetParticlePositions(), m_Scene->GetParticlesCount(), 0, 0);
 }
 
 // By default all physics particles but 0 mesh
 void BaseDemo::InitializeRenderer(DX11Renderer &renderer)
 {
-    const bool isUsingInteroperability = IsUsingInteroperability();
+    const bool isUsingInteroperability = m_Scene->IsUsingInteroperability();
     renderer.SetIsUsingInteroperability(isUsingInteroperability);
-    m_PhysicsParticle.SetIsUsingInteroperability(isUsingInteroperability);
+    m_Scene->GetPhysicsParticle(0).SetIsUsingInteroperability(isUsingInteroperability);
 
     InitializeGraphicsObjectToRender(renderer);
 
@@ -86,134 +78,19 @@ void BaseDemo::InitializeRenderer(DX11Renderer &renderer)
 
 void BaseDemo::InitializeOpenCL(DX11Renderer &renderer)
 {
-    m_PhysicsParticle.InitializeOpenCL(renderer.GetID3D11Device(), renderer.GetID3D11Buffer());
+    m_Scene->InitializeOpenCL(renderer.GetID3D11Device(), renderer.GetID3D11Buffer());
 }
 
 void BaseDemo::InitializeOpenClData()
 {
-    m_PhysicsParticle.InitializeOpenClData();
+    m_Scene->InitializeOpenClData();
 }
 
 void BaseDemo::Draw(DX11Renderer &renderer) const
 {
-    renderer.Render(GetParticlePositions(), GetParticlesCount());
-}
-
-float BaseDemo::Compress(const slmath::vec4 &vector)
-{
-    // Supported compression
-    assert(vector.x >= 0.0f && vector.x <= 1.0f);
-    assert(vector.y >= 0.0f && vector.y <= 1.0f);
-    assert(vector.z >= 0.0f && vector.z <= 1.0f);
-    // Size support from 0.0f to 51.0f
-    assert(vector.w >= 0.0f && vector.w <= 51.0f);
-
-    slmath::vec4 toCompress = vector;
-    unsigned int  v1 = unsigned int (toCompress.x * 0xFF);
-    unsigned int  v2 = unsigned int(toCompress.y * 0xFF);
-    unsigned int  v3 = unsigned int(toCompress.z * 0xFF);
-    unsigned int  v4 = unsigned int (toCompress.w * 5.0f);
-    
-    v1 =  v1 > 255 ? 255 : v1;
-    v2 =  v2 > 255 ? 255 : v2;
-    v3 =  v3 > 255 ? 255 : v3;
-    v4 =  v4 > 255 ? 255 : v4;
-   
-
-    unsigned int store = ((v1 & 0xFF) << 0) | ((v2 & 0xFF) << 8) | ((v3 & 0xFF) << 16) | ((v4 & 0xFF) << 24);
-    float returnValue = *reinterpret_cast<float*>(&store);
-
-    #ifdef DEBUG
-        slmath::vec4 original = UnCompress(returnValue);
-        const slmath::vec4 epsiolon(1.0f);
-        assert(original <= toCompress + epsiolon && original >= toCompress - epsiolon );
-    #endif // DEBUG
-
-    return returnValue;
-}
-
-slmath::vec4 BaseDemo::UnCompress(float value)
-{
-    unsigned int uncompress = *reinterpret_cast<unsigned int*>(&value);
-
-    unsigned int o1, o2, o3, o4;
-    o1 = (unsigned int) uncompress & 0xFF;
-    o2 = (unsigned int)(uncompress >> 8) & 0xFF;
-    o3 = (unsigned int)(uncompress >> 16) & 0xFF;
-    o4 = (unsigned int)(uncompress >> 24) & 0xFF;
-
-    slmath::vec4 vector(float(o1) / 255.0f,
-                        float(o2) / 255.0f,
-                        float(o3) / 255.0f,
-                        float(o4) / 5.0f);
-
-    return vector;
-}
-
-int BaseDemo::FillPositionFromXml(const std::string& fileName, const std::string& tag, slmath::vec4* positions, int positionsCount)
-{
-
-    const std::string assetFolder ="Asset/";
-    const std::string xmlExtension =".xml";
-    std::string fullPath = assetFolder + fileName + xmlExtension;
-    TiXmlDocument doc(fullPath.c_str());
-	doc.LoadFile();
-
-    int index = 0;
-    float depth = 0.0f;
-    positions[1] = slmath::vec4(0.0f);
-
-    TiXmlElement* currentPositionElement = doc.FirstChildElement( tag.c_str() );
-    TiXmlElement* firstPositionElement = currentPositionElement;
-    if ( currentPositionElement )
-    {
-        while (currentPositionElement != NULL && index < positionsCount)
-        {
-            TiXmlAttribute* attribute = currentPositionElement->FirstAttribute();
-
-            float x = 0, y = 0, z = 0;
-            while (attribute != NULL)
-            {
-                std::stringstream stream(attribute->Value());
-
-                if (stream.fail())
-                {
-                    continue;
-                }
-                
-                if (strcmp(  attribute->Name(), "x") == 0)
-                {
-                    stream >> x;
-                }
-                if (strcmp(  attribute->Name(), "y") == 0)
-                {
-                    stream >> y;
-                }
-                if (strcmp(  attribute->Name(), "z") == 0)
-                {
-                    stream >> z;
-                }
-                  
-                attribute = attribute->Next();
-            }
-            positions[index] = slmath::vec4(x, z + 200.0f, y + depth);
-
-            positions[index] -= positions[0];
-            positions[index] *= 0.2f;
-            currentPositionElement = currentPositionElement->NextSiblingElement();
-
-            if (currentPositionElement == NULL)
-            {
-                currentPositionElement = firstPositionElement;
-                depth += 2.0f;
-            }
-            index++;
-        }
-    }
-    return index;
+    renderer.Render(m_Scene->GetParticlePositions(), m_Scene->GetParticlesCount());
 }
 
-
 void BaseDemo::ConvertFiles()
 {
 
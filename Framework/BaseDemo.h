@@ -3,7 +3,7 @@
 #ifndef BASE_DEMO
 #define BASE_DEMO
 
-#include "ParticleEngine/PhysicsParticle.h"
+#include "BaseScene.h"
 #include <DX11Renderer.h>
 #include <slmath/slmath.h>
 #include <string>
@@ -12,18 +12,18 @@ class DX11Renderer;
 class Camera;
 
 
+// Draws a scene, by default the particles of its first simulation. The demo owns
+// the scene, the demos drawing more override the renderer methods
 class BaseDemo
 {
 public:
-    BaseDemo();
+    explicit BaseDemo(BaseScene *scene);
+    virtual ~BaseDemo();
 
-    virtual void Initialize() = 0;
-    virtual void Simulate(float delatT = 1 / 60.0f);
-    virtual void IputKey(unsigned int wParam);
-    virtual void Release();
-
-    virtual slmath::vec4 *GetParticlePositions() const;
-    virtual int GetParticlesCount() const;
+    void Initialize();
+    void Simulate(float delatT = 1 / 60.0f);
+    void IputKey(unsigned int wParam);
+    void Release();
 
     const slmath::vec3& GetLightPosition() const;
 
@@ -34,26 +34,21 @@ public:
     void InitializeOpenClData();
 
     // Camera
-    virtual void SetCamera(Camera *) {}
+    void SetCamera(Camera *camera);
 
-    static float Compress(const slmath::vec4 &vector);
-    static slmath::vec4 UnCompress(float value);
-    static int FillPositionFromXml(const std::string& fileName, const std::string& tag, slmath::vec4* positions, int positionsCount);
     static void ConvertFiles();
 
 
 protected:
     virtual void InitializeGraphicsObjectToRender(DX11Renderer &renderer);
-    virtual bool IsUsingInteroperability() const;
     virtual void InitializeOpenCL(DX11Renderer &renderer);
 
 protected:
-    PhysicsParticle m_PhysicsParticle;
-    static slmath::vec4 s_Colors [6];
-    static const int s_ColorCount;
-    
-    slmath::vec3 m_LightPosition;
+    BaseScene *m_Scene;
 
+private:
+    BaseDemo(const BaseDemo&);
+    BaseDemo& operator=(const BaseDemo&);
 };
 
 
@@ -0,0 +1,211 @@
+#include "BaseScene.h"
+#include "Utility/Profiler.h"
+#include "Utility/Utility.h"
+
+#include "Parser/tinyxml.h"
+
+#include <assert.h>
+#include <cstring>
+#include <sstream>
+
+
+slmath::vec4 BaseScene::s_Colors[] = {  slmath::vec4(1.0f, 0.1f, 0.1f, 0.45f),
+                                        slmath::vec4(0.1f, 1.0f, 0.1f, 0.45f),
+                                        slmath::vec4(0.1f, 0.1f, 1.0f, 0.45f),
+                                        slmath::vec4(1.0f, 1.0f, 0.1f, 0.45f),
+                                        slmath::vec4(1.0f, 0.1f, 1.0f, 0.45f),
+                                        slmath::vec4(0.1f, 1.0f, 1.0f, 0.45f)
+                                    };
+
+const int BaseScene::s_ColorCount = 6;
+
+BaseScene::BaseScene() : m_LightPosition(0.0f), m_IsUsingWallClock(true), m_Random(1)
+{
+}
+
+void BaseScene::Simulate(float delatT /*= 1 / 60.0f*/)
+{
+    m_PhysicsParticle.Simulate(delatT);
+}
+
+void BaseScene::IputKey(unsigned int /*wParam*/)
+{
+}
+
+void BaseScene::Release()
+{
+    m_PhysicsParticle.Release();
+}
+
+void BaseScene::InitializeOpenCL(ID3D11Device *d3D11Device /*= NULL*/, ID3D11Buffer *d3D11buffer /*= NULL*/)
+{
+    // The queue commands are timed only for a trace
+    m_PhysicsParticle.SetEnableQueueProfiling(Profiler::GetInstance()->IsTracing());
+    m_PhysicsParticle.InitializeOpenCL(d3D11Device, d3D11buffer);
+}
+
+void BaseScene::InitializeOpenClData()
+{
+    m_PhysicsParticle.InitializeOpenClData();
+}
+
+slmath::vec4 *BaseScene::GetParticlePositions() const
+{
+    return reinterpret_cast<slmath::vec4 *>(m_PhysicsParticle.GetParticlePositions());
+}
+
+int BaseScene::GetParticlesCount() const
+{
+    return m_PhysicsParticle.GetParticlesCount();
+}
+
+int BaseScene::GetPhysicsParticlesCount() const
+{
+    return 1;
+}
+
+PhysicsParticle& BaseScene::GetPhysicsParticle(int index)
+{
+    assert(index == 0 && "BaseScene::GetPhysicsParticle failed.");
+    UNUSED_PARAMETER(index);
+    return m_PhysicsParticle;
+}
+
+bool BaseScene::IsUsingInteroperability() const
+{
+    return false;
+}
+
+const slmath::vec3& BaseScene::GetLightPosition() const
+{
+    return m_LightPosition;
+}
+
+void BaseScene::SetIsUsingWallClock(bool isUsingWallClock)
+{
+    m_IsUsingWallClock = isUsingWallClock;
+}
+
+void BaseScene::SetRandomSeed(unsigned int seed)
+{
+    m_Random = slmath::random(static_cast<int>(seed));
+}
+
+int BaseScene::GetRandom()
+{
+    return m_Random.randomInt() & 0x7fffffff;
+}
+
+float BaseScene::Compress(const slmath::vec4 &vector)
+{
+    // Supported compression
+    assert(vector.x >= 0.0f && vector.x <= 1.0f);
+    assert(vector.y >= 0.0f && vector.y <= 1.0f);
+    assert(vector.z >= 0.0f && vector.z <= 1.0f);
+    // Size support from 0.0f to 51.0f
+    assert(vector.w >= 0.0f && vector.w <= 51.0f);
+
+    slmath::vec4 toCompress = vector;
+    unsigned int  v1 = static_cast<unsigned int>(toCompress.x * 0xFF);
+    unsigned int  v2 = static_cast<unsigned int>(toCompress.y * 0xFF);
+    unsigned int  v3 = static_cast<unsigned int>(toCompress.z * 0xFF);
+    unsigned int  v4 = static_cast<unsigned int>(toCompress.w * 5.0f);
+    
+    v1 =  v1 > 255 ? 255 : v1;
+    v2 =  v2 > 255 ? 255 : v2;
+    v3 =  v3 > 255 ? 255 : v3;
+    v4 =  v4 > 255 ? 255 : v4;
+   
+
+    unsigned int store = ((v1 & 0xFF) << 0) | ((v2 & 0xFF) << 8) | ((v3 & 0xFF) << 16) | ((v4 & 0xFF) << 24);
+    float returnValue = *reinterpret_cast<float*>(&store);
+
+    #ifdef DEBUG
+        slmath::vec4 original = UnCompress(returnValue);
+        const slmath::vec4 epsiolon(1.0f);
+        assert(original <= toCompress + epsiolon && original >= toCompress - epsiolon );
+    #endif // DEBUG
+
+    return returnValue;
+}
+
+slmath::vec4 BaseScene::UnCompress(float value)
+{
+    unsigned int uncompress = *reinterpret_cast<unsigned int*>(&value);
+
+    unsigned int o1, o2, o3, o4;
+    o1 = (unsigned int) uncompress & 0xFF;
+    o2 = (unsigned int)(uncompress >> 8) & 0xFF;
+    o3 = (unsigned int)(uncompress >> 16) & 0xFF;
+    o4 = (unsigned int)(uncompress >> 24) & 0xFF;
+
+    slmath::vec4 vector(float(o1) / 255.0f,
+                        float(o2) / 255.0f,
+                        float(o3) / 255.0f,
+                        float(o4) / 5.0f);
+
+    return vector;
+}
+
+int BaseScene::FillPositionFromXml(const std::string& fileName, const std::string& tag, slmath::vec4* positions, int positionsCount)
+{
+
+    const std::string assetFolder ="Asset/";
+    const std::string xmlExtension =".xml";
+    std::string fullPath = assetFolder + fileName + xmlExtension;
+    TiXmlDocument doc(fullPath.c_str());
+	doc.LoadFile();
+
+    int index = 0;
+    float depth = 0.0f;
+    positions[1] = slmath::vec4(0.0f);
+
+    TiXmlElement* currentPositionElement = doc.FirstChildElement( tag.c_str() );
+    TiXmlElement* firstPositionElement = currentPositionElement;
+    if ( currentPositionElement )
+    {
+        while (currentPositionElement != NULL && index < positionsCount)
+        {
+            TiXmlAttribute* attribute = currentPositionElement->FirstAttribute();
+
+            float x = 0, y = 0, z = 0;
+            while (attribute != NULL)
+            {
+                std::stringstream stream(attribute->Value());
+
+                if (stream.fail())
+                {
+                    continue;
+                }
+                
+                if (strcmp(  attribute->Name(), "x") == 0)
+                {
+                    stream >> x;
+                }
+                if (strcmp(  attribute->Name(), "y") == 0)
+                {
+                    stream >> y;
+                }
+                if (strcmp(  attribute->Name(), "z") == 0)
+                {
+                    stream >> z;
+                }
+                  
+                attribute = attribute->Next();
+            }
+            positions[index] = slmath::vec4(x, z + 200.0f, y + depth);
+
+            positions[index] -= positions[0];
+            positions[index] *= 0.2f;
+            currentPositionElement = currentPositionElement->NextSiblingElement();
+
+            if (currentPositionElement == NULL)
+            {
+                currentPositionElement = firstPositionElement;
+                depth += 2.0f;
+            }
+            index++;
+        }
+    }
+    return index;
+}
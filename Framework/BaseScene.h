@@ -0,0 +1,67 @@
+#ifndef BASE_SCENE
+#define BASE_SCENE
+
+#include "ParticleEngine/PhysicsParticle.h"
+#include <slmath/slmath.h>
+#include <string>
+
+class Camera;
+
+
+// Physics of a demo without any renderer, a BaseDemo draws it and the headless
+// replay runs it alone
+class BaseScene
+{
+public:
+    BaseScene();
+    virtual ~BaseScene() {}
+
+    virtual void Initialize() = 0;
+    virtual void Simulate(float delatT = 1 / 60.0f);
+    virtual void IputKey(unsigned int wParam);
+    virtual void Release();
+
+    // OpenCL of every simulation, the buffer is the renderer one with interoperability
+    virtual void InitializeOpenCL(ID3D11Device *d3D11Device = NULL, ID3D11Buffer *d3D11buffer = NULL);
+    void InitializeOpenClData();
+
+    virtual slmath::vec4 *GetParticlePositions() const;
+    virtual int GetParticlesCount() const;
+
+    // Every simulation of the scene, the first one is drawn by default
+    virtual int GetPhysicsParticlesCount() const;
+    virtual PhysicsParticle& GetPhysicsParticle(int index);
+
+    virtual bool IsUsingInteroperability() const;
+    virtual void SetCamera(Camera *) {}
+
+    const slmath::vec3& GetLightPosition() const;
+
+    // Scenes scripted on the wall clock follow the simulated time instead when
+    // disabled, enabled by default
+    void SetIsUsingWallClock(bool isUsingWallClock);
+
+    // Seed of the generators placing the particles, to call before Initialize.
+    // A seed gives the same scene with every C runtime, 1 by default
+    void SetRandomSeed(unsigned int seed);
+
+    static float Compress(const slmath::vec4 &vector);
+    static slmath::vec4 UnCompress(float value);
+    static int FillPositionFromXml(const std::string& fileName, const std::string& tag, slmath::vec4* positions, int positionsCount);
+
+protected:
+    // Positive random number of the scene generator, in place of rand
+    int GetRandom();
+
+    PhysicsParticle m_PhysicsParticle;
+    static slmath::vec4 s_Colors [6];
+    static const int s_ColorCount;
+    
+    slmath::vec3 m_LightPosition;
+    bool m_IsUsingWallClock;
+    slmath::random m_Random;
+};
+
+
+
+#endif // BASE_SCENE
@@ -5,10 +5,10 @@ const float Camera::speedRotation = 6.0f;
 
 
 Camera::Camera()
- : m_DistanceFromTarget(20.0f)
+ : m_Position(0,800,0)
+ , m_DistanceFromTarget(20.0f)
  , m_AngleHeight(0.0f)
  , m_AngleHorizon(0.0f)
- , m_Position(0,800,0)
 {
 }
 
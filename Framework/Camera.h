@@ -52,4 +52,4 @@ public:
 	virtual void moveLeft(float distance);
 };
 
-#endif CAMERA_H
+#endif // CAMERA_H
@@ -1,28 +1,23 @@
-
 #ifndef RAIN_DEMO
 #define RAIN_DEMO
 
 #include "../BaseDemo.h"
-#include "ParticleEngine/PhysicsParticle.h"
-
-#include <slmath/slmath.h>
+#include "../Scenes/RainScene.h"
 
+// Draws the spheres of the rain scene under the particles
 class RainDemo : public BaseDemo
 {
 public:
-    virtual void Initialize();
-    virtual void Release();
+    RainDemo();
 
     virtual void Draw(DX11Renderer &renderer) const;
 
 protected:
     virtual void InitializeGraphicsObjectToRender(DX11Renderer &renderer);
-    virtual bool IsUsingInteroperability() const;
 
 private:
-    slmath::vec4 *m_Spheres;
-    vrAccelerator m_Accelerator;
+    const RainScene *m_RainScene;
 };
 
 
-#endif // RAIN_DEMO
\ No newline at end of file
+#endif // RAIN_DEMO
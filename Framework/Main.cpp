@@ -13,14 +13,14 @@
 
 #include "Camera.h"
 #include "BaseDemo.h"
-#include "Demos/WaterDemo.h"
-#include "Demos/TestGrid.h"
+#include "Scenes/WaterScene.h"
+#include "Scenes/TestGridScene.h"
+#include "Scenes/GalaxyScene.h"
+#include "Scenes/AnimationScene.h"
 #include "Demos/ClothDemo.h"
-#include "Demos/GalaxyDemo.h"
 #include "Demos/RainDemo.h"
-#include "Demos/Animation.h"
 #include "Demos/SimulationsTransition.h"
-#include "Utility/Timer.h"
+#include "Utility/Profiler.h"
 #include "Utility/Utility.h"
  
 
@@ -68,11 +68,17 @@ unsigned int __stdcall PlayASound(DX11Sound* sound)
 int WINAPI wWinMain( HINSTANCE hInstance, HINSTANCE hPrevInstance, LPWSTR lpCmdLine, int nCmdShow )
 {
     UNREFERENCED_PARAMETER( hPrevInstance );
-    UNREFERENCED_PARAMETER( lpCmdLine );
 
     if( FAILED( InitWindow( hInstance, nCmdShow ) ) )
         return 0;
 
+    // -trace streams the profiled frames to a file for chrome://tracing or ui.perfetto.dev
+    Profiler::GetInstance()->SetThreadName("Main thread");
+    if (wcsstr(lpCmdLine, L"-trace") != NULL)
+    {
+        Profiler::GetInstance()->StartTrace("ParticleEngineTrace.json");
+    }
+
     
     // Time
     LARGE_INTEGER startTime;
@@ -83,14 +89,14 @@ int WINAPI wWinMain( HINSTANCE hInstance, HINSTANCE hPrevInstance, LPWSTR lpCmdL
     camera.setDistanceFromTarget(100.0f);
 
     // Init demo
-    Timer::GetInstance()->StartTimerProfile();
-    baseDemo = new WaterDemo;
+    PROFILE_BEGIN();
+    baseDemo = new BaseDemo(new WaterScene);
     baseDemo->SetCamera(&camera);
     baseDemo->Initialize();
-    Timer::GetInstance()->StopTimerProfile("Init demo");
+    PROFILE_END("Init demo");
 
 
-    Timer::GetInstance()->StartTimerProfile();
+    PROFILE_BEGIN();
     if( FAILED( renderer.Initialize(g_hWnd) ) )
     {
         renderer.Release();
@@ -99,7 +105,7 @@ int WINAPI wWinMain( HINSTANCE hInstance, HINSTANCE hPrevInstance, LPWSTR lpCmdL
     renderer.BeginFrame();
     renderer.EndFrame();
     baseDemo->InitializeRenderer(renderer);
-    Timer::GetInstance()->StopTimerProfile("Init rendering");
+    PROFILE_END("Init rendering");
 
     slmath::mat4 viewMatrix;
     
@@ -109,10 +115,8 @@ int WINAPI wWinMain( HINSTANCE hInstance, HINSTANCE hPrevInstance, LPWSTR lpCmdL
     _beginthreadex( NULL, 0, (unsigned int (__stdcall *)(void *))(&PlayASound), &sound, 0, 0);
 
 
-    // Start a global timer that will be always present
-    Timer::GetInstance()->StartTimer();
-    // Start timer for FPS and frame duration computation
-    Timer::GetInstance()->StartTimer();
+    // Start of the frame for FPS and frame duration computation
+    long long frameStart = Profiler::GetTicks();
 
     // Main message loop
     MSG msg = {0};
@@ -164,25 +168,23 @@ int WINAPI wWinMain( HINSTANCE hInstance, HINSTANCE hPrevInstance, LPWSTR lpCmdL
             if (!isPaused || isStepping)
             {
                 // Calculate frame duration 
-                float frameDuration = Timer::GetInstance()->StopTimer();
+                float frameDuration = static_cast<float>((Profiler::GetTicks() - frameStart) / (Profiler::GetTicksPerMillisecond() * 1000.0));
 
                 
                 const float fastestFrameDuration = (1.0f / 60.0f);
 
                 float timeToSleep = slmath::max(fastestFrameDuration - frameDuration, 0.0f);
-                Timer::GetInstance()->StartTimer();
                 if (timeToSleep > 0.0f)
                 {
                     Sleep( DWORD(timeToSleep * 1000.0f));
                 }
-                // float sleepingTime = Timer::GetInstance()->StopTimer();
                 // else
                 {
                     float fps = 1.0f / frameDuration;
                     DEBUG_OUT("FPS :\t" << fps << "\tFrame duration:\t" << frameDuration /*<<  "Sleeping time: "<< sleepingTime << "Time to sleep : "<< timeToSleep*/ <<"\n");
                 }
                 // Start loop timer
-                Timer::GetInstance()->StartTimer();
+                frameStart = Profiler::GetTicks();
 
                 baseDemo->Simulate(frameDuration + timeToSleep);
                 isStepping = false;
@@ -190,7 +192,7 @@ int WINAPI wWinMain( HINSTANCE hInstance, HINSTANCE hPrevInstance, LPWSTR lpCmdL
 
             if (!isPaused)
             {
-                Timer::GetInstance()->StartTimerProfile();
+                PROFILE_BEGIN();
             }
             
             slmath::vec4 vec4CameraPosition = camera.getPosition();
@@ -206,12 +208,19 @@ int WINAPI wWinMain( HINSTANCE hInstance, HINSTANCE hPrevInstance, LPWSTR lpCmdL
             renderer.EndFrame();
             if (!isPaused)
             {
-                Timer::GetInstance()->StopTimerProfile("Renderer");
+                PROFILE_END("Renderer");
+
+                // Zones of the simulated and rendered frame
+                Profiler::GetInstance()->EndFrame();
+#ifndef PROFILER_DISABLED
+                Profiler::GetInstance()->OutputFrame();
+#endif // PROFILER_DISABLED
             }
 
         }
     }
 
+    Profiler::GetInstance()->StopTrace();
     renderer.Release();
     sound.Shutdown();
 
@@ -262,11 +271,11 @@ void InitNewDemo(BaseDemo *newDemo)
     baseDemo->Release();
     delete baseDemo;
     baseDemo = newDemo;
-    Timer::GetInstance()->StartTimerProfile();
+    PROFILE_BEGIN();
     baseDemo->SetCamera(&camera);
     baseDemo->Initialize();
-    Timer::GetInstance()->StopTimerProfile("Init demo");
-    Timer::GetInstance()->StartTimerProfile();
+    PROFILE_END("Init demo");
+    PROFILE_BEGIN();
     renderer.Release();
     if( FAILED( renderer.Initialize(g_hWnd) ) )
     {
@@ -275,7 +284,7 @@ void InitNewDemo(BaseDemo *newDemo)
 	}
     baseDemo->InitializeRenderer(renderer);
     baseDemo->SetCamera(&camera);
-    Timer::GetInstance()->StopTimerProfile("Init rendering");
+    PROFILE_END("Init rendering");
 }
 
 void IputKey(WPARAM wParam)
@@ -308,22 +317,22 @@ void IputKey(WPARAM wParam)
         break;
 
     case VK_NUMPAD1:
-        InitNewDemo(new WaterDemo);
+        InitNewDemo(new BaseDemo(new WaterScene));
         break;
     case VK_NUMPAD2:
-        InitNewDemo(new TestGrid);
+        InitNewDemo(new BaseDemo(new TestGridScene));
         break;
     case VK_NUMPAD3:
         InitNewDemo(new ClothDemo);
         break;
     case VK_NUMPAD4:
-        InitNewDemo(new GalaxyDemo);
+        InitNewDemo(new BaseDemo(new GalaxyScene));
         break;
     case VK_NUMPAD5:
         InitNewDemo(new RainDemo);
         break;
     case VK_NUMPAD6:
-        InitNewDemo(new Animation);
+        InitNewDemo(new BaseDemo(new AnimationScene));
         break;
     case VK_NUMPAD7:
         InitNewDemo(new SimulationsTransition);
@@ -1,186 +1,11 @@
-#include "Animation.h"
+#include "AnimationScene.h"
 
 #include <slmath/slmath.h>
 #include <stdlib.h>
 #include <string>
 
-namespace
-{
-    class Emiter
-    {
-        public:
-            Emiter();
-            void Initialize(vrVec4 *particlesPosition, int pariclesCount);
-
-            void Update();
-
-        private:
-            int m_ActiveParticlesCount;
-            int m_ActiveParticlesIncrement;
-            float m_TimeDurantion;
-            vrVec4 *m_ParticlesPosition;
-            int m_ParticlesCount;
-            slmath::vec3 m_AreaCreation;
-
-            slmath::vec3 *m_Velocties;
-            slmath::vec3 *m_Accelerations;
-
-    };
-
-    Emiter::Emiter():   m_ActiveParticlesCount(0),
-                        m_ActiveParticlesIncrement(100),
-                        m_TimeDurantion(0.0f),
-                        m_ParticlesPosition(NULL),
-                        m_ParticlesCount(0),
-                        m_AreaCreation(10000.0f, 0.0f, 1000.0f)
-    {
-    }
-
-    void Emiter::Initialize(vrVec4 *particlesPosition, int pariclesCount)
-    {
-        m_ParticlesPosition = particlesPosition;
-        m_ParticlesCount    = pariclesCount;
-        for (int i = 0; i < m_ParticlesCount; i++)
-        {
-            vrVec4 &position = m_ParticlesPosition[i];
-            position.w = 0.0f;
-        }
-    }
-
-    void Emiter::Update()
-    {
-        // Create new particles
-        for (int i = m_ActiveParticlesCount; i < m_ActiveParticlesCount + m_ActiveParticlesIncrement; i++)
-        {
-            vrVec4 &position = m_ParticlesPosition[i];
-            position.w = 0.002f;
-
-            float sin, cos;
-            position.x = float(rand() % int(m_AreaCreation.x) - int(m_AreaCreation.x) / 2) * 0.01f;
-            slmath::sincos(position.x + m_TimeDurantion, &sin, &cos);
-            position.y = sin;
-            position.z = 0.0f; // float(rand() % int(m_AreaCreation.z) - int(m_AreaCreation.z) / 2) * 0.01f;
-        }
-
-        for (int i = 0; i < m_ParticlesCount; i++)
-        {
-            vrVec4 &position = m_ParticlesPosition[i];
-            position.y += 0.1f;
-        }
-
-        m_ActiveParticlesCount += m_ActiveParticlesIncrement;
-
-        if (m_ActiveParticlesCount + m_ActiveParticlesIncrement >= m_ParticlesCount)
-        {
-            for (int i = m_ActiveParticlesCount; i < m_ParticlesCount; i++)
-            {
-                vrVec4 &position = m_ParticlesPosition[i];
-                position.w = 0.0f;
-            }
-            m_ActiveParticlesCount = 0;
-        }
 
-        m_TimeDurantion += 1.0f / 60.0f;
-    }
-
-
-    class Transformer
-    {
-        public:
-            Transformer();
-            void Initialize(const slmath::vec4 *startPositions, 
-                            const slmath::vec4 *endPositions, 
-                            slmath::vec4 *positions, 
-                            int           positionCount);
-
-            void Initialize(const slmath::vec4 *startPositions, 
-                            const slmath::vec4 *endPositions,
-                            float currentStep = 0.0f);
-
-            void Update(float step, float delay = 0.0f);
-            float GetCurrentStep() const;
-            void SetCurrentStep(const float currentStep);
-
-        private:
-            const slmath::vec4 *m_StartPositions;
-            const slmath::vec4 *m_EndPositions;
-            slmath::vec4 *m_Positions;
-            int           m_ParticlesCount;
-            float         m_CurrentStep;
-    };
-
-    Transformer::Transformer() :    m_StartPositions(NULL), 
-                                    m_EndPositions(NULL), 
-                                    m_Positions(NULL), 
-                                    m_ParticlesCount(0),
-                                    m_CurrentStep(0)
-    {
-    }
-
-    void Transformer::Initialize(const slmath::vec4 *startPositions, 
-                                 const slmath::vec4 *endPositions, 
-                                 slmath::vec4 *positions, 
-                                 int           particlesCount)
-    {
-        m_StartPositions    = startPositions;
-        m_EndPositions      = endPositions;
-        m_Positions         = positions;
-        m_ParticlesCount    = particlesCount;
-        m_CurrentStep       = 0.0f;
-    }
-
-    void Transformer::Initialize(const slmath::vec4 *startPositions, const slmath::vec4 *endPositions, float currentStep /* = 0.0f */)
-    {
-        assert(m_Positions != NULL);
-        m_StartPositions    = startPositions;
-        m_EndPositions      = endPositions;
-        m_CurrentStep       = currentStep;
-    }
-
-
-    void Transformer::Update(float step, float delay)
-    {
-        m_CurrentStep += step;
-        float currentStep = slmath::saturate(m_CurrentStep);
-        
-        for (int i = 0; i < m_ParticlesCount; i++)
-        {
-            float iCurrentStep = m_CurrentStep + (float(i) / float(m_ParticlesCount)) * delay;
-            iCurrentStep = slmath::saturate(iCurrentStep);
-
-            slmath::vec4 startColor = BaseDemo::UnCompress(m_StartPositions[i].w);
-            slmath::vec4 endColor   = BaseDemo::UnCompress(m_EndPositions[i].w);
-            slmath::vec4 currentColor = startColor * (1.0f - currentStep) + endColor * currentStep;
-
-            slmath::vec4 startPosition = m_StartPositions[i];
-            startPosition.w = 0.0f;
-
-            slmath::vec4 endPosition = m_EndPositions[i];
-            endPosition.w = 0.0f;
-
-            m_Positions[i] = startPosition * (1.0f - iCurrentStep) + endPosition * iCurrentStep;
-
-
-            m_Positions[i].w = BaseDemo::Compress(currentColor);
-        }        
-    }
-
-    float Transformer::GetCurrentStep()const
-    {
-        return m_CurrentStep;
-    }
-
-    void Transformer::SetCurrentStep(const float currentStep)
-    {
-        m_CurrentStep = currentStep;
-    }
-
-    Emiter      m_Emiter;
-    Transformer m_Transformer;
-}
-
-
-void Animation::Initialize()
+void AnimationScene::Initialize()
 {
 
     m_AmimationTime = 0.0f;
@@ -236,9 +61,9 @@ void Animation::Initialize()
             for (int k = 0; k < sideBox; k++)
             {
                 assert(index < particlesCount );
-                m_StartPositions[index] = slmath::vec4( (i - halfSideBox) * spaceBetweenParticles + float (rand() % 10) * 3.3f , 
-                                                        (j - halfSideBox) * spaceBetweenParticles + float (rand() % 10) * 3.3f, 
-                                                        (k - halfSideBox) * spaceBetweenParticles + float (rand() % 10) * 3.3f);
+                m_StartPositions[index] = slmath::vec4( (i - halfSideBox) * spaceBetweenParticles + float (GetRandom() % 10) * 3.3f , 
+                                                        (j - halfSideBox) * spaceBetweenParticles + float (GetRandom() % 10) * 3.3f, 
+                                                        (k - halfSideBox) * spaceBetweenParticles + float (GetRandom() % 10) * 3.3f);
 
                // float floatIndex = float (index);
                //  m_StartPositions[index] = slmath::vec4( 10.0f * cos(5.0f * floatIndex / particlesCount), floatIndex / 20.0f, 10.0f * floatIndex * sin( 5.0f * floatIndex / particlesCount));
@@ -259,8 +84,8 @@ void Animation::Initialize()
     }
 
     int newSize = particlesCount;
-    BaseDemo::FillPositionFromXml(std::string("people"), std::string("noi:GEO_POINT"), reinterpret_cast<slmath::vec4*>(m_StartPositions), newSize);
-//    BaseDemo::FillPositionFromXml(std::string("chris"), std::string("vector"), reinterpret_cast<slmath::vec4*>(m_StartPositions), newSize);
+    BaseScene::FillPositionFromXml(std::string("people"), std::string("noi:GEO_POINT"), reinterpret_cast<slmath::vec4*>(m_StartPositions), newSize);
+//    BaseScene::FillPositionFromXml(std::string("chris"), std::string("vector"), reinterpret_cast<slmath::vec4*>(m_StartPositions), newSize);
 
     const float pi2 = 6.28318530f;
     const float pi = pi2 / 2.0f;
@@ -479,18 +304,11 @@ void Animation::Initialize()
      m_PhysicsParticle.Initialize(reinterpret_cast<vrVec4*>(m_StartPositions), particlesCount);
 
      m_ParticleToAdd = 0;
-
-     // m_Emiter.Initialize(m_PhysicsParticle.GetParticlePositions() + (sideBox * sideBox), sideBox);
-
-     slmath::vec4 * particles = reinterpret_cast<slmath::vec4*> (m_PhysicsParticle.GetParticlePositions());
-
-     m_Transformer.Initialize(m_StartPositions, m_ParametricSphere, particles, sqrShapesCount * sqrShapesCount
-     );
 }
 
-void Animation::Release()
+void AnimationScene::Release()
 {
-    BaseDemo::Release();
+    BaseScene::Release();
     delete[] m_StartPositions;
     delete[] m_ParametricSphere;
     delete[] m_ParametricCone;
@@ -507,10 +325,8 @@ void Animation::Release()
 
 
 
-void Animation::Simulate(float /*delatT*/)
+void AnimationScene::Simulate(float /*delatT*/)
 {
-    m_Transition;
-
     m_AmimationTime += 0.01f;
 
     if (m_Transition % 2 == 0 && m_AmimationTime >= 1.1f)
@@ -547,12 +363,12 @@ void Animation::Simulate(float /*delatT*/)
 
 }
 
-void Animation::IputKey(unsigned int /*wParam*/)
+void AnimationScene::IputKey(unsigned int /*wParam*/)
 {
 }
 
 
-bool Animation::IsUsingInteroperability() const
+bool AnimationScene::IsUsingInteroperability() const
 {
     return true;
 }
\ No newline at end of file
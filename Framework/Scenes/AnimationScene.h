@@ -1,11 +1,11 @@
 
-#ifndef ANIMATION
-#define ANIMATION
+#ifndef ANIMATION_SCENE
+#define ANIMATION_SCENE
 
-#include "../BaseDemo.h"
+#include "../BaseScene.h"
 #include "ParticleEngine/PhysicsParticle.h"
 
-class Animation : public BaseDemo
+class AnimationScene : public BaseScene
 {
 public:
     virtual void Initialize();
@@ -39,4 +39,4 @@ private:
 };
 
 
-#endif // ANIMATION
\ No newline at end of file
+#endif // ANIMATION_SCENE
\ No newline at end of file
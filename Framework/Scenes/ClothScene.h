@@ -0,0 +1,48 @@
+#ifndef CLOTH_SCENE
+#define CLOTH_SCENE
+
+#include "../BaseScene.h"
+#include "ParticleEngine/PhysicsParticle.h"
+#include <slmath/slmath.h>
+
+
+// Two cloth simulations, the second one is simulated by another thread
+class ClothScene : public BaseScene
+{
+public:
+    virtual void Initialize();
+    virtual void Release();
+
+    virtual void Simulate(float delatT /*=  1 / 60.0f */);
+    virtual void IputKey(unsigned int wParam);
+    virtual void InitializeOpenCL(ID3D11Device *d3D11Device = NULL, ID3D11Buffer *d3D11buffer = NULL);
+
+    virtual int GetPhysicsParticlesCount() const;
+    virtual PhysicsParticle& GetPhysicsParticle(int index);
+
+    int GetSideCloth() const;
+    int GetMaxClothCount() const;
+    // Sphere of the accelerator, the w is the compressed color and radius
+    const slmath::vec4 *GetSpheres() const;
+
+private:
+
+    void CreateCloth(PhysicsParticle *physicsParticle, const slmath::vec3& globalPosition, int clothCount, bool isUsingCPU);
+    void CreateSpring(PhysicsParticle *physicsParticle, int index1, int index2, slmath::vec4 *startPositions);
+    void UpdateSphere();
+
+
+    int m_SideCloth;
+    int m_ClothCount1;
+    int m_ClothCount2;
+
+
+    slmath::vec4* m_Spheres;
+    vrAccelerator m_Accelerator;
+
+    PhysicsParticle m_PhysicsParticle2;
+
+};
+
+
+#endif // CLOTH_SCENE
\ No newline at end of file
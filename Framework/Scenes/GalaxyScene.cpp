@@ -1,9 +1,9 @@
-#include "GalaxyDemo.h"
+#include "GalaxyScene.h"
 
 #include <slmath/slmath.h>
 #include <stdlib.h>
 
-void GalaxyDemo::Initialize()
+void GalaxyScene::Initialize()
 {
 
 const int length = 4;
@@ -34,11 +34,11 @@ const float spaceBetweenParticles = 0.2f;
             for (int k = 0; k < sideBox; k++)
             {
                 assert(index < particlesCount );
-                startPositions[index] = slmath::vec4( (i - halfSideBox) * spaceBetweenParticles + float (rand() % 10) * 3.1f , 
-                                                        (j - halfSideBox) * spaceBetweenParticles + float (rand() % 10) * 3.1f, 
-                                                        (k - halfSideBox) * spaceBetweenParticles + float (rand() % 10) * 3.1f);
+                startPositions[index] = slmath::vec4( (i - halfSideBox) * spaceBetweenParticles + float (GetRandom() % 10) * 3.1f , 
+                                                        (j - halfSideBox) * spaceBetweenParticles + float (GetRandom() % 10) * 3.1f, 
+                                                        (k - halfSideBox) * spaceBetweenParticles + float (GetRandom() % 10) * 3.1f);
 
-                startPositions[index] += slmath::vec4(float((rand() % 100 - 50) * 0.1f));
+                startPositions[index] += slmath::vec4(float((GetRandom() % 100 - 50) * 0.1f));
 
 
                 startPositions[index].w =  Compress(colors[index % 3]);
@@ -104,23 +104,23 @@ const float spaceBetweenParticles = 0.2f;
      m_ParticleToAdd = 0;
 }
 
-void GalaxyDemo::IputKey(unsigned int wParam)
+void GalaxyScene::IputKey(unsigned int wParam)
 {
 
     const float speedAccelerator = 1.0f;
     const float radiusAccelerator = 100.0f;
     switch (wParam)
     {
-        case VK_DOWN:
+        case 0x28: // Down
             m_Accelerator.m_Radius-= radiusAccelerator;
             break;
-        case VK_UP:
+        case 0x26: // Up
             m_Accelerator.m_Radius += radiusAccelerator;
             break;
-        case VK_RIGHT:
+        case 0x27: // Right
             m_Accelerator.m_Position.x += speedAccelerator;
             break;
-        case VK_LEFT:
+        case 0x25: // Left
             m_Accelerator.m_Position.x -= speedAccelerator;
             break;
     }
@@ -130,7 +130,7 @@ void GalaxyDemo::IputKey(unsigned int wParam)
 }
 
 
-void GalaxyDemo::PositionSphere(slmath::vec4 *startPositions, int particlesCount)
+void GalaxyScene::PositionSphere(slmath::vec4 *startPositions, int particlesCount)
 {
     int lod = 400; // 260;
     int latitudeCount = lod;
@@ -182,7 +182,7 @@ void GalaxyDemo::PositionSphere(slmath::vec4 *startPositions, int particlesCount
     }
 }
 
-bool GalaxyDemo::IsUsingInteroperability() const
+bool GalaxyScene::IsUsingInteroperability() const
 {
     return true;
 }
@@ -1,17 +1,15 @@
 
-#ifndef GALAXY_DEMO
-#define GALAXY_DEMO
+#ifndef GALAXY_SCENE
+#define GALAXY_SCENE
 
-#include "../BaseDemo.h"
+#include "../BaseScene.h"
 #include "ParticleEngine/PhysicsParticle.h"
 
-class GalaxyDemo : public BaseDemo
+class GalaxyScene : public BaseScene
 {
 public:
     virtual void Initialize();
     virtual void IputKey(unsigned int wParam);
-
-protected:
     virtual bool IsUsingInteroperability() const;
 
 private:
@@ -22,4 +20,4 @@ private:
 };
 
 
-#endif // GALAXY_DEMO
\ No newline at end of file
+#endif // GALAXY_SCENE
\ No newline at end of file
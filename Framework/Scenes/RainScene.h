@@ -0,0 +1,28 @@
+#ifndef RAIN_SCENE
+#define RAIN_SCENE
+
+#include "../BaseScene.h"
+#include "ParticleEngine/PhysicsParticle.h"
+
+#include <slmath/slmath.h>
+
+class RainScene : public BaseScene
+{
+public:
+    static const int s_SpheresCount = 9;
+
+    virtual void Initialize();
+    virtual void Release();
+
+    virtual bool IsUsingInteroperability() const;
+
+    // Collision spheres, the w is the compressed color and radius
+    const slmath::vec4 *GetSpheres() const;
+
+private:
+    slmath::vec4 *m_Spheres;
+    vrAccelerator m_Accelerator;
+};
+
+
+#endif // RAIN_SCENE
\ No newline at end of file
@@ -1,9 +1,9 @@
-#include "TestGrid.h"
+#include "TestGridScene.h"
 
 #include <slmath/slmath.h>
-#include "Utility/Timer.h"
+#include "Utility/Profiler.h"
 
-void TestGrid::Initialize()
+void TestGridScene::Initialize()
 {
     m_BugFound = false;
     const float positionInGrid = 1.0f;
@@ -36,7 +36,7 @@ void TestGrid::Initialize()
     slmath::vec4 acceleration(0.0f, -10.0f, 0.0f);
     m_PhysicsParticle.SetParticlesAcceleration(*reinterpret_cast<vrVec4 *>(&acceleration));
 
-    Timer::GetInstance()->StartTimer();
+    m_TimeStart = Profiler::GetTicks();
     delete[]startPositions;
 
     m_Index = 0;
@@ -44,15 +44,15 @@ void TestGrid::Initialize()
     m_Time = 0;
 }
 
-void TestGrid::Release()
+void TestGridScene::Release()
 {
-    BaseDemo::Release();
+    BaseScene::Release();
     delete [] m_Colors;
     delete []m_PositionsColors;
 }
 
 
-void TestGrid::Simulate(float /*deltaT*/)
+void TestGridScene::Simulate(float /*deltaT*/)
 {
     m_PhysicsParticle.CreateGrid();
 
@@ -63,7 +63,7 @@ void TestGrid::Simulate(float /*deltaT*/)
 
     
 
-    m_Time += Timer::GetInstance()->StopTimer() / 1000.0f;
+    m_Time += static_cast<float>((Profiler::GetTicks() - m_TimeStart) / (Profiler::GetTicksPerMillisecond() * 1000.0)) / 1000.0f;
 
     // Stop m_Increment if bug has been found !
     if (m_Time > m_Increment && ! m_BugFound)
@@ -85,7 +85,7 @@ void TestGrid::Simulate(float /*deltaT*/)
         m_Colors[neighborsBuffer[j]] = Compress(slmath::vec4(1.0f, 0.0f, 0.0f, 1.0f));
     }
     m_Colors[m_Index] =  Compress(slmath::vec4(0.0f, 1.0f, 0.0f, 1.0f));
-    Timer::GetInstance()->StartTimer();
+    m_TimeStart = Profiler::GetTicks();
 
     const float maxDistance = length(slmath::vec3(1.0f));
 
@@ -111,7 +111,7 @@ void TestGrid::Simulate(float /*deltaT*/)
 
 }
 
-slmath::vec4 *TestGrid::GetParticlePositions() const
+slmath::vec4 *TestGridScene::GetParticlePositions() const
 {
     for (int i = 0; i < m_ParticlesCount; i++)
     {
@@ -1,11 +1,11 @@
 
-#ifndef TEST_GRID
-#define TEST_GRID
+#ifndef TEST_GRID_SCENE
+#define TEST_GRID_SCENE
 
-#include "../BaseDemo.h"
+#include "../BaseScene.h"
 #include "ParticleEngine/PhysicsParticle.h"
 
-class TestGrid : public BaseDemo
+class TestGridScene : public BaseScene
 {
 public:
     virtual void Initialize();
@@ -23,7 +23,9 @@ private:
     float m_Increment;
     int m_Index;
     float m_Time;
+    // Profiler ticks of the last time update
+    long long m_TimeStart;
 };
 
 
-#endif // TEST_GRID
\ No newline at end of file
+#endif // TEST_GRID_SCENE
\ No newline at end of file
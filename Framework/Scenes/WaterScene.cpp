@@ -1,15 +1,13 @@
-#include "WaterDemo.h"
+#include "WaterScene.h"
 
 #include <stdlib.h>
 
 
 
 
-void WaterDemo::Initialize()
+void WaterScene::Initialize()
 {
 
-BaseDemo::ConvertFiles();
-
 const float spaceBetweenParticles = 0.9f;
 #ifdef DEBUG
 const int length = 64;// 8;
@@ -32,9 +30,9 @@ const int sideBox = 8; // 16;
             for (int k = 0; k < sideBox; k++)
             {
 
-                float noiseI = float((rand() % 100 - 50) * 0.0001f);
-                float noiseJ = float((rand() % 100 - 50) * 0.0001f);
-                float noiseK = float((rand() % 100 - 50) * 0.0001f);
+                float noiseI = float((GetRandom() % 100 - 50) * 0.0001f);
+                float noiseJ = float((GetRandom() % 100 - 50) * 0.0001f);
+                float noiseK = float((GetRandom() % 100 - 50) * 0.0001f);
 
                 assert(index < particlesCount );
                 startPositions[index] = slmath::vec4( (i - halfSideBox + noiseI) * spaceBetweenParticles, 
@@ -49,7 +47,7 @@ const int sideBox = 8; // 16;
         }
     }
 
-   //  BaseDemo::FillPositionFromXml(std::string("people"), std::string("noi:GEO_POINT"), reinterpret_cast<slmath::vec4*>(animations), particlesCount);
+   //  BaseScene::FillPositionFromXml(std::string("people"), std::string("noi:GEO_POINT"), reinterpret_cast<slmath::vec4*>(animations), particlesCount);
 
     index = 0;
     for (int i = 0; i < sideBox; i++)
@@ -138,7 +136,7 @@ const int sideBox = 8; // 16;
 
 }
 
-void WaterDemo::Simulate(float deltaT)
+void WaterScene::Simulate(float deltaT)
 {
 
     /*if (m_Step == 1)
@@ -183,11 +181,11 @@ void WaterDemo::Simulate(float deltaT)
     //    m_Spheres[i] = *reinterpret_cast<slmath::vec4*>(&sphere);
     //    m_Spheres[i].w = colorAndSize;
     //}
-    BaseDemo::Simulate(deltaT);
+    BaseScene::Simulate(deltaT);
     m_Step++;
 }
 
-void WaterDemo::IputKey(unsigned int wParam)
+void WaterScene::IputKey(unsigned int wParam)
 {
     switch (wParam)
     {
@@ -224,18 +222,13 @@ void WaterDemo::IputKey(unsigned int wParam)
 }
 
 
-void WaterDemo::Release()
+void WaterScene::Release()
 {
-    BaseDemo::Release();
+    BaseScene::Release();
     delete []m_Spheres;
 }
 
-void WaterDemo::InitializeGraphicsObjectToRender(DX11Renderer &renderer)
-{
-    renderer.InitializeParticles(GetParticlePositions(), GetParticlesCount(), m_SpheresCount, 0);
-}
-
-void WaterDemo::ChangeColor()
+void WaterScene::ChangeColor()
 {
 	const int colorCount = 5;
 
@@ -262,13 +255,7 @@ void WaterDemo::ChangeColor()
 }
 
 
-void WaterDemo::Draw(DX11Renderer &renderer) const
-{
-    //renderer.RenderSphere(m_Spheres, m_SpheresCount);
-    renderer.Render(GetParticlePositions(), GetParticlesCount());
-}
-
-bool WaterDemo::IsUsingInteroperability() const
+bool WaterScene::IsUsingInteroperability() const
 {
     return false;
 }
@@ -1,29 +1,22 @@
+#ifndef WATER_SCENE
+#define WATER_SCENE
 
-#ifndef WATER_DEMO
-#define WATER_DEMO
-
-#include "../BaseDemo.h"
+#include "../BaseScene.h"
 #include "ParticleEngine/PhysicsParticle.h"
 
 #include <slmath/slmath.h>
 
-class WaterDemo : public BaseDemo
+class WaterScene : public BaseScene
 {
 public:
-    WaterDemo() : m_Spheres(0), m_SpheresCount(0), mReduction(0.0f), mColorIndex(0){}
+    WaterScene() : m_Spheres(0), m_SpheresCount(0), mReduction(0.0f), mColorIndex(0){}
 
     virtual void Initialize();
     virtual void Release();
 
     virtual void Simulate(float deltaT);
     virtual void IputKey(unsigned int wParam);
-    
-    virtual void Draw(DX11Renderer &renderer) const;
-    
-
 
-protected:
-    virtual void InitializeGraphicsObjectToRender(DX11Renderer &renderer);
     virtual bool IsUsingInteroperability() const;
 
 private:
@@ -40,4 +33,4 @@ private:
 };
 
 
-#endif // WATER_DEMO
\ No newline at end of file
+#endif // WATER_SCENE
\ No newline at end of file
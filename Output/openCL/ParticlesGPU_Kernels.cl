@@ -1,340 +1,409 @@
-
 #pragma OPENCL EXTENSION cl_khr_byte_addressable_store : enable
 
+// OpenCL C contracts a * b + c in a fused multiply add by default, the compilers of the
+// CPU and GPU devices fuse different expressions. The deterministic mode keeps every
+// rounding, the SPH and spring kernels lose the fused instructions
+#ifdef DETERMINISTIC
+#pragma OPENCL FP_CONTRACT OFF
+#endif
+
+// With HALF_PREVIOUS_POSITIONS the previous positions are stored as the half offset from
+// the positions, 8 bytes instead of 16. The offset is the last Verlet step, small enough
+// to keep the velocity precise. vload_half and vstore_half don't need cl_khr_fp16
+#ifdef HALF_PREVIOUS_POSITIONS
+typedef half PreviousPosition;
 
-inline float4 AtomicMin(volatile __global float4 *source, float4 value) 
+float4 LoadPreviousPosition(__global const half* previousPositions, size_t index, float4 position)
 {
-    union {
-        float4 m_Float4;
-        int    m_4Ints[4]; 
-    } prevVal;
-
-    union {
-        float4 m_Float4;
-        int    m_4Ints[4]; 
-    } newVal;
-
-
-    do {
-        prevVal.m_Float4 = *source;
-        newVal.m_Float4.x = min(prevVal.m_Float4.x, value.x);
-    } while (atomic_cmpxchg((volatile __global int*)source + 0, prevVal.m_4Ints[0], newVal.m_4Ints[0]) != prevVal.m_4Ints[0]);
-
-    do {
-        prevVal.m_Float4 = *source;
-        newVal.m_Float4.y = min(prevVal.m_Float4.y, value.y);
-    } while (atomic_cmpxchg((volatile __global int*)source + 1, prevVal.m_4Ints[1], newVal.m_4Ints[1]) != prevVal.m_4Ints[1]);
-
-    do {
-        prevVal.m_Float4 = *source;
-        newVal.m_Float4.z = min(prevVal.m_Float4.z, value.z);
-    } while (atomic_cmpxchg((volatile __global int*)source + 2, prevVal.m_4Ints[2], newVal.m_4Ints[2]) != prevVal.m_4Ints[2]);
-    
-    return prevVal.m_Float4;
+    return position - vload_half4(index, previousPositions);
 }
 
-inline float4 AtomicMax(volatile __global float4 *source, float4 value) 
+void StorePreviousPosition(__global half* previousPositions, size_t index, float4 position, float4 previousPosition)
 {
-    union {
-        float4 m_Float4;
-        int    m_4Ints[4]; 
-    } prevVal;
-
-    union {
-        float4 m_Float4;
-        int    m_4Ints[4]; 
-    } newVal;
-
-  
-    do {
-        prevVal.m_Float4 = *source;
-        newVal.m_Float4.x = max(prevVal.m_Float4.x, value.x);
-    } while (atomic_cmpxchg(((volatile __global int*)source) + 0, prevVal.m_4Ints[0], newVal.m_4Ints[0]) != prevVal.m_4Ints[0]);
-
-    do {
-        prevVal.m_Float4 = *source;
-        newVal.m_Float4.y = max(prevVal.m_Float4.y, value.y);
-    } while (atomic_cmpxchg(((volatile __global int*)source) + 1, prevVal.m_4Ints[1], newVal.m_4Ints[1]) != prevVal.m_4Ints[1]);
-
-    do {
-        prevVal.m_Float4 = *source;
-        newVal.m_Float4.z = max(prevVal.m_Float4.z, value.z);
-    } while (atomic_cmpxchg(((volatile __global int*)source) + 2, prevVal.m_4Ints[2], newVal.m_4Ints[2]) != prevVal.m_4Ints[2]);
-    
-    return prevVal.m_Float4;
+    float4 offset = position - previousPosition;
+    offset.w = 0.0f;
+    vstore_half4(offset, index, previousPositions);
+}
+#else
+typedef float4 PreviousPosition;
+
+float4 LoadPreviousPosition(__global const float4* previousPositions, size_t index, float4 position)
+{
+    return previousPositions[index];
+}
+
+void StorePreviousPosition(__global float4* previousPositions, size_t index, float4 position, float4 previousPosition)
+{
+    previousPositions[index] = previousPosition;
+}
+#endif
+
+
+// Tree reduction of the bounds in local memory, minimums are in the first half
+// and maximums in the second one. Local size has to be a power of 2
+void ReduceLocalBounds(__local float4 *localMemory)
+{
+    size_t localId = get_local_id(0);
+    size_t localSize = get_local_size(0);
+
+    // Synchronize to make sure data is available for processing
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    for (size_t stride = localSize / 2; stride > 0; stride /= 2)
+    {
+        if (localId < stride)
+        {
+            localMemory[localId] = min(localMemory[localId], localMemory[localId + stride]);
+            localMemory[localId + localSize] = max(localMemory[localId + localSize], localMemory[localId + localSize + stride]);
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
 }
 
+// First pass of the bounding box, each work item reads two particles and each
+// work group writes its bounds in partialBounds (minimum then maximum).
+// ReduceBounds reduces the partial bounds, there is no global atomic
 __kernel void ComputeMinMax(  __global const float4* positions,
                             __local float4  *localMemory,
-                            volatile __global float4 *globalMemory)
+                            __global float4 *partialBounds,
+                            __global int4*   gridInfo)
 {
     size_t localId = get_local_id(0);
     size_t globalId = get_global_id(0);
+    size_t globalSize = get_global_size(0);
     size_t localSize = get_local_size(0);
     size_t groupId = get_group_id(0);
-    size_t groupSize = get_num_groups(0);
-
+    const int particlesCount = gridInfo[0].x;
 
-    // Find the the local min (the minimum for each work item)
-    // First put the result in local memory...
-    localMemory[localId] = positions[globalId];
-    localMemory[localId + localSize] = positions[globalId];
-    
-    // Synchronize to make sure data is available for processing
-    barrier(CLK_LOCAL_MEM_FENCE);
-    
-    // ...Then work in local
-    int localStep = 1;
-    size_t workingLocalSize = localSize;
-    while (workingLocalSize > 1)
+    // The biggest cell index is found again by CreateGrid
+    if (globalId == 0)
     {
-        int indexInput = (localId / (2 * localStep)) * (2 * localStep);
-        localMemory[indexInput] = min(localMemory[indexInput], localMemory[indexInput + localStep]);
-        localMemory[indexInput + localSize] = max(localMemory[indexInput + localSize], localMemory[indexInput + localSize + localStep]);
-        workingLocalSize /= 2;
-        localStep *= 2;
-        barrier(CLK_LOCAL_MEM_FENCE);
+        gridInfo[0].w = 0;
     }
 
-    AtomicMin(&globalMemory[0], localMemory[0]);
-    AtomicMax(&globalMemory[1], localMemory[localSize]);
+    // Padding work items take the first particle, it doesn't change the bounds
+    float4 first = positions[globalId < particlesCount ? globalId : 0];
+    float4 second = positions[globalId + globalSize < particlesCount ? globalId + globalSize : 0];
+    localMemory[localId] = min(first, second);
+    localMemory[localId + localSize] = max(first, second);
+
+    ReduceLocalBounds(localMemory);
+
+    if (localId == 0)
+    {
+        partialBounds[2 * groupId] = localMemory[0];
+        partialBounds[2 * groupId + 1] = localMemory[localSize];
+    }
 }
 
+// Second pass of the bounding box, run by a single work group. The bounds replace the
+// first partial bounds and the axis lengths of the grid go in gridInfo.
+// It isn't fused in ComputeMinMax or CreateGrid. Every key needs the final minimum, and
+// OpenCL 1.2 doesn't order the global writes of different work groups, so the last group
+// of ComputeMinMax can't safely reduce the partial bounds of the others. It costs one
+// more dispatch and a reduction of one partial bound by 2 * local size particles on a
+// single compute unit
+__kernel void ReduceBounds( __global float4 *partialBounds,
+                            __global int4*   gridInfo,
+                            __local float4  *localMemory,
+                            int partialBoundsCount)
+{
+    size_t localId = get_local_id(0);
+    size_t localSize = get_local_size(0);
+
+    float4 localMin = partialBounds[0];
+    float4 localMax = partialBounds[1];
+    for (int i = localId; i < partialBoundsCount; i += localSize)
+    {
+        localMin = min(localMin, partialBounds[2 * i]);
+        localMax = max(localMax, partialBounds[2 * i + 1]);
+    }
+    localMemory[localId] = localMin;
+    localMemory[localId + localSize] = localMax;
+
+    // Every partial bound is read before the barrier of the reduction
+    ReduceLocalBounds(localMemory);
+
+    if (localId == 0)
+    {
+        float4 positionMin = localMemory[0];
+        float4 positionMax = localMemory[localSize];
+        partialBounds[0] = positionMin;
+        partialBounds[1] = positionMax;
+
+        // Cells on the border are included, a cell index gives back its coordinates
+        gridInfo[0].y = (int)floor(positionMax.y) - (int)floor(positionMin.y) + 1;
+        gridInfo[0].z = (int)floor(positionMax.z) - (int)floor(positionMin.z) + 1;
+    }
+}
 
+// Cell index of each particle from the bounds reduced by ReduceBounds
 __kernel void CreateGrid(__global const float4* positions,
-                        volatile __global float4 *globalMemory,
+                        __global const float4 *bounds,
                         __global int2*   neighborsInfo,
                         __global int4*   gridInfo)
 {
     size_t globalId = get_global_id(0);
-    size_t groupSize = get_num_groups(0);
 
-    float4 positionMin = globalMemory[0];
-    float4 positionMax = globalMemory[1];
-    
-    float4 diff = positionMax - positionMin;
-    int secondAxisLength = (int)diff.y;
-    int thirdAxisLength  = (int)diff.z;
+    if (globalId >= gridInfo[0].x)
+        return;
 
-    gridInfo[0].y = secondAxisLength;
-    gridInfo[0].z = thirdAxisLength;
+    float4 positionMin = bounds[0];
+    int secondAxisLength = gridInfo[0].y;
+    int thirdAxisLength  = gridInfo[0].z;
 
     int xAxisProduct = secondAxisLength * thirdAxisLength;
     int yAxisProduct = thirdAxisLength;
 
-
     float4 currentPosition = positions[globalId];
 
     neighborsInfo[globalId].x = globalId;
 
-    neighborsInfo[globalId].y = ((int)floor(currentPosition.x) - (int)floor(positionMin.x)) * xAxisProduct +
-                                ((int)floor(currentPosition.y) - (int)floor(positionMin.y)) * yAxisProduct + 
-                                ((int)floor(currentPosition.z) - (int)floor(positionMin.z));
+    int cellIndex = ((int)floor(currentPosition.x) - (int)floor(positionMin.x)) * xAxisProduct +
+                    ((int)floor(currentPosition.y) - (int)floor(positionMin.y)) * yAxisProduct + 
+                    ((int)floor(currentPosition.z) - (int)floor(positionMin.z));
+    neighborsInfo[globalId].y = cellIndex;
 
+    // The radix sort skips the passes above the biggest cell index
+    atomic_max(((volatile __global int*)gridInfo) + 3, cellIndex);
 }
 
 
-// Local size should be bigger than 10 
-__kernel void SortLocalGridCells(   __global int2* neighborsInfo,
-                                    __global int2* neighborsInfo2)
+// Radix sort of the neighbors info by cell index, 4 bits by pass.
+// Each work group sorts its block in local memory, the histograms of all the
+// blocks are scanned to find where each block scatters its digits.
+#define RADIX_BITS  4
+#define RADIX_SIZE  16
+
+// Exclusive prefix sum of one value by work item, total is the sum of all the values
+int LocalExclusiveScan(__local int *localScan, int value, int *total)
 {
-    volatile __local int localBucket[10];
-    volatile __local int localMaxCellIndex;
-    
     size_t localId = get_local_id(0);
     size_t localSize = get_local_size(0);
-    size_t globalId = get_global_id(0);
-    size_t groupId = get_group_id(0);
-
-    atomic_max(&localMaxCellIndex, neighborsInfo[globalId].y);
 
-    int exp = 1;
-
-    barrier(CLK_GLOBAL_MEM_FENCE | CLK_LOCAL_MEM_FENCE);
+    localScan[localId] = value;
+    barrier(CLK_LOCAL_MEM_FENCE);
 
-    while (localMaxCellIndex / exp > 0)
+    for (size_t offset = 1; offset < localSize; offset *= 2)
     {
-        if (localId < 10)
-        {
-            localBucket[localId] = 0;
-        }
-
-        barrier(CLK_GLOBAL_MEM_FENCE | CLK_LOCAL_MEM_FENCE);
-        
-        int currentBucketIndex = (neighborsInfo[globalId].y / exp) % 10;
-
-        atomic_inc(&localBucket[currentBucketIndex]);
+        int addend = localId >= offset ? localScan[localId - offset] : 0;
+        barrier(CLK_LOCAL_MEM_FENCE);
+        localScan[localId] += addend;
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
 
-        barrier(CLK_GLOBAL_MEM_FENCE | CLK_LOCAL_MEM_FENCE);
-        
-        // Copy just once; only one work item will do it
-        if (localId == 0)
-        {
-            for (int i = 1; i < 10; i++)
-            {
-                localBucket[i] += localBucket[i - 1];
-            }
-        }
+    int inclusive = localScan[localId];
+    *total = localScan[localSize - 1];
+    barrier(CLK_LOCAL_MEM_FENCE);
+    return inclusive - value;
+}
 
-        barrier(CLK_GLOBAL_MEM_FENCE | CLK_LOCAL_MEM_FENCE);
+// Passes above the biggest cell index only copy the keys
+bool IsRadixPassUseless(__global const int4* gridInfo, int shift)
+{
+    return shift > 0 && (gridInfo[0].w >> shift) == 0;
+}
 
-       if (localId == 0)
-       {
-            for (int i = localSize - 1; i >= 0; i--)
-            {
-                int neighborIndex = i + (localSize * groupId);
-                int bucketIndex = (neighborsInfo[neighborIndex].y / exp) % 10;
-                int newIndex  = --localBucket[bucketIndex];
-                newIndex += (localSize * groupId);
-                neighborsInfo2[newIndex] = neighborsInfo[neighborIndex];
-            }
-        }
+__kernel void RadixHistogram(   __global const int2* neighborsInfo,
+                                __global int* histograms,
+                                __global const int4* gridInfo,
+                                int shift)
+{
+    __local int localCounts[RADIX_SIZE];
 
-        barrier(CLK_GLOBAL_MEM_FENCE | CLK_LOCAL_MEM_FENCE);
-        
-        // Copy the buffer in the data
-        neighborsInfo[globalId] = neighborsInfo2[globalId];
+    size_t localId = get_local_id(0);
+    size_t globalId = get_global_id(0);
+    size_t groupId = get_group_id(0);
+    size_t groupsCount = get_num_groups(0);
 
-        barrier(CLK_GLOBAL_MEM_FENCE | CLK_LOCAL_MEM_FENCE);
+    if (IsRadixPassUseless(gridInfo, shift))
+        return;
 
-        exp *= 10;
+    if (localId < RADIX_SIZE)
+    {
+        localCounts[localId] = 0;
     }
+    barrier(CLK_LOCAL_MEM_FENCE);
 
-    neighborsInfo2[globalId] = 0x7FFFFFFF;
+    if (globalId < gridInfo[0].x)
+    {
+        int digit = (neighborsInfo[globalId].y >> shift) & (RADIX_SIZE - 1);
+        atomic_inc(&localCounts[digit]);
+    }
+    barrier(CLK_LOCAL_MEM_FENCE);
 
-    barrier(CLK_GLOBAL_MEM_FENCE | CLK_LOCAL_MEM_FENCE);
+    // Digit major, the scan gives the digits in order then the blocks in order
+    if (localId < RADIX_SIZE)
+    {
+        histograms[localId * groupsCount + groupId] = localCounts[localId];
+    }
 }
 
-
-__kernel void MergeSortGridCells(  __global int2* neighborsInfo,
-                                   __global int2* neighborsInfo2,
-                                   __local  int2* localMemory)
+// Run by a single work group, each work item scans a contiguous chunk
+__kernel void RadixScan(__global int* histograms,
+                        __local int* localScan,
+                        __global const int4* gridInfo,
+                        int shift,
+                        int groupsCount)
 {
     size_t localId = get_local_id(0);
     size_t localSize = get_local_size(0);
-    size_t globalId = get_global_id(0);
-    size_t globalSize = get_global_size(0);
-    size_t groupSize = get_num_groups(0);
 
-    int2 value = neighborsInfo[globalId];
+    if (IsRadixPassUseless(gridInfo, shift))
+        return;
 
-    int arrayPosition = 0;
-    
+    int histogramsCount = RADIX_SIZE * groupsCount;
+    int chunkSize = (histogramsCount + localSize - 1) / localSize;
+    int first = min((int)localId * chunkSize, histogramsCount);
+    int last = min(first + chunkSize, histogramsCount);
 
-    for(int i = 0; i < groupSize; i++)
+    int chunkSum = 0;
+    for (int i = first; i < last; i++)
     {
-        // load one tile into local memory
-        int idx = i * localSize + localId;
-        localMemory[localId] = neighborsInfo[idx];
+        chunkSum += histograms[i];
+    }
 
-        // Synchronize to make sure data is available for processing
-        barrier(CLK_LOCAL_MEM_FENCE);
-        
-        int minimum = 0;
-        int maximum = localSize - 1;
+    int total;
+    int offset = LocalExclusiveScan(localScan, chunkSum, &total);
 
-        // calculate the midpoint for roughly equal partition
-        int middle = (maximum - minimum) * 0.5f + minimum;
+    for (int i = first; i < last; i++)
+    {
+        int count = histograms[i];
+        histograms[i] = offset;
+        offset += count;
+    }
+}
 
-        bool wasBigger = true;
-        bool found = false;
+__kernel void RadixScatter( __global const int2* neighborsInfo,
+                            __global int2* sortedNeighborsInfo,
+                            __global const int* histograms,
+                            __local int2* localKeys,
+                            __local int* localScan,
+                            __global const int4* gridInfo,
+                            int shift)
+{
+    __local int localDigitStarts[RADIX_SIZE];
 
-        // continue searching while [minimum,maximum] is not empty
-        while (maximum >= minimum)
-        {
-            // determine which subarray to search
-            if (value.y > localMemory[middle].y )
-            {    
-                // change min index to search upper subarray
-                minimum = middle + 1;
-                wasBigger = true;
-            }
-            else if (value.y < localMemory[middle].y)
-            {
-                // change max index to search lower subarray
-                maximum = middle - 1;
-                wasBigger = false;
-            }
-            else
-            {
-                found = true;
-                // Start from the first cell with the same value
-                while (middle - 1 >= minimum && value.y == localMemory[middle - 1].y)
-                {
-                    middle--;
-                }
-                int localImid = middle;
-                // Sort by id to obtain an unique position in the output array even with the same cell index
-                while (localImid <= maximum && value.y == localMemory[localImid].y)
-                {
-                    if (value.x > localMemory[localImid].x)
-                    {
-                        middle++;
-                    }
-                    localImid++;
-                }
-                break;
-            }
-            middle = (maximum - minimum) * 0.5f + minimum;
-        }
+    size_t localId = get_local_id(0);
+    size_t globalId = get_global_id(0);
+    size_t groupId = get_group_id(0);
+    size_t groupsCount = get_num_groups(0);
+    const int particlesCount = gridInfo[0].x;
+    const bool isParticle = globalId < particlesCount;
 
-        // The result can be different if we didn't found the samecell index
-        if ( ! found)
+    if (IsRadixPassUseless(gridInfo, shift))
+    {
+        if (isParticle)
         {
-            // The difference is in function the last branch we have not found it, from the top or the bottom
-            if ( (! wasBigger || middle >= maximum ) && maximum != -1)
-            {
-                middle++;
-            }
+            sortedNeighborsInfo[globalId] = neighborsInfo[globalId];
         }
-        
+        return;
+    }
+
+    // Padding work items go after every particle of the block, they are never written
+    int2 key = isParticle ? neighborsInfo[globalId] : (int2)(0x7FFFFFFF, 0x7FFFFFFF);
+    int digit = isParticle ? (key.y >> shift) & (RADIX_SIZE - 1) : RADIX_SIZE - 1;
 
-        arrayPosition += middle;
+    // Stable sort of the block on the digit, one split by bit
+    for (int bit = 0; bit < RADIX_BITS; bit++)
+    {
+        int isZero = ((digit >> bit) & 1) == 0;
+        int zerosCount;
+        int zerosBefore = LocalExclusiveScan(localScan, isZero, &zerosCount);
+        int newIndex = isZero ? zerosBefore : zerosCount + (int)localId - zerosBefore;
+
+        localKeys[newIndex] = key;
+        localScan[newIndex] = digit;
+        barrier(CLK_LOCAL_MEM_FENCE);
+        key = localKeys[localId];
+        digit = localScan[localId];
         barrier(CLK_LOCAL_MEM_FENCE);
     }
 
-    neighborsInfo2[arrayPosition] = value;
-    
+    // First position of each digit in the sorted block
+    if (localId == 0 || digit != localScan[localId - 1])
+    {
+        localDigitStarts[digit] = localId;
+    }
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    if (key.x != 0x7FFFFFFF)
+    {
+        int rank = (int)localId - localDigitStarts[digit];
+        sortedNeighborsInfo[histograms[digit * groupsCount + groupId] + rank] = key;
+    }
 }
 
-int GetNeighborsMax(__global const int2* neighborsInfo, 
-                int currentIndex, int particlesCount, 
-                int secondAxis, int thirdAxis)
+// Cell ranges of the sorted particles are kept in an open addressing hash table,
+// only the occupied cells are stored so the table size only depends on the particles count
+#define EMPTY_CELL  -1
+
+uint HashCell(int cellIndex, int tableMask)
 {
-    int nextNeighbors = currentIndex;
-    const int currentPosition = neighborsInfo[currentIndex].y;
-    const int sizePlane = thirdAxis * secondAxis;
-    const int bottom = currentPosition + sizePlane;
-    const int bottomBack = bottom + thirdAxis;
-    const int bottomBackRight = bottomBack + 1;
-    
-    while ( nextNeighbors < particlesCount &&  
-            bottomBackRight >= neighborsInfo[nextNeighbors].y)
+    uint hash = (uint)cellIndex;
+    hash ^= hash >> 16;
+    hash *= 0x7FEB352Du;
+    hash ^= hash >> 15;
+    hash *= 0x846CA68Bu;
+    hash ^= hash >> 16;
+    return hash & (uint)tableMask;
+}
+
+__kernel void ClearCellTable(__global int4* cellTable)
+{
+    size_t globalId = get_global_id(0);
+    cellTable[globalId] = (int4)(EMPTY_CELL, 0, 0, 0);
+}
+
+// The first particle of each cell inserts the range [start; end[ of the cell.
+// The table is bigger than the particles count, it never fills
+__kernel void BuildCellTable(   __global const int2* neighborsInfo,
+                                __global int4* cellTable,
+                                __global const int4* gridInfo,
+                                int tableMask)
+{
+    int globalId = get_global_id(0);
+    int particlesCount = gridInfo[0].x;
+
+    if (globalId >= particlesCount)
+        return;
+
+    int cellIndex = neighborsInfo[globalId].y;
+    if (globalId > 0 && neighborsInfo[globalId - 1].y == cellIndex)
+        return;
+
+    int end = globalId + 1;
+    while (end < particlesCount && neighborsInfo[end].y == cellIndex)
     {
-        nextNeighbors++;
+        end++;
     }
 
-    return nextNeighbors - 1;
+    // Each cell is inserted once, the slot only has to be empty
+    uint slot = HashCell(cellIndex, tableMask);
+    while (atomic_cmpxchg((volatile __global int*)&cellTable[slot], EMPTY_CELL, cellIndex) != EMPTY_CELL)
+    {
+        slot = (slot + 1) & (uint)tableMask;
+    }
+
+    cellTable[slot].y = globalId;
+    cellTable[slot].z = end;
 }
 
-int GetNeighborsMin(__global const int2* neighborsInfo, 
-                    int currentIndex, 
-                int secondAxis, int thirdAxis)
+// Returns the range of the sorted particles in the cell, empty if there is none
+int2 FindCellRange(__global const int4* cellTable, int cellIndex, int tableMask)
 {
-    int previousNeighbors = currentIndex;
-    const int currentPosition = neighborsInfo[currentIndex].y;
-    const int sizePlane = thirdAxis * secondAxis;
-    const int top = currentPosition - sizePlane;
-    const int topBack = top - thirdAxis;
-    const int topBackLeft = topBack - 1;
-
-    while ( previousNeighbors >= 0 && 
-            neighborsInfo[previousNeighbors].y >= topBackLeft)
+    uint slot = HashCell(cellIndex, tableMask);
+    int4 cell = cellTable[slot];
+    while (cell.x != EMPTY_CELL)
     {
-        previousNeighbors--;
+        if (cell.x == cellIndex)
+            return cell.yz;
+
+        slot = (slot + 1) & (uint)tableMask;
+        cell = cellTable[slot];
     }
 
-    return previousNeighbors + 1;
+    return (int2)(0, 0);
 }
 
 typedef struct 
@@ -345,113 +414,226 @@ typedef struct
     float m_DeltaT;
     float m_Mass;
     float m_H;
+    float m_PreviousDeltaT;
 } Parameters;
 
-// positions has to be const because used in other work group
+// A program specialized for a scene is built with SPH_SPECIALIZED and the scene constants
+// below as defines, with the kernel coefficients already computed by the host.
+// The step and the gravity are still read from the parameters, they can change every frame
+
+// positions and previousPositions have to be const because used in other work group,
+// the new previous positions go to outputPreviousPositions, swapped by the host.
+// For each of the 9 columns of neighbor cells, the three cells of a column are contiguous
+// in the sorted particles. The runs of the work group are merged in one range, staged in
+// local memory tile by tile. Each work item keeps the particles of its own three cells,
+// in the same order as a loop over its cells
 __kernel void ComputeSPH(__global const float4* positions, 
-                 __global float4* previousPositions,
+                 __global const PreviousPosition* previousPositions,
+                 __global PreviousPosition* outputPreviousPositions,
                __global const int2* neighborsInfo,
                __constant int4* particlesInfo,
                __constant Parameters* paramters,
                __global float4* newPositions,
                __global float* inputDensity,
-               __global float* outputDensity)
+               __global float* outputDensity,
+               __global const int4* cellTable,
+               int cellTableMask,
+               __local float4* localPositions,
+               __local float4* localPreviousPositions,
+               __local float* localDensities,
+               __local int* localCells)
 {
+    // Sorted range of the neighbors of the work group for the current column
+    __local int localRange[2];
 
     size_t globalId = get_global_id(0);
-    int index = neighborsInfo[globalId].x;
-    size_t globalSize = get_global_size(0);
+    size_t localId = get_local_id(0);
+    const int localSize = get_local_size(0);
+    int particlesCount = particlesInfo[0].x;
+    const bool isParticle = globalId < particlesCount;
 
-    if (globalId >= particlesInfo[0].x)
+    // The whole work group returns, the others reach the barriers below
+    if (get_group_id(0) * localSize >= particlesCount)
         return;
 
-    const float PI = 3.141592659f;
     float4 gravity = paramters[0].m_Gravity;
+#ifdef SPH_SPECIALIZED
+    const float mass = SPH_MASS;
+    const float h = SPH_H;
+    const float muViscosity = SPH_MU_VISCOSITY;
+    const float sqrH = h * h;
+    const float inverseH = SPH_INVERSE_H;
+    const float selfDensity = SPH_SELF_DENSITY;
+    const float densityCoefficient = SPH_DENSITY_COEFFICIENT;
+    const float pressureCoefficient = SPH_PRESSURE_COEFFICIENT;
+    const float viscosityCoefficient = SPH_VISCOSITY_COEFFICIENT;
+#else
+    const float PI = 3.141592659f;
     const float mass = paramters[0].m_Mass;
     const float h = paramters[0].m_H;
     const float gazConstant = paramters[0].m_GazConstant;
     const float muViscosity = paramters[0].m_MuViscosity;
     const float sqrH = h * h;
+    const float inverseH = 1.0f / h;
+    const float selfDensity = 4.0f * mass  / (PI*sqrH*sqrH*sqrH);
+    const float densityCoefficient = mass * ( 15.0f / (PI*h*sqrH) );
+    const float pressureCoefficient = mass * gazConstant * 0.5f * ( 45.0f / (PI*sqrH*sqrH) );
+    const float viscosityCoefficient = mass * ( 45.0f / (PI*sqrH*sqrH*sqrH) );
+#endif
 
-    int particlesCount = particlesInfo[0].x;
     int secondAxis = particlesInfo[0].y;
     int thirdAxis = particlesInfo[0].z;
+    const int sizePlane = secondAxis * thirdAxis;
 
-    const float deltaT = 1 / 60.0f;
+    const float deltaT = paramters[0].m_DeltaT;
+    const float previousDeltaT = paramters[0].m_PreviousDeltaT;
+    const float inversePreviousDeltaT = 1.0f / previousDeltaT;
 
-    
-    int minIndexNeighbor = GetNeighborsMin(neighborsInfo, globalId, secondAxis, thirdAxis);
-    int maxIndexNeighbor = GetNeighborsMax(neighborsInfo, globalId, particlesCount, secondAxis, thirdAxis);
+    // Cell coordinates on the two last axis, the first one is only bounded by the table
+    const int2 info = isParticle ? neighborsInfo[globalId] : (int2)(0, 0);
+    const int index = info.x;
+    const int cellIndex = info.y;
+    const int thirdCell = cellIndex % thirdAxis;
+    const int secondCell = (cellIndex / thirdAxis) % secondAxis;
 
 
     float4 pressure = {0.0f, 0.0f, 0.0f, 0.0f};
     float4 viscosity = {0.0f, 0.0f, 0.0f, 0.0f};
 
     float4 currentPosition  = positions[index];
-    float4 previsouPosition = previousPositions[index];
+    float4 previsouPosition = LoadPreviousPosition(previousPositions, index, currentPosition);
     float previousDensity = inputDensity[index];
+    float positionData = currentPosition.w;
     currentPosition.w = 0.0f;
-    float density = 4.0f * mass  / (PI*sqrH*sqrH*sqrH) ;
-    float positionData = positions[index].w;
+    float density = selfDensity;
+    const float4 veolocity = (currentPosition - previsouPosition) * inversePreviousDeltaT;
 
-    for (int j = minIndexNeighbor; j <= maxIndexNeighbor; j++)
+    for (int first = -1; first <= 1; first++)
     {
-        int indexNeighbor =  neighborsInfo[j].x;
+        for (int second = -1; second <= 1; second++)
+        {
+            const bool isColumn = isParticle && secondCell + second >= 0 && secondCell + second < secondAxis;
+            const int columnCell = cellIndex + first * sizePlane + second * thirdAxis;
 
-        float4 neighborPosition = positions[indexNeighbor];
-        float4 neighborPrevisousPosition = previousPositions[indexNeighbor];
+            // The range of the previous column is no longer read
+            barrier(CLK_LOCAL_MEM_FENCE);
+            if (localId == 0)
+            {
+                localRange[0] = particlesCount;
+                localRange[1] = 0;
+            }
+            barrier(CLK_LOCAL_MEM_FENCE);
 
-        float4 separation = currentPosition - neighborPosition;
-        separation.w = 0.0f;
-        float sqrDistance = dot(separation, separation);
-            
-        if (sqrDistance < sqrH)
-        {
-            float4 normal = separation;
-            float distance = sqrt(sqrDistance);
-            if (distance > 1e-5f/*0.0f*/ )
+            if (isColumn)
             {
-                normal /= distance;
+                int runFirst = particlesCount;
+                int runEnd = 0;
+                for (int third = -1; third <= 1; third++)
+                {
+                    if (thirdCell + third < 0 || thirdCell + third >= thirdAxis || columnCell + third < 0)
+                        continue;
+
+                    const int2 range = FindCellRange(cellTable, columnCell + third, cellTableMask);
+                    if (range.x < range.y)
+                    {
+                        runFirst = min(runFirst, range.x);
+                        runEnd = max(runEnd, range.y);
+                    }
+                }
+                if (runFirst < runEnd)
+                {
+                    atomic_min(&localRange[0], runFirst);
+                    atomic_max(&localRange[1], runEnd);
+                }
             }
+            barrier(CLK_LOCAL_MEM_FENCE);
+
+            const int rangeFirst = localRange[0];
+            const int rangeEnd = localRange[1];
+            for (int tileFirst = rangeFirst; tileFirst < rangeEnd; tileFirst += localSize)
+            {
+                const int tileSize = min(localSize, rangeEnd - tileFirst);
+                if (localId < tileSize)
+                {
+                    const int2 neighborInfo = neighborsInfo[tileFirst + localId];
+                    const float4 position = positions[neighborInfo.x];
+                    localPositions[localId] = position;
+                    localPreviousPositions[localId] = LoadPreviousPosition(previousPositions, neighborInfo.x, position);
+                    localDensities[localId] = inputDensity[neighborInfo.x];
+                    localCells[localId] = neighborInfo.y;
+                }
+                barrier(CLK_LOCAL_MEM_FENCE);
+
+                for (int j = 0; isColumn && j < tileSize; j++)
+                {
+                    // Only the three cells of the column around the particle
+                    const int third = localCells[j] - columnCell;
+                    if (third < -1 || third > 1 || thirdCell + third < 0 || thirdCell + third >= thirdAxis)
+                        continue;
+
+                    float4 neighborPosition = localPositions[j];
+
+                    float4 separation = currentPosition - neighborPosition;
+                    separation.w = 0.0f;
+                    float sqrDistance = dot(separation, separation);
+            
+                    if (sqrDistance < sqrH)
+                    {
+                        float4 neighborPrevisousPosition = localPreviousPositions[j];
+                        float previousDensityNeighbor = localDensities[j];
+
+                        float4 normal = separation;
+                        float distance = sqrt(sqrDistance);
+                        if (distance > 1e-5f/*0.0f*/ )
+                        {
+                            normal /= distance;
+                        }
 
-            float previousDensityNeighbor = inputDensity[indexNeighbor];
+                        // Constant factors are in the coefficients, the neighbor density is inverted once
+                        const float inverseDensityNeighbor = 1.0f / previousDensityNeighbor;
+                        const float ratio = 1.0f - distance * inverseH;
+                        const float cubicRatio = ratio * ratio * ratio;
 
-             density += mass * ( 15.0f / (PI*h*sqrH) ) * ((1.0f - distance / h)*(1.0f - distance / h)*(1.0f - distance / h));
-			// density += ((sqrH - sqrDistance )*(sqrH - sqrDistance )*(sqrH - sqrDistance ));
-            pressure += mass / previousDensityNeighbor * 
-                        ((gazConstant * previousDensity + gazConstant * previousDensityNeighbor) * 0.5f) * 
-                        ( 45.0f / (PI*sqrH*sqrH) ) * ((1.0f - distance / h)*(1.0f - distance / h)*(1.0f - distance / h)) * normal;
+                        density += densityCoefficient * cubicRatio;
+                        pressure += (pressureCoefficient * (previousDensity + previousDensityNeighbor) * inverseDensityNeighbor * cubicRatio) * normal;
 
+                        float4 neighborVeolocity = (neighborPosition - neighborPrevisousPosition) * inversePreviousDeltaT;
 
-            float4 veolocity = (currentPosition - previsouPosition) / deltaT;
-            float4 neighborVeolocity = (neighborPosition - neighborPrevisousPosition) / deltaT;
+                        viscosity += (viscosityCoefficient * inverseDensityNeighbor * (h - distance)) * (neighborVeolocity - veolocity);
+                    }
+                }
 
-            viscosity += (mass / previousDensityNeighbor) *  ((neighborVeolocity - veolocity) * 
-                        ( 45.0f / (PI*sqrH*sqrH*sqrH) ) * (h - distance) );
-                        
+                // The tile is read by every work item before the next one is staged
+                barrier(CLK_LOCAL_MEM_FENCE);
+            }
         }
     }
 
+    if ( ! isParticle)
+        return;
+
     pressure *= mass / previousDensity;
     viscosity *= muViscosity * mass / previousDensity;
 
     const float damping = 0.99f;
-    const float dampingPlusOne = damping + 1.0f;
+    // Time corrected Verlet, the step can change between two frames
+    const float dampingRatio = damping * deltaT / previousDeltaT;
     
 
     float4 acceleration = pressure + viscosity + gravity;
 
 
-    newPositions[index] = (currentPosition * dampingPlusOne - 
-                                previousPositions[index] * damping) +
+    float4 newPosition = currentPosition + 
+                                (currentPosition - previsouPosition) * dampingRatio +
                                 acceleration * deltaT * deltaT;
 
     
 
-    previousPositions[index] = currentPosition;
+    StorePreviousPosition(outputPreviousPositions, index, newPosition, currentPosition);
     outputDensity[index] = density;
 
-    newPositions[index].w = positionData;
+    newPosition.w = positionData;
+    newPositions[index] = newPosition;
 }
 
 __kernel void CopyBuffer(__global const float4* positions,  __global float4* newPositions)
@@ -461,7 +643,7 @@ __kernel void CopyBuffer(__global const float4* positions,  __global float4* new
 }
 
 __kernel void ComputeCollision( __global float4* positionsOutput,
-                                __global float4* previousPositions,
+                                __global PreviousPosition* previousPositions,
                                 __constant const float4* spheres,
                                 __constant const float4* spheresIn,
                                 __constant const float4* aabbs,
@@ -472,7 +654,8 @@ __kernel void ComputeCollision( __global float4* positionsOutput,
     float4 newPosition = positionsOutput[globalId];
     float positionData = positionsOutput[globalId].w;
 
-    previousPositions[globalId].w = 0.0f;
+    float4 previousPosition = LoadPreviousPosition(previousPositions, globalId, newPosition);
+    previousPosition.w = 0.0f;
 
     const float friction = 0.5f;
     const float restitution = 1.0f;
@@ -483,7 +666,7 @@ __kernel void ComputeCollision( __global float4* positionsOutput,
         newPosition.w = 0.0f;
 
         const float radius = spheres[i].w;
-        const float4 difference = newPosition - spheres[i];
+        float4 difference = newPosition - spheres[i];
         difference.w = 0.0f;
         float sqrDistance = dot(difference, difference);
 
@@ -494,13 +677,12 @@ __kernel void ComputeCollision( __global float4* positionsOutput,
             newPosition = spheres[i] + contactNormal * radius;
             
             // Compute previous position to generate collision response considering restitution
-            float4 previousPosition = previousPositions[globalId];
             float4 oppositeVelocity = previousPosition - newPosition;
 
             float projection = dot(contactNormal, oppositeVelocity);
             previousPosition -= (projection * onePlusRestitution) * contactNormal;
 
-            previousPositions[globalId] = previousPosition - (previousPosition - newPosition)* (1.0f - friction);
+            previousPosition = previousPosition - (previousPosition - newPosition)* (1.0f - friction);
         }
     }
 
@@ -510,7 +692,7 @@ __kernel void ComputeCollision( __global float4* positionsOutput,
         newPosition.w = 0.0f;
 
         const float radius = spheresIn[i].w;
-        const float4 difference = newPosition - spheresIn[i];
+        float4 difference = newPosition - spheresIn[i];
         difference.w = 0.0f;
         float sqrDistance = dot(difference, difference);
 
@@ -521,13 +703,12 @@ __kernel void ComputeCollision( __global float4* positionsOutput,
             newPosition = spheresIn[i] + contactNormal * radius;
             
             // Compute previous position to generate collision response considering restitution
-            float4 previousPosition = previousPositions[globalId];
             float4 oppositeVelocity = previousPosition - newPosition;
 
             float projection = dot(contactNormal, oppositeVelocity);
             previousPosition -= (projection * onePlusRestitution) * contactNormal;
 
-            previousPositions[globalId] = previousPosition - (previousPosition - newPosition)* (1.0f - friction);
+            previousPosition = previousPosition - (previousPosition - newPosition)* (1.0f - friction);
         }
     }
 
@@ -555,20 +736,20 @@ __kernel void ComputeCollision( __global float4* positionsOutput,
         {
             newPosition = newPosition2 + noise;
             // Compute previous position to generate collision response considering restitution
-            float4 previousPosition = previousPositions[globalId];
             float4 oppositeVelocity = (previousPosition - newPosition);
 
             float projection = dot(contactNormal, oppositeVelocity);
             previousPosition -= (projection * onePlusRestitution) * contactNormal;
 
-            previousPositions[globalId] = previousPosition - (previousPosition - newPosition)*friction;
+            previousPosition = previousPosition - (previousPosition - newPosition)*friction;
         }
 
     }
 
+    newPosition.w       = positionData;
+    previousPosition.w  = positionData;
     positionsOutput     [globalId]      = newPosition;
-    positionsOutput     [globalId].w    = positionData;
-    previousPositions   [globalId].w    = positionData;
+    StorePreviousPosition(previousPositions, globalId, newPosition, previousPosition);
 }
 
 
@@ -695,9 +876,11 @@ typedef struct
 
 
 __kernel void ComputeAccelerator(__global float4* positions,
-                                 __global float4* previousPositions,
+                                 __global PreviousPosition* previousPositions,
                                  __global const Accelerator* accelerators,
-                                 int acceleratorsCount)
+                                 int acceleratorsCount,
+                                 const float deltaT,
+                                 const float previousDeltaT)
 {
     size_t globalId = get_global_id(0);
 
@@ -822,12 +1005,13 @@ __kernel void ComputeAccelerator(__global float4* positions,
 
     acceleration.w = 0.0f;
 
-    const float deltaT = 1/60.0f;
     const float damping = 0.9999f;
-    const float dampingPlusOne = 1.0f + damping;
+    const float dampingRatio = damping * deltaT / previousDeltaT;
 
 
-    float4 newPosition = (positions[globalId] * dampingPlusOne - previousPositions[globalId] * damping) 
+    const float4 currentPosition = positions[globalId];
+    const float4 previousPosition = LoadPreviousPosition(previousPositions, globalId, currentPosition);
+    float4 newPosition = currentPosition + (currentPosition - previousPosition) * dampingRatio 
                                 + acceleration * deltaT * deltaT;
 
     newPosition.w = positionData;
@@ -835,12 +1019,12 @@ __kernel void ComputeAccelerator(__global float4* positions,
     // Store the previous position
     if ( ! hasKillSpeed)
     {
-        previousPositions[globalId] = positions[globalId];
+        StorePreviousPosition(previousPositions, globalId, newPosition, currentPosition);
         positions   [globalId] = newPosition;
     }
     else
     {
-        previousPositions[globalId] = positions[globalId];
+        StorePreviousPosition(previousPositions, globalId, currentPosition, currentPosition);
     }
 
     
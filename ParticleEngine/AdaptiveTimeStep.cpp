@@ -0,0 +1,143 @@
+#include "AdaptiveTimeStep.h"
+
+#include "Utility/ThreadPool.h"
+
+#include <cmath>
+#include <algorithm>
+#include <vector>
+
+namespace
+{
+    // Biggest squaredLength(i) of [0; count[, each thread of threadPool reduces its partition
+    template <class Function>
+    float ReduceMax(ThreadPool *threadPool, int count, const Function &squaredLength)
+    {
+        if (threadPool == NULL)
+        {
+            float maxValue = 0.0f;
+            for (int i = 0; i < count; i++)
+            {
+                maxValue = std::max(maxValue, squaredLength(i));
+            }
+            return maxValue;
+        }
+
+        std::vector<float> threadMaxValues(threadPool->GetThreadsCount(), 0.0f);
+        float *maxValues = &threadMaxValues[0];
+        threadPool->ParallelForStatic(count, [maxValues, &squaredLength](int first, int last)
+        {
+            float maxValue = 0.0f;
+            for (int i = first; i < last; i++)
+            {
+                maxValue = std::max(maxValue, squaredLength(i));
+            }
+            maxValues[ThreadPool::GetThreadIndex()] = maxValue;
+        });
+        return *std::max_element(threadMaxValues.begin(), threadMaxValues.end());
+    }
+}
+
+AdaptiveTimeStep::AdaptiveTimeStep() :  m_MinDeltaT(1.0f / 3840.0f),
+                                        m_MaxDeltaT(1.0f / 60.0f),
+                                        m_CourantFactor(0.4f),
+                                        m_ForceFactor(0.25f),
+                                        m_MaxSubStepsCount(32),
+                                        m_LengthScale(1.0f)
+{
+}
+
+void AdaptiveTimeStep::SetDeltaTLimits(float minDeltaT, float maxDeltaT)
+{
+    assert(minDeltaT > 0.0f && minDeltaT <= maxDeltaT);
+    m_MinDeltaT = minDeltaT;
+    m_MaxDeltaT = maxDeltaT;
+}
+
+void AdaptiveTimeStep::SetCourantFactor(float courantFactor)
+{
+    assert(courantFactor > 0.0f);
+    m_CourantFactor = courantFactor;
+}
+
+void AdaptiveTimeStep::SetForceFactor(float forceFactor)
+{
+    assert(forceFactor > 0.0f);
+    m_ForceFactor = forceFactor;
+}
+
+void AdaptiveTimeStep::SetMaxSubStepsCount(int maxSubStepsCount)
+{
+    assert(maxSubStepsCount > 0);
+    m_MaxSubStepsCount = maxSubStepsCount;
+}
+
+void AdaptiveTimeStep::SetLengthScale(float lengthScale)
+{
+    assert(lengthScale > 0.0f);
+    m_LengthScale = lengthScale;
+}
+
+float AdaptiveTimeStep::GetMinDeltaT() const
+{
+    return m_MinDeltaT;
+}
+
+float AdaptiveTimeStep::GetMaxDeltaT() const
+{
+    return m_MaxDeltaT;
+}
+
+int AdaptiveTimeStep::GetMaxSubStepsCount() const
+{
+    return m_MaxSubStepsCount;
+}
+
+float AdaptiveTimeStep::GetLengthScale() const
+{
+    return m_LengthScale;
+}
+
+float AdaptiveTimeStep::ComputeMaxSpeed(const slmath::vec4 *positions,
+                                        const slmath::vec4 *previousPositions,
+                                        int particlesCount,
+                                        float previousDeltaT,
+                                        ThreadPool *threadPool) const
+{
+    assert(previousDeltaT > 0.0f);
+    float maxSqrDisplacement = ReduceMax(threadPool, particlesCount, [positions, previousPositions](int i)
+    {
+        // w is used to store the color
+        slmath::vec3 displacement = slmath::vec3(positions[i]) - slmath::vec3(previousPositions[i]);
+        return slmath::dot(displacement, displacement);
+    });
+    return std::sqrt(maxSqrDisplacement) / previousDeltaT;
+}
+
+float AdaptiveTimeStep::ComputeMaxAcceleration(const slmath::vec4 *accelerations, int particlesCount, ThreadPool *threadPool) const
+{
+    float maxSqrAcceleration = ReduceMax(threadPool, particlesCount, [accelerations](int i)
+    {
+        slmath::vec3 acceleration(accelerations[i]);
+        return slmath::dot(acceleration, acceleration);
+    });
+    return std::sqrt(maxSqrAcceleration);
+}
+
+float AdaptiveTimeStep::ComputeStableDeltaT(float maxSpeed, float maxAcceleration, float soundSpeed, float h) const
+{
+    assert(h > 0.0f);
+    float deltaT = m_MaxDeltaT;
+
+    const float signalSpeed = maxSpeed + soundSpeed;
+    if (signalSpeed > 0.0f)
+    {
+        deltaT = std::min(deltaT, m_CourantFactor * h / signalSpeed);
+    }
+
+    if (maxAcceleration > 0.0f)
+    {
+        deltaT = std::min(deltaT, m_ForceFactor * std::sqrt(h / maxAcceleration));
+    }
+
+    return std::max(deltaT, m_MinDeltaT);
+}
@@ -0,0 +1,55 @@
+#ifndef ADAPTIVE_TIME_STEP
+#define ADAPTIVE_TIME_STEP
+
+#include <slmath/slmath.h>
+
+class ThreadPool;
+
+// Computes the biggest stable time step from the particles state.
+// Two CFL like conditions are used:
+//  - the fastest information must not travel further than a fraction of h,
+//    information is carried by the particle speed plus the SPH speed of sound
+//  - the biggest acceleration must not move a particle further than a fraction of h
+// h is the SPH smoothing length, or the length scale without SPH
+class AdaptiveTimeStep
+{
+public:
+    AdaptiveTimeStep();
+
+    void SetDeltaTLimits(float minDeltaT, float maxDeltaT);
+    void SetCourantFactor(float courantFactor);
+    void SetForceFactor(float forceFactor);
+    void SetMaxSubStepsCount(int maxSubStepsCount);
+    // h of the conditions without SPH, the distance a particle must not cross in a step.
+    // 1 by default, the size of a grid cell
+    void SetLengthScale(float lengthScale);
+
+    float GetMinDeltaT() const;
+    float GetMaxDeltaT() const;
+    int GetMaxSubStepsCount() const;
+    float GetLengthScale() const;
+
+    // Speed is deduced from the Verlet positions, previousDeltaT is the step
+    // which separates the two positions.
+    // The maxima are reduced by the threads of threadPool when it isn't NULL
+    float ComputeMaxSpeed(  const slmath::vec4 *positions,
+                            const slmath::vec4 *previousPositions,
+                            int particlesCount,
+                            float previousDeltaT,
+                            ThreadPool *threadPool = NULL) const;
+
+    float ComputeMaxAcceleration(const slmath::vec4 *accelerations, int particlesCount, ThreadPool *threadPool = NULL) const;
+
+    // Returns the stable step clamped between the limits
+    float ComputeStableDeltaT(float maxSpeed, float maxAcceleration, float soundSpeed, float h) const;
+
+private:
+    float   m_MinDeltaT;
+    float   m_MaxDeltaT;
+    float   m_CourantFactor;
+    float   m_ForceFactor;
+    int     m_MaxSubStepsCount;
+    float   m_LengthScale;
+};
+
+#endif // ADAPTIVE_TIME_STEP
@@ -0,0 +1,80 @@
+#include "CheckpointWriter.h"
+#include "Utility/Platform.h"
+
+#include <assert.h>
+#include <cstdio>
+#include <cstring>
+
+
+CheckpointWriter::CheckpointWriter() :  m_Image(NULL),
+                                        m_ImageSize(0),
+                                        m_ImageCapacity(0),
+                                        m_IsSucceeded(true)
+{
+}
+
+CheckpointWriter::~CheckpointWriter()
+{
+    Wait();
+    delete[] m_Image;
+}
+
+char* CheckpointWriter::BeginWrite(size_t size)
+{
+    Wait();
+
+    if (size > m_ImageCapacity)
+    {
+        delete[] m_Image;
+        m_Image = new char[size];
+        m_ImageCapacity = size;
+    }
+
+    // Padding between the sections is written too, the same state gives the same file
+    memset(m_Image, 0, size);
+    m_ImageSize = size;
+    return m_Image;
+}
+
+bool CheckpointWriter::EndWrite(const char *fileName)
+{
+    assert(m_Image != NULL && ! m_Thread.joinable() && "CheckpointWriter::EndWrite failed.");
+
+    m_FileName = fileName;
+    m_TemporaryFileName = m_FileName + ".tmp";
+    FILE *file = OpenFile(m_TemporaryFileName.c_str(), "wb");
+    if (file == NULL)
+    {
+        m_IsSucceeded = false;
+        return false;
+    }
+
+    m_IsSucceeded = true;
+    m_Thread = std::thread(&CheckpointWriter::Write, this, file);
+    return true;
+}
+
+bool CheckpointWriter::Wait()
+{
+    if (m_Thread.joinable())
+    {
+        m_Thread.join();
+    }
+    return m_IsSucceeded;
+}
+
+void CheckpointWriter::Write(FILE *file)
+{
+    // On the disk before the rename, a crash can't leave a renamed file without its data
+    bool isSucceeded = fwrite(m_Image, 1, m_ImageSize, file) == m_ImageSize;
+    isSucceeded = isSucceeded && SyncFile(file);
+    isSucceeded = (fclose(file) == 0) && isSucceeded;
+
+    // The previous checkpoint is only replaced by a complete one
+    isSucceeded = isSucceeded && ReplaceFileAtomically(m_TemporaryFileName.c_str(), m_FileName.c_str());
+    if ( ! isSucceeded)
+    {
+        remove(m_TemporaryFileName.c_str());
+    }
+    m_IsSucceeded = isSucceeded;
+}
@@ -0,0 +1,42 @@
+#ifndef CHECKPOINT_WRITER
+#define CHECKPOINT_WRITER
+
+#include <cstddef>
+#include <cstdio>
+#include <string>
+#include <thread>
+
+// Writes the image of a checkpoint on a background thread, the simulation only pays the
+// copy in the image. The file is written next to its final name, synchronized then renamed
+// over it, a crash while writing keeps the previous checkpoint. The image is kept for the
+// next checkpoint
+class CheckpointWriter
+{
+public:
+    CheckpointWriter();
+    ~CheckpointWriter();
+
+    // Waits for the previous write, the returned image is zeroed and filled by the caller
+    char* BeginWrite(size_t size);
+    // Returns false when the file can't be created
+    bool EndWrite(const char *fileName);
+    // Waits for the last write, returns false when it failed
+    bool Wait();
+
+private:
+    CheckpointWriter(const CheckpointWriter&);
+    CheckpointWriter& operator=(const CheckpointWriter&);
+
+    void Write(FILE *file);
+
+    char        *m_Image;
+    size_t      m_ImageSize;
+    size_t      m_ImageCapacity;
+    std::string m_FileName;
+    std::string m_TemporaryFileName;
+    std::thread m_Thread;
+    // Written by the background thread, read after the join
+    bool        m_IsSucceeded;
+};
+
+#endif // CHECKPOINT_WRITER
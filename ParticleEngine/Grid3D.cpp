@@ -1,25 +1,47 @@
 #include "Grid3D.h"
-#include "Utility/Timer.h"
+#include "Utility/Profiler.h"
+#include "Utility/Utility.h"
+#include "Utility/MemoryArena.h"
 
 #include <cmath>
-#include <windows.h>
 
 #include <algorithm>
 
-Grid3D::Grid3D():   m_ParticlesAllocatedCount(0), 
-                    m_ParticleCellOrder(NULL), 
+namespace
+{
+    // Cells of the virtual grid allocated by particle
+    const int s_VirtualCellsByParticle = 50;
+}
+
+Grid3D::Grid3D():   m_ParticleCellOrder(NULL), 
                     m_ParticleCellOrderBuffer(NULL),
-                    m_Grid(NULL)
+                    m_ParticleOrderIndex(NULL),
+                    m_Grid(NULL),
+                    m_MemoryArena(NULL),
+                    m_ParticlesAllocatedCount(0)
 {
 }
 
  Grid3D::~Grid3D()
  {
-    delete[] m_ParticleCellOrder;
-    delete[] m_ParticleCellOrderBuffer;
-    delete[] m_Grid;
+    ReleaseMemory();
  }
 
+void Grid3D::ReleaseMemory()
+{
+    MemoryArena::DeleteArray(m_MemoryArena, m_ParticleCellOrder);
+    MemoryArena::DeleteArray(m_MemoryArena, m_ParticleCellOrderBuffer);
+    MemoryArena::DeleteArray(m_MemoryArena, m_ParticleOrderIndex);
+    MemoryArena::DeleteArray(m_MemoryArena, m_Grid);
+
+    m_ParticleCellOrder         = NULL;
+    m_ParticleCellOrderBuffer   = NULL;
+    m_ParticleOrderIndex        = NULL;
+    m_Grid                      = NULL;
+    m_ParticlesAllocatedCount   = 0;
+    m_VirtualGridAllocatedCount = 0;
+}
+
  Grid3D::ParticleCellOrder* Grid3D::GetParticleCellOrder() const
  {
     return m_ParticleCellOrder;
@@ -30,6 +52,11 @@ Grid3D::Grid3D():   m_ParticlesAllocatedCount(0),
     return m_ParticleCellOrderBuffer;
  }
 
+ const int *Grid3D::GetParticleOrderIndex() const
+ {
+    return m_ParticleOrderIndex;
+ }
+
  int Grid3D::GetSecondAxisLength() const
  {
     return m_SecondAxisLength;
@@ -46,18 +73,39 @@ Grid3D::Grid3D():   m_ParticlesAllocatedCount(0),
  }
 
 
-void Grid3D::Reallocate()
+void Grid3D::Reserve(int particlesCapacity)
+{
+    assert(particlesCapacity > 0);
+    Reallocate(particlesCapacity);
+}
+
+void Grid3D::SetMemoryArena(MemoryArena *memoryArena)
+{
+    assert(m_ParticlesAllocatedCount == 0 && "Grid3D::SetMemoryArena failed.");
+    m_MemoryArena = memoryArena;
+}
+
+size_t Grid3D::GetMemorySize(int particlesCapacity)
+{
+    return  2 * MemoryArena::GetArraySize<ParticleCellOrder>(particlesCapacity) +
+            MemoryArena::GetArraySize<int>(particlesCapacity) +
+            MemoryArena::GetArraySize<int>(s_VirtualCellsByParticle * particlesCapacity);
+}
+
+void Grid3D::Reallocate(int particlesCount)
 {
-    if (m_ParticlesAllocatedCount < m_ParticlesCount)
+    if (m_ParticlesAllocatedCount < particlesCount)
     {
-        m_ParticlesAllocatedCount = m_ParticlesCount;
-        m_VirtualGridAllocatedCount = 50 * m_ParticlesCount;
-        delete[] m_ParticleCellOrder;
-        delete[] m_ParticleCellOrderBuffer;
-        delete[] m_Grid;
-        m_ParticleCellOrder         = new ParticleCellOrder[m_ParticlesAllocatedCount];
-        m_ParticleCellOrderBuffer   = new ParticleCellOrder[m_ParticlesAllocatedCount];
-        m_Grid                      = new int[m_VirtualGridAllocatedCount];
+        m_ParticlesAllocatedCount = particlesCount;
+        m_VirtualGridAllocatedCount = s_VirtualCellsByParticle * particlesCount;
+        MemoryArena::DeleteArray(m_MemoryArena, m_ParticleCellOrder);
+        MemoryArena::DeleteArray(m_MemoryArena, m_ParticleCellOrderBuffer);
+        MemoryArena::DeleteArray(m_MemoryArena, m_ParticleOrderIndex);
+        MemoryArena::DeleteArray(m_MemoryArena, m_Grid);
+        m_ParticleCellOrder         = MemoryArena::NewArray<ParticleCellOrder>(m_MemoryArena, m_ParticlesAllocatedCount);
+        m_ParticleCellOrderBuffer   = MemoryArena::NewArray<ParticleCellOrder>(m_MemoryArena, m_ParticlesAllocatedCount);
+        m_ParticleOrderIndex        = MemoryArena::NewArray<int>(m_MemoryArena, m_ParticlesAllocatedCount);
+        m_Grid                      = MemoryArena::NewArray<int>(m_MemoryArena, m_VirtualGridAllocatedCount);
 
     }
 }
@@ -65,19 +113,19 @@ void Grid3D::Reallocate()
 void Grid3D::InitSizeGrid(slmath::vec4 *particlePositions, int particlesCount)
 {
     m_ParticlesCount = particlesCount;
-    Reallocate();
+    Reallocate(m_ParticlesCount);
 
     m_MaxAABB = particlePositions[0];
     m_MinAABB = particlePositions[0];
 
-    Timer::GetInstance()->StartTimerProfile();
+    PROFILE_BEGIN();
     for (int i = 1; i < particlesCount; i++)
     {
         m_MaxAABB = slmath::max(particlePositions[i], m_MaxAABB);
         m_MinAABB = slmath::min(particlePositions[i], m_MinAABB);
     }
 
-    Timer::GetInstance()->StopTimerProfile("Min on CPU");
+    PROFILE_END("Min on CPU");
 
     m_MaxAABB.x = std::floor(m_MaxAABB.x + 1.0f);
     m_MaxAABB.y = std::floor(m_MaxAABB.y + 1.0f);
@@ -90,7 +138,7 @@ void Grid3D::InitSizeGrid(slmath::vec4 *particlePositions, int particlesCount)
 
 void Grid3D::Initialize(slmath::vec4 *particlePositions, int particlesCount)
 {
-    Timer::GetInstance()->StartTimerProfile();
+    PROFILE_BEGIN();
     
     InitSizeGrid(particlePositions, particlesCount);
 
@@ -193,7 +241,16 @@ void Grid3D::Initialize(slmath::vec4 *particlePositions, int particlesCount)
     
     
     RadixSort();
-    Timer::GetInstance()->StopTimerProfile("Create Grid");
+
+    // Range of the sorted cells, used by the hash search
+    m_MinCellUsed = m_ParticleCellOrder[0].m_CellIndex;
+    m_MaxCellUsed = m_ParticleCellOrder[particlesCount - 1].m_CellIndex;
+
+    for (int i = 0; i < particlesCount; i++)
+    {
+        m_ParticleOrderIndex[m_ParticleCellOrder[i].m_ParticleIndex] = i;
+    }
+    PROFILE_END("Create Grid");
 
     m_GridInfo[0] = m_ParticlesCount;
     m_GridInfo[1] = m_SecondAxisLength;
@@ -203,7 +260,7 @@ void Grid3D::Initialize(slmath::vec4 *particlePositions, int particlesCount)
 
 void Grid3D::InitializeFullGrid(slmath::vec4 *particlePositions, int particlesCount)
 {
-    Timer::GetInstance()->StartTimerProfile();
+    PROFILE_BEGIN();
 
     Initialize(particlePositions, particlesCount);
 
@@ -356,7 +413,7 @@ void Grid3D::InitializeFullGrid(slmath::vec4 *particlePositions, int particlesCo
         }
     }
 
-    Timer::GetInstance()->StopTimerProfile("Create Grid");
+    PROFILE_END("Create Grid");
 }
 
 
@@ -399,7 +456,7 @@ int Grid3D::GetNeighborsMin(int currentIndex)
 // Twenty seven cells to check !
 int Grid3D::GetNeighborsByParticleOrder(int currentIndex,  int *neighbors, int neighborsMaxCount)
 {
-    UNREFERENCED_PARAMETER(neighborsMaxCount);
+    UNUSED_PARAMETER(neighborsMaxCount);
     assert(neighborsMaxCount > 0);
     // Itself is considered
     int neighborsCount = 0;
@@ -621,7 +678,7 @@ int Grid3D::GetNeighbors(int currentIndex,  int *neighbors, int neighborsMaxCoun
 
 int Grid3D::GetNeighborsByParticleOrderFullGrid(int currentIndex,  int *neighbors, int neighborsMaxCount) const
 {
-    UNREFERENCED_PARAMETER(neighborsMaxCount);
+    UNUSED_PARAMETER(neighborsMaxCount);
     assert(neighborsMaxCount > 0);
     const int cellsCount = 27;
     int cellPositions[cellsCount];
@@ -662,7 +719,7 @@ int Grid3D::GetNeighborsByParticleOrderFullGrid(int currentIndex,  int *neighbor
 
 int Grid3D::GetNeighborsByParticleOrderHeuristic(int currentIndex,  int *neighbors, int neighborsMaxCount)
 {
-    UNREFERENCED_PARAMETER(neighborsMaxCount);
+    UNUSED_PARAMETER(neighborsMaxCount);
     assert(neighborsMaxCount > 0);
     const int cellsCount = 27;
     int cellPositions[cellsCount];
@@ -820,6 +877,9 @@ int Grid3D::ComputeHashNeighbors(int currentIndex,  int *neighbors, int neighbor
 
 int Grid3D::HashFunction(int cellToSearch) const
 {
+    if (m_MaxCellUsed == m_MinCellUsed || m_ParticlesCount < 2)
+        return 0;
+
     float hashRatio = float(m_MaxCellUsed - m_MinCellUsed) / (m_ParticlesCount - 1);
     int indexToFind = int((cellToSearch - m_MinCellUsed) / hashRatio);
 
@@ -831,6 +891,9 @@ int Grid3D::SearchPosition(int cellToSearch) const
     int indexToFind = HashFunction(cellToSearch);
     int indexToSearch = indexToFind;
 
+    if (cellToSearch < m_MinCellUsed || cellToSearch > m_MaxCellUsed)
+        return -1;
+
     if (indexToFind < 0 || indexToFind >= m_ParticlesCount)
         return -1;
 
@@ -838,16 +901,22 @@ int Grid3D::SearchPosition(int cellToSearch) const
     {
         indexToFind--;
     }
-    if (m_ParticleCellOrder[indexToFind].m_CellIndex != cellToSearch)
+    if (indexToFind < 0)
         indexToFind = indexToSearch;
 
     while (indexToFind < m_ParticlesCount && m_ParticleCellOrder[indexToFind].m_CellIndex != cellToSearch)
     {
         indexToFind++;
     }
-    if (m_ParticleCellOrder[indexToFind].m_CellIndex != cellToSearch)
+    if (indexToFind >= m_ParticlesCount)
         return -1;
 
+    // First particle of the cell
+    while (indexToFind > 0 && m_ParticleCellOrder[indexToFind - 1].m_CellIndex == cellToSearch)
+    {
+        indexToFind--;
+    }
+
     return indexToFind;
 }
 
@@ -1244,7 +1313,7 @@ int Grid3D::ConmputeCellsOnTrajectory(const slmath::vec3 &trajectory, const slma
                                             int *positionsIndex, int positionsMaxCount) const
 {
     const float increment = 0.5f;
-    UNREFERENCED_PARAMETER(positionsMaxCount);
+    UNUSED_PARAMETER(positionsMaxCount);
     int positionsIndexCount = 0;
     
     float distance = slmath::length(trajectory);
@@ -1373,7 +1442,7 @@ int Grid3D::ConmputeCellsOnTrajectory(const slmath::vec3 &trajectory, const slma
 int Grid3D::ComputeParticlesOnTrajectory(int currentIndex, const slmath::vec3 &trajectory, const slmath::vec3 &position, 
                                      int *positionsIndex, int positionsMaxCount) const
 {
-    UNREFERENCED_PARAMETER(positionsMaxCount);
+    UNUSED_PARAMETER(positionsMaxCount);
     assert(positionsMaxCount > 27);
     const int maxCellsCount = 1024;
     int cellPositions[maxCellsCount];
@@ -4,6 +4,8 @@
 
 #include <slmath/slmath.h>
 
+class MemoryArena;
+
 class Grid3D
 {
 
@@ -13,6 +15,12 @@ public:
     void Initialize(slmath::vec4 *particlePositions, int particlesCount);
     void InitializeFullGrid(slmath::vec4 *particlePositions, int particlesCount);
 
+    // Capacity is reserved to add particles without reallocation
+    void Reserve(int particlesCapacity);
+    void SetMemoryArena(MemoryArena *memoryArena);
+    static size_t GetMemorySize(int particlesCapacity);
+    void ReleaseMemory();
+
     // Returns neighbors by particles positions index
     int GetNeighbors(int currentIndex,  int *neighbors, int neighborsMaxCount);
 
@@ -43,6 +51,9 @@ public:
     ParticleCellOrder *GetParticleCellOrder()const;
     ParticleCellOrder *GetParticleCellOrderBuffer()const;
 
+    // Inverse of ParticleCellOrder: index in ParticleCellOrder array by particle index
+    const int *GetParticleOrderIndex()const;
+
 
     int ComputeParticlesOnTrajectory(  int currentIndex,
                                         const slmath::vec3 &trajectory, 
@@ -68,7 +79,7 @@ private:
     void HashCellIndex();
 
     void CreateFullGrid();
-    void Reallocate();
+    void Reallocate(int particlesCount);
 
     slmath::vec4 m_MaxAABB;
     slmath::vec4 m_MinAABB;
@@ -84,7 +95,9 @@ private:
 
     ParticleCellOrder *m_ParticleCellOrder;
     ParticleCellOrder *m_ParticleCellOrderBuffer;
+    int               *m_ParticleOrderIndex;
     int               *m_Grid;
+    MemoryArena       *m_MemoryArena;
 
     int m_ParticlesAllocatedCount;
     int m_ParticlesCount;
@@ -0,0 +1,227 @@
+#include "MultiRateStepping.h"
+#include "AdaptiveTimeStep.h"
+#include "Utility/Profiler.h"
+#include "Utility/MemoryArena.h"
+
+#include <cmath>
+#include <algorithm>
+
+
+MultiRateStepping::MultiRateStepping() :    m_Levels(NULL),
+                                            m_ActiveIndices(NULL),
+                                            m_DeltaTs(NULL),
+                                            m_PreviousDeltaTs(NULL),
+                                            m_MemoryArena(NULL),
+                                            m_LevelsCount(4),
+                                            m_ActiveCount(0),
+                                            m_ParticlesCount(0),
+                                            m_ParticlesCapacity(0)
+{
+}
+
+MultiRateStepping::~MultiRateStepping()
+{
+    ReleaseMemory();
+}
+
+void MultiRateStepping::ReleaseMemory()
+{
+    MemoryArena::DeleteArray(m_MemoryArena, m_Levels);
+    MemoryArena::DeleteArray(m_MemoryArena, m_ActiveIndices);
+    MemoryArena::DeleteArray(m_MemoryArena, m_DeltaTs);
+    MemoryArena::DeleteArray(m_MemoryArena, m_PreviousDeltaTs);
+
+    m_Levels            = NULL;
+    m_ActiveIndices     = NULL;
+    m_DeltaTs           = NULL;
+    m_PreviousDeltaTs   = NULL;
+    m_ActiveCount       = 0;
+    m_ParticlesCount    = 0;
+    m_ParticlesCapacity = 0;
+}
+
+void MultiRateStepping::SetLevelsCount(int levelsCount)
+{
+    assert(levelsCount > 0 && levelsCount <= s_MaxLevelsCount);
+    m_LevelsCount = levelsCount;
+}
+
+int MultiRateStepping::GetLevelsCount() const
+{
+    return m_LevelsCount;
+}
+
+void MultiRateStepping::Initialize(int particlesCount, float deltaT)
+{
+    assert(particlesCount > 0);
+    assert(deltaT > 0.0f);
+    if (m_ParticlesCapacity < particlesCount)
+    {
+        Reserve(particlesCount);
+    }
+    m_ParticlesCount = particlesCount;
+    for (int i = 0; i < m_ParticlesCount; i++)
+    {
+        m_Levels[i] = 0;
+        m_DeltaTs[i] = deltaT;
+        m_PreviousDeltaTs[i] = deltaT;
+    }
+    m_ActiveCount = 0;
+}
+
+int MultiRateStepping::GetParticlesCount() const
+{
+    return m_ParticlesCount;
+}
+
+void MultiRateStepping::AddParticles(int particlesCount, float deltaT)
+{
+    assert(m_ParticlesCount + particlesCount <= m_ParticlesCapacity);
+    assert(deltaT > 0.0f);
+    for (int i = m_ParticlesCount; i < m_ParticlesCount + particlesCount; i++)
+    {
+        m_Levels[i] = 0;
+        m_DeltaTs[i] = deltaT;
+        m_PreviousDeltaTs[i] = deltaT;
+    }
+    m_ParticlesCount += particlesCount;
+}
+
+void MultiRateStepping::CompactParticles(const int *sources, const int *destinations, int movesCount, int particlesCount)
+{
+    assert(particlesCount <= m_ParticlesCount);
+    for (int i = 0; i < movesCount; i++)
+    {
+        m_Levels[destinations[i]]           = m_Levels[sources[i]];
+        m_DeltaTs[destinations[i]]          = m_DeltaTs[sources[i]];
+        m_PreviousDeltaTs[destinations[i]]  = m_PreviousDeltaTs[sources[i]];
+    }
+    m_ParticlesCount = particlesCount;
+}
+
+float MultiRateStepping::ComputeStableDeltaTs(  const slmath::vec4 *positions,
+                                                const slmath::vec4 *previousPositions,
+                                                const slmath::vec4 *accelerations,
+                                                const slmath::vec4 &commonAcceleration,
+                                                float soundSpeed,
+                                                float h,
+                                                const AdaptiveTimeStep &adaptiveTimeStep)
+{
+    PROFILE_BEGIN();
+
+    const float commonAccelerationLength = slmath::length(slmath::vec3(commonAcceleration));
+    float minDeltaT = adaptiveTimeStep.GetMaxDeltaT();
+    for (int i = 0; i < m_ParticlesCount; i++)
+    {
+        // w is used to store the color
+        slmath::vec3 displacement = slmath::vec3(positions[i]) - slmath::vec3(previousPositions[i]);
+        float speed = slmath::length(displacement) / m_PreviousDeltaTs[i];
+        float acceleration = commonAccelerationLength;
+        if (accelerations != NULL)
+        {
+            acceleration += slmath::length(slmath::vec3(accelerations[i]));
+        }
+
+        m_DeltaTs[i] = adaptiveTimeStep.ComputeStableDeltaT(speed, acceleration, soundSpeed, h);
+        minDeltaT = std::min(minDeltaT, m_DeltaTs[i]);
+    }
+
+    PROFILE_END("Multi rate: stable steps");
+    return minDeltaT;
+}
+
+void MultiRateStepping::AssignLevels(float baseDeltaT)
+{
+    assert(baseDeltaT > 0.0f);
+    const int maxLevel = m_LevelsCount - 1;
+    for (int i = 0; i < m_ParticlesCount; i++)
+    {
+        // Biggest power of two of the base step smaller than the stable step
+        int level = static_cast<int>(floorf(log2f(m_DeltaTs[i] / baseDeltaT)));
+        level = std::max(0, std::min(level, maxLevel));
+
+        m_Levels[i] = level;
+        m_DeltaTs[i] = baseDeltaT * static_cast<float>(1 << level);
+    }
+}
+
+int MultiRateStepping::GetSubStepsCount() const
+{
+    return 1 << (m_LevelsCount - 1);
+}
+
+int MultiRateStepping::BuildActiveList(int subStep)
+{
+    assert(subStep >= 0 && subStep < GetSubStepsCount());
+    m_ActiveCount = 0;
+    for (int i = 0; i < m_ParticlesCount; i++)
+    {
+        const int levelMask = (1 << m_Levels[i]) - 1;
+        if ((subStep & levelMask) == 0)
+        {
+            m_ActiveIndices[m_ActiveCount++] = i;
+        }
+    }
+    return m_ActiveCount;
+}
+
+const int *MultiRateStepping::GetActiveIndices() const
+{
+    return m_ActiveIndices;
+}
+
+int MultiRateStepping::GetActiveCount() const
+{
+    return m_ActiveCount;
+}
+
+const float *MultiRateStepping::GetDeltaTs() const
+{
+    return m_DeltaTs;
+}
+
+float *MultiRateStepping::GetPreviousDeltaTs() const
+{
+    return m_PreviousDeltaTs;
+}
+
+void MultiRateStepping::Reserve(int particlesCapacity)
+{
+    assert(particlesCapacity > 0);
+    if (particlesCapacity <= m_ParticlesCapacity)
+        return;
+
+    int *levels             = MemoryArena::NewArray<int>(m_MemoryArena, particlesCapacity);
+    float *deltaTs          = MemoryArena::NewArray<float>(m_MemoryArena, particlesCapacity);
+    float *previousDeltaTs  = MemoryArena::NewArray<float>(m_MemoryArena, particlesCapacity);
+    for (int i = 0; i < m_ParticlesCount; i++)
+    {
+        levels[i]           = m_Levels[i];
+        deltaTs[i]          = m_DeltaTs[i];
+        previousDeltaTs[i]  = m_PreviousDeltaTs[i];
+    }
+
+    MemoryArena::DeleteArray(m_MemoryArena, m_Levels);
+    MemoryArena::DeleteArray(m_MemoryArena, m_ActiveIndices);
+    MemoryArena::DeleteArray(m_MemoryArena, m_DeltaTs);
+    MemoryArena::DeleteArray(m_MemoryArena, m_PreviousDeltaTs);
+
+    m_ParticlesCapacity = particlesCapacity;
+    m_Levels            = levels;
+    m_ActiveIndices     = MemoryArena::NewArray<int>(m_MemoryArena, m_ParticlesCapacity);
+    m_DeltaTs           = deltaTs;
+    m_PreviousDeltaTs   = previousDeltaTs;
+    m_ActiveCount       = 0;
+}
+
+void MultiRateStepping::SetMemoryArena(MemoryArena *memoryArena)
+{
+    assert(m_ParticlesCapacity == 0 && "MultiRateStepping::SetMemoryArena failed.");
+    m_MemoryArena = memoryArena;
+}
+
+size_t MultiRateStepping::GetMemorySize(int particlesCapacity)
+{
+    return  2 * MemoryArena::GetArraySize<int>(particlesCapacity) +
+            2 * MemoryArena::GetArraySize<float>(particlesCapacity);
+}
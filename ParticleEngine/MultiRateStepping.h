@@ -0,0 +1,76 @@
+#ifndef MULTI_RATE_STEPPING
+#define MULTI_RATE_STEPPING
+
+#include <slmath/slmath.h>
+
+class AdaptiveTimeStep;
+class MemoryArena;
+
+// Block time stepping: each particle is assigned to a power of two level
+// from its own stable step. A block is made of 2^(levelsCount - 1) sub steps
+// of the base step, a particle of level L is integrated every 2^L sub steps
+// with a step of 2^L base steps. All particles are synchronized at the end of a block.
+class MultiRateStepping
+{
+public:
+    MultiRateStepping();
+    ~MultiRateStepping();
+
+    void SetLevelsCount(int levelsCount);
+    int GetLevelsCount() const;
+
+    // deltaT is the step used to reach the current positions
+    void Initialize(int particlesCount, float deltaT);
+    int GetParticlesCount() const;
+
+    // Capacity is reserved to add particles without reallocation, steps are kept
+    void Reserve(int particlesCapacity);
+    void SetMemoryArena(MemoryArena *memoryArena);
+    static size_t GetMemorySize(int particlesCapacity);
+    void ReleaseMemory();
+    // Particles added after the last one, deltaT is the step used to reach their positions
+    void AddParticles(int particlesCount, float deltaT);
+    // Moves the steps from sources to destinations then shrinks the count
+    void CompactParticles(const int *sources, const int *destinations, int movesCount, int particlesCount);
+
+    // Computes the stable step of each particle, returns the smallest one.
+    // accelerations can be NULL
+    float ComputeStableDeltaTs( const slmath::vec4 *positions,
+                                const slmath::vec4 *previousPositions,
+                                const slmath::vec4 *accelerations,
+                                const slmath::vec4 &commonAcceleration,
+                                float soundSpeed,
+                                float h,
+                                const AdaptiveTimeStep &adaptiveTimeStep);
+
+    // Must be called at the start of a block, after ComputeStableDeltaTs
+    void AssignLevels(float baseDeltaT);
+
+    // Sub steps in a block
+    int GetSubStepsCount() const;
+
+    // Fills the active list of the sub step, returns the active particles count
+    int BuildActiveList(int subStep);
+    const int *GetActiveIndices() const;
+    int GetActiveCount() const;
+
+    // Steps by particle index
+    const float *GetDeltaTs() const;
+    float *GetPreviousDeltaTs() const;
+
+private:
+    static const int s_MaxLevelsCount = 8;
+
+    int     *m_Levels;
+    int     *m_ActiveIndices;
+    float   *m_DeltaTs;
+    float   *m_PreviousDeltaTs;
+    MemoryArena *m_MemoryArena;
+
+    int     m_LevelsCount;
+    int     m_ActiveCount;
+    int     m_ParticlesCount;
+    int     m_ParticlesCapacity;
+};
+
+#endif // MULTI_RATE_STEPPING
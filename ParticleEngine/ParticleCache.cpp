@@ -0,0 +1,325 @@
+#include "ParticleCache.h"
+
+#include <assert.h>
+#include <cmath>
+#include <cstring>
+
+
+namespace
+{
+    // Largest float below 2^31, the quantized positions are clamped to it
+    const float s_QuantizedLimit = 2147483520.0f;
+
+    int Quantize(float value, float inverseQuantum)
+    {
+        float scaled = value * inverseQuantum;
+        // NaN goes to the lower limit
+        if ( ! (scaled > -s_QuantizedLimit))
+        {
+            scaled = -s_QuantizedLimit;
+        }
+        if (scaled > s_QuantizedLimit)
+        {
+            scaled = s_QuantizedLimit;
+        }
+        return static_cast<int>(floorf(scaled + 0.5f));
+    }
+
+    // Deltas wrap around, the decoder gets the same values whatever their range
+    unsigned int ZigZag(int previous, int value)
+    {
+        const int delta = static_cast<int>(static_cast<unsigned int>(value) - static_cast<unsigned int>(previous));
+        return (static_cast<unsigned int>(delta) << 1) ^ static_cast<unsigned int>(delta >> 31);
+    }
+
+    int UnZigZag(int previous, unsigned int code)
+    {
+        const unsigned int delta = (code >> 1) ^ (0u - (code & 1));
+        return static_cast<int>(static_cast<unsigned int>(previous) + delta);
+    }
+
+    void WriteVarint(unsigned int value, std::vector<unsigned char>& data)
+    {
+        while (value >= 0x80)
+        {
+            data.push_back(static_cast<unsigned char>(value | 0x80));
+            value >>= 7;
+        }
+        data.push_back(static_cast<unsigned char>(value));
+    }
+
+    bool ReadVarint(const unsigned char *data, size_t size, size_t& offset, unsigned int& value)
+    {
+        value = 0;
+        for (int shift = 0; shift < 35; shift += 7)
+        {
+            if (offset >= size)
+                return false;
+            const unsigned char byte = data[offset++];
+            value |= static_cast<unsigned int>(byte & 0x7f) << shift;
+            if ((byte & 0x80) == 0)
+                return true;
+        }
+        return false;
+    }
+
+    unsigned int GetColor(const vrVec4& position)
+    {
+        unsigned int color;
+        memcpy(&color, &position.w, sizeof(color));
+        return color;
+    }
+
+    // From the previous particle in a key frame, else from the particle in the key frame
+    unsigned int GetColorDelta(const vrVec4 *positions, const unsigned int *keyColors, int index, bool isKeyFrame)
+    {
+        if (isKeyFrame)
+            return GetColor(positions[index]) ^ (index > 0 ? GetColor(positions[index - 1]) : 0);
+        return GetColor(positions[index]) ^ keyColors[index];
+    }
+}
+
+// "PCCH" in the first bytes of a little endian file
+const unsigned int ParticleCache::s_Magic   = 0x48434350;
+const unsigned int ParticleCache::s_Version = 2;
+
+void ParticleCache::EncodeFrame(const vrVec4 *positions, int particlesCount, float quantum, bool isKeyFrame,
+                                int *keyQuantizedPositions, unsigned int *keyColors, std::vector<unsigned char>& data)
+{
+    assert(quantum > 0.0f && "ParticleCache::EncodeFrame failed.");
+    const float inverseQuantum = 1.0f / quantum;
+
+    // One component after the other, the deltas of a component are alike
+    for (int component = 0; component < 3; component++)
+    {
+        int previous = 0;
+        for (int i = 0; i < particlesCount; i++)
+        {
+            const vrVec4& position = positions[i];
+            const float value = component == 0 ? position.x : (component == 1 ? position.y : position.z);
+            int& keyQuantized = keyQuantizedPositions[i * 3 + component];
+            const int current = Quantize(value, inverseQuantum);
+            WriteVarint(ZigZag(isKeyFrame ? previous : keyQuantized, current), data);
+            if (isKeyFrame)
+            {
+                keyQuantized = current;
+            }
+            previous = current;
+        }
+    }
+
+    // Runs of the same xor of the color, most frames are a single run of 0
+    int i = 0;
+    while (i < particlesCount)
+    {
+        const unsigned int delta = GetColorDelta(positions, keyColors, i, isKeyFrame);
+        int runEnd = i + 1;
+        while (runEnd < particlesCount && GetColorDelta(positions, keyColors, runEnd, isKeyFrame) == delta)
+        {
+            runEnd++;
+        }
+        WriteVarint(static_cast<unsigned int>(runEnd - i), data);
+        WriteVarint(delta, data);
+        i = runEnd;
+    }
+
+    if (isKeyFrame)
+    {
+        for (i = 0; i < particlesCount; i++)
+        {
+            keyColors[i] = GetColor(positions[i]);
+        }
+    }
+}
+
+bool ParticleCache::DecodeFrame(const unsigned char *data, size_t size, int particlesCount, bool isKeyFrame,
+                                const int *keyQuantizedPositions, const unsigned int *keyColors,
+                                int *quantizedPositions, unsigned int *colors)
+{
+    size_t offset = 0;
+    unsigned int code = 0;
+    for (int component = 0; component < 3; component++)
+    {
+        int previous = 0;
+        for (int i = 0; i < particlesCount; i++)
+        {
+            if ( ! ReadVarint(data, size, offset, code))
+                return false;
+            const int index = i * 3 + component;
+            quantizedPositions[index] = UnZigZag(isKeyFrame ? previous : keyQuantizedPositions[index], code);
+            previous = quantizedPositions[index];
+        }
+    }
+
+    unsigned int previousColor = 0;
+    int i = 0;
+    while (i < particlesCount)
+    {
+        unsigned int runLength = 0;
+        unsigned int delta = 0;
+        if ( ! ReadVarint(data, size, offset, runLength) || ! ReadVarint(data, size, offset, delta))
+            return false;
+        if (runLength == 0 || runLength > static_cast<unsigned int>(particlesCount - i))
+            return false;
+
+        const int runEnd = i + static_cast<int>(runLength);
+        for (; i < runEnd; i++)
+        {
+            colors[i] = delta ^ (isKeyFrame ? previousColor : keyColors[i]);
+            previousColor = colors[i];
+        }
+    }
+    return offset == size;
+}
+
+unsigned int ParticleCache::GetChecksum(const unsigned char *data, size_t size)
+{
+    unsigned int hash = 2166136261u;
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= data[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+ParticleCache::ParticleCache() :    m_Header(NULL),
+                                    m_Frames(NULL),
+                                    m_FramesCount(0),
+                                    m_DecodedKeyFrame(-1)
+{
+}
+
+bool ParticleCache::Open(const char *fileName)
+{
+    Close();
+    if ( ! m_File.Open(fileName))
+        return false;
+
+    m_Header = static_cast<const ParticleCacheHeader*>(m_File.GetData());
+    if ( ! ReadIndex())
+    {
+        Close();
+        return false;
+    }
+    return true;
+}
+
+void ParticleCache::Close()
+{
+    m_File.Close();
+    m_Header        = NULL;
+    m_Frames        = NULL;
+    m_FramesCount       = 0;
+    m_DecodedKeyFrame   = -1;
+}
+
+const ParticleCacheHeader& ParticleCache::GetHeader() const
+{
+    assert(m_Header != NULL && "ParticleCache::GetHeader failed.");
+    return *m_Header;
+}
+
+int ParticleCache::GetFramesCount() const
+{
+    return m_FramesCount;
+}
+
+int ParticleCache::GetParticlesCount(int frame) const
+{
+    assert(frame >= 0 && frame < m_FramesCount && "ParticleCache::GetParticlesCount failed.");
+    return m_Frames[frame].m_ParticlesCount;
+}
+
+bool ParticleCache::ReadFrame(int frame, vrVec4 *positions)
+{
+    assert(frame >= 0 && frame < m_FramesCount && "ParticleCache::ReadFrame failed.");
+    const ParticleCacheFrame& description = m_Frames[frame];
+    const int particlesCount = description.m_ParticlesCount;
+    const int keyFrame = description.m_KeyFrame;
+
+    if (m_DecodedKeyFrame != keyFrame)
+    {
+        m_KeyQuantizedPositions.resize(particlesCount * 3);
+        m_KeyColors.resize(particlesCount);
+        m_DecodedKeyFrame = -1;
+        if ( ! DecodeFrame(keyFrame, NULL, NULL, m_KeyQuantizedPositions.data(), m_KeyColors.data()))
+            return false;
+        m_DecodedKeyFrame = keyFrame;
+    }
+
+    const int *quantizedPositions = m_KeyQuantizedPositions.data();
+    const unsigned int *colors = m_KeyColors.data();
+    if (frame != keyFrame)
+    {
+        m_QuantizedPositions.resize(particlesCount * 3);
+        m_Colors.resize(particlesCount);
+        if ( ! DecodeFrame( frame, m_KeyQuantizedPositions.data(), m_KeyColors.data(),
+                            m_QuantizedPositions.data(), m_Colors.data()))
+            return false;
+        quantizedPositions = m_QuantizedPositions.data();
+        colors = m_Colors.data();
+    }
+
+    const float quantum = m_Header->m_Quantum;
+    for (int i = 0; i < particlesCount; i++)
+    {
+        vrVec4& position = positions[i];
+        position.x = quantizedPositions[i * 3] * quantum;
+        position.y = quantizedPositions[i * 3 + 1] * quantum;
+        position.z = quantizedPositions[i * 3 + 2] * quantum;
+        memcpy(&position.w, &colors[i], sizeof(position.w));
+    }
+    return true;
+}
+
+// The checksum is verified before the data is decoded
+bool ParticleCache::DecodeFrame(int frame, const int *keyQuantizedPositions, const unsigned int *keyColors,
+                                int *quantizedPositions, unsigned int *colors) const
+{
+    const ParticleCacheFrame& description = m_Frames[frame];
+    const unsigned char *data = static_cast<const unsigned char*>(m_File.GetData()) + description.m_Offset;
+    if (GetChecksum(data, description.m_Size) != description.m_Checksum)
+        return false;
+
+    return DecodeFrame( data, description.m_Size, description.m_ParticlesCount, frame == description.m_KeyFrame,
+                        keyQuantizedPositions, keyColors, quantizedPositions, colors);
+}
+
+// Validates the header and the index, the frames of a chunk have the particles count of
+// its key frame. The index is 8 bytes aligned after the frames
+bool ParticleCache::ReadIndex()
+{
+    const unsigned long long fileSize = m_File.GetSize();
+    if (fileSize < sizeof(ParticleCacheHeader) + sizeof(ParticleCacheFooter))
+        return false;
+    if (m_Header->m_Magic != s_Magic || m_Header->m_Version != s_Version ||
+        m_Header->m_HeaderSize != sizeof(ParticleCacheHeader) || ! (m_Header->m_Quantum > 0.0f))
+        return false;
+
+    const char *data = static_cast<const char*>(m_File.GetData());
+    // Copied, a truncated file doesn't end on an aligned footer
+    ParticleCacheFooter footer;
+    memcpy(&footer, data + fileSize - sizeof(ParticleCacheFooter), sizeof(footer));
+    if (footer.m_Magic != s_Magic || footer.m_FramesCount < 0 || footer.m_IndexOffset % 8 != 0 ||
+        footer.m_IndexOffset < sizeof(ParticleCacheHeader) ||
+        footer.m_IndexOffset + footer.m_FramesCount * sizeof(ParticleCacheFrame) + sizeof(ParticleCacheFooter) != fileSize)
+        return false;
+
+    const ParticleCacheFrame *frames = reinterpret_cast<const ParticleCacheFrame*>(data + footer.m_IndexOffset);
+    for (int i = 0; i < footer.m_FramesCount; i++)
+    {
+        const ParticleCacheFrame& frame = frames[i];
+        if (frame.m_Offset < sizeof(ParticleCacheHeader) || frame.m_Offset > footer.m_IndexOffset ||
+            frame.m_Size > footer.m_IndexOffset - frame.m_Offset)
+            return false;
+        if (frame.m_ParticlesCount < 0 || frame.m_KeyFrame < 0 || frame.m_KeyFrame > i ||
+            frames[frame.m_KeyFrame].m_KeyFrame != frame.m_KeyFrame ||
+            frames[frame.m_KeyFrame].m_ParticlesCount != frame.m_ParticlesCount)
+            return false;
+    }
+
+    m_Frames = frames;
+    m_FramesCount = footer.m_FramesCount;
+    return true;
+}
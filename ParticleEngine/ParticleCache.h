@@ -0,0 +1,98 @@
+#ifndef PARTICLE_CACHE
+#define PARTICLE_CACHE
+
+#include "PhysicsParticle.h"
+#include "Utility/MappedFile.h"
+
+#include <cstddef>
+#include <vector>
+
+// First bytes of a cache, the frames follow in their order
+struct ParticleCacheHeader
+{
+    unsigned int        m_Magic;
+    unsigned int        m_Version;
+    unsigned int        m_HeaderSize;
+    int                 m_KeyFrameInterval;
+    // World size of the quantization step of the positions
+    float               m_Quantum;
+    unsigned int        m_Pad[3];
+};
+
+// Entry of the index of the frames
+struct ParticleCacheFrame
+{
+    unsigned long long  m_Offset;
+    unsigned int        m_Size;
+    int                 m_ParticlesCount;
+    // Frame starting the chunk of this one, the frame itself for a key frame
+    int                 m_KeyFrame;
+    // Of the encoded bytes, cf ParticleCache::GetChecksum
+    unsigned int        m_Checksum;
+};
+
+// Last bytes of a cache, written when it is closed
+struct ParticleCacheFooter
+{
+    unsigned long long  m_IndexOffset;
+    int                 m_FramesCount;
+    unsigned int        m_Magic;
+};
+
+// Per frame particles for offline rendering: positions quantized on a grid of the
+// quantum and the packed color of w.
+// Frames are grouped in chunks. The key frame of a chunk is delta encoded from particle
+// to particle, the next frames from the key frame. The deltas are zigzag varints, the
+// colors runs of the same delta, so resting particles and constant colors cost a byte or
+// less. A frame only needs the key frame of its chunk to be decoded, the index of the
+// footer gives their offsets without reading the other frames
+class ParticleCache
+{
+public:
+    static const unsigned int s_Magic;
+    static const unsigned int s_Version;
+
+    // The quantized positions and colors are the ones of the key frame of the chunk, sized
+    // by the particles count. A key frame replaces them, the other frames only read them
+    static void EncodeFrame(const vrVec4 *positions, int particlesCount, float quantum, bool isKeyFrame,
+                            int *keyQuantizedPositions, unsigned int *keyColors, std::vector<unsigned char>& data);
+    // Reverse of EncodeFrame, the key arrays aren't read for a key frame and can be the
+    // decoded ones. Returns false when the data is corrupted
+    static bool DecodeFrame(const unsigned char *data, size_t size, int particlesCount, bool isKeyFrame,
+                            const int *keyQuantizedPositions, const unsigned int *keyColors,
+                            int *quantizedPositions, unsigned int *colors);
+    // FNV-1a of the encoded bytes of a frame
+    static unsigned int GetChecksum(const unsigned char *data, size_t size);
+
+    ParticleCache();
+
+    // Returns false when the file isn't a closed cache of this version
+    bool Open(const char *fileName);
+    void Close();
+
+    const ParticleCacheHeader& GetHeader() const;
+    int GetFramesCount() const;
+    int GetParticlesCount(int frame) const;
+    // Positions are sized by the particles count of the frame. The last decoded key frame
+    // is kept, the other frames of its chunk are then decoded alone.
+    // Returns false when the frame or its key frame is corrupted
+    bool ReadFrame(int frame, vrVec4 *positions);
+
+private:
+    bool ReadIndex();
+    bool DecodeFrame(int frame, const int *keyQuantizedPositions, const unsigned int *keyColors,
+                     int *quantizedPositions, unsigned int *colors) const;
+
+    MappedFile                  m_File;
+    const ParticleCacheHeader   *m_Header;
+    const ParticleCacheFrame    *m_Frames;
+    int                         m_FramesCount;
+    // Key frame of the key arrays, -1 when there is none
+    int                         m_DecodedKeyFrame;
+    std::vector<int>            m_KeyQuantizedPositions;
+    std::vector<unsigned int>   m_KeyColors;
+    std::vector<int>            m_QuantizedPositions;
+    std::vector<unsigned int>   m_Colors;
+};
+
+#endif // PARTICLE_CACHE
@@ -0,0 +1,223 @@
+#include "ParticleCacheWriter.h"
+#include "Utility/Platform.h"
+#include "Utility/Profiler.h"
+
+#include <assert.h>
+#include <cstring>
+
+
+ParticleCacheWriter::ParticleCacheWriter() :    m_File(NULL),
+                                                m_Quantum(1.0f / 1024.0f),
+                                                m_KeyFrameInterval(30),
+                                                m_FillingSnapshot(0),
+                                                m_FramesCount(0),
+                                                m_IsFramePending(false),
+                                                m_IsStopping(false),
+                                                m_Offset(0),
+                                                m_RawSize(0),
+                                                m_IsSucceeded(true)
+{
+}
+
+ParticleCacheWriter::~ParticleCacheWriter()
+{
+    Close();
+}
+
+bool ParticleCacheWriter::Open(const char *fileName, float quantum /*= 1.0f / 1024.0f*/, int keyFrameInterval /*= 30*/)
+{
+    assert(quantum > 0.0f && keyFrameInterval > 0 && "ParticleCacheWriter::Open failed.");
+    Close();
+
+    m_File = OpenFile(fileName, "wb");
+    if (m_File == NULL)
+        return false;
+
+    m_Quantum           = quantum;
+    m_KeyFrameInterval  = keyFrameInterval;
+    m_FillingSnapshot   = 0;
+    m_FramesCount       = 0;
+    m_IsFramePending    = false;
+    m_IsStopping        = false;
+    m_Offset            = 0;
+    m_RawSize           = 0;
+    m_IsSucceeded       = true;
+    m_Frames.clear();
+
+    ParticleCacheHeader header;
+    memset(&header, 0, sizeof(header));
+    header.m_Magic              = ParticleCache::s_Magic;
+    header.m_Version            = ParticleCache::s_Version;
+    header.m_HeaderSize         = sizeof(ParticleCacheHeader);
+    header.m_KeyFrameInterval   = keyFrameInterval;
+    header.m_Quantum            = quantum;
+    Write(&header, sizeof(header));
+
+    m_Thread = std::thread(&ParticleCacheWriter::WorkerLoop, this);
+    return true;
+}
+
+bool ParticleCacheWriter::Close()
+{
+    if (m_File == NULL)
+        return m_IsSucceeded;
+
+    {
+        std::unique_lock<std::mutex> lock(m_Mutex);
+        while (m_IsFramePending)
+        {
+            m_Done.wait(lock);
+        }
+        m_IsStopping = true;
+    }
+    m_WakeUp.notify_one();
+    m_Thread.join();
+
+    // The index is 8 bytes aligned, the reader uses it in place
+    const unsigned char padding[8] = { 0 };
+    Write(padding, static_cast<size_t>((8 - m_Offset % 8) % 8));
+
+    ParticleCacheFooter footer;
+    memset(&footer, 0, sizeof(footer));
+    footer.m_IndexOffset    = m_Offset;
+    footer.m_FramesCount    = static_cast<int>(m_Frames.size());
+    footer.m_Magic          = ParticleCache::s_Magic;
+    if ( ! m_Frames.empty())
+    {
+        Write(&m_Frames[0], m_Frames.size() * sizeof(ParticleCacheFrame));
+    }
+    Write(&footer, sizeof(footer));
+
+    m_IsSucceeded = (fclose(m_File) == 0) && m_IsSucceeded;
+    m_File = NULL;
+    return m_IsSucceeded;
+}
+
+bool ParticleCacheWriter::IsOpen() const
+{
+    return m_File != NULL;
+}
+
+void ParticleCacheWriter::BeginFrame()
+{
+    assert(m_File != NULL && "ParticleCacheWriter::BeginFrame failed.");
+    // The worker never uses the filling snapshot, its capacity is kept from frame to frame
+    m_Snapshots[m_FillingSnapshot].clear();
+}
+
+void ParticleCacheWriter::AddParticles(const vrVec4 *positions, int particlesCount)
+{
+    std::vector<vrVec4>& snapshot = m_Snapshots[m_FillingSnapshot];
+    snapshot.insert(snapshot.end(), positions, positions + particlesCount);
+}
+
+void ParticleCacheWriter::EndFrame()
+{
+    assert(m_File != NULL && "ParticleCacheWriter::EndFrame failed.");
+    {
+        std::unique_lock<std::mutex> lock(m_Mutex);
+        while (m_IsFramePending)
+        {
+            m_Done.wait(lock);
+        }
+        m_IsFramePending = true;
+        m_FillingSnapshot = 1 - m_FillingSnapshot;
+    }
+    m_WakeUp.notify_one();
+    m_FramesCount++;
+}
+
+int ParticleCacheWriter::GetFramesCount() const
+{
+    return m_FramesCount;
+}
+
+unsigned long long ParticleCacheWriter::GetEncodedSize() const
+{
+    unsigned long long size = 0;
+    for (size_t i = 0; i < m_Frames.size(); i++)
+    {
+        size += m_Frames[i].m_Size;
+    }
+    return size;
+}
+
+unsigned long long ParticleCacheWriter::GetRawSize() const
+{
+    return m_RawSize;
+}
+
+void ParticleCacheWriter::WorkerLoop()
+{
+    Profiler::GetInstance()->SetThreadName("Particle cache writer");
+
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    for (;;)
+    {
+        while ( ! m_IsFramePending && ! m_IsStopping)
+        {
+            m_WakeUp.wait(lock);
+        }
+        if ( ! m_IsFramePending)
+            break;
+
+        // The pending snapshot is the one the simulation doesn't fill
+        const std::vector<vrVec4>& snapshot = m_Snapshots[1 - m_FillingSnapshot];
+        lock.unlock();
+        {
+            PROFILE_SCOPE("Write cache frame");
+            WriteFrame(snapshot);
+        }
+        lock.lock();
+
+        m_IsFramePending = false;
+        m_Done.notify_one();
+    }
+}
+
+// A chunk starts every key frame interval and when the particles count changes
+void ParticleCacheWriter::WriteFrame(const std::vector<vrVec4>& snapshot)
+{
+    const int particlesCount = static_cast<int>(snapshot.size());
+    const int frameIndex = static_cast<int>(m_Frames.size());
+
+    ParticleCacheFrame frame;
+    memset(&frame, 0, sizeof(frame));
+    frame.m_Offset          = m_Offset;
+    frame.m_ParticlesCount  = particlesCount;
+    frame.m_KeyFrame        = frameIndex;
+    if ( ! m_Frames.empty())
+    {
+        const ParticleCacheFrame& previous = m_Frames.back();
+        if (previous.m_ParticlesCount == particlesCount && frameIndex - previous.m_KeyFrame < m_KeyFrameInterval)
+        {
+            frame.m_KeyFrame = previous.m_KeyFrame;
+        }
+    }
+
+    const bool isKeyFrame = frame.m_KeyFrame == frameIndex;
+    if (isKeyFrame)
+    {
+        m_KeyQuantizedPositions.resize(particlesCount * 3);
+        m_KeyColors.resize(particlesCount);
+    }
+
+    m_Data.clear();
+    ParticleCache::EncodeFrame( snapshot.data(), particlesCount, m_Quantum, isKeyFrame,
+                                m_KeyQuantizedPositions.data(), m_KeyColors.data(), m_Data);
+    frame.m_Size        = static_cast<unsigned int>(m_Data.size());
+    frame.m_Checksum    = ParticleCache::GetChecksum(m_Data.data(), m_Data.size());
+    Write(m_Data.data(), m_Data.size());
+
+    m_Frames.push_back(frame);
+    m_RawSize += particlesCount * sizeof(vrVec4);
+}
+
+void ParticleCacheWriter::Write(const void *data, size_t size)
+{
+    if (size > 0 && fwrite(data, 1, size, m_File) != size)
+    {
+        m_IsSucceeded = false;
+    }
+    m_Offset += size;
+}
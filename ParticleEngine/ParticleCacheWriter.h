@@ -0,0 +1,74 @@
+#ifndef PARTICLE_CACHE_WRITER
+#define PARTICLE_CACHE_WRITER
+
+#include "ParticleCache.h"
+
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Streams the frames of a simulation in a ParticleCache.
+// The particles of a frame are copied in one of two snapshots, a worker thread encodes
+// and writes the other one. The simulation only pays the copy, it waits when the worker
+// is still on the frame before the previous one
+class ParticleCacheWriter
+{
+public:
+    ParticleCacheWriter();
+    ~ParticleCacheWriter();
+
+    // The quantum is the world size of the quantization step of the positions, a chunk
+    // starts every keyFrameInterval frames. Returns false when the file can't be created
+    bool Open(const char *fileName, float quantum = 1.0f / 1024.0f, int keyFrameInterval = 30);
+    // Writes the pending frames and the index, returns false when a write failed
+    bool Close();
+    bool IsOpen() const;
+
+    // The particles of several simulations are added one after the other in a frame
+    void BeginFrame();
+    void AddParticles(const vrVec4 *positions, int particlesCount);
+    void EndFrame();
+
+    int GetFramesCount() const;
+    // Sizes of the written frames and of their particles, valid after Close
+    unsigned long long GetEncodedSize() const;
+    unsigned long long GetRawSize() const;
+
+private:
+    ParticleCacheWriter(const ParticleCacheWriter&);
+    ParticleCacheWriter& operator=(const ParticleCacheWriter&);
+
+    void WorkerLoop();
+    void WriteFrame(const std::vector<vrVec4>& snapshot);
+    void Write(const void *data, size_t size);
+
+    FILE                                *m_File;
+    float                               m_Quantum;
+    int                                 m_KeyFrameInterval;
+
+    // Snapshot filled by the simulation, the other one is the worker one
+    std::vector<vrVec4>                 m_Snapshots[2];
+    int                                 m_FillingSnapshot;
+    int                                 m_FramesCount;
+
+    std::thread                         m_Thread;
+    std::mutex                          m_Mutex;
+    std::condition_variable             m_WakeUp;
+    std::condition_variable             m_Done;
+    // Written under the mutex, the snapshot handed to the worker
+    bool                                m_IsFramePending;
+    bool                                m_IsStopping;
+
+    // Worker state, read by the simulation after the join
+    std::vector<int>                    m_KeyQuantizedPositions;
+    std::vector<unsigned int>           m_KeyColors;
+    std::vector<unsigned char>          m_Data;
+    std::vector<ParticleCacheFrame>     m_Frames;
+    unsigned long long                  m_Offset;
+    unsigned long long                  m_RawSize;
+    bool                                m_IsSucceeded;
+};
+
+#endif // PARTICLE_CACHE_WRITER
@@ -1,26 +1,45 @@
 
 #include "ParticlesAccelerator.h"
-#include "Utility/Timer.h"
+#include "Utility/Profiler.h"
+#include "Utility/MemoryArena.h"
 
 
-ParticlesAccelerator::ParticlesAccelerator() :  m_AccelerationsCount(0),
-                                                m_Accelerations(NULL)
+ParticlesAccelerator::ParticlesAccelerator() :  m_Accelerations(NULL),
+                                                m_AccelerationsCount(0),
+                                                m_MemoryArena(NULL),
+                                                m_Generation(1)
 {
 }
 
 ParticlesAccelerator::~ParticlesAccelerator()
 {
-    delete[] m_Accelerations;
+    ReleaseMemory();
+}
+
+void ParticlesAccelerator::ReleaseMemory()
+{
+    MemoryArena::DeleteArray(m_MemoryArena, m_Accelerations);
+
+    m_Accelerations      = NULL;
+    m_AccelerationsCount = 0;
 }
 
 void ParticlesAccelerator::AllocateAccelerations(int particlesCount)
 {
     m_AccelerationsCount = particlesCount;
-    if (m_Accelerations != NULL)
-    {
-        delete[] m_Accelerations;
-    }
-    m_Accelerations = new slmath::vec4[m_AccelerationsCount];
+    MemoryArena::DeleteArray(m_MemoryArena, m_Accelerations);
+    m_Accelerations = MemoryArena::NewArray<slmath::vec4>(m_MemoryArena, m_AccelerationsCount);
+}
+
+void ParticlesAccelerator::SetMemoryArena(MemoryArena *memoryArena)
+{
+    assert(m_Accelerations == NULL && "ParticlesAccelerator::SetMemoryArena failed.");
+    m_MemoryArena = memoryArena;
+}
+
+size_t ParticlesAccelerator::GetMemorySize(int particlesCount)
+{
+    return MemoryArena::GetArraySize<slmath::vec4>(particlesCount);
 }
 
 void ParticlesAccelerator::Initialize()
@@ -39,11 +58,13 @@ slmath::vec4 *ParticlesAccelerator::GetAccelerations()
 void ParticlesAccelerator::AddAccelerator(const Accelerator& accelerator)
 {
     m_Accelerators.push_back(accelerator);
+    m_Generation++;
 }
 
 void ParticlesAccelerator::ClearAccelerators()
 {
     m_Accelerators.clear();
+    m_Generation++;
 }
 
 const Accelerator *ParticlesAccelerator::GetAccelerators() const
@@ -66,21 +87,24 @@ void ParticlesAccelerator::UpdateAccelerator(int index, const Accelerator& accel
     assert(static_cast<unsigned int>(index) < m_Accelerators.size());
 
     m_Accelerators[index] = accelerator;
+    m_Generation++;
+}
+
+unsigned int ParticlesAccelerator::GetGeneration() const
+{
+    return m_Generation;
 }
 
 void ParticlesAccelerator::Accelerate(slmath::vec4 *particles, int particlesCount)
 {
-    Timer::GetInstance()->StartTimerProfile();
+    PROFILE_BEGIN();
 
     if (m_AccelerationsCount < particlesCount)
     {
+        // Only when the accelerations weren't allocated for the capacity
         m_AccelerationsCount = particlesCount;
-        if (m_Accelerations != NULL)
-        {
-            delete[] m_Accelerations;
-        }
-        m_AccelerationsCount = particlesCount;
-        m_Accelerations = new slmath::vec4[m_AccelerationsCount];
+        MemoryArena::DeleteArray(m_MemoryArena, m_Accelerations);
+        m_Accelerations = MemoryArena::NewArray<slmath::vec4>(m_MemoryArena, m_AccelerationsCount);
         for (int j = 0; j < particlesCount; j++)
         {
             m_Accelerations[j] = slmath::vec4(0.0f);
@@ -111,11 +135,49 @@ void ParticlesAccelerator::Accelerate(slmath::vec4 *particles, int particlesCoun
             }
         }
     }
-    Timer::GetInstance()->StopTimerProfile("Accelerator");
+    PROFILE_END("Accelerator");
+}
+
+void ParticlesAccelerator::Accelerate(slmath::vec4 *particles, int particlesCount, const int *activeIndices, int activeCount)
+{
+    PROFILE_BEGIN();
+
+    if (m_AccelerationsCount < particlesCount)
+    {
+        AllocateAccelerations(particlesCount);
+        Initialize();
+    }
+
+    const int acceleratorCount = m_Accelerators.size();
+    for (int i = 0; i < acceleratorCount; i++)
+    {
+        Accelerator accelerator = m_Accelerators[i];
+        float sqrRadius = accelerator.m_Radius * accelerator.m_Radius;
+        for (int j = 0; j < activeCount; j++)
+        {
+            const int index = activeIndices[j];
+            slmath::vec3 separation = accelerator.m_Position - slmath::vec3(particles[index]);
+            float sqrDistance = slmath::dot(separation, separation);
+
+            if (sqrDistance > 1.0f && sqrDistance < sqrRadius)
+            {
+                float distance = sqrt(sqrDistance);
+                slmath::vec4 normal = separation / distance;
+
+                m_Accelerations[index] = normal * (accelerator.m_Radius / distance);
+            }
+            else
+            {
+                m_Accelerations[index] = slmath::vec4(0.0f);
+            }
+        }
+    }
+    PROFILE_END("Accelerator active");
 }
 
 
 void ParticlesAccelerator::Release()
 {
     m_Accelerators.clear();
+    m_Generation++;
 }
\ No newline at end of file
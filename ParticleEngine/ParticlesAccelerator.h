@@ -6,6 +6,7 @@
 #include <slmath/slmath.h>
 #include "Utility/AlignmentAllocator.h"
 
+class MemoryArena;
 
 struct Accelerator
 {
@@ -22,10 +23,16 @@ public:
     ~ParticlesAccelerator();
     void Initialize();
     void AllocateAccelerations(int particlesCount);
+    // AllocateAccelerations is the Reserve of the arena components
+    void SetMemoryArena(MemoryArena *memoryArena);
+    static size_t GetMemorySize(int particlesCount);
+    void ReleaseMemory();
     slmath::vec4 *GetAccelerations();
     void AddAccelerator(const Accelerator& accelerator);
     void ClearAccelerators();
     void Accelerate(slmath::vec4 *particles, int particlesCount);
+    // Only the accelerations of the active list are updated
+    void Accelerate(slmath::vec4 *particles, int particlesCount, const int *activeIndices, int activeCount);
     void Release();
 
     const Accelerator *GetAccelerators() const;
@@ -33,12 +40,17 @@ public:
 
     void UpdateAccelerator(int index, const Accelerator& accelerator);
 
+    // Incremented by AddAccelerator, ClearAccelerators, UpdateAccelerator and Release
+    unsigned int GetGeneration() const;
+
 
 private:
     // std::vector<Accelerator>    m_Accelerators;
     std::vector<Accelerator, AlignmentAllocator<Accelerator, 16> > m_Accelerators;
     slmath::vec4               *m_Accelerations;
     int                         m_AccelerationsCount;
+    MemoryArena                 *m_MemoryArena;
+    unsigned int                m_Generation;
 };
 
 #endif // PARTICLES_ACCELERATOR
\ No newline at end of file
@@ -0,0 +1,87 @@
+#ifndef PARTICLES_BACKEND
+#define PARTICLES_BACKEND
+
+#include <cstddef>
+#include "PipelineDescription.h"
+
+namespace slmath
+{
+    class vec4;
+}
+
+struct Aabb;
+struct Sphere;
+struct Spring;
+struct Accelerator;
+struct SphParameters;
+
+struct ID3D11Buffer;
+
+// Stages enabled in the PipelineDescription run on a backend, the OpenCL one or the
+// native CPU one. Host arrays are given by the update functions, a backend can keep its
+// own copy of the particles until Synchronize. Functions return 0 on success
+class ParticlesBackend
+{
+public:
+    virtual ~ParticlesBackend() {}
+
+    // Function used only for cloth simulation
+    virtual void SetClothCount(int clothCount) = 0;
+
+    // Function used only for animation
+    virtual void SetAnimationTime(float animationTime) = 0;
+
+    // Step used by the integration, the previous one corrects the Verlet velocity
+    virtual void SetDeltaT(float deltaT) = 0;
+
+    virtual bool IsUsingInteroperability() const = 0;
+
+    virtual int Initialize( int particlesCount, int springsCount, int acceleratorsCount,
+                            const PipelineDescription& pipeline, ID3D11Buffer *d3D11buffer = NULL) = 0;
+
+    // Initialize
+    virtual int InitializeCreateGrid() = 0;
+    virtual int InitializeKernelSPH() = 0;
+    virtual int InitializeKernelCollision() = 0;
+    virtual int InitializeKernelAccelerator() = 0;
+    virtual int InitializeKernelSpring() = 0;
+    virtual int InitializeKernelAnimation() = 0;
+
+    // Stages
+    virtual int runKernelCreateGrid() = 0;
+    virtual int runKernelSPH() = 0;
+    virtual int runKernelCollision() = 0;
+    virtual int runKernelSpring() = 0;
+    virtual int runKernelAccelerator() = 0;
+    virtual int runKernelAnimation() = 0;
+
+    // Update functions
+    virtual void UpdateInputCreateGrid(slmath::vec4 *positions, slmath::vec4 *outMin, int *neighborInfo, int *neighborInfo2, int *gridInfo) = 0;
+    // The generations tell when the parameters, shapes or accelerators must be uploaded again
+    virtual void UpdateInputSPH(slmath::vec4 *positions, slmath::vec4 *previousPositions, float * density, int *neighborInfo, int *gridInfo,
+                                const SphParameters& sphParameters, unsigned int parametersGeneration) = 0;
+    virtual void UpdateInputCollision(  slmath::vec4 *positions, slmath::vec4 *previousPositions, int particlesCount,
+                                        const Sphere *spheres, int spheresCount,
+                                        const Sphere *spheresIn, int spheresInCount,
+                                        const Aabb *aabbs, int aabbsCount,
+                                        unsigned int shapesGeneration) = 0;
+    virtual void UpdateInputSpring(slmath::vec4 *positions, int particlesCount, const Spring *springs, int springsCount) = 0;
+    virtual void UpdateInputAccelerator(slmath::vec4 *positions, slmath::vec4 *previousPositions, int particlesCount,
+                                        const Accelerator *accelerators, int acceleratorsCount,
+                                        unsigned int acceleratorsGeneration) = 0;
+    virtual void UpdateInputAnimation(slmath::vec4 *positions, slmath::vec4 *ends, int particlesCount) = 0;
+
+    // Host particles are used again by the next initialize kernel calls
+    virtual void InvalidateDeviceParticles() = 0;
+
+    // Single sync point of a step, without read back the host particles can be out of date
+    virtual int Synchronize(bool isReadingBack = true) = 0;
+    virtual bool HasPendingReadBack() const = 0;
+    // Densities of the last SPH step are also read back by the next synchronization,
+    // a checkpoint needs them on the host
+    virtual void ReadBackDensities() = 0;
+
+    virtual int cleanup() = 0;
+};
+
+#endif // PARTICLES_BACKEND
@@ -0,0 +1,1048 @@
+#include "ParticlesCPU.h"
+#include "ParticlesCollider.h"
+#include "ParticlesSpring.h"
+#include "ParticlesAccelerator.h"
+#include "SmoothedParticleHydrodynamics.h"
+#include "Utility/Utility.h"
+#include "Utility/Profiler.h"
+
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+
+namespace
+{
+    const int s_GrainSize = 256;
+
+    int FloorToInt(float value)
+    {
+        return static_cast<int>(std::floor(value));
+    }
+}
+
+ParticlesCPU::ParticlesCPU() :  m_ThreadsCount(0),
+                                m_IsThreadPoolStarted(false),
+                                m_ParticlesCount(0),
+                                m_SpringsCount(0),
+                                m_AcceleratorsCount(0),
+                                m_ClothCount(1),
+                                m_AnimationTime(0.0f),
+                                m_DeltaT(1.0f / 60.0f),
+                                m_PreviousDeltaT(1.0f / 60.0f),
+                                m_Positions(NULL),
+                                m_PreviousPositions(NULL),
+                                m_EndsAnimation(NULL),
+                                m_Density(NULL),
+                                m_Spheres(NULL),
+                                m_SpheresIn(NULL),
+                                m_Aabbs(NULL),
+                                m_SpheresCount(0),
+                                m_SpheresInCount(0),
+                                m_AabbsCount(0),
+                                m_Springs(NULL),
+                                m_Accelerators(NULL),
+                                m_SphParameters(NULL),
+                                m_DevicePositions(NULL),
+                                m_DevicePreviousPositions(NULL),
+                                m_OutputPositions(NULL),
+                                m_StartsAnimation(NULL),
+                                m_InputDensities(NULL),
+                                m_OutputDensities(NULL),
+                                m_CellKeys(NULL),
+                                m_CellKeysBuffer(NULL),
+                                m_SortedCellKeys(NULL),
+                                m_ParticleCells(NULL),
+                                m_SecondAxisLength(1),
+                                m_ThirdAxisLength(1),
+                                m_SliceMins(NULL),
+                                m_SliceMaxs(NULL),
+                                m_IsPositionsOnDevice(false),
+                                m_IsPreviousPositionsOnDevice(false),
+                                m_IsReadingPositions(false),
+                                m_IsReadingPreviousPositions(false),
+                                m_IsReadingDensities(false)
+{
+}
+
+ParticlesCPU::~ParticlesCPU()
+{
+    cleanup();
+}
+
+void ParticlesCPU::SetThreadsCount(int threadsCount)
+{
+    assert(threadsCount >= 0);
+    m_ThreadsCount = threadsCount;
+    m_IsThreadPoolStarted = false;
+}
+
+int ParticlesCPU::GetThreadsCount() const
+{
+    return ThreadPool::ResolveThreadsCount(m_ThreadsCount);
+}
+
+void ParticlesCPU::SetIsPinningThreads(bool isPinningThreads)
+{
+    m_ThreadPool.SetIsPinningThreads(isPinningThreads);
+}
+
+ThreadPool *ParticlesCPU::StartPinnedThreads()
+{
+    if ( ! m_ThreadPool.IsPinningThreads())
+        return NULL;
+
+    if ( ! m_IsThreadPoolStarted)
+    {
+        m_ThreadPool.Initialize(m_ThreadsCount);
+        m_IsThreadPoolStarted = true;
+    }
+    return &m_ThreadPool;
+}
+
+ThreadPool *ParticlesCPU::GetThreadPool()
+{
+    return m_IsThreadPoolStarted ? &m_ThreadPool : NULL;
+}
+
+template <class Function>
+void ParticlesCPU::ParallelForParticles(int count, const Function &function, int grainSize)
+{
+    if (m_ThreadPool.IsPinningThreads())
+    {
+        m_ThreadPool.ParallelForStatic(count, function);
+    }
+    else
+    {
+        m_ThreadPool.ParallelFor(count, function, grainSize);
+    }
+}
+
+void ParticlesCPU::SetClothCount(int clothCount)
+{
+    m_ClothCount = clothCount;
+}
+
+void ParticlesCPU::SetAnimationTime(float animationTime)
+{
+    m_AnimationTime = animationTime;
+}
+
+void ParticlesCPU::SetDeltaT(float deltaT)
+{
+    assert(deltaT > 0.0f);
+    m_PreviousDeltaT = m_DeltaT;
+    m_DeltaT = deltaT;
+}
+
+bool ParticlesCPU::IsUsingInteroperability() const
+{
+    return false;
+}
+
+int ParticlesCPU::Initialize(   int particlesCount, int springsCount, int acceleratorsCount,
+                                const PipelineDescription& pipeline, ID3D11Buffer *d3D11buffer /*= NULL*/)
+{
+    assert(particlesCount > 0);
+    assert(d3D11buffer == NULL && "No interoperability with the native backend.");
+    UNUSED_PARAMETER(d3D11buffer);
+    ReleaseArrays();
+
+    m_ParticlesCount    = particlesCount;
+    m_SpringsCount      = springsCount;
+    m_AcceleratorsCount = acceleratorsCount;
+    m_Pipeline          = pipeline;
+    // Half previous positions are a device storage, converting them would cost more than the saved bandwidth here
+    m_Pipeline.m_IsUsingHalfPreviousPositions = false;
+
+    // Kept when started by StartPinnedThreads, the threads stay on the nodes of the host arrays they touched
+    if ( ! m_IsThreadPoolStarted)
+    {
+        m_ThreadPool.Initialize(m_ThreadsCount);
+        m_IsThreadPoolStarted = true;
+    }
+    const int slicesCount = m_ThreadPool.GetThreadsCount();
+
+    // Mapped without being touched, the first touch below places the pages unless they are Windows large pages
+    m_MemoryArena.Reserve(GetMemorySize(m_ParticlesCount, slicesCount), 0, 0);
+    MemoryArena *memoryArena = &m_MemoryArena;
+    m_DevicePositions           = MemoryArena::NewArray<slmath::vec4>(memoryArena, m_ParticlesCount);
+    m_DevicePreviousPositions   = MemoryArena::NewArray<slmath::vec4>(memoryArena, m_ParticlesCount);
+    m_OutputPositions           = MemoryArena::NewArray<slmath::vec4>(memoryArena, m_ParticlesCount);
+    m_StartsAnimation           = MemoryArena::NewArray<slmath::vec4>(memoryArena, m_ParticlesCount);
+    m_InputDensities            = MemoryArena::NewArray<float>(memoryArena, m_ParticlesCount);
+    m_OutputDensities           = MemoryArena::NewArray<float>(memoryArena, m_ParticlesCount);
+    m_CellKeys                  = MemoryArena::NewArray<unsigned long long>(memoryArena, m_ParticlesCount);
+    m_CellKeysBuffer            = MemoryArena::NewArray<unsigned long long>(memoryArena, m_ParticlesCount);
+    m_ParticleCells             = MemoryArena::NewArray<int>(memoryArena, m_ParticlesCount);
+    m_SortedCellKeys            = m_CellKeys;
+    m_SliceMins                 = MemoryArena::NewArray<slmath::vec4>(memoryArena, slicesCount);
+    m_SliceMaxs                 = MemoryArena::NewArray<slmath::vec4>(memoryArena, slicesCount);
+
+    // First touch, the pages of a range go to the node of the thread running it
+    slmath::vec4 *devicePositions = m_DevicePositions;
+    slmath::vec4 *devicePreviousPositions = m_DevicePreviousPositions;
+    slmath::vec4 *outputPositions = m_OutputPositions;
+    slmath::vec4 *startsAnimation = m_StartsAnimation;
+    float *inputDensities = m_InputDensities;
+    float *outputDensities = m_OutputDensities;
+    unsigned long long *cellKeys = m_CellKeys;
+    unsigned long long *cellKeysBuffer = m_CellKeysBuffer;
+    int *particleCells = m_ParticleCells;
+    ParallelForParticles(m_ParticlesCount, [=](int first, int last)
+    {
+        const int count = last - first;
+        const slmath::vec4 zero(0.0f, 0.0f, 0.0f, 0.0f);
+        std::fill(devicePositions + first, devicePositions + last, zero);
+        std::fill(devicePreviousPositions + first, devicePreviousPositions + last, zero);
+        std::fill(outputPositions + first, outputPositions + last, zero);
+        std::fill(startsAnimation + first, startsAnimation + last, zero);
+        memset(inputDensities + first, 0, count * sizeof(float));
+        memset(outputDensities + first, 0, count * sizeof(float));
+        memset(cellKeys + first, 0, count * sizeof(unsigned long long));
+        memset(cellKeysBuffer + first, 0, count * sizeof(unsigned long long));
+        memset(particleCells + first, 0, count * sizeof(int));
+    }, 4096);
+
+    // New device arrays, everything is copied again
+    InvalidateDeviceParticles();
+    return 0;
+}
+
+void ParticlesCPU::UpdateInputCreateGrid(slmath::vec4 *positions, slmath::vec4 *outMin, int *neighborInfo, int *neighborInfo2, int *gridInfo)
+{
+    // The grid stays in the backend like on the device
+    UNUSED_PARAMETER(outMin);
+    UNUSED_PARAMETER(neighborInfo);
+    UNUSED_PARAMETER(neighborInfo2);
+    UNUSED_PARAMETER(gridInfo);
+    m_Positions = positions;
+}
+
+void ParticlesCPU::UpdateInputSPH(  slmath::vec4 *positions, slmath::vec4 *previousPositions, float * density,
+                                    int *neighborInfo, int *gridInfo, const SphParameters& sphParameters,
+                                    unsigned int parametersGeneration)
+{
+    assert(gridInfo[0] == m_ParticlesCount);
+    UNUSED_PARAMETER(neighborInfo);
+    UNUSED_PARAMETER(gridInfo);
+    UNUSED_PARAMETER(parametersGeneration);
+
+    m_Positions         = positions;
+    m_PreviousPositions = previousPositions;
+    m_Density           = density;
+    m_SphParameters     = &sphParameters;
+}
+
+void ParticlesCPU::UpdateInputCollision(slmath::vec4 *positions, slmath::vec4 *previousPositions, int particlesCount,
+                                        const Sphere *spheres, int spheresCount,
+                                        const Sphere *spheresIn, int spheresInCount,
+                                        const Aabb *aabbs, int aabbsCount,
+                                        unsigned int shapesGeneration)
+{
+    assert(particlesCount == m_ParticlesCount);
+    UNUSED_PARAMETER(particlesCount);
+    UNUSED_PARAMETER(shapesGeneration);
+
+    // Shapes are read in place, a sphere is a center and a radius in w, an aabb two corners
+    m_Positions         = positions;
+    m_PreviousPositions = previousPositions;
+    m_Spheres           = reinterpret_cast<const slmath::vec4*>(spheres);
+    m_SpheresIn         = reinterpret_cast<const slmath::vec4*>(spheresIn);
+    m_Aabbs             = reinterpret_cast<const slmath::vec4*>(aabbs);
+    m_SpheresCount      = spheresCount;
+    m_SpheresInCount    = spheresInCount;
+    m_AabbsCount        = aabbsCount;
+}
+
+void ParticlesCPU::UpdateInputSpring(slmath::vec4 *positions, int particlesCount, const Spring *springs, int springsCount)
+{
+    assert(particlesCount == m_ParticlesCount);
+    assert(springsCount == m_SpringsCount);
+    UNUSED_PARAMETER(particlesCount);
+    UNUSED_PARAMETER(springsCount);
+
+    m_Positions = positions;
+    m_Springs   = springs;
+}
+
+void ParticlesCPU::UpdateInputAccelerator(  slmath::vec4 *positions, slmath::vec4 *previousPositions, int particlesCount,
+                                            const Accelerator *accelerators, int acceleratorsCount,
+                                            unsigned int acceleratorsGeneration)
+{
+    assert(particlesCount == m_ParticlesCount);
+    assert(acceleratorsCount > 0);
+    UNUSED_PARAMETER(particlesCount);
+    UNUSED_PARAMETER(acceleratorsGeneration);
+
+    m_Positions         = positions;
+    m_PreviousPositions = previousPositions;
+    m_Accelerators      = accelerators;
+    m_AcceleratorsCount = acceleratorsCount;
+}
+
+void ParticlesCPU::UpdateInputAnimation(slmath::vec4 *positions, slmath::vec4 *ends, int particlesCount)
+{
+    assert(particlesCount == m_ParticlesCount);
+    UNUSED_PARAMETER(particlesCount);
+
+    m_Positions     = positions;
+    m_EndsAnimation = ends;
+}
+
+void ParticlesCPU::InvalidateDeviceParticles()
+{
+    m_IsPositionsOnDevice = false;
+    m_IsPreviousPositionsOnDevice = false;
+}
+
+void ParticlesCPU::CopyParticles(slmath::vec4 *destination, const slmath::vec4 *source)
+{
+    ParallelForParticles(m_ParticlesCount, [=](int first, int last)
+    {
+        memcpy(destination + first, source + first, (last - first) * sizeof(slmath::vec4));
+    }, 4096);
+}
+
+void ParticlesCPU::UploadParticles(bool isUploadingPreviousPositions)
+{
+    if ( ! m_IsPositionsOnDevice)
+    {
+        CopyParticles(m_DevicePositions, m_Positions);
+        m_IsPositionsOnDevice = true;
+    }
+
+    if (isUploadingPreviousPositions && ! m_IsPreviousPositionsOnDevice)
+    {
+        CopyParticles(m_DevicePreviousPositions, m_PreviousPositions);
+        m_IsPreviousPositionsOnDevice = true;
+    }
+}
+
+int ParticlesCPU::InitializeCreateGrid()
+{
+    assert(m_Pipeline.m_IsCreatingGridOnGPU);
+    UploadParticles(false);
+    return 0;
+}
+
+int ParticlesCPU::InitializeKernelSPH()
+{
+    assert(m_Pipeline.m_SPHAndIntegrateOnGPU);
+    UploadParticles(true);
+    memcpy(m_InputDensities, m_Density, m_ParticlesCount * sizeof(float));
+    return 0;
+}
+
+int ParticlesCPU::InitializeKernelCollision()
+{
+    UploadParticles(true);
+    return 0;
+}
+
+int ParticlesCPU::InitializeKernelAccelerator()
+{
+    UploadParticles(true);
+    return 0;
+}
+
+int ParticlesCPU::InitializeKernelSpring()
+{
+    assert(m_Pipeline.m_SpringOnGPU);
+    UploadParticles(false);
+    return 0;
+}
+
+int ParticlesCPU::InitializeKernelAnimation()
+{
+    assert(m_Pipeline.m_IsUsingAnimation);
+    UploadParticles(false);
+    return 0;
+}
+
+// ComputeMinMax and CreateGrid kernels
+int ParticlesCPU::runKernelCreateGrid()
+{
+    assert(m_Pipeline.m_IsCreatingGridOnGPU);
+    PROFILE_BEGIN();
+
+    const slmath::vec4 *positions = m_DevicePositions;
+    const int particlesCount = m_ParticlesCount;
+    const int slicesCount = m_ThreadPool.GetThreadsCount();
+    slmath::vec4 *sliceMins = m_SliceMins;
+    slmath::vec4 *sliceMaxs = m_SliceMaxs;
+
+    // Bounds of each slice, then of all the slices
+    ParallelForParticles(slicesCount, [=](int first, int last)
+    {
+        for (int slice = first; slice < last; slice++)
+        {
+            const int begin = static_cast<int>(static_cast<long long>(particlesCount) * slice / slicesCount);
+            const int end = static_cast<int>(static_cast<long long>(particlesCount) * (slice + 1) / slicesCount);
+            slmath::vec4 positionMin = positions[begin < particlesCount ? begin : 0];
+            slmath::vec4 positionMax = positionMin;
+            for (int i = begin; i < end; i++)
+            {
+                positionMin = slmath::min(positionMin, positions[i]);
+                positionMax = slmath::max(positionMax, positions[i]);
+            }
+            sliceMins[slice] = positionMin;
+            sliceMaxs[slice] = positionMax;
+        }
+    }, 1);
+
+    slmath::vec4 positionMin = sliceMins[0];
+    slmath::vec4 positionMax = sliceMaxs[0];
+    for (int i = 1; i < slicesCount; i++)
+    {
+        positionMin = slmath::min(positionMin, sliceMins[i]);
+        positionMax = slmath::max(positionMax, sliceMaxs[i]);
+    }
+
+    // Cells on the border are included, a cell index gives back its coordinates
+    m_SecondAxisLength = FloorToInt(positionMax.y) - FloorToInt(positionMin.y) + 1;
+    m_ThirdAxisLength  = FloorToInt(positionMax.z) - FloorToInt(positionMin.z) + 1;
+
+    const int xAxisProduct = m_SecondAxisLength * m_ThirdAxisLength;
+    const int yAxisProduct = m_ThirdAxisLength;
+    const int minX = FloorToInt(positionMin.x);
+    const int minY = FloorToInt(positionMin.y);
+    const int minZ = FloorToInt(positionMin.z);
+    unsigned long long *cellKeys = m_CellKeys;
+    int *particleCells = m_ParticleCells;
+
+    ParallelForParticles(m_ParticlesCount, [=](int first, int last)
+    {
+        for (int i = first; i < last; i++)
+        {
+            const int cellIndex =   (FloorToInt(positions[i].x) - minX) * xAxisProduct +
+                                    (FloorToInt(positions[i].y) - minY) * yAxisProduct +
+                                    (FloorToInt(positions[i].z) - minZ);
+            assert(cellIndex >= 0);
+            cellKeys[i] = (static_cast<unsigned long long>(cellIndex) << 32) | static_cast<unsigned int>(i);
+            particleCells[i] = cellIndex;
+        }
+    }, s_GrainSize);
+
+    SortCellKeys();
+
+    PROFILE_END("Create Grid : native backend");
+    return 0;
+}
+
+// Each slice is sorted by a thread, then the slices are merged two by two.
+// Keys are unique so the order is the one of the stable GPU radix sort
+void ParticlesCPU::SortCellKeys()
+{
+    const int particlesCount = m_ParticlesCount;
+    const int slicesCount = m_ThreadPool.GetThreadsCount();
+    const int sliceSize = (particlesCount + slicesCount - 1) / slicesCount;
+    unsigned long long *source = m_CellKeys;
+    unsigned long long *destination = m_CellKeysBuffer;
+
+    ParallelForParticles(slicesCount, [=](int first, int last)
+    {
+        for (int slice = first; slice < last; slice++)
+        {
+            const int begin = std::min(slice * sliceSize, particlesCount);
+            const int end = std::min(begin + sliceSize, particlesCount);
+            std::sort(source + begin, source + end);
+        }
+    }, 1);
+
+    for (int width = sliceSize; width < particlesCount; width *= 2)
+    {
+        const int pairsCount = (particlesCount + 2 * width - 1) / (2 * width);
+        m_ThreadPool.ParallelFor(pairsCount, [=](int first, int last)
+        {
+            for (int pair = first; pair < last; pair++)
+            {
+                const int begin = pair * 2 * width;
+                const int middle = std::min(begin + width, particlesCount);
+                const int end = std::min(begin + 2 * width, particlesCount);
+                std::merge(source + begin, source + middle, source + middle, source + end, destination + begin);
+            }
+        }, 1);
+        std::swap(source, destination);
+    }
+
+    m_SortedCellKeys = source;
+}
+
+// ComputeSPH kernel, every particle of the 27 neighbor cells is visited in the same
+// order as on the device. New previous positions are the current ones, the arrays are
+// rotated instead of written in place so the neighbors are always read before the step.
+// Pinned threads step the particles of their own partition, whose pages are on their node,
+// the others follow the sorted keys so the neighbors of consecutive particles stay in cache
+int ParticlesCPU::runKernelSPH()
+{
+    assert(m_Pipeline.m_SPHAndIntegrateOnGPU);
+    assert(m_SphParameters != NULL);
+    PROFILE_BEGIN();
+
+    const SphParameters& parameters = *m_SphParameters;
+    const float PI = 3.141592659f;
+    const slmath::vec4 gravity = parameters.gravity;
+    const float mass = parameters.m_Mass;
+    const float h = parameters.m_H;
+    const float gazConstant = parameters.m_GazConstant;
+    const float muViscosity = parameters.m_MuViscosity;
+    const float sqrH = h * h;
+    const float deltaT = parameters.m_DeltaT;
+    const float previousDeltaT = parameters.m_PreviousDeltaT;
+
+    // Kernel coefficients of the specialized OpenCL program, computed once by step
+    const float inverseH = 1.0f / h;
+    const float inversePreviousDeltaT = 1.0f / previousDeltaT;
+    const float selfDensity = 4.0f * mass  / (PI*sqrH*sqrH*sqrH);
+    const float densityCoefficient = mass * ( 15.0f / (PI*h*sqrH) );
+    const float pressureCoefficient = mass * gazConstant * 0.5f * ( 45.0f / (PI*sqrH*sqrH) );
+    const float viscosityCoefficient = mass * ( 45.0f / (PI*sqrH*sqrH*sqrH) );
+
+    const int particlesCount = m_ParticlesCount;
+    const int secondAxis = m_SecondAxisLength;
+    const int thirdAxis = m_ThirdAxisLength;
+    const int sizePlane = secondAxis * thirdAxis;
+    const unsigned long long *sortedKeys = m_SortedCellKeys;
+    const int *particleCells = m_ParticleCells;
+    const bool isSteppingByParticle = m_ThreadPool.IsPinningThreads();
+    const slmath::vec4 *positions = m_DevicePositions;
+    const slmath::vec4 *previousPositions = m_DevicePreviousPositions;
+    const float *inputDensity = m_InputDensities;
+    slmath::vec4 *newPositions = m_OutputPositions;
+    float *outputDensity = m_OutputDensities;
+
+    ParallelForParticles(m_ParticlesCount, [=](int first, int last)
+    {
+        for (int i = first; i < last; i++)
+        {
+            const int index = isSteppingByParticle ? i : static_cast<int>(sortedKeys[i] & 0xFFFFFFFFull);
+            const int cellIndex = isSteppingByParticle ? particleCells[i] : static_cast<int>(sortedKeys[i] >> 32);
+            const int thirdCell = cellIndex % thirdAxis;
+            const int secondCell = (cellIndex / thirdAxis) % secondAxis;
+
+            slmath::vec4 pressure(0.0f);
+            slmath::vec4 viscosity(0.0f);
+
+            slmath::vec4 currentPosition = positions[index];
+            const slmath::vec4 previsouPosition = previousPositions[index];
+            const float previousDensity = inputDensity[index];
+            const float positionData = currentPosition.w;
+            currentPosition.w = 0.0f;
+            float density = selfDensity;
+            const slmath::vec4 veolocity = (currentPosition - previsouPosition) * inversePreviousDeltaT;
+
+            // The three cells of a row on the last axis are contiguous in the sorted keys
+            const int thirdFirst = std::max(thirdCell - 1, 0) - thirdCell;
+            const int thirdLast = std::min(thirdCell + 1, thirdAxis - 1) - thirdCell;
+            for (int firstOffset = -1; firstOffset <= 1; firstOffset++)
+            {
+                for (int secondOffset = -1; secondOffset <= 1; secondOffset++)
+                {
+                    if (secondCell + secondOffset < 0 || secondCell + secondOffset >= secondAxis)
+                        continue;
+
+                    const int rowCell = cellIndex + firstOffset * sizePlane + secondOffset * thirdAxis;
+                    const int firstCell = std::max(rowCell + thirdFirst, 0);
+                    const int lastCell = rowCell + thirdLast;
+                    if (lastCell < 0)
+                        continue;
+
+                    const unsigned long long *begin = std::lower_bound(sortedKeys, sortedKeys + particlesCount, static_cast<unsigned long long>(firstCell) << 32);
+                    const unsigned long long *end = std::lower_bound(begin, sortedKeys + particlesCount, static_cast<unsigned long long>(lastCell + 1) << 32);
+                    for (const unsigned long long *key = begin; key != end; key++)
+                    {
+                        const int indexNeighbor = static_cast<int>(*key & 0xFFFFFFFFull);
+                        const slmath::vec4 neighborPosition = positions[indexNeighbor];
+
+                        slmath::vec4 separation = currentPosition - neighborPosition;
+                        separation.w = 0.0f;
+                        const float sqrDistance = slmath::dot(separation, separation);
+
+                        if (sqrDistance < sqrH)
+                        {
+                            const slmath::vec4 neighborPrevisousPosition = previousPositions[indexNeighbor];
+                            const float previousDensityNeighbor = inputDensity[indexNeighbor];
+
+                            slmath::vec4 normal = separation;
+                            const float distance = std::sqrt(sqrDistance);
+                            if (distance > 1e-5f)
+                            {
+                                normal /= distance;
+                            }
+
+                            const float inverseDensityNeighbor = 1.0f / previousDensityNeighbor;
+                            const float ratio = 1.0f - distance * inverseH;
+                            const float cubicRatio = ratio * ratio * ratio;
+
+                            density += densityCoefficient * cubicRatio;
+                            pressure += (pressureCoefficient * (previousDensity + previousDensityNeighbor) * inverseDensityNeighbor * cubicRatio) * normal;
+
+                            const slmath::vec4 neighborVeolocity = (neighborPosition - neighborPrevisousPosition) * inversePreviousDeltaT;
+
+                            viscosity += (viscosityCoefficient * inverseDensityNeighbor * (h - distance)) * (neighborVeolocity - veolocity);
+                        }
+                    }
+                }
+            }
+
+            pressure *= mass / previousDensity;
+            viscosity *= muViscosity * mass / previousDensity;
+
+            const float damping = 0.99f;
+            // Time corrected Verlet, the step can change between two frames
+            const float dampingRatio = damping * deltaT / previousDeltaT;
+
+            const slmath::vec4 acceleration = pressure + viscosity + gravity;
+
+            newPositions[index] =   currentPosition +
+                                    (currentPosition - previsouPosition) * dampingRatio +
+                                    acceleration * deltaT * deltaT;
+            newPositions[index].w = positionData;
+            outputDensity[index] = density;
+        }
+    }, s_GrainSize);
+
+    // Previous positions are the current ones, the old previous ones are the next output
+    slmath::vec4 *oldPreviousPositions = m_DevicePreviousPositions;
+    m_DevicePreviousPositions = m_DevicePositions;
+    m_DevicePositions = m_OutputPositions;
+    m_OutputPositions = oldPreviousPositions;
+    std::swap(m_InputDensities, m_OutputDensities);
+
+    m_IsReadingPositions = true;
+    m_IsReadingPreviousPositions = true;
+
+    PROFILE_END("SPH Integrate : native backend");
+    return 0;
+}
+
+// ComputeCollision kernel
+int ParticlesCPU::runKernelCollision()
+{
+    PROFILE_BEGIN();
+
+    slmath::vec4 *positionsOutput = m_DevicePositions;
+    slmath::vec4 *previousPositions = m_DevicePreviousPositions;
+    const slmath::vec4 *spheres = m_Spheres;
+    const slmath::vec4 *spheresIn = m_SpheresIn;
+    const slmath::vec4 *aabbs = m_Aabbs;
+    const int spheresCount = m_SpheresCount;
+    const int spheresInCount = m_SpheresInCount;
+    const int aabbsCornersCount = 2 * m_AabbsCount;
+
+    ParallelForParticles(m_ParticlesCount, [=](int first, int last)
+    {
+        const float friction = 0.5f;
+        const float restitution = 1.0f;
+        const float onePlusRestitution = 1.0f + restitution;
+        const float bigMultiplier = 100000.0f;
+
+        for (int i = first; i < last; i++)
+        {
+            slmath::vec4 newPosition = positionsOutput[i];
+            const float positionData = positionsOutput[i].w;
+
+            previousPositions[i].w = 0.0f;
+
+            for (int j = 0; j < spheresCount; j++)
+            {
+                newPosition.w = 0.0f;
+
+                const float radius = spheres[j].w;
+                slmath::vec4 difference = newPosition - spheres[j];
+                difference.w = 0.0f;
+                const float sqrDistance = slmath::dot(difference, difference);
+
+                if (sqrDistance < radius * radius)
+                {
+                    // Compute new position
+                    const slmath::vec4 contactNormal = difference / std::sqrt(sqrDistance);
+                    newPosition = spheres[j] + contactNormal * radius;
+
+                    // Compute previous position to generate collision response considering restitution
+                    slmath::vec4 previousPosition = previousPositions[i];
+                    const slmath::vec4 oppositeVelocity = previousPosition - newPosition;
+
+                    const float projection = slmath::dot(contactNormal, oppositeVelocity);
+                    previousPosition -= (projection * onePlusRestitution) * contactNormal;
+
+                    previousPositions[i] = previousPosition - (previousPosition - newPosition) * (1.0f - friction);
+                }
+            }
+
+            for (int j = 0; j < spheresInCount; j++)
+            {
+                newPosition.w = 0.0f;
+
+                const float radius = spheresIn[j].w;
+                slmath::vec4 difference = newPosition - spheresIn[j];
+                difference.w = 0.0f;
+                const float sqrDistance = slmath::dot(difference, difference);
+
+                if (sqrDistance > radius * radius)
+                {
+                    // Compute new position
+                    const slmath::vec4 contactNormal = difference / std::sqrt(sqrDistance);
+                    newPosition = spheresIn[j] + contactNormal * radius;
+
+                    // Compute previous position to generate collision response considering restitution
+                    slmath::vec4 previousPosition = previousPositions[i];
+                    const slmath::vec4 oppositeVelocity = previousPosition - newPosition;
+
+                    const float projection = slmath::dot(contactNormal, oppositeVelocity);
+                    previousPosition -= (projection * onePlusRestitution) * contactNormal;
+
+                    previousPositions[i] = previousPosition - (previousPosition - newPosition) * (1.0f - friction);
+                }
+            }
+
+            // Same noise as the device, the work dimension is 1
+            const float noiseId = static_cast<float>(i) - 2.0f;
+            const slmath::vec4 noise(-0.000000000456f * noiseId, 0.0000000005486f * noiseId, 0.0000000004864f * noiseId, 0.0f);
+
+            for (int j = 0; j < aabbsCornersCount; j += 2)
+            {
+                // Compute contact normal, the device select gives 1 for the negative differences
+                slmath::vec4 contactNormal(0.0f);
+                for (int k = 0; k < 4; k++)
+                {
+                    const int lowDifference = static_cast<int>((newPosition[k] - aabbs[j][k]) * bigMultiplier);
+                    const int highDifference = static_cast<int>((aabbs[j + 1][k] - newPosition[k]) * bigMultiplier);
+                    contactNormal[k] = (lowDifference < 0 ? 1.0f : 0.0f) - (highDifference < 0 ? 1.0f : 0.0f);
+                }
+
+                // Compute new position
+                const slmath::vec4 newPosition2 = slmath::clamp(newPosition, aabbs[j], aabbs[j + 1]);
+
+                if (newPosition2.x != newPosition.x || newPosition2.y != newPosition.y || newPosition2.z != newPosition.z)
+                {
+                    newPosition = newPosition2 + noise;
+                    // Compute previous position to generate collision response considering restitution
+                    slmath::vec4 previousPosition = previousPositions[i];
+                    const slmath::vec4 oppositeVelocity = previousPosition - newPosition;
+
+                    const float projection = slmath::dot(contactNormal, oppositeVelocity);
+                    previousPosition -= (projection * onePlusRestitution) * contactNormal;
+
+                    previousPositions[i] = previousPosition - (previousPosition - newPosition) * friction;
+                }
+            }
+
+            positionsOutput[i]      = newPosition;
+            positionsOutput[i].w    = positionData;
+            previousPositions[i].w  = positionData;
+        }
+    }, s_GrainSize);
+
+    m_IsReadingPositions = true;
+    m_IsReadingPreviousPositions = true;
+
+    PROFILE_END("Collision : native backend");
+    return 0;
+}
+
+// ComputeSpring kernel, a cloth by work group. Springs of a batch don't share particles,
+// the batches of a cloth are solved in order
+int ParticlesCPU::runKernelSpring()
+{
+    assert(m_Pipeline.m_SpringOnGPU);
+    assert(m_ClothCount > 0);
+    PROFILE_BEGIN();
+
+    const int batchesCount = 12;
+    const int workItemsCount = static_cast<int>(slmath::roundToPowerOf2(m_SpringsCount / batchesCount));
+    const int workItemsByCloth = workItemsCount / m_ClothCount;
+    const int particlesByCloth = m_ParticlesCount / m_ClothCount;
+    const int springsCount = m_SpringsCount;
+    const Spring *springs = m_Springs;
+    slmath::vec4 *positions = m_DevicePositions;
+
+    m_ThreadPool.ParallelFor(m_ClothCount, [=](int first, int last)
+    {
+        const float kStiffness = 0.8f;
+
+        for (int cloth = first; cloth < last; cloth++)
+        {
+            slmath::vec4 *clothPositions = positions + cloth * particlesByCloth;
+            for (int batch = 0; batch < batchesCount; batch++)
+            {
+                for (int workItem = cloth * workItemsByCloth; workItem < (cloth + 1) * workItemsByCloth; workItem++)
+                {
+                    const int indexSpring = batchesCount * workItem + batch;
+                    if (indexSpring >= springsCount)
+                        break;
+
+                    const int index1 = springs[indexSpring].m_ParticleIndex1 % particlesByCloth;
+                    const int index2 = springs[indexSpring].m_ParticleIndex2 % particlesByCloth;
+                    float rest = springs[indexSpring].m_Distance;
+
+                    slmath::vec4 position1 = clothPositions[index1];
+                    slmath::vec4 position2 = clothPositions[index2];
+
+                    slmath::vec4 separation = position2 - position1;
+                    separation.w = 0.0f;
+                    float distance = slmath::length(separation);
+
+                    // Handle particles without constraints in this batch
+                    if (rest == 0.0f)
+                    {
+                        rest = 1.0f;
+                        distance = 1.0f;
+                    }
+
+                    slmath::vec4 movingVector(0.0f);
+                    if (distance > 1e-2f)
+                    {
+                        movingVector = (rest / distance - 1.0f) * 0.5f * separation;
+                    }
+
+                    if (position1.w == 0.0f || position2.w == 0.0f)
+                    {
+                        movingVector *= 2.0f;
+                    }
+                    if (position1.w != 0.0f)
+                    {
+                        position1 -= kStiffness * movingVector;
+                    }
+                    if (position2.w != 0.0f)
+                    {
+                        position2 += kStiffness * movingVector;
+                    }
+
+                    clothPositions[index1] = position1;
+                    clothPositions[index2] = position2;
+                }
+            }
+        }
+    }, 1);
+
+    m_IsReadingPositions = true;
+
+    PROFILE_END("Spring : native backend");
+    return 0;
+}
+
+// ComputeAccelerator kernel
+int ParticlesCPU::runKernelAccelerator()
+{
+    assert(m_Accelerators != NULL);
+    PROFILE_BEGIN();
+
+    slmath::vec4 *positions = m_DevicePositions;
+    slmath::vec4 *previousPositions = m_DevicePreviousPositions;
+    const Accelerator *accelerators = m_Accelerators;
+    const int acceleratorsCount = m_AcceleratorsCount;
+    const float deltaT = m_DeltaT;
+    const float previousDeltaT = m_PreviousDeltaT;
+
+    ParallelForParticles(m_ParticlesCount, [=](int first, int last)
+    {
+        const float sqrClosestActivity = 0.0f;
+        const float damping = 0.9999f;
+        const float dampingRatio = damping * deltaT / previousDeltaT;
+
+        for (int i = first; i < last; i++)
+        {
+            slmath::vec4 acceleration(0.0f);
+            const slmath::vec4 position = positions[i];
+            const float positionData = position.w;
+            bool hasKillSpeed = false;
+
+            for (int j = 0; j < acceleratorsCount && positionData != 0.0f; j++)
+            {
+                const Accelerator& accelerator = accelerators[j];
+                if (accelerator.m_Type == 1)
+                {
+                    // Simple homogenous force
+                    acceleration += accelerator.m_Direction;
+                    continue;
+                }
+                if (accelerator.m_Type == 5)
+                {
+                    hasKillSpeed = true;
+                    continue;
+                }
+
+                const float radius = accelerator.m_Radius;
+                slmath::vec4 separation = accelerator.m_Position - position;
+                separation.w = 0.0f;
+                const float sqrDistance = slmath::dot(separation, separation);
+                if (sqrDistance <= sqrClosestActivity || sqrDistance >= radius * radius)
+                    continue;
+
+                const float distance = std::sqrt(sqrDistance);
+                const slmath::vec4 normal = separation / distance;
+                // Zero along the direction, like normalize of OpenCL
+                slmath::vec3 perpendicular = slmath::cross(slmath::vec3(normal), slmath::vec3(accelerator.m_Direction));
+                const float sqrPerpendicularLength = slmath::dot(perpendicular, perpendicular);
+                if (sqrPerpendicularLength > 0.0f)
+                {
+                    perpendicular /= std::sqrt(sqrPerpendicularLength);
+                }
+
+                switch (accelerator.m_Type)
+                {
+                    case 0: // Force field + attraction
+                    {
+                        acceleration += normal * (radius / distance);
+                        acceleration += slmath::vec4(perpendicular, 0.0f) * (radius / distance) * 0.05f;
+                        break;
+                    }
+                    case 2: // Repulsion
+                    {
+                        acceleration -= normal * (radius / distance);
+                        break;
+                    }
+                    case 3: // Attraction
+                    {
+                        acceleration += normal * (radius / distance);
+                        break;
+                    }
+                    case 4: // Spiral
+                    {
+                        acceleration += slmath::vec4(perpendicular, 0.0f) * (radius / distance);
+                        break;
+                    }
+                }
+            }
+
+            acceleration.w = 0.0f;
+
+            slmath::vec4 newPosition =  position + (position - previousPositions[i]) * dampingRatio
+                                        + acceleration * deltaT * deltaT;
+            newPosition.w = positionData;
+
+            previousPositions[i] = position;
+            if ( ! hasKillSpeed)
+            {
+                positions[i] = newPosition;
+            }
+        }
+    }, s_GrainSize);
+
+    m_IsReadingPositions = true;
+    m_IsReadingPreviousPositions = true;
+
+    PROFILE_END("Accelerators : native backend");
+    return 0;
+}
+
+// ComputeAnimation kernel, the start positions are the ones at the time 0
+int ParticlesCPU::runKernelAnimation()
+{
+    assert(m_Pipeline.m_IsUsingAnimation);
+    assert(m_EndsAnimation != NULL);
+
+    if (m_AnimationTime == 0.0f)
+    {
+        CopyParticles(m_StartsAnimation, m_DevicePositions);
+    }
+
+    slmath::vec4 *positions = m_DevicePositions;
+    const slmath::vec4 *startPositions = m_StartsAnimation;
+    const slmath::vec4 *endPositions = m_EndsAnimation;
+    const float animationTime = m_AnimationTime;
+
+    ParallelForParticles(m_ParticlesCount, [=](int first, int last)
+    {
+        for (int i = first; i < last; i++)
+        {
+            const float positionData = endPositions[i].w;
+            positions[i] = startPositions[i] * (1.0f - animationTime) + endPositions[i] * animationTime;
+            positions[i].w = positionData;
+        }
+    }, s_GrainSize);
+
+    m_IsReadingPositions = true;
+    return 0;
+}
+
+int ParticlesCPU::Synchronize(bool isReadingBack /*= true*/)
+{
+    if ( ! isReadingBack)
+        return 0;
+
+    if (m_IsReadingPreviousPositions)
+    {
+        CopyParticles(m_PreviousPositions, m_DevicePreviousPositions);
+    }
+    if (m_IsReadingPositions)
+    {
+        CopyParticles(m_Positions, m_DevicePositions);
+    }
+    if (m_IsReadingDensities)
+    {
+        memcpy(m_Density, m_InputDensities, m_ParticlesCount * sizeof(float));
+    }
+    m_IsReadingPositions = false;
+    m_IsReadingPreviousPositions = false;
+    m_IsReadingDensities = false;
+    return 0;
+}
+
+bool ParticlesCPU::HasPendingReadBack() const
+{
+    return m_IsReadingPositions || m_IsReadingPreviousPositions || m_IsReadingDensities;
+}
+
+// The output of the last SPH step is already the input of the next one
+void ParticlesCPU::ReadBackDensities()
+{
+    m_IsReadingDensities = m_Pipeline.m_SPHAndIntegrateOnGPU && m_Density != NULL;
+}
+
+const MemoryArena& ParticlesCPU::GetMemoryArena() const
+{
+    return m_MemoryArena;
+}
+
+size_t ParticlesCPU::GetMemorySize(int particlesCount, int threadsCount)
+{
+    return  4 * MemoryArena::GetArraySize<slmath::vec4>(particlesCount) +
+            2 * MemoryArena::GetArraySize<float>(particlesCount) +
+            2 * MemoryArena::GetArraySize<unsigned long long>(particlesCount) +
+            MemoryArena::GetArraySize<int>(particlesCount) +
+            2 * MemoryArena::GetArraySize<slmath::vec4>(threadsCount);
+}
+
+int ParticlesCPU::cleanup()
+{
+    m_ThreadPool.Release();
+    m_IsThreadPoolStarted = false;
+    ReleaseArrays();
+    return 0;
+}
+
+void ParticlesCPU::ReleaseArrays()
+{
+    MemoryArena *memoryArena = &m_MemoryArena;
+    MemoryArena::DeleteArray(memoryArena, m_DevicePositions);
+    MemoryArena::DeleteArray(memoryArena, m_DevicePreviousPositions);
+    MemoryArena::DeleteArray(memoryArena, m_OutputPositions);
+    MemoryArena::DeleteArray(memoryArena, m_StartsAnimation);
+    MemoryArena::DeleteArray(memoryArena, m_InputDensities);
+    MemoryArena::DeleteArray(memoryArena, m_OutputDensities);
+    MemoryArena::DeleteArray(memoryArena, m_CellKeys);
+    MemoryArena::DeleteArray(memoryArena, m_CellKeysBuffer);
+    MemoryArena::DeleteArray(memoryArena, m_ParticleCells);
+    MemoryArena::DeleteArray(memoryArena, m_SliceMins);
+    MemoryArena::DeleteArray(memoryArena, m_SliceMaxs);
+    m_MemoryArena.Release();
+
+    m_DevicePositions           = NULL;
+    m_DevicePreviousPositions   = NULL;
+    m_OutputPositions           = NULL;
+    m_StartsAnimation           = NULL;
+    m_InputDensities            = NULL;
+    m_OutputDensities           = NULL;
+    m_CellKeys                  = NULL;
+    m_CellKeysBuffer            = NULL;
+    m_ParticleCells             = NULL;
+    m_SortedCellKeys            = NULL;
+    m_SliceMins                 = NULL;
+    m_SliceMaxs                 = NULL;
+
+    m_IsReadingPositions = false;
+    m_IsReadingPreviousPositions = false;
+}
@@ -0,0 +1,144 @@
+#ifndef PARTICLES_CPU
+#define PARTICLES_CPU
+
+#include <slmath/slmath.h>
+#include "ParticlesBackend.h"
+#include "Utility/ThreadPool.h"
+#include "Utility/MemoryArena.h"
+
+// Native backend running the OpenCL kernels with C++ threads, for the machines without
+// OpenCL runtime. Like the device buffers its particles stay in its own arrays between
+// steps, the host arrays are only read when invalidated and written by Synchronize
+class ParticlesCPU : public ParticlesBackend
+{
+public:
+    ParticlesCPU();
+    ~ParticlesCPU();
+
+    // 0 uses all the hardware threads, must be called before Initialize
+    void SetThreadsCount(int threadsCount);
+    int GetThreadsCount() const;
+    // Threads pinned over the NUMA nodes. Each thread then always runs the same range of
+    // the particle loops and touches it first, so the backend arrays of a range are on the
+    // node of its thread. Must be called before Initialize
+    void SetIsPinningThreads(bool isPinningThreads);
+    // With pinning, starts the threads before Initialize so the host arrays can be first
+    // touched by the same partitions. NULL without pinning
+    ThreadPool *StartPinnedThreads();
+    // Threads of the solver for the loops of the simulation, NULL until they are started
+    ThreadPool *GetThreadPool();
+
+    void SetClothCount(int clothCount);
+    void SetAnimationTime(float animationTime);
+    void SetDeltaT(float deltaT);
+    bool IsUsingInteroperability() const;
+
+    int Initialize( int particlesCount, int springsCount, int acceleratorsCount,
+                    const PipelineDescription& pipeline, ID3D11Buffer *d3D11buffer = NULL);
+
+    int InitializeCreateGrid();
+    int InitializeKernelSPH();
+    int InitializeKernelCollision();
+    int InitializeKernelAccelerator();
+    int InitializeKernelSpring();
+    int InitializeKernelAnimation();
+
+    int runKernelCreateGrid();
+    int runKernelSPH();
+    int runKernelCollision();
+    int runKernelSpring();
+    int runKernelAccelerator();
+    int runKernelAnimation();
+
+    void UpdateInputCreateGrid(slmath::vec4 *positions, slmath::vec4 *outMin, int *neighborInfo, int *neighborInfo2, int *gridInfo);
+    void UpdateInputSPH(slmath::vec4 *positions, slmath::vec4 *previousPositions, float * density, int *neighborInfo, int *gridInfo,
+                        const SphParameters& sphParameters, unsigned int parametersGeneration);
+    void UpdateInputCollision(  slmath::vec4 *positions, slmath::vec4 *previousPositions, int particlesCount,
+                                const Sphere *spheres, int spheresCount,
+                                const Sphere *spheresIn, int spheresInCount,
+                                const Aabb *aabbs, int aabbsCount,
+                                unsigned int shapesGeneration);
+    void UpdateInputSpring(slmath::vec4 *positions, int particlesCount, const Spring *springs, int springsCount);
+    void UpdateInputAccelerator(slmath::vec4 *positions, slmath::vec4 *previousPositions, int particlesCount,
+                                const Accelerator *accelerators, int acceleratorsCount,
+                                unsigned int acceleratorsGeneration);
+    void UpdateInputAnimation(slmath::vec4 *positions, slmath::vec4 *ends, int particlesCount);
+
+    void InvalidateDeviceParticles();
+    int Synchronize(bool isReadingBack = true);
+    bool HasPendingReadBack() const;
+    void ReadBackDensities();
+
+    int cleanup();
+
+    // The backend arrays and the bounds of the slices, reserved by Initialize
+    const MemoryArena& GetMemoryArena() const;
+    static size_t GetMemorySize(int particlesCount, int threadsCount);
+
+private:
+    void UploadParticles(bool isUploadingPreviousPositions);
+    void CopyParticles(slmath::vec4 *destination, const slmath::vec4 *source);
+    void SortCellKeys();
+    void ReleaseArrays();
+    // Partitioned by thread when the threads are pinned, by chunks of grainSize otherwise
+    template <class Function>
+    void ParallelForParticles(int count, const Function &function, int grainSize);
+
+    ThreadPool          m_ThreadPool;
+    int                 m_ThreadsCount;
+    bool                m_IsThreadPoolStarted;
+    MemoryArena         m_MemoryArena;
+
+    int                 m_ParticlesCount;
+    int                 m_SpringsCount;
+    int                 m_AcceleratorsCount;
+    int                 m_ClothCount;
+    float               m_AnimationTime;
+    float               m_DeltaT;
+    float               m_PreviousDeltaT;
+    PipelineDescription m_Pipeline;
+
+    // Host arrays
+    slmath::vec4        *m_Positions;
+    slmath::vec4        *m_PreviousPositions;
+    const slmath::vec4  *m_EndsAnimation;
+    float               *m_Density;
+    const slmath::vec4  *m_Spheres;
+    const slmath::vec4  *m_SpheresIn;
+    const slmath::vec4  *m_Aabbs;
+    int                 m_SpheresCount;
+    int                 m_SpheresInCount;
+    int                 m_AabbsCount;
+    const Spring        *m_Springs;
+    const Accelerator   *m_Accelerators;
+    const SphParameters *m_SphParameters;
+
+    // Backend arrays, the "device" particles
+    slmath::vec4        *m_DevicePositions;
+    slmath::vec4        *m_DevicePreviousPositions;
+    slmath::vec4        *m_OutputPositions;
+    slmath::vec4        *m_StartsAnimation;
+    float               *m_InputDensities;
+    float               *m_OutputDensities;
+
+    // Cell index in the high bits and particle index in the low bits, sorted by CreateGrid
+    unsigned long long  *m_CellKeys;
+    unsigned long long  *m_CellKeysBuffer;
+    unsigned long long  *m_SortedCellKeys;
+    // Cell of each particle, by particle index
+    int                 *m_ParticleCells;
+    int                 m_SecondAxisLength;
+    int                 m_ThirdAxisLength;
+    // Bounds of each slice of particles
+    slmath::vec4        *m_SliceMins;
+    slmath::vec4        *m_SliceMaxs;
+
+    bool                m_IsPositionsOnDevice;
+    bool                m_IsPreviousPositionsOnDevice;
+    // Set by the kernels writing the particles, they are copied once by Synchronize
+    bool                m_IsReadingPositions;
+    bool                m_IsReadingPreviousPositions;
+    bool                m_IsReadingDensities;
+};
+
+#endif // PARTICLES_CPU
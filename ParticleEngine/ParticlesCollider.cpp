@@ -1,27 +1,35 @@
 
 #include "ParticlesCollider.h"
-#include "Utility/Timer.h"
+#include "Utility/Profiler.h"
 
 
+ParticlesCollider::ParticlesCollider() : m_Generation(1)
+{
+}
+
 void ParticlesCollider::AddInsideAabb(const Aabb& aabb)
 {
 	m_InsideAabb.clear();
     m_InsideAabb.push_back(aabb);
+    m_Generation++;
 }
 
 void ParticlesCollider::AddOutsideAabb(const Aabb& aabb)
 {
     m_OutsideAabb.push_back(aabb);
+    m_Generation++;
 }
 
 void ParticlesCollider::AddInsideSphere(const Sphere& sphere)
 {
     m_InsideSphere.push_back(sphere);
+    m_Generation++;
 }
 
 void ParticlesCollider::AddOutsideSphere(const Sphere& sphere)
 {
     m_OutsideSphere.push_back(sphere);
+    m_Generation++;
 }
 
 
@@ -34,6 +42,15 @@ Aabb *ParticlesCollider::GetInsideAabbs()
     return &m_InsideAabb[0];
 }
 
+Aabb *ParticlesCollider::GetOutsideAabbs()
+{
+    if (m_OutsideAabb.size() == 0)
+    {
+        return &m_NullAabb;
+    }
+    return &m_OutsideAabb[0];
+}
+
 Sphere *ParticlesCollider::GetInsideSpheres()
 {
     if (m_InsideSphere.size() == 0)
@@ -53,11 +70,36 @@ Sphere *ParticlesCollider::GetOutsideSpheres()
     return &m_OutsideSphere[0];
 }
 
+const Aabb *ParticlesCollider::GetInsideAabbs() const
+{
+    return m_InsideAabb.empty() ? &m_NullAabb : &m_InsideAabb[0];
+}
+
+const Aabb *ParticlesCollider::GetOutsideAabbs() const
+{
+    return m_OutsideAabb.empty() ? &m_NullAabb : &m_OutsideAabb[0];
+}
+
+const Sphere *ParticlesCollider::GetInsideSpheres() const
+{
+    return m_InsideSphere.empty() ? &m_NullSphere : &m_InsideSphere[0];
+}
+
+const Sphere *ParticlesCollider::GetOutsideSpheres() const
+{
+    return m_OutsideSphere.empty() ? &m_NullSphere : &m_OutsideSphere[0];
+}
+
 int ParticlesCollider::GetInsideAabbsCount() const
 {
     return m_InsideAabb.size();
 }
 
+int ParticlesCollider::GetOutsideAabbsCount() const
+{
+    return m_OutsideAabb.size();
+}
+
 int ParticlesCollider::GetInsideSpheresCount() const
 {
     return m_InsideSphere.size();
@@ -70,7 +112,7 @@ int ParticlesCollider::GetOutsideSpheresCount() const
 
 void ParticlesCollider::SatisfyCollisions(slmath::vec4 *particles, int particlesCount)
 {
-    Timer::GetInstance()->StartTimerProfile();
+    PROFILE_BEGIN();
     for (int i = 0; i < particlesCount; i++)
     {
         slmath::vec4 &position = particles[i];
@@ -79,7 +121,21 @@ void ParticlesCollider::SatisfyCollisions(slmath::vec4 *particles, int particles
         SatisfyInsideSphere(position);
         SatisfyOutsideSphere(position);
     }
-    Timer::GetInstance()->StopTimerProfile("Shape Collision");
+    PROFILE_END("Shape Collision");
+}
+
+void ParticlesCollider::SatisfyCollisions(slmath::vec4 *particles, const int *activeIndices, int activeCount)
+{
+    PROFILE_BEGIN();
+    for (int i = 0; i < activeCount; i++)
+    {
+        slmath::vec4 &position = particles[activeIndices[i]];
+        SatisfyInsideAabb(position);
+        SatisfyOutsideAabb(position);
+        SatisfyInsideSphere(position);
+        SatisfyOutsideSphere(position);
+    }
+    PROFILE_END("Shape Collision");
 }
 
 
@@ -137,4 +193,15 @@ void ParticlesCollider::Release()
     m_OutsideAabb.clear();
     m_InsideSphere.clear();
     m_OutsideSphere.clear();
+    m_Generation++;
+}
+
+unsigned int ParticlesCollider::GetGeneration() const
+{
+    return m_Generation;
+}
+
+void ParticlesCollider::IncrementGeneration()
+{
+    m_Generation++;
 }
\ No newline at end of file
@@ -23,6 +23,7 @@ struct SLMATH_ALIGN16 Sphere
 class ParticlesCollider
 {
 public:
+    ParticlesCollider();
 
     void AddInsideAabb(const Aabb& aabb);
     void AddOutsideAabb(const Aabb& aabb);
@@ -30,17 +31,30 @@ public:
     void AddOutsideSphere(const Sphere& sphere);
 
     void SatisfyCollisions(slmath::vec4 *particles, int particlesCount);
+    // Only the particles of the active list are moved
+    void SatisfyCollisions(slmath::vec4 *particles, const int *activeIndices, int activeCount);
 
     void Release();
 
+    // Shapes can be moved through the mutable pointers, IncrementGeneration must follow
     Aabb    *GetInsideAabbs();
+    Aabb    *GetOutsideAabbs();
     Sphere  *GetInsideSpheres();
     Sphere  *GetOutsideSpheres();
+    const Aabb    *GetInsideAabbs() const;
+    const Aabb    *GetOutsideAabbs() const;
+    const Sphere  *GetInsideSpheres() const;
+    const Sphere  *GetOutsideSpheres() const;
 
     int GetInsideAabbsCount() const;
+    int GetOutsideAabbsCount() const;
     int GetInsideSpheresCount() const;
     int GetOutsideSpheresCount() const;
 
+    // Incremented by the Add functions, Release and IncrementGeneration, never by a getter
+    unsigned int GetGeneration() const;
+    void IncrementGeneration();
+
 
 private:
 
@@ -58,6 +72,8 @@ private:
 
     Sphere  m_NullSphere;
     Aabb    m_NullAabb;
+
+    unsigned int m_Generation;
 };
 
 #endif // PARTICLES_COLLIDER
\ No newline at end of file
@@ -0,0 +1,272 @@
+#include "ParticlesEmitter.h"
+#include "Utility/Profiler.h"
+#include "Utility/MemoryArena.h"
+
+#include <algorithm>
+
+
+ParticlesEmitter::ParticlesEmitter() :  m_LifeTimes(NULL),
+                                        m_IsDead(NULL),
+                                        m_DeadIndices(NULL),
+                                        m_MoveSources(NULL),
+                                        m_MoveDestinations(NULL),
+                                        m_MemoryArena(NULL),
+                                        m_DeadCount(0),
+                                        m_MovesCount(0),
+                                        m_ParticlesCapacity(0),
+                                        m_IsActive(false),
+                                        m_RandomSeed(1)
+{
+}
+
+ParticlesEmitter::~ParticlesEmitter()
+{
+    ReleaseMemory();
+}
+
+void ParticlesEmitter::ReleaseMemory()
+{
+    MemoryArena::DeleteArray(m_MemoryArena, m_LifeTimes);
+    MemoryArena::DeleteArray(m_MemoryArena, m_IsDead);
+    MemoryArena::DeleteArray(m_MemoryArena, m_DeadIndices);
+    MemoryArena::DeleteArray(m_MemoryArena, m_MoveSources);
+    MemoryArena::DeleteArray(m_MemoryArena, m_MoveDestinations);
+
+    m_LifeTimes         = NULL;
+    m_IsDead            = NULL;
+    m_DeadIndices       = NULL;
+    m_MoveSources       = NULL;
+    m_MoveDestinations  = NULL;
+    m_ParticlesCapacity = 0;
+}
+
+void ParticlesEmitter::AddEmitter(const Emitter& emitter)
+{
+    assert(emitter.m_Rate >= 0.0f && emitter.m_Radius >= 0.0f);
+    m_Emitters.push_back(emitter);
+    m_EmittedFractions.push_back(0.0f);
+    m_IsActive = true;
+}
+
+void ParticlesEmitter::UpdateEmitter(int index, const Emitter& emitter)
+{
+    assert(static_cast<unsigned int>(index) < m_Emitters.size());
+    m_Emitters[index] = emitter;
+}
+
+void ParticlesEmitter::ClearEmitters()
+{
+    m_Emitters.clear();
+    m_EmittedFractions.clear();
+}
+
+int ParticlesEmitter::GetEmittersCount() const
+{
+    return m_Emitters.size();
+}
+
+void ParticlesEmitter::AddKiller(const Aabb& aabb)
+{
+    m_Killers.push_back(aabb);
+    m_IsActive = true;
+}
+
+void ParticlesEmitter::ClearKillers()
+{
+    m_Killers.clear();
+}
+
+bool ParticlesEmitter::IsActive() const
+{
+    return m_IsActive;
+}
+
+void ParticlesEmitter::Reserve(int particlesCapacity)
+{
+    assert(particlesCapacity > 0);
+    if (particlesCapacity <= m_ParticlesCapacity)
+        return;
+
+    float *lifeTimes = MemoryArena::NewArray<float>(m_MemoryArena, particlesCapacity);
+    for (int i = 0; i < particlesCapacity; i++)
+    {
+        lifeTimes[i] = i < m_ParticlesCapacity ? m_LifeTimes[i] : -1.0f;
+    }
+
+    MemoryArena::DeleteArray(m_MemoryArena, m_LifeTimes);
+    MemoryArena::DeleteArray(m_MemoryArena, m_IsDead);
+    MemoryArena::DeleteArray(m_MemoryArena, m_DeadIndices);
+    MemoryArena::DeleteArray(m_MemoryArena, m_MoveSources);
+    MemoryArena::DeleteArray(m_MemoryArena, m_MoveDestinations);
+
+    m_ParticlesCapacity = particlesCapacity;
+    m_LifeTimes         = lifeTimes;
+    m_IsDead            = MemoryArena::NewArray<bool>(m_MemoryArena, m_ParticlesCapacity);
+    m_DeadIndices       = MemoryArena::NewArray<int>(m_MemoryArena, m_ParticlesCapacity);
+    m_MoveSources       = MemoryArena::NewArray<int>(m_MemoryArena, m_ParticlesCapacity);
+    m_MoveDestinations  = MemoryArena::NewArray<int>(m_MemoryArena, m_ParticlesCapacity);
+}
+
+void ParticlesEmitter::SetMemoryArena(MemoryArena *memoryArena)
+{
+    assert(m_ParticlesCapacity == 0 && "ParticlesEmitter::SetMemoryArena failed.");
+    m_MemoryArena = memoryArena;
+}
+
+size_t ParticlesEmitter::GetMemorySize(int particlesCapacity)
+{
+    return  MemoryArena::GetArraySize<float>(particlesCapacity) +
+            MemoryArena::GetArraySize<bool>(particlesCapacity) +
+            3 * MemoryArena::GetArraySize<int>(particlesCapacity);
+}
+
+void ParticlesEmitter::SetLifeTimes(int firstIndex, int particlesCount, float lifeTime)
+{
+    assert(firstIndex >= 0 && firstIndex + particlesCount <= m_ParticlesCapacity);
+    for (int i = firstIndex; i < firstIndex + particlesCount; i++)
+    {
+        m_LifeTimes[i] = lifeTime;
+    }
+}
+
+int ParticlesEmitter::CollectDeadParticles(float deltaT, const slmath::vec4 *positions, int particlesCount)
+{
+    assert(particlesCount <= m_ParticlesCapacity);
+    PROFILE_BEGIN();
+
+    const int killersCount = m_Killers.size();
+    m_DeadCount = 0;
+    for (int i = 0; i < particlesCount; i++)
+    {
+        bool isDead = false;
+
+        // Negative life time never dies
+        if (m_LifeTimes[i] >= 0.0f)
+        {
+            m_LifeTimes[i] -= deltaT;
+            isDead = m_LifeTimes[i] <= 0.0f;
+        }
+
+        for (int j = 0; j < killersCount && ! isDead; j++)
+        {
+            const Aabb& killer = m_Killers[j];
+            isDead =    positions[i].x >= killer.m_Min.x && positions[i].x <= killer.m_Max.x &&
+                        positions[i].y >= killer.m_Min.y && positions[i].y <= killer.m_Max.y &&
+                        positions[i].z >= killer.m_Min.z && positions[i].z <= killer.m_Max.z;
+        }
+
+        m_IsDead[i] = isDead;
+        if (isDead)
+        {
+            m_DeadIndices[m_DeadCount++] = i;
+        }
+    }
+
+    // Dead slots before the new count are filled with the alive particles after it,
+    // both lists have the same size
+    const int aliveCount = particlesCount - m_DeadCount;
+    int source = particlesCount - 1;
+    m_MovesCount = 0;
+    for (int i = 0; i < m_DeadCount && m_DeadIndices[i] < aliveCount; i++)
+    {
+        while (m_IsDead[source])
+        {
+            source--;
+        }
+        assert(source >= aliveCount);
+
+        m_MoveSources[m_MovesCount] = source;
+        m_MoveDestinations[m_MovesCount] = m_DeadIndices[i];
+        m_LifeTimes[m_DeadIndices[i]] = m_LifeTimes[source];
+        m_MovesCount++;
+        source--;
+    }
+
+    PROFILE_END("Collect dead particles");
+    return aliveCount;
+}
+
+const int *ParticlesEmitter::GetDeadIndices() const
+{
+    return m_DeadIndices;
+}
+
+int ParticlesEmitter::GetDeadCount() const
+{
+    return m_DeadCount;
+}
+
+const int *ParticlesEmitter::GetMoveSources() const
+{
+    return m_MoveSources;
+}
+
+const int *ParticlesEmitter::GetMoveDestinations() const
+{
+    return m_MoveDestinations;
+}
+
+int ParticlesEmitter::GetMovesCount() const
+{
+    return m_MovesCount;
+}
+
+int ParticlesEmitter::Emit( float deltaT,
+                            slmath::vec4 *positions,
+                            slmath::vec4 *previousPositions,
+                            unsigned char *phases,
+                            int particlesCount,
+                            int particlesCapacity)
+{
+    assert(particlesCapacity <= m_ParticlesCapacity);
+    PROFILE_BEGIN();
+
+    const int emittersCount = m_Emitters.size();
+    int emittedCount = 0;
+    for (int i = 0; i < emittersCount; i++)
+    {
+        const Emitter& emitter = m_Emitters[i];
+
+        // The fraction of particle left is kept for the next step
+        m_EmittedFractions[i] += emitter.m_Rate * deltaT;
+        int toEmitCount = static_cast<int>(m_EmittedFractions[i]);
+        m_EmittedFractions[i] -= static_cast<float>(toEmitCount);
+
+        // Particles which don't fit are lost
+        toEmitCount = std::min(toEmitCount, particlesCapacity - particlesCount - emittedCount);
+
+        const slmath::vec4 displacement = emitter.m_Velocity * deltaT;
+        for (int j = 0; j < toEmitCount; j++)
+        {
+            // Uniform in the sphere
+            slmath::vec4 offset;
+            do
+            {
+                offset = slmath::vec4(Random(), Random(), Random(), 0.0f);
+            }
+            while (slmath::dot(offset, offset) > 1.0f);
+
+            const int index = particlesCount + emittedCount;
+            positions[index] = emitter.m_Position + offset * emitter.m_Radius;
+            positions[index].w = emitter.m_Position.w;
+            previousPositions[index] = positions[index] - displacement;
+            previousPositions[index].w = emitter.m_Position.w;
+            m_LifeTimes[index] = emitter.m_LifeTime;
+            if (phases != NULL)
+            {
+                phases[index] = static_cast<unsigned char>(emitter.m_Phase);
+            }
+            emittedCount++;
+        }
+    }
+
+    PROFILE_END("Emit particles");
+    return emittedCount;
+}
+
+// Returns a value in [-1; 1]
+float ParticlesEmitter::Random()
+{
+    m_RandomSeed = m_RandomSeed * 1664525u + 1013904223u;
+    return static_cast<float>(m_RandomSeed >> 8) * (2.0f / 16777216.0f) - 1.0f;
+}
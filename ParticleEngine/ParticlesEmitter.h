@@ -0,0 +1,94 @@
+#ifndef PARTICLES_EMITTER
+#define PARTICLES_EMITTER
+
+#include <vector>
+#include <slmath/slmath.h>
+#include "Utility/AlignmentAllocator.h"
+#include "ParticlesCollider.h"
+
+class MemoryArena;
+
+// Particles are spawned in a sphere with an initial velocity.
+// The w of the position is copied in the particles, it is used to store the color
+struct Emitter
+{
+    slmath::vec4    m_Position;
+    slmath::vec4    m_Velocity;
+    float           m_Radius;
+    // Particles by second
+    float           m_Rate;
+    // In seconds, negative for particles which never die
+    float           m_LifeTime;
+    // SPH phase of the particles
+    int             m_Phase;
+};
+
+// Spawns particles after the last alive one and removes the dead ones.
+// Capacity is reserved up front, nothing is allocated while simulating.
+// Dead slots are filled with the last alive particles. The moves are independent but
+// the stages apply them serially, emitters only run with the single threaded CPU solver
+class ParticlesEmitter
+{
+public:
+    ParticlesEmitter();
+    ~ParticlesEmitter();
+
+    void AddEmitter(const Emitter& emitter);
+    void UpdateEmitter(int index, const Emitter& emitter);
+    void ClearEmitters();
+    int GetEmittersCount() const;
+
+    // Particles inside a killer die
+    void AddKiller(const Aabb& aabb);
+    void ClearKillers();
+
+    // True once an emitter or a killer has been added
+    bool IsActive() const;
+
+    void Reserve(int particlesCapacity);
+    void SetMemoryArena(MemoryArena *memoryArena);
+    static size_t GetMemorySize(int particlesCapacity);
+    void ReleaseMemory();
+    void SetLifeTimes(int firstIndex, int particlesCount, float lifeTime);
+
+    // Ages the particles and finds the dead ones, returns the alive particles count.
+    // Moves to fill the dead slots are available after this call
+    int CollectDeadParticles(float deltaT, const slmath::vec4 *positions, int particlesCount);
+    const int *GetDeadIndices() const;
+    int GetDeadCount() const;
+    const int *GetMoveSources() const;
+    const int *GetMoveDestinations() const;
+    int GetMovesCount() const;
+
+    // Writes the new particles after the last one, returns the emitted particles count.
+    // phases can be NULL
+    int Emit(   float deltaT,
+                slmath::vec4 *positions,
+                slmath::vec4 *previousPositions,
+                unsigned char *phases,
+                int particlesCount,
+                int particlesCapacity);
+
+private:
+    float Random();
+
+    std::vector<Emitter, AlignmentAllocator<Emitter, 16> >  m_Emitters;
+    std::vector<float>                                      m_EmittedFractions;
+    std::vector<Aabb>                                       m_Killers;
+
+    float   *m_LifeTimes;
+    bool    *m_IsDead;
+    int     *m_DeadIndices;
+    int     *m_MoveSources;
+    int     *m_MoveDestinations;
+    MemoryArena *m_MemoryArena;
+
+    int     m_DeadCount;
+    int     m_MovesCount;
+    int     m_ParticlesCapacity;
+    bool    m_IsActive;
+
+    unsigned int m_RandomSeed;
+};
+
+#endif // PARTICLES_EMITTER
@@ -0,0 +1,265 @@
+#include "ParticlesSleeping.h"
+#include "Grid3D.h"
+#include "Utility/Profiler.h"
+#include "Utility/MemoryArena.h"
+
+
+ParticlesSleeping::ParticlesSleeping() :    m_Velocities(NULL),
+                                            m_CalmStepsCount(NULL),
+                                            m_IsSleeping(NULL),
+                                            m_ActiveIndices(NULL),
+                                            m_MemoryArena(NULL),
+                                            m_SqrSpeedThreshold(0.1f * 0.1f),
+                                            m_SqrAccelerationThreshold(1.0f),
+                                            m_StepsBeforeSleeping(30),
+                                            m_ActiveCount(0),
+                                            m_SleepingCount(0),
+                                            m_ParticlesCount(0),
+                                            m_ParticlesCapacity(0)
+{
+}
+
+ParticlesSleeping::~ParticlesSleeping()
+{
+    ReleaseMemory();
+}
+
+void ParticlesSleeping::ReleaseMemory()
+{
+    MemoryArena::DeleteArray(m_MemoryArena, m_Velocities);
+    MemoryArena::DeleteArray(m_MemoryArena, m_CalmStepsCount);
+    MemoryArena::DeleteArray(m_MemoryArena, m_IsSleeping);
+    MemoryArena::DeleteArray(m_MemoryArena, m_ActiveIndices);
+
+    m_Velocities        = NULL;
+    m_CalmStepsCount    = NULL;
+    m_IsSleeping        = NULL;
+    m_ActiveIndices     = NULL;
+    m_ActiveCount       = 0;
+    m_ParticlesCount    = 0;
+    m_ParticlesCapacity = 0;
+}
+
+void ParticlesSleeping::SetThresholds(float speed, float acceleration)
+{
+    assert(speed >= 0.0f && acceleration >= 0.0f);
+    m_SqrSpeedThreshold = speed * speed;
+    m_SqrAccelerationThreshold = acceleration * acceleration;
+}
+
+void ParticlesSleeping::SetStepsBeforeSleeping(int stepsCount)
+{
+    assert(stepsCount > 0);
+    m_StepsBeforeSleeping = stepsCount;
+}
+
+void ParticlesSleeping::Initialize(int particlesCount)
+{
+    assert(particlesCount > 0);
+    if (m_ParticlesCapacity < particlesCount)
+    {
+        Reserve(particlesCount);
+    }
+    m_ParticlesCount = particlesCount;
+    for (int i = 0; i < m_ParticlesCount; i++)
+    {
+        m_Velocities[i] = slmath::vec4(0.0f);
+        m_CalmStepsCount[i] = 0;
+        m_IsSleeping[i] = false;
+        m_ActiveIndices[i] = i;
+    }
+    m_ActiveCount = m_ParticlesCount;
+    m_SleepingCount = 0;
+}
+
+int ParticlesSleeping::GetParticlesCount() const
+{
+    return m_ParticlesCount;
+}
+
+void ParticlesSleeping::AddParticles(int particlesCount)
+{
+    assert(m_ParticlesCount + particlesCount <= m_ParticlesCapacity);
+    for (int i = m_ParticlesCount; i < m_ParticlesCount + particlesCount; i++)
+    {
+        m_Velocities[i] = slmath::vec4(0.0f);
+        m_CalmStepsCount[i] = 0;
+        m_IsSleeping[i] = false;
+    }
+    m_ParticlesCount += particlesCount;
+}
+
+void ParticlesSleeping::CompactParticles(   const int *deadIndices,
+                                            int deadCount,
+                                            const int *sources,
+                                            const int *destinations,
+                                            int movesCount,
+                                            int particlesCount)
+{
+    assert(particlesCount <= m_ParticlesCount);
+    for (int i = 0; i < deadCount; i++)
+    {
+        WakeUp(deadIndices[i]);
+    }
+    for (int i = 0; i < movesCount; i++)
+    {
+        m_Velocities[destinations[i]]       = m_Velocities[sources[i]];
+        m_CalmStepsCount[destinations[i]]   = m_CalmStepsCount[sources[i]];
+        m_IsSleeping[destinations[i]]       = m_IsSleeping[sources[i]];
+    }
+    m_ParticlesCount = particlesCount;
+}
+
+int ParticlesSleeping::Update(  const slmath::vec4 *positions,
+                                slmath::vec4 *previousPositions,
+                                float deltaT,
+                                Grid3D *grid3D)
+{
+    assert(deltaT > 0.0f);
+    PROFILE_BEGIN();
+
+    const int neighborsMaxCount = 256;
+    int neighborsBuffer[neighborsMaxCount];
+    const float inverseDeltaT = 1.0f / deltaT;
+
+    for (int i = 0; i < m_ParticlesCount; i++)
+    {
+        if (m_IsSleeping[i])
+            continue;
+
+        // Acceleration is deduced from the velocity, collision and spring corrections are included
+        slmath::vec4 velocity = (positions[i] - previousPositions[i]) * inverseDeltaT;
+        velocity.w = 0.0f;
+        slmath::vec4 acceleration = (velocity - m_Velocities[i]) * inverseDeltaT;
+        m_Velocities[i] = velocity;
+
+        if (slmath::dot(velocity, velocity) < m_SqrSpeedThreshold &&
+            slmath::dot(acceleration, acceleration) < m_SqrAccelerationThreshold)
+        {
+            if (++m_CalmStepsCount[i] >= m_StepsBeforeSleeping)
+            {
+                m_IsSleeping[i] = true;
+                m_Velocities[i] = slmath::vec4(0.0f);
+                previousPositions[i] = positions[i];
+                m_SleepingCount++;
+            }
+            continue;
+        }
+
+        m_CalmStepsCount[i] = 0;
+        if (grid3D == NULL)
+            continue;
+
+        // A moving particle wakes up its neighbors
+        const Grid3D::ParticleCellOrder *particleOrder = grid3D->GetParticleCellOrder();
+        int neighborsCount = grid3D->GetNeighborsByParticleOrder(grid3D->GetParticleOrderIndex()[i], neighborsBuffer, neighborsMaxCount);
+        for (int j = 0; j < neighborsCount; j++)
+        {
+            WakeUp(particleOrder[neighborsBuffer[j]].m_ParticleIndex);
+        }
+    }
+
+    m_ActiveCount = 0;
+    for (int i = 0; i < m_ParticlesCount; i++)
+    {
+        if ( ! m_IsSleeping[i])
+        {
+            m_ActiveIndices[m_ActiveCount++] = i;
+        }
+    }
+    assert(m_ActiveCount == m_ParticlesCount - m_SleepingCount);
+
+    PROFILE_END("Sleeping");
+    return m_ActiveCount;
+}
+
+const int *ParticlesSleeping::GetActiveIndices() const
+{
+    return m_ActiveIndices;
+}
+
+int ParticlesSleeping::GetActiveCount() const
+{
+    return m_ActiveCount;
+}
+
+int ParticlesSleeping::GetAwakeCount() const
+{
+    return m_ParticlesCount - m_SleepingCount;
+}
+
+void ParticlesSleeping::WakeUp(int particleIndex)
+{
+    assert(particleIndex >= 0 && particleIndex < m_ParticlesCount);
+    if (m_IsSleeping[particleIndex])
+    {
+        m_IsSleeping[particleIndex] = false;
+        m_CalmStepsCount[particleIndex] = 0;
+        m_SleepingCount--;
+    }
+}
+
+void ParticlesSleeping::WakeUpAll()
+{
+    for (int i = 0; i < m_ParticlesCount; i++)
+    {
+        m_IsSleeping[i] = false;
+        m_CalmStepsCount[i] = 0;
+    }
+    m_SleepingCount = 0;
+}
+
+void ParticlesSleeping::WakeUpInSphere(const slmath::vec4 *positions, const slmath::vec3 &center, float radius)
+{
+    const float sqrRadius = radius * radius;
+    for (int i = 0; i < m_ParticlesCount; i++)
+    {
+        slmath::vec3 separation = slmath::vec3(positions[i]) - center;
+        if (slmath::dot(separation, separation) < sqrRadius)
+        {
+            WakeUp(i);
+        }
+    }
+}
+
+void ParticlesSleeping::Reserve(int particlesCapacity)
+{
+    assert(particlesCapacity > 0);
+    if (particlesCapacity <= m_ParticlesCapacity)
+        return;
+
+    slmath::vec4 *velocities    = MemoryArena::NewArray<slmath::vec4>(m_MemoryArena, particlesCapacity);
+    int *calmStepsCount         = MemoryArena::NewArray<int>(m_MemoryArena, particlesCapacity);
+    bool *isSleeping            = MemoryArena::NewArray<bool>(m_MemoryArena, particlesCapacity);
+    for (int i = 0; i < m_ParticlesCount; i++)
+    {
+        velocities[i]       = m_Velocities[i];
+        calmStepsCount[i]   = m_CalmStepsCount[i];
+        isSleeping[i]       = m_IsSleeping[i];
+    }
+
+    MemoryArena::DeleteArray(m_MemoryArena, m_Velocities);
+    MemoryArena::DeleteArray(m_MemoryArena, m_CalmStepsCount);
+    MemoryArena::DeleteArray(m_MemoryArena, m_IsSleeping);
+    MemoryArena::DeleteArray(m_MemoryArena, m_ActiveIndices);
+
+    m_ParticlesCapacity = particlesCapacity;
+    m_Velocities        = velocities;
+    m_CalmStepsCount    = calmStepsCount;
+    m_IsSleeping        = isSleeping;
+    m_ActiveIndices     = MemoryArena::NewArray<int>(m_MemoryArena, m_ParticlesCapacity);
+    m_ActiveCount       = 0;
+}
+
+void ParticlesSleeping::SetMemoryArena(MemoryArena *memoryArena)
+{
+    assert(m_ParticlesCapacity == 0 && "ParticlesSleeping::SetMemoryArena failed.");
+    m_MemoryArena = memoryArena;
+}
+
+size_t ParticlesSleeping::GetMemorySize(int particlesCapacity)
+{
+    return  MemoryArena::GetArraySize<slmath::vec4>(particlesCapacity) +
+            2 * MemoryArena::GetArraySize<int>(particlesCapacity) +
+            MemoryArena::GetArraySize<bool>(particlesCapacity);
+}
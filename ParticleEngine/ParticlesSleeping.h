@@ -0,0 +1,73 @@
+#ifndef PARTICLES_SLEEPING
+#define PARTICLES_SLEEPING
+
+#include <slmath/slmath.h>
+
+class Grid3D;
+class MemoryArena;
+
+// Particles which stay under the speed and acceleration thresholds during
+// enough steps fall asleep, they are removed from the active list.
+// Moving particles wake up their sleeping neighbors.
+class ParticlesSleeping
+{
+public:
+    ParticlesSleeping();
+    ~ParticlesSleeping();
+
+    void SetThresholds(float speed, float acceleration);
+    void SetStepsBeforeSleeping(int stepsCount);
+
+    // All particles start awake
+    void Initialize(int particlesCount);
+    int GetParticlesCount() const;
+
+    // Capacity is reserved to add particles without reallocation, states are kept
+    void Reserve(int particlesCapacity);
+    void SetMemoryArena(MemoryArena *memoryArena);
+    static size_t GetMemorySize(int particlesCapacity);
+    void ReleaseMemory();
+    // Particles added after the last one start awake
+    void AddParticles(int particlesCount);
+    // Dead particles are woken up, then states are moved from sources to destinations
+    void CompactParticles(  const int *deadIndices,
+                            int deadCount,
+                            const int *sources,
+                            const int *destinations,
+                            int movesCount,
+                            int particlesCount);
+
+    // Updates the sleep states and builds the active list, returns the active particles count.
+    // Velocities of particles falling asleep are killed. The grid is used to wake up
+    // the neighbors of moving particles, it can be NULL
+    int Update( const slmath::vec4 *positions,
+                slmath::vec4 *previousPositions,
+                float deltaT,
+                Grid3D *grid3D);
+
+    const int *GetActiveIndices() const;
+    int GetActiveCount() const;
+    int GetAwakeCount() const;
+
+    void WakeUp(int particleIndex);
+    void WakeUpAll();
+    void WakeUpInSphere(const slmath::vec4 *positions, const slmath::vec3 &center, float radius);
+
+private:
+    slmath::vec4    *m_Velocities;
+    int             *m_CalmStepsCount;
+    bool            *m_IsSleeping;
+    int             *m_ActiveIndices;
+    MemoryArena     *m_MemoryArena;
+
+    float   m_SqrSpeedThreshold;
+    float   m_SqrAccelerationThreshold;
+    int     m_StepsBeforeSleeping;
+
+    int     m_ActiveCount;
+    int     m_SleepingCount;
+    int     m_ParticlesCount;
+    int     m_ParticlesCapacity;
+};
+
+#endif // PARTICLES_SLEEPING
@@ -1,5 +1,6 @@
 #include "ParticlesSpring.h"
-#include "Utility/Timer.h"
+#include "Utility/Profiler.h"
+#include "Utility/Utility.h"
 #include <slmath/slmath.h>
 
 void ParticlesSpring::AddSpring(const Spring& spring)
@@ -10,7 +11,7 @@ void ParticlesSpring::AddSpring(const Spring& spring)
 void ParticlesSpring::Solve(slmath::vec4 *positions, int positionsCount)
 {
     UNUSED_PARAMETER(positionsCount);
-    Timer::GetInstance()->StartTimerProfile();
+    PROFILE_BEGIN();
     const int springCount = m_SpringsList.size();
 
     for (int i = 0; i < springCount; i++)
@@ -33,7 +34,7 @@ void ParticlesSpring::Solve(slmath::vec4 *positions, int positionsCount)
 
         const float epsilon = 1e-4f;
         float distance = 1e-1f;
-        if (sqrDistance < epsilon)
+        if (sqrDistance > epsilon)
         {
             distance = sqrt (sqrDistance);
         }
@@ -44,7 +45,7 @@ void ParticlesSpring::Solve(slmath::vec4 *positions, int positionsCount)
         position2 += movingVector;
     }
 
-    Timer::GetInstance()->StopTimerProfile("Solve Spring");
+    PROFILE_END("Solve Spring");
 }
 
 void ParticlesSpring::Release()
@@ -9,32 +9,133 @@
 #include "Grid3D.h"
 #include "ParticlesSpring.h"
 #include "ParticlesAccelerator.h"
+#include "AdaptiveTimeStep.h"
+#include "MultiRateStepping.h"
+#include "ParticlesSleeping.h"
+#include "ParticlesEmitter.h"
 #include "PipelineDescription.h"
-#include "ParticlesGPU/ParticlesGPU.hpp"
+#ifndef PARTICLES_GPU_DISABLED
+    #include "ParticlesGPU/ParticlesGPU.hpp"
+    #include "ParticlesGPU/ParticlesMultiGPU.hpp"
+#endif // PARTICLES_GPU_DISABLED
+#include "ParticlesCPU.h"
+#include "SimulationCheckpoint.h"
+#include "CheckpointWriter.h"
 
 
-#include "Utility/Timer.h"
+#include "Utility/Profiler.h"
+#include "Utility/MemoryArena.h"
+#include "Utility/Utility.h"
 
+#include <cmath>
+#include <cstring>
+#include <algorithm>
 
 
+namespace
+{
+    // Scratch of each thread for the neighbors lists of the CPU stages
+    const size_t    s_ScratchSize           = 64 * 1024;
+
+    void SetFlag(unsigned int& flags, unsigned int flag, bool isSet)
+    {
+        if (isSet)
+        {
+            flags |= flag;
+        }
+    }
+
+    bool HasFlag(unsigned int flags, unsigned int flag)
+    {
+        return (flags & flag) != 0;
+    }
+}
 
 struct PhysicsParticle::Pimpl
 {
+    // Destroyed after the components allocated in it
+    MemoryArena                     m_MemoryArena;
     Grid3D m_Grid3D;
     SmoothedParticleHydrodynamics   m_SmoothedParticleHydrodynamics;
     ParticlesCollider               m_ParticlesCollider;
     VerletIntegration               m_VerletIntegration;
     ParticlesSpring                 m_ParticlesSpring;
     ParticlesAccelerator            m_ParticlesAccelerator;
+#ifndef PARTICLES_GPU_DISABLED
     ParticlesGPU                    m_ParticlesGPU;
+    ParticlesMultiGPU               m_ParticlesMultiGPU;
+#endif // PARTICLES_GPU_DISABLED
+    ParticlesCPU                    m_ParticlesCPU;
+    // Backend running the stages of the pipeline, OpenCL by default, the native one
+    // when the OpenCL backends are compiled out
+    ParticlesBackend                *m_Backend;
     slmath::vec4*                   m_EndsAnimation;
+    AdaptiveTimeStep                m_AdaptiveTimeStep;
+    bool                            m_IsUsingAdaptiveTimeStep;
+    int                             m_SubStepsCount;
+    MultiRateStepping               m_MultiRateStepping;
+    bool                            m_IsUsingMultiRate;
+    ParticlesSleeping               m_ParticlesSleeping;
+    bool                            m_IsUsingSleeping;
+    ParticlesEmitter                m_ParticlesEmitter;
+    int                             m_ParticlesCapacity;
+    float                           m_MultiRateBlockTime;
+    bool                            m_IsReadingBack;
+    // Given to the backend again when it changes, and saved in the checkpoints
+    int                             m_ClothCount;
+
+    // Collision shapes of the previous step, to detect their motion
+    std::vector<Aabb>               m_PreviousInsideAabbs;
+    std::vector<Sphere>             m_PreviousInsideSpheres;
+    std::vector<Sphere>             m_PreviousOutsideSpheres;
 
     PipelineDescription             m_Pipeline;
+    CheckpointWriter                m_CheckpointWriter;
 
     Pimpl() : m_SmoothedParticleHydrodynamics(&m_Grid3D)
-            , m_ParticlesGPU()
             , m_EndsAnimation(NULL)
+            , m_IsUsingAdaptiveTimeStep(false)
+            , m_SubStepsCount(1)
+            , m_IsUsingMultiRate(false)
+            , m_IsUsingSleeping(false)
+            , m_ParticlesCapacity(0)
+            , m_MultiRateBlockTime(1.0f / 60.0f)
+            , m_IsReadingBack(true)
+            , m_ClothCount(1)
+    {
+#ifndef PARTICLES_GPU_DISABLED
+        m_Backend = &m_ParticlesGPU;
+#else // PARTICLES_GPU_DISABLED
+        m_Backend = &m_ParticlesCPU;
+#endif // PARTICLES_GPU_DISABLED
+
+        m_Grid3D.SetMemoryArena(&m_MemoryArena);
+        m_SmoothedParticleHydrodynamics.SetMemoryArena(&m_MemoryArena);
+        m_VerletIntegration.SetMemoryArena(&m_MemoryArena);
+        m_ParticlesAccelerator.SetMemoryArena(&m_MemoryArena);
+        m_MultiRateStepping.SetMemoryArena(&m_MemoryArena);
+        m_ParticlesSleeping.SetMemoryArena(&m_MemoryArena);
+        m_ParticlesEmitter.SetMemoryArena(&m_MemoryArena);
+    }
+
+    // Before the arena is reserved again, nothing may point in the previous block
+    void ReleaseMemory()
     {
+        m_Grid3D.ReleaseMemory();
+        m_SmoothedParticleHydrodynamics.ReleaseMemory();
+        m_VerletIntegration.ReleaseMemory();
+        m_ParticlesAccelerator.ReleaseMemory();
+        m_MultiRateStepping.ReleaseMemory();
+        m_ParticlesSleeping.ReleaseMemory();
+        m_ParticlesEmitter.ReleaseMemory();
+    }
+
+    // A region by thread of the native backend pool, the simulating thread is its first one
+    int GetScratchThreadsCount() const
+    {
+        if (m_Backend != &m_ParticlesCPU)
+            return 1;
+        return std::min(m_ParticlesCPU.GetThreadsCount(), MemoryArena::s_MaxThreadsCount);
     }
 };
 
@@ -53,7 +154,7 @@ PhysicsParticle::PhysicsParticle() :    // Private parameters disabled
 
 PhysicsParticle::~PhysicsParticle()
 {
-    if (m_Pimpl->m_ParticlesGPU.cleanup() != 0)
+    if (m_Pimpl->m_Backend->cleanup() != 0)
     {
         assert(0);
     }
@@ -94,6 +195,7 @@ void PhysicsParticle::SetParticlesViscosity(float viscosity)
 void PhysicsParticle::SetParticlesAcceleration(const vrVec4 &acceleration)
 {
     m_Pimpl->m_VerletIntegration.SetCommonAcceleration(*reinterpret_cast<const slmath::vec4*>(&acceleration));
+    WakeUpParticles();
 }
 
 void PhysicsParticle::SetParticlesAnimation(vrVec4 *endsAnimation)
@@ -106,6 +208,26 @@ void PhysicsParticle::SetDamping(float damping)
     m_Pimpl->m_VerletIntegration.SetDamping(damping);
 }
 
+int PhysicsParticle::AddFluidPhase(float mass, float gazConstant, float restDensity)
+{
+    SphPhase phase;
+    phase.m_Mass = mass;
+    phase.m_GazConstant = gazConstant;
+    phase.m_RestDensity = restDensity;
+    return m_Pimpl->m_SmoothedParticleHydrodynamics.AddPhase(phase);
+}
+
+void PhysicsParticle::SetPhasesPressureFactor(int phase1, int phase2, float pressureFactor)
+{
+    m_Pimpl->m_SmoothedParticleHydrodynamics.SetPhasesPressureFactor(phase1, phase2, pressureFactor);
+}
+
+void PhysicsParticle::SetParticlesPhase(int firstIndex, int particlesCount, int phase)
+{
+    assert( ! m_Pimpl->m_Pipeline.m_SPHAndIntegrateOnGPU && "Multi phase needs the CPU solver !");
+    m_Pimpl->m_SmoothedParticleHydrodynamics.SetParticlesPhase(firstIndex, particlesCount, phase);
+}
+
 // Properies Getters
 float PhysicsParticle::GetParticlesMass() const
 {
@@ -141,59 +263,122 @@ int PhysicsParticle::GetNeighbors(int currentIndex,  int *neighbors, int neighbo
 
 void PhysicsParticle::Initialize(vrVec4 *positions, int positionsCount)
 {
-    Timer::GetInstance()->StartTimerProfile();
-    
+    PROFILE_BEGIN();
+
+    // Nothing is reallocated when particles are emitted
+    const int particlesCapacity = std::max(m_Pimpl->m_ParticlesCapacity, positionsCount);
+    const bool isUsingSPH = m_Pimpl->m_Pipeline.m_SPHAndIntegrateOnGPU || m_SPHSimulation;
+    const bool isUsingGrid3D = m_Pimpl->m_Pipeline.m_IsCreatingGridOnGPU || m_IsUsingGrid3D;
+
+    // The whole capacity is reserved at once. An initialization again gives the arrays of the
+    // previous one back first, the arena would otherwise fill up and fall back on the heap
+    m_Pimpl->ReleaseMemory();
+    size_t memorySize = VerletIntegration::GetMemorySize(particlesCapacity) +
+                        ParticlesEmitter::GetMemorySize(particlesCapacity);
+    memorySize += isUsingSPH ? SmoothedParticleHydrodynamics::GetMemorySize(particlesCapacity) : 0;
+    memorySize += isUsingGrid3D ? Grid3D::GetMemorySize(particlesCapacity) : 0;
+    memorySize += m_IsUsingAccelerator ? ParticlesAccelerator::GetMemorySize(particlesCapacity) : 0;
+    memorySize += m_Pimpl->m_IsUsingMultiRate ? MultiRateStepping::GetMemorySize(particlesCapacity) : 0;
+    memorySize += m_Pimpl->m_IsUsingSleeping ? ParticlesSleeping::GetMemorySize(particlesCapacity) : 0;
+    m_Pimpl->m_MemoryArena.Reserve(memorySize, s_ScratchSize, m_Pimpl->GetScratchThreadsCount());
+
+    if (isUsingGrid3D)
+    {
+        m_Pimpl->m_Grid3D.Reserve(particlesCapacity);
+    }
+
     // Initialze grid to allocate memory
     if (m_Pimpl->m_Pipeline.m_IsCreatingGridOnGPU)
     {
         CreateGrid(positions, positionsCount);
     }
 
-    Timer::GetInstance()->StartTimerProfile();
+    PROFILE_BEGIN();
+    // The native backend copies the host arrays with the partitions of its pinned threads
+    m_Pimpl->m_VerletIntegration.SetThreadPool(IsUsingNativeBackend() ? m_Pimpl->m_ParticlesCPU.StartPinnedThreads() : NULL);
+    m_Pimpl->m_VerletIntegration.Reserve(particlesCapacity);
     m_Pimpl->m_VerletIntegration.Initialize(reinterpret_cast<slmath::vec4*>(positions), positionsCount);
-    if (m_Pimpl->m_Pipeline.m_IsCreatingGridOnGPU)
+    if (m_Pimpl->m_Pipeline.m_IsCreatingGridOnGPU || m_IsUsingGrid3D)
     {
         m_Pimpl->m_VerletIntegration.SetGrid3D(&m_Pimpl->m_Grid3D);
     }
     //m_Pimpl->m_ParticlesAccelerator.AllocateAccelerations(positionsCount);
-    Timer::GetInstance()->StopTimerProfile("Init Verlet");
-    Timer::GetInstance()->StartTimerProfile();
+    PROFILE_END("Init Verlet");
+    PROFILE_BEGIN();
 
-    if (m_Pimpl->m_Pipeline.m_SPHAndIntegrateOnGPU)
+    if (isUsingSPH)
     {
+        m_Pimpl->m_SmoothedParticleHydrodynamics.Reserve(particlesCapacity);
         m_Pimpl->m_SmoothedParticleHydrodynamics.Initialize(m_Pimpl->m_VerletIntegration.GetParticlePositions(),
                                                positionsCount);
     }
-    Timer::GetInstance()->StopTimerProfile("Intit SPH");
+    PROFILE_END("Intit SPH");
+
+    if (m_IsUsingAccelerator)
+    {
+        m_Pimpl->m_ParticlesAccelerator.AllocateAccelerations(particlesCapacity);
+        m_Pimpl->m_ParticlesAccelerator.Initialize();
+    }
+
+    if (m_Pimpl->m_IsUsingMultiRate)
+    {
+        m_Pimpl->m_MultiRateStepping.Reserve(particlesCapacity);
+        m_Pimpl->m_MultiRateStepping.Initialize(positionsCount, m_Pimpl->m_VerletIntegration.GetDeltaT());
+    }
+    if (m_Pimpl->m_IsUsingSleeping)
+    {
+        m_Pimpl->m_ParticlesSleeping.Reserve(particlesCapacity);
+        m_Pimpl->m_ParticlesSleeping.Initialize(positionsCount);
+    }
+
+    // Initial particles never die of age
+    m_Pimpl->m_ParticlesEmitter.Reserve(particlesCapacity);
+    m_Pimpl->m_ParticlesEmitter.SetLifeTimes(0, particlesCapacity, -1.0f);
 //    m_Pimpl->m_ParticlesAccelerator.Initialize();
-    Timer::GetInstance()->StopTimerProfile("Init Physics");
+    PROFILE_END("Init Physics");
 
 }
 
 void PhysicsParticle::InitializeOpenCL( ID3D11Device *d3D11Device /*= NULL*/,
                                         ID3D11Buffer *d3D11buffer /*= NULL*/)
 {
-    Timer::GetInstance()->StartTimerProfile();
-    assert( ! (m_Pimpl->m_ParticlesGPU.IsUsingInteroperability() && m_Pimpl->m_ParticlesGPU.IsUsingCPU() ));
-    
-    int status = m_Pimpl->m_ParticlesGPU.Setup(d3D11Device);
-    UNUSED_PARAMETER(status);
-    assert(status == CL_SUCCESS);
+    PROFILE_BEGIN();
+    int status = 0;
+#ifndef PARTICLES_GPU_DISABLED
+    // The native backend doesn't need any OpenCL platform
+    if ( ! IsUsingNativeBackend())
+    {
+        assert( ! (m_Pimpl->m_ParticlesGPU.IsUsingInteroperability() && m_Pimpl->m_ParticlesGPU.IsUsingCPU() ));
+
+        status = m_Pimpl->m_ParticlesGPU.Setup(d3D11Device);
+        assert(status == CL_SUCCESS);
+    }
+
+    // Springs and animation index the particles of the whole simulation, they stay on one device
+    if (m_Pimpl->m_Backend == &m_Pimpl->m_ParticlesMultiGPU &&
+        (m_Pimpl->m_Pipeline.m_SpringOnGPU || m_Pimpl->m_Pipeline.m_IsUsingAnimation))
+    {
+        m_Pimpl->m_Backend = &m_Pimpl->m_ParticlesGPU;
+    }
+#else // PARTICLES_GPU_DISABLED
+    UNUSED_PARAMETER(d3D11Device);
+#endif // PARTICLES_GPU_DISABLED
 
-    Timer::GetInstance()->StopTimerProfile("Setup openCL");
+    PROFILE_END("Setup openCL");
 
-    Timer::GetInstance()->StartTimerProfile();
+    PROFILE_BEGIN();
 
-    status = m_Pimpl->m_ParticlesGPU.Initialize(  m_Pimpl->m_VerletIntegration.GetParticlesCount(),
+    m_Pimpl->m_Backend->SetClothCount(m_Pimpl->m_ClothCount);
+    status = m_Pimpl->m_Backend->Initialize(  m_Pimpl->m_VerletIntegration.GetParticlesCount(),
                                         m_Pimpl->m_ParticlesSpring.GetSpringsCount(), 
                                         m_Pimpl->m_ParticlesAccelerator.GetAcceleratorsCount(),
                                         m_Pimpl->m_Pipeline ,d3D11buffer);
     UNUSED_PARAMETER(status);
-    assert(status == CL_SUCCESS);
+    assert(status == 0);
 
 
     InitializeOpenClData();
-    Timer::GetInstance()->StopTimerProfile("Init openCL");
+    PROFILE_END("Init openCL");
     
 }
 
@@ -208,47 +393,51 @@ void PhysicsParticle::Release()
 
 void PhysicsParticle::InitializeOpenClData()
 {
+    m_Pimpl->m_Backend->InvalidateDeviceParticles();
+
     if (m_Pimpl->m_Pipeline.m_AcceleratorOnGPU)
     {
         assert(m_Pimpl->m_ParticlesAccelerator.GetAcceleratorsCount() > 0);
 
 
-        m_Pimpl->m_ParticlesGPU.UpdateInputAccelerator(  m_Pimpl->m_VerletIntegration.GetParticlePositions(), 
+        m_Pimpl->m_Backend->UpdateInputAccelerator(  m_Pimpl->m_VerletIntegration.GetParticlePositions(), 
                                                 m_Pimpl->m_VerletIntegration.GetParticlePreviousPositions(),
                                                 m_Pimpl->m_VerletIntegration.GetParticlesCount(),
                                                 m_Pimpl->m_ParticlesAccelerator.GetAccelerators(), 
-                                                m_Pimpl->m_ParticlesAccelerator.GetAcceleratorsCount());
-        int status = m_Pimpl->m_ParticlesGPU.InitializeKernelAccelerator();
+                                                m_Pimpl->m_ParticlesAccelerator.GetAcceleratorsCount(),
+                                                m_Pimpl->m_ParticlesAccelerator.GetGeneration());
+        int status = m_Pimpl->m_Backend->InitializeKernelAccelerator();
         UNUSED_PARAMETER(status);
-        assert(status == CL_SUCCESS);
+        assert(status == 0);
     }
     if (m_Pimpl->m_Pipeline.m_CollisionOnGPU)
     {
 
-        m_Pimpl->m_ParticlesGPU.UpdateInputCollision(    m_Pimpl->m_VerletIntegration.GetParticlePositions(), 
+        m_Pimpl->m_Backend->UpdateInputCollision(    m_Pimpl->m_VerletIntegration.GetParticlePositions(), 
                                                 m_Pimpl->m_VerletIntegration.GetParticlePreviousPositions(),
                                                 m_Pimpl->m_VerletIntegration.GetParticlesCount(),
                                                 m_Pimpl->m_ParticlesCollider.GetOutsideSpheres(), m_Pimpl->m_ParticlesCollider.GetOutsideSpheresCount(),
                                                 m_Pimpl->m_ParticlesCollider.GetInsideSpheres(), m_Pimpl->m_ParticlesCollider.GetInsideSpheresCount(),
-                                                m_Pimpl->m_ParticlesCollider.GetInsideAabbs(), m_Pimpl->m_ParticlesCollider.GetInsideAabbsCount());
+                                                m_Pimpl->m_ParticlesCollider.GetInsideAabbs(), m_Pimpl->m_ParticlesCollider.GetInsideAabbsCount(),
+                                                m_Pimpl->m_ParticlesCollider.GetGeneration());
                                             
 
-        int status = m_Pimpl->m_ParticlesGPU.InitializeKernelCollision();
+        int status = m_Pimpl->m_Backend->InitializeKernelCollision();
         UNUSED_PARAMETER(status);
-        assert(status == CL_SUCCESS);
+        assert(status == 0);
     }
     if (m_Pimpl->m_Pipeline.m_IsCreatingGridOnGPU)
     {
-         m_Pimpl->m_ParticlesGPU.UpdateInputCreateGrid(  m_Pimpl->m_VerletIntegration.GetParticlePositions(), 
+         m_Pimpl->m_Backend->UpdateInputCreateGrid(  m_Pimpl->m_VerletIntegration.GetParticlePositions(), 
                                                 m_Pimpl->m_ParticlesAccelerator.GetAccelerations(),
                                                 (int*)m_Pimpl->m_Grid3D.GetParticleCellOrder(),
                                                 (int*)m_Pimpl->m_Grid3D.GetParticleCellOrderBuffer(),
                                                 m_Pimpl->m_Grid3D.GetGridInfo());
 
 
-        int status = m_Pimpl->m_ParticlesGPU.InitializeCreateGrid();
+        int status = m_Pimpl->m_Backend->InitializeCreateGrid();
         UNUSED_PARAMETER(status);
-        assert(status == CL_SUCCESS);
+        assert(status == 0);
     
     }
     if (m_Pimpl->m_Pipeline.m_SPHAndIntegrateOnGPU)
@@ -256,172 +445,188 @@ void PhysicsParticle::InitializeOpenClData()
         assert(m_Pimpl->m_Pipeline.m_IsCreatingGridOnGPU && "Must use a grid for SPH !");
         // assert (m_Pimpl->m_ParticlesCollider.GetOutsideSpheresCount() > 0 && m_Pimpl->m_ParticlesCollider.GetInsideAabbsCount() > 0);
 
-        m_Pimpl->m_ParticlesGPU.UpdateInputSPH(  m_Pimpl->m_VerletIntegration.GetParticlePositions(), 
+        m_Pimpl->m_Backend->UpdateInputSPH(  m_Pimpl->m_VerletIntegration.GetParticlePositions(), 
                                         m_Pimpl->m_VerletIntegration.GetParticlePreviousPositions(), 
                                         m_Pimpl->m_SmoothedParticleHydrodynamics.GetPreviousDensity(), 
                                         (int*)m_Pimpl->m_Grid3D.GetParticleCellOrder(), 
                                         m_Pimpl->m_Grid3D.GetGridInfo(),
-                                        m_Pimpl->m_SmoothedParticleHydrodynamics.GetParameters());
+                                        m_Pimpl->m_SmoothedParticleHydrodynamics.GetParameters(),
+                                        m_Pimpl->m_SmoothedParticleHydrodynamics.GetParametersGeneration());
                                             
 
-        int status = m_Pimpl->m_ParticlesGPU.InitializeKernelSPH();
+        int status = m_Pimpl->m_Backend->InitializeKernelSPH();
         UNUSED_PARAMETER(status);
-        assert(status == CL_SUCCESS);
+        assert(status == 0);
     }
     if (m_Pimpl->m_Pipeline.m_SpringOnGPU)
     {
-        m_Pimpl->m_ParticlesGPU.UpdateInputSpring(   m_Pimpl->m_VerletIntegration.GetParticlePositions(), 
+        m_Pimpl->m_Backend->UpdateInputSpring(   m_Pimpl->m_VerletIntegration.GetParticlePositions(), 
                                         m_Pimpl->m_VerletIntegration.GetParticlesCount(),
                                         m_Pimpl->m_ParticlesSpring.GetSprings(), 
                                         m_Pimpl->m_ParticlesSpring.GetSpringsCount());
 
-        int status = m_Pimpl->m_ParticlesGPU.InitializeKernelSpring();
+        int status = m_Pimpl->m_Backend->InitializeKernelSpring();
 
         UNUSED_PARAMETER(status);
-        assert(status == CL_SUCCESS);
+        assert(status == 0);
     }
     if (m_Pimpl->m_Pipeline.m_IsUsingAnimation)
     {
         assert(m_Pimpl->m_EndsAnimation != NULL);
 
-        m_Pimpl->m_ParticlesGPU.UpdateInputAnimation(   m_Pimpl->m_VerletIntegration.GetParticlePositions(), 
+        m_Pimpl->m_Backend->UpdateInputAnimation(   m_Pimpl->m_VerletIntegration.GetParticlePositions(), 
                                                         m_Pimpl->m_EndsAnimation,
                                                         m_Pimpl->m_VerletIntegration.GetParticlesCount());
 
 
-    int status = m_Pimpl->m_ParticlesGPU.InitializeKernelAnimation();
+    int status = m_Pimpl->m_Backend->InitializeKernelAnimation();
 
     UNUSED_PARAMETER(status);
-    assert(status == CL_SUCCESS);
+    assert(status == 0);
 
     }
+
+    // Uploads are done before the host data can change
+    int status = m_Pimpl->m_Backend->Synchronize();
+    UNUSED_PARAMETER(status);
+    assert(status == 0);
 }
 
 void PhysicsParticle::CreateGridOnGPU()
 {
-    Timer::GetInstance()->StartTimerProfile();
+    PROFILE_BEGIN();
 
 
-    m_Pimpl->m_ParticlesGPU.UpdateInputCreateGrid(   m_Pimpl->m_VerletIntegration.GetParticlePositions(), 
+    m_Pimpl->m_Backend->UpdateInputCreateGrid(   m_Pimpl->m_VerletIntegration.GetParticlePositions(), 
                                             m_Pimpl->m_ParticlesAccelerator.GetAccelerations(),
                                             (int*)m_Pimpl->m_Grid3D.GetParticleCellOrder(),
                                             (int*)m_Pimpl->m_Grid3D.GetParticleCellOrderBuffer(),
                                             m_Pimpl->m_Grid3D.GetGridInfo());
 
 
-    int status = m_Pimpl->m_ParticlesGPU.runKernelCreateGrid();
+    int status = m_Pimpl->m_Backend->runKernelCreateGrid();
     UNUSED_PARAMETER(status);
-    assert(status == CL_SUCCESS);
+    assert(status == 0);
     
-    Timer::GetInstance()->StopTimerProfile("Create Grid on GPU");
+    PROFILE_END("Create Grid on GPU");
 }
 
 void PhysicsParticle::CollisionOnGPU()
 {
-    Timer::GetInstance()->StartTimerProfile();
+    PROFILE_BEGIN();
 
-    m_Pimpl->m_ParticlesGPU.UpdateInputCollision(    m_Pimpl->m_VerletIntegration.GetParticlePositions(), 
+    m_Pimpl->m_Backend->UpdateInputCollision(    m_Pimpl->m_VerletIntegration.GetParticlePositions(), 
                                             m_Pimpl->m_VerletIntegration.GetParticlePreviousPositions(),
                                             m_Pimpl->m_VerletIntegration.GetParticlesCount(),
                                             m_Pimpl->m_ParticlesCollider.GetOutsideSpheres(), m_Pimpl->m_ParticlesCollider.GetOutsideSpheresCount(), 
                                             m_Pimpl->m_ParticlesCollider.GetInsideSpheres(), m_Pimpl->m_ParticlesCollider.GetInsideSpheresCount(), 
-                                            m_Pimpl->m_ParticlesCollider.GetInsideAabbs(), m_Pimpl->m_ParticlesCollider.GetInsideAabbsCount());
+                                            m_Pimpl->m_ParticlesCollider.GetInsideAabbs(), m_Pimpl->m_ParticlesCollider.GetInsideAabbsCount(),
+                                            m_Pimpl->m_ParticlesCollider.GetGeneration());
                                             
 
-    int status = m_Pimpl->m_ParticlesGPU.runKernelCollision();
+    int status = m_Pimpl->m_Backend->runKernelCollision();
     UNUSED_PARAMETER(status);
-    assert(status == CL_SUCCESS);
+    assert(status == 0);
 
 
-    Timer::GetInstance()->StopTimerProfile("Collision on GPU");
+    PROFILE_END("Collision on GPU");
 }
 
 void PhysicsParticle::SimuateSPHIntegrateOnGPU()
 {
-    Timer::GetInstance()->StartTimerProfile();
+    PROFILE_BEGIN();
 
-    m_Pimpl->m_ParticlesGPU.UpdateInputSPH(  m_Pimpl->m_VerletIntegration.GetParticlePositions(), 
+    m_Pimpl->m_Backend->UpdateInputSPH(  m_Pimpl->m_VerletIntegration.GetParticlePositions(), 
                                     m_Pimpl->m_VerletIntegration.GetParticlePreviousPositions(), 
                                     m_Pimpl->m_SmoothedParticleHydrodynamics.GetPreviousDensity(), 
                                     (int*)m_Pimpl->m_Grid3D.GetParticleCellOrder(), 
                                     m_Pimpl->m_Grid3D.GetGridInfo(),
-                                    m_Pimpl->m_SmoothedParticleHydrodynamics.GetParameters());
+                                    m_Pimpl->m_SmoothedParticleHydrodynamics.GetParameters(),
+                                    m_Pimpl->m_SmoothedParticleHydrodynamics.GetParametersGeneration());
 
 
-    int status = m_Pimpl->m_ParticlesGPU.runKernelSPH();
+    int status = m_Pimpl->m_Backend->runKernelSPH();
     UNUSED_PARAMETER(status);
-    assert(status == CL_SUCCESS);
+    assert(status == 0);
     
     m_Pimpl->m_VerletIntegration.SwapPositionBuffer();
 
 
-    Timer::GetInstance()->StopTimerProfile("SPH Integrate on GPU");
+    PROFILE_END("SPH Integrate on GPU");
 }
 
 void PhysicsParticle::SolveSpringOnGPU()
 {
-    Timer::GetInstance()->StartTimerProfile();
+    PROFILE_BEGIN();
 
-    m_Pimpl->m_ParticlesGPU.UpdateInputSpring(   m_Pimpl->m_VerletIntegration.GetParticlePositions(), 
+    m_Pimpl->m_Backend->UpdateInputSpring(   m_Pimpl->m_VerletIntegration.GetParticlePositions(), 
                                         m_Pimpl->m_VerletIntegration.GetParticlesCount(),
                                         m_Pimpl->m_ParticlesSpring.GetSprings(), 
                                         m_Pimpl->m_ParticlesSpring.GetSpringsCount());
 
-    int status = m_Pimpl->m_ParticlesGPU.runKernelSpring();
+    int status = m_Pimpl->m_Backend->runKernelSpring();
 
     UNUSED_PARAMETER(status);
-    assert(status == CL_SUCCESS);
+    assert(status == 0);
 
-    Timer::GetInstance()->StopTimerProfile("Spring on GPU");
+    PROFILE_END("Spring on GPU");
 }
 
 
 void PhysicsParticle::AcceleratorsOnGPU()
 {
-    Timer::GetInstance()->StartTimerProfile();
+    PROFILE_BEGIN();
 
 
     assert (m_Pimpl->m_ParticlesAccelerator.GetAcceleratorsCount() > 0);
 
-    m_Pimpl->m_ParticlesGPU.UpdateInputAccelerator(  m_Pimpl->m_VerletIntegration.GetParticlePositions(), 
+    m_Pimpl->m_Backend->UpdateInputAccelerator(  m_Pimpl->m_VerletIntegration.GetParticlePositions(), 
                                             m_Pimpl->m_VerletIntegration.GetParticlePreviousPositions(),
                                             m_Pimpl->m_VerletIntegration.GetParticlesCount(),
                                             m_Pimpl->m_ParticlesAccelerator.GetAccelerators(), 
-                                            m_Pimpl->m_ParticlesAccelerator.GetAcceleratorsCount());
+                                            m_Pimpl->m_ParticlesAccelerator.GetAcceleratorsCount(),
+                                            m_Pimpl->m_ParticlesAccelerator.GetGeneration());
         
 
-    int status = m_Pimpl->m_ParticlesGPU.runKernelAccelerator();
+    int status = m_Pimpl->m_Backend->runKernelAccelerator();
 
     UNUSED_PARAMETER(status);
-    assert(status == CL_SUCCESS);
+    assert(status == 0);
 
     m_Pimpl->m_VerletIntegration.SwapPositionBuffer();
 
-    Timer::GetInstance()->StopTimerProfile("Accelerators on GPU");
+    PROFILE_END("Accelerators on GPU");
 }
 
 void PhysicsParticle::Animate()
 {
-    Timer::GetInstance()->StartTimerProfile();
+    PROFILE_BEGIN();
 
     assert(m_Pimpl->m_EndsAnimation != NULL);
-    m_Pimpl->m_ParticlesGPU.UpdateInputAnimation(   m_Pimpl->m_VerletIntegration.GetParticlePositions(), 
+    m_Pimpl->m_Backend->UpdateInputAnimation(   m_Pimpl->m_VerletIntegration.GetParticlePositions(), 
                                                     m_Pimpl->m_EndsAnimation,
                                                     m_Pimpl->m_VerletIntegration.GetParticlesCount());
 
 
-    int status = m_Pimpl->m_ParticlesGPU.runKernelAnimation();
+    int status = m_Pimpl->m_Backend->runKernelAnimation();
 
     UNUSED_PARAMETER(status);
-    assert(status == CL_SUCCESS);
+    assert(status == 0);
 
-    Timer::GetInstance()->StopTimerProfile("Animation");
+    PROFILE_END("Animation");
 }
 
 void PhysicsParticle::Simulate()
 {
+    UpdateParticlesLife(m_Pimpl->m_VerletIntegration.GetDeltaT());
+
+    if (m_Pimpl->m_IsUsingSleeping)
+    {
+        SimulateAwake();
+        return;
+    }
 
-    Timer::GetInstance()->StartTimerProfile();
+    PROFILE_BEGIN();
 
     // Create grid
     
@@ -488,6 +693,8 @@ void PhysicsParticle::Simulate()
     }
     else if (m_IsSolvingSpring)
     {
+        // Positions computed on GPU are needed
+        m_Pimpl->m_Backend->Synchronize();
         m_Pimpl->m_ParticlesSpring.Solve(    m_Pimpl->m_VerletIntegration.GetParticlePositions(), 
                                     m_Pimpl->m_VerletIntegration.GetParticlesCount());
     }
@@ -503,11 +710,453 @@ void PhysicsParticle::Simulate()
     }
     else if (m_IsColliding)
     {
+        m_Pimpl->m_Backend->Synchronize();
         m_Pimpl->m_ParticlesCollider.SatisfyCollisions(  m_Pimpl->m_VerletIntegration.GetParticlePositions(), 
                                                 m_Pimpl->m_VerletIntegration.GetParticlesCount());
     }
+
+    // Single synchronization point of the step, the GPU results are read back here when enabled
+    m_Pimpl->m_Backend->Synchronize(m_Pimpl->m_IsReadingBack);
     
-    Timer::GetInstance()->StopTimerProfile("Physics simulation");
+    PROFILE_END("Physics simulation");
+
+    SetProfilerCounters(m_Pimpl->m_VerletIntegration.GetParticlesCount(),
+                        m_SPHSimulation && ! m_Pimpl->m_Pipeline.m_SPHAndIntegrateOnGPU);
+}
+
+void PhysicsParticle::Simulate(float frameTime)
+{
+    assert(frameTime > 0.0f);
+    if (m_Pimpl->m_IsUsingMultiRate)
+    {
+        SimulateMultiRate(frameTime);
+        return;
+    }
+
+    if ( ! m_Pimpl->m_IsUsingAdaptiveTimeStep)
+    {
+        m_Pimpl->m_SubStepsCount = 1;
+        Simulate();
+        return;
+    }
+
+    PROFILE_BEGIN();
+
+    const int maxSubStepsCount = m_Pimpl->m_AdaptiveTimeStep.GetMaxSubStepsCount();
+    float remainingTime = frameTime;
+    int subStepsCount = 0;
+
+    // When the sub steps limit is reached the remaining time is dropped,
+    // the simulation slows down instead of exploding
+    while (remainingTime > 0.0f && subStepsCount < maxSubStepsCount)
+    {
+        float deltaT = ComputeStableDeltaT();
+
+        // Spread the remaining time on equal steps to avoid a tiny last step
+        int stepsCount = static_cast<int>(ceilf(remainingTime / deltaT));
+        if (stepsCount <= 1)
+        {
+            deltaT = remainingTime;
+            remainingTime = 0.0f;
+        }
+        else
+        {
+            deltaT = remainingTime / stepsCount;
+            remainingTime -= deltaT;
+        }
+
+        SetDeltaT(deltaT);
+        Simulate();
+        subStepsCount++;
+    }
+    m_Pimpl->m_SubStepsCount = subStepsCount;
+
+    PROFILE_END("Adaptive simulation");
+}
+
+float PhysicsParticle::ComputeStableDeltaT() const
+{
+    const AdaptiveTimeStep& adaptiveTimeStep = m_Pimpl->m_AdaptiveTimeStep;
+
+    // With interoperability or without read back the positions stay on the device, host copies are not up to date
+    if (m_Pimpl->m_Backend->IsUsingInteroperability() || m_Pimpl->m_Backend->HasPendingReadBack())
+    {
+        return adaptiveTimeStep.GetMaxDeltaT();
+    }
+
+    const VerletIntegration& verlet = m_Pimpl->m_VerletIntegration;
+    const SmoothedParticleHydrodynamics& sph = m_Pimpl->m_SmoothedParticleHydrodynamics;
+    const bool isUsingSPH = m_Pimpl->m_Pipeline.m_SPHAndIntegrateOnGPU || m_SPHSimulation;
+    // Scanned on every sub step, the native backend threads share them
+    ThreadPool *threadPool = IsUsingNativeBackend() ? m_Pimpl->m_ParticlesCPU.GetThreadPool() : NULL;
+
+    float maxSpeed = adaptiveTimeStep.ComputeMaxSpeed(  verlet.GetParticlePositions(), 
+                                                        verlet.GetParticlePreviousPositions(),
+                                                        verlet.GetParticlesCount(),
+                                                        verlet.GetDeltaT(),
+                                                        threadPool);
+
+    // Uniform accelerations, the SPH gravity is only used by the GPU kernel
+    slmath::vec3 commonAcceleration(verlet.GetCommonAcceleration());
+    float maxAcceleration = slmath::length(commonAcceleration);
+    if (m_Pimpl->m_Pipeline.m_SPHAndIntegrateOnGPU)
+    {
+        maxAcceleration += slmath::length(slmath::vec3(sph.GetParameters().gravity));
+    }
+    else if (m_SPHSimulation)
+    {
+        maxAcceleration += adaptiveTimeStep.ComputeMaxAcceleration(sph.GetParticleAccelerations(), sph.GetParticlesCount(), threadPool);
+    }
+
+    // Pressure is proportional to the density, the speed of sound is sqrt(k)
+    float soundSpeed = 0.0f;
+    float h = adaptiveTimeStep.GetLengthScale();
+    if (isUsingSPH)
+    {
+        soundSpeed = sqrtf(sph.GetParameters().m_GazConstant);
+        h = sph.GetParameters().m_H;
+    }
+
+    return adaptiveTimeStep.ComputeStableDeltaT(maxSpeed, maxAcceleration, soundSpeed, h);
+}
+
+void PhysicsParticle::SetDeltaT(float deltaT)
+{
+    m_Pimpl->m_VerletIntegration.SetDeltaT(deltaT);
+    m_Pimpl->m_SmoothedParticleHydrodynamics.SetDeltaT(deltaT);
+    m_Pimpl->m_Backend->SetDeltaT(deltaT);
+}
+
+void PhysicsParticle::SimulateMultiRate(float frameTime)
+{
+    assert( ! m_Pimpl->m_Pipeline.m_SPHAndIntegrateOnGPU && 
+            ! m_Pimpl->m_Pipeline.m_AcceleratorOnGPU &&
+            ! m_Pimpl->m_Pipeline.m_CollisionOnGPU && "Multi rate needs the CPU solver !");
+    assert(m_IsIntegrating && ! m_ContinuousIntegration);
+
+    PROFILE_BEGIN();
+
+    const VerletIntegration& verlet = m_Pimpl->m_VerletIntegration;
+    const SmoothedParticleHydrodynamics& sph = m_Pimpl->m_SmoothedParticleHydrodynamics;
+    const AdaptiveTimeStep& adaptiveTimeStep = m_Pimpl->m_AdaptiveTimeStep;
+    MultiRateStepping& multiRate = m_Pimpl->m_MultiRateStepping;
+
+    if (multiRate.GetParticlesCount() != verlet.GetParticlesCount())
+    {
+        multiRate.Initialize(verlet.GetParticlesCount(), verlet.GetDeltaT());
+    }
+
+    float soundSpeed = 0.0f;
+    float h = adaptiveTimeStep.GetLengthScale();
+    if (m_SPHSimulation)
+    {
+        soundSpeed = sqrtf(sph.GetParameters().m_GazConstant);
+        h = sph.GetParameters().m_H;
+    }
+
+    const int subStepsCount = multiRate.GetSubStepsCount();
+    const int maxBlocksCount = std::max(1, adaptiveTimeStep.GetMaxSubStepsCount() / subStepsCount);
+    float remainingTime = frameTime;
+    int blocksCount = 0;
+
+    while (remainingTime > 0.0f && blocksCount < maxBlocksCount)
+    {
+        UpdateParticlesLife(m_Pimpl->m_MultiRateBlockTime);
+
+        // Last pressures are used as accelerations estimation
+        float minDeltaT = multiRate.ComputeStableDeltaTs(   verlet.GetParticlePositions(),
+                                                            verlet.GetParticlePreviousPositions(),
+                                                            m_SPHSimulation ? sph.GetParticleAccelerations() : NULL,
+                                                            verlet.GetCommonAcceleration(),
+                                                            soundSpeed,
+                                                            h,
+                                                            adaptiveTimeStep);
+
+        // The fastest particle is stable on the smallest level
+        float blockTime = minDeltaT * subStepsCount;
+        int stepsCount = static_cast<int>(ceilf(remainingTime / blockTime));
+        if (stepsCount <= 1)
+        {
+            blockTime = remainingTime;
+            remainingTime = 0.0f;
+        }
+        else
+        {
+            blockTime = remainingTime / stepsCount;
+            remainingTime -= blockTime;
+        }
+
+        multiRate.AssignLevels(blockTime / subStepsCount);
+        for (int subStep = 0; subStep < subStepsCount; subStep++)
+        {
+            // Inactive particles are still neighbors of the active ones
+            if (m_IsUsingGrid3D)
+            {
+                m_Pimpl->m_Grid3D.Initialize(verlet.GetParticlePositions(), verlet.GetParticlesCount());
+            }
+
+            int activeCount = multiRate.BuildActiveList(subStep);
+            SimulateActive(multiRate.GetActiveIndices(), activeCount);
+        }
+        m_Pimpl->m_MultiRateBlockTime = blockTime;
+        blocksCount++;
+    }
+    m_Pimpl->m_SubStepsCount = blocksCount * subStepsCount;
+
+    PROFILE_END("Multi rate simulation");
+}
+
+void PhysicsParticle::SimulateActive(const int *activeIndices, int activeCount)
+{
+    // The grid must be up to date
+    VerletIntegration& verlet = m_Pimpl->m_VerletIntegration;
+
+    if (m_IsUsingAccelerator)
+    {
+        m_Pimpl->m_ParticlesAccelerator.Accelerate( verlet.GetParticlePositions(), 
+                                                    verlet.GetParticlesCount(),
+                                                    activeIndices, 
+                                                    activeCount);
+        verlet.AccumateAccelerations(m_Pimpl->m_ParticlesAccelerator.GetAccelerations(), activeIndices, activeCount);
+    }
+
+    if (m_SPHSimulation)
+    {
+        assert(m_IsUsingGrid3D && "Must use a grid for SPH !");
+        m_Pimpl->m_SmoothedParticleHydrodynamics.Simulate(  verlet.GetParticlePositions(), 
+                                                            verlet.GetParticlesCount(),
+                                                            activeIndices,
+                                                            activeCount);
+
+        verlet.AccumateAccelerations(   m_Pimpl->m_SmoothedParticleHydrodynamics.GetParticleAccelerations(),
+                                        activeIndices,
+                                        activeCount);
+    }
+
+    if (m_Pimpl->m_IsUsingMultiRate)
+    {
+        MultiRateStepping& multiRate = m_Pimpl->m_MultiRateStepping;
+        verlet.Integration(activeIndices, activeCount, multiRate.GetDeltaTs(), multiRate.GetPreviousDeltaTs());
+    }
+    else if (m_IsIntegrating)
+    {
+        verlet.Integration(activeIndices, activeCount);
+    }
+
+    // Springs link particles of different levels, they are solved for all particles
+    if (m_Pimpl->m_Pipeline.m_SpringOnGPU)
+    {
+        SolveSpringOnGPU();
+    }
+    else if (m_IsSolvingSpring)
+    {
+        m_Pimpl->m_ParticlesSpring.Solve(verlet.GetParticlePositions(), verlet.GetParticlesCount());
+    }
+
+    if (m_IsColliding)
+    {
+        m_Pimpl->m_ParticlesCollider.SatisfyCollisions(verlet.GetParticlePositions(), activeIndices, activeCount);
+    }
+
+    SetProfilerCounters(activeCount, m_SPHSimulation);
+}
+
+void PhysicsParticle::SetProfilerCounters(int activeCount, bool isCountingNeighbors)
+{
+    Profiler *profiler = Profiler::GetInstance();
+    profiler->SetCounter("Particles", m_Pimpl->m_VerletIntegration.GetParticlesCount());
+    profiler->SetCounter("Active particles", activeCount);
+    if (isCountingNeighbors)
+    {
+        profiler->SetCounter("Neighbors", m_Pimpl->m_SmoothedParticleHydrodynamics.GetNeighborsCount());
+    }
+}
+
+void PhysicsParticle::UpdateParticlesLife(float deltaT)
+{
+    ParticlesEmitter& emitter = m_Pimpl->m_ParticlesEmitter;
+    if ( ! emitter.IsActive())
+        return;
+
+    assert( ! m_Pimpl->m_Pipeline.m_IsCreatingGridOnGPU &&
+            ! m_Pimpl->m_Pipeline.m_SPHAndIntegrateOnGPU && 
+            ! m_Pimpl->m_Pipeline.m_AcceleratorOnGPU &&
+            ! m_Pimpl->m_Pipeline.m_CollisionOnGPU &&
+            ! m_Pimpl->m_Pipeline.m_SpringOnGPU && "Emitters need the CPU solver !");
+    assert(m_Pimpl->m_ParticlesSpring.GetSpringsCount() == 0 && "Springs use particle indices !");
+
+    PROFILE_BEGIN();
+
+    VerletIntegration& verlet = m_Pimpl->m_VerletIntegration;
+    SmoothedParticleHydrodynamics& sph = m_Pimpl->m_SmoothedParticleHydrodynamics;
+    MultiRateStepping& multiRate = m_Pimpl->m_MultiRateStepping;
+    ParticlesSleeping& sleeping = m_Pimpl->m_ParticlesSleeping;
+
+    // States not matching the particles are initialized again by their simulate method
+    const int particlesCount = verlet.GetParticlesCount();
+    const bool isUpdatingSPH = m_SPHSimulation && sph.GetParticlesCount() == particlesCount;
+    const bool isUpdatingMultiRate = m_Pimpl->m_IsUsingMultiRate && multiRate.GetParticlesCount() == particlesCount;
+    const bool isUpdatingSleeping = m_Pimpl->m_IsUsingSleeping && sleeping.GetParticlesCount() == particlesCount;
+
+    int aliveCount = emitter.CollectDeadParticles(deltaT, verlet.GetParticlePositions(), particlesCount);
+    if (aliveCount != particlesCount)
+    {
+        const int *sources = emitter.GetMoveSources();
+        const int *destinations = emitter.GetMoveDestinations();
+        const int movesCount = emitter.GetMovesCount();
+
+        verlet.CompactParticles(sources, destinations, movesCount, aliveCount);
+        if (isUpdatingSPH)
+        {
+            sph.CompactParticles(sources, destinations, movesCount, aliveCount);
+        }
+        if (isUpdatingMultiRate)
+        {
+            multiRate.CompactParticles(sources, destinations, movesCount, aliveCount);
+        }
+        if (isUpdatingSleeping)
+        {
+            sleeping.CompactParticles(  emitter.GetDeadIndices(),
+                                        emitter.GetDeadCount(),
+                                        sources,
+                                        destinations,
+                                        movesCount,
+                                        aliveCount);
+        }
+    }
+
+    int emittedCount = emitter.Emit(deltaT,
+                                    verlet.GetParticlePositions(),
+                                    verlet.GetParticlePreviousPositions(),
+                                    isUpdatingSPH ? sph.GetPhases() : NULL,
+                                    aliveCount,
+                                    verlet.GetParticlesCapacity());
+    if (emittedCount > 0)
+    {
+        verlet.AddParticles(emittedCount);
+        if (isUpdatingSPH)
+        {
+            sph.AddParticles(emittedCount);
+        }
+        if (isUpdatingMultiRate)
+        {
+            multiRate.AddParticles(emittedCount, deltaT);
+        }
+        if (isUpdatingSleeping)
+        {
+            sleeping.AddParticles(emittedCount);
+        }
+    }
+
+    PROFILE_END("Particles life");
+}
+
+void PhysicsParticle::SimulateAwake()
+{
+    assert( ! m_Pimpl->m_Pipeline.m_SPHAndIntegrateOnGPU && 
+            ! m_Pimpl->m_Pipeline.m_AcceleratorOnGPU &&
+            ! m_Pimpl->m_Pipeline.m_CollisionOnGPU && "Sleeping needs the CPU solver !");
+    assert( ! m_ContinuousIntegration);
+
+    PROFILE_BEGIN();
+
+    VerletIntegration& verlet = m_Pimpl->m_VerletIntegration;
+    ParticlesSleeping& sleeping = m_Pimpl->m_ParticlesSleeping;
+
+    if (sleeping.GetParticlesCount() != verlet.GetParticlesCount())
+    {
+        sleeping.Initialize(verlet.GetParticlesCount());
+    }
+
+    WakeUpOnColliderMotion();
+
+    // Nothing moves
+    if (sleeping.GetAwakeCount() == 0)
+    {
+        PROFILE_END("Physics simulation awake");
+        SetProfilerCounters(0, false);
+        return;
+    }
+
+    // Sleeping particles are still neighbors of the awake ones
+    if (m_IsUsingGrid3D)
+    {
+        m_Pimpl->m_Grid3D.Initialize(verlet.GetParticlePositions(), verlet.GetParticlesCount());
+    }
+
+    int activeCount = sleeping.Update(  verlet.GetParticlePositions(), 
+                                        verlet.GetParticlePreviousPositions(),
+                                        verlet.GetDeltaT(),
+                                        m_IsUsingGrid3D ? &m_Pimpl->m_Grid3D : NULL);
+
+    SimulateActive(sleeping.GetActiveIndices(), activeCount);
+
+    PROFILE_END("Physics simulation awake");
+}
+
+void PhysicsParticle::WakeUpAccelerator(const vrAccelerator& accelerator)
+{
+    if ( ! m_Pimpl->m_IsUsingSleeping || m_Pimpl->m_ParticlesSleeping.GetParticlesCount() == 0)
+        return;
+
+    // A simple force is applied everywhere
+    if (accelerator.m_Type == vrAccelerator::SIMPLE_FORCE)
+    {
+        m_Pimpl->m_ParticlesSleeping.WakeUpAll();
+    }
+    else
+    {
+        m_Pimpl->m_ParticlesSleeping.WakeUpInSphere(m_Pimpl->m_VerletIntegration.GetParticlePositions(), 
+                                                    slmath::vec3(accelerator.m_Position.x, accelerator.m_Position.y, accelerator.m_Position.z),
+                                                    accelerator.m_Radius);
+    }
+}
+
+template <typename Shape>
+static bool HasShapesChanged(const std::vector<Shape> &previousShapes, const Shape *shapes, int shapesCount)
+{
+    return  previousShapes.size() != static_cast<size_t>(shapesCount) ||
+            (shapesCount > 0 && memcmp(&previousShapes[0], shapes, sizeof(Shape) * shapesCount) != 0);
+}
+
+void PhysicsParticle::WakeUpOnColliderMotion()
+{
+    const ParticlesCollider& collider = m_Pimpl->m_ParticlesCollider;
+    ParticlesSleeping& sleeping = m_Pimpl->m_ParticlesSleeping;
+    const slmath::vec4 *positions = m_Pimpl->m_VerletIntegration.GetParticlePositions();
+
+    const Aabb *insideAabbs = collider.GetInsideAabbs();
+    const int insideAabbsCount = collider.GetInsideAabbsCount();
+    const Sphere *insideSpheres = collider.GetInsideSpheres();
+    const int insideSpheresCount = collider.GetInsideSpheresCount();
+    const Sphere *outsideSpheres = collider.GetOutsideSpheres();
+    const int outsideSpheresCount = collider.GetOutsideSpheresCount();
+
+    // A moving container can push any particle
+    if (HasShapesChanged(m_Pimpl->m_PreviousInsideAabbs, insideAabbs, insideAabbsCount) ||
+        HasShapesChanged(m_Pimpl->m_PreviousInsideSpheres, insideSpheres, insideSpheresCount) ||
+        m_Pimpl->m_PreviousOutsideSpheres.size() != static_cast<size_t>(outsideSpheresCount))
+    {
+        sleeping.WakeUpAll();
+    }
+    // An obstacle only wakes up the particles around its previous and new positions
+    else
+    {
+        for (int i = 0; i < outsideSpheresCount; i++)
+        {
+            const Sphere &previousSphere = m_Pimpl->m_PreviousOutsideSpheres[i];
+            if (memcmp(&previousSphere, &outsideSpheres[i], sizeof(Sphere)) != 0)
+            {
+                const float margin = 1.0f;
+                sleeping.WakeUpInSphere(positions, previousSphere.m_Position, previousSphere.m_Radius + margin);
+                sleeping.WakeUpInSphere(positions, outsideSpheres[i].m_Position, outsideSpheres[i].m_Radius + margin);
+            }
+        }
+    }
+
+    m_Pimpl->m_PreviousInsideAabbs.assign(insideAabbs, insideAabbs + insideAabbsCount);
+    m_Pimpl->m_PreviousInsideSpheres.assign(insideSpheres, insideSpheres + insideSpheresCount);
+    m_Pimpl->m_PreviousOutsideSpheres.assign(outsideSpheres, outsideSpheres + outsideSpheresCount);
 }
 
 
@@ -527,6 +1176,12 @@ vrAabb* PhysicsParticle::GetInsideAabbs()
     return reinterpret_cast<vrAabb*>(m_Pimpl->m_ParticlesCollider.GetInsideAabbs());
 }
 
+const vrAabb* PhysicsParticle::GetInsideAabbs() const
+{
+    const ParticlesCollider& collider = m_Pimpl->m_ParticlesCollider;
+    return reinterpret_cast<const vrAabb*>(collider.GetInsideAabbs());
+}
+
 int PhysicsParticle::GetInsideAabbsCount() const
 {
     return m_Pimpl->m_ParticlesCollider.GetInsideAabbsCount();
@@ -542,6 +1197,12 @@ vrSphere* PhysicsParticle::GetOutsideSpheres()
     return reinterpret_cast<vrSphere*>(m_Pimpl->m_ParticlesCollider.GetOutsideSpheres());
 }
 
+const vrSphere* PhysicsParticle::GetOutsideSpheres() const
+{
+    const ParticlesCollider& collider = m_Pimpl->m_ParticlesCollider;
+    return reinterpret_cast<const vrSphere*>(collider.GetOutsideSpheres());
+}
+
 int PhysicsParticle::GetOutsideSpheresCount() const
 {
     return m_Pimpl->m_ParticlesCollider.GetOutsideSpheresCount();
@@ -557,11 +1218,22 @@ vrSphere* PhysicsParticle::GetInsideSpheres()
     return reinterpret_cast<vrSphere*>(m_Pimpl->m_ParticlesCollider.GetInsideSpheres());
 }
 
+const vrSphere* PhysicsParticle::GetInsideSpheres() const
+{
+    const ParticlesCollider& collider = m_Pimpl->m_ParticlesCollider;
+    return reinterpret_cast<const vrSphere*>(collider.GetInsideSpheres());
+}
+
 int PhysicsParticle::GetInsideSpheresCount() const
 {
     return m_Pimpl->m_ParticlesCollider.GetInsideSpheresCount();
 }
 
+void PhysicsParticle::IncrementShapesGeneration()
+{
+    m_Pimpl->m_ParticlesCollider.IncrementGeneration();
+}
+
 // Spring
 void PhysicsParticle::AddSpring(const vrSpring& spring)
 {
@@ -572,19 +1244,65 @@ void PhysicsParticle::AddSpring(const vrSpring& spring)
 void PhysicsParticle::AddAccelerator(const vrAccelerator & accelerator)
 {
     m_Pimpl->m_ParticlesAccelerator.AddAccelerator(*reinterpret_cast<const Accelerator*>(&accelerator));
+    WakeUpAccelerator(accelerator);
 }
 
 void PhysicsParticle::ClearAccelerators()
 {
     m_Pimpl->m_ParticlesAccelerator.ClearAccelerators();
+    WakeUpParticles();
 }
 
 void PhysicsParticle::UpdateAccelerator(int index, const vrAccelerator& accelerator)
 {
     assert(accelerator.m_Type < vrAccelerator::ACCELRATOR_TYPES_COUNT);
+    assert(index >= 0 && index < m_Pimpl->m_ParticlesAccelerator.GetAcceleratorsCount());
+    const vrAccelerator& previousAccelerator = reinterpret_cast<const vrAccelerator*>(m_Pimpl->m_ParticlesAccelerator.GetAccelerators())[index];
+    if (memcmp(&previousAccelerator, &accelerator, sizeof(vrAccelerator)) != 0)
+    {
+        WakeUpAccelerator(previousAccelerator);
+        WakeUpAccelerator(accelerator);
+    }
     m_Pimpl->m_ParticlesAccelerator.UpdateAccelerator(index, *reinterpret_cast<const Accelerator*>(&accelerator));
 }
 
+// Emitters
+void PhysicsParticle::SetParticlesCapacity(int particlesCapacity)
+{
+    assert(particlesCapacity > 0);
+    m_Pimpl->m_ParticlesCapacity = particlesCapacity;
+}
+
+int PhysicsParticle::GetParticlesCapacity() const
+{
+    return m_Pimpl->m_VerletIntegration.GetParticlesCapacity();
+}
+
+void PhysicsParticle::AddEmitter(const vrEmitter& emitter)
+{
+    m_Pimpl->m_ParticlesEmitter.AddEmitter(*reinterpret_cast<const Emitter*>(&emitter));
+}
+
+void PhysicsParticle::UpdateEmitter(int index, const vrEmitter& emitter)
+{
+    m_Pimpl->m_ParticlesEmitter.UpdateEmitter(index, *reinterpret_cast<const Emitter*>(&emitter));
+}
+
+void PhysicsParticle::ClearEmitters()
+{
+    m_Pimpl->m_ParticlesEmitter.ClearEmitters();
+}
+
+void PhysicsParticle::AddKiller(const vrAabb& aabb)
+{
+    m_Pimpl->m_ParticlesEmitter.AddKiller(*reinterpret_cast<const Aabb*>(&aabb));
+}
+
+void PhysicsParticle::ClearKillers()
+{
+    m_Pimpl->m_ParticlesEmitter.ClearKillers();
+}
+
 void PhysicsParticle::SetEnableGridOnGPU(bool isCreatingGridOnGPU)
 {
     m_Pimpl->m_Pipeline.m_IsCreatingGridOnGPU = isCreatingGridOnGPU;
@@ -615,26 +1333,461 @@ void PhysicsParticle::SetEnableAnimation(bool enableAnimation)
     m_Pimpl->m_Pipeline.m_IsUsingAnimation = enableAnimation;
 }
 
+void PhysicsParticle::SetEnableHalfPreviousPositions(bool isUsingHalfPreviousPositions)
+{
+    m_Pimpl->m_Pipeline.m_IsUsingHalfPreviousPositions = isUsingHalfPreviousPositions;
+}
+
+void PhysicsParticle::SetEnableDeterminism(bool isDeterministic)
+{
+    m_Pimpl->m_Pipeline.m_IsDeterministic = isDeterministic;
+}
+
 void PhysicsParticle::SetClothCount(int clothCount)
 {
-    m_Pimpl->m_ParticlesGPU.SetClothCount(clothCount);
+    m_Pimpl->m_ClothCount = clothCount;
+    m_Pimpl->m_Backend->SetClothCount(clothCount);
 }
 void PhysicsParticle::SetAnimationTime(float animationTime)
 {
-    m_Pimpl->m_ParticlesGPU.SetAnimationTime(animationTime);
+    m_Pimpl->m_Backend->SetAnimationTime(animationTime);
 }
 
 void PhysicsParticle::SetIsUsingInteroperability(bool isUsingInteroperability)
 {
+#ifndef PARTICLES_GPU_DISABLED
     m_Pimpl->m_ParticlesGPU.SetIsUsingInteroperability(isUsingInteroperability);
+#else // PARTICLES_GPU_DISABLED
+    assert( ! isUsingInteroperability && "PhysicsParticle::SetIsUsingInteroperability failed.");
+#endif // PARTICLES_GPU_DISABLED
 }
 
 bool PhysicsParticle::IsUsingInteroperability() const
 {
-    return m_Pimpl->m_ParticlesGPU.IsUsingInteroperability();
+    return m_Pimpl->m_Backend->IsUsingInteroperability();
+}
+
+void PhysicsParticle::SetEnableReadBack(bool isReadingBack)
+{
+    m_Pimpl->m_IsReadingBack = isReadingBack;
+}
+
+void PhysicsParticle::ReadBack()
+{
+    int status = m_Pimpl->m_Backend->Synchronize(true);
+    UNUSED_PARAMETER(status);
+    assert(status == 0);
 }
 
 void PhysicsParticle::SetIsUsingCPU(bool isUsingCPU)
 {
+#ifndef PARTICLES_GPU_DISABLED
     m_Pimpl->m_ParticlesGPU.SetIsUsingCPU(isUsingCPU);
+    m_Pimpl->m_ParticlesMultiGPU.SetIsUsingCPU(isUsingCPU);
+#else // PARTICLES_GPU_DISABLED
+    UNUSED_PARAMETER(isUsingCPU);
+#endif // PARTICLES_GPU_DISABLED
+}
+
+void PhysicsParticle::SetDeviceIndex(int deviceIndex)
+{
+#ifndef PARTICLES_GPU_DISABLED
+    m_Pimpl->m_ParticlesGPU.SetDeviceIndex(deviceIndex);
+#else // PARTICLES_GPU_DISABLED
+    UNUSED_PARAMETER(deviceIndex);
+#endif // PARTICLES_GPU_DISABLED
+}
+
+void PhysicsParticle::SetMultiDeviceSlabsCount(int slabsCount)
+{
+#ifndef PARTICLES_GPU_DISABLED
+    assert( ! (slabsCount != 1 && m_Pimpl->m_ParticlesGPU.IsUsingInteroperability()));
+    if (slabsCount == 1)
+    {
+        m_Pimpl->m_Backend = &m_Pimpl->m_ParticlesGPU;
+    }
+    else
+    {
+        m_Pimpl->m_ParticlesMultiGPU.SetSlabsCount(slabsCount);
+        m_Pimpl->m_Backend = &m_Pimpl->m_ParticlesMultiGPU;
+    }
+#else // PARTICLES_GPU_DISABLED
+    assert(slabsCount == 1 && "PhysicsParticle::SetMultiDeviceSlabsCount failed.");
+    UNUSED_PARAMETER(slabsCount);
+#endif // PARTICLES_GPU_DISABLED
+}
+
+void PhysicsParticle::SetEnableKernelSpecialization(bool isSpecializingKernels)
+{
+#ifndef PARTICLES_GPU_DISABLED
+    m_Pimpl->m_ParticlesGPU.SetIsSpecializingKernels(isSpecializingKernels);
+    m_Pimpl->m_ParticlesMultiGPU.SetIsSpecializingKernels(isSpecializingKernels);
+#else // PARTICLES_GPU_DISABLED
+    UNUSED_PARAMETER(isSpecializingKernels);
+#endif // PARTICLES_GPU_DISABLED
+}
+
+void PhysicsParticle::SetEnableQueueProfiling(bool isProfilingQueue)
+{
+#ifndef PARTICLES_GPU_DISABLED
+    m_Pimpl->m_ParticlesGPU.SetIsProfilingCommands(isProfilingQueue);
+    m_Pimpl->m_ParticlesMultiGPU.SetIsProfilingCommands(isProfilingQueue);
+#else // PARTICLES_GPU_DISABLED
+    UNUSED_PARAMETER(isProfilingQueue);
+#endif // PARTICLES_GPU_DISABLED
+}
+
+void PhysicsParticle::SetIsUsingNativeBackend(bool isUsingNativeBackend)
+{
+#ifndef PARTICLES_GPU_DISABLED
+    assert( ! (isUsingNativeBackend && m_Pimpl->m_ParticlesGPU.IsUsingInteroperability()));
+    if (isUsingNativeBackend)
+    {
+        m_Pimpl->m_Backend = &m_Pimpl->m_ParticlesCPU;
+    }
+    else
+    {
+        m_Pimpl->m_Backend = &m_Pimpl->m_ParticlesGPU;
+    }
+#else // PARTICLES_GPU_DISABLED
+    // The native backend is the only one
+    assert(isUsingNativeBackend && "PhysicsParticle::SetIsUsingNativeBackend failed.");
+    UNUSED_PARAMETER(isUsingNativeBackend);
+#endif // PARTICLES_GPU_DISABLED
+}
+
+void PhysicsParticle::SetEnableThreadPinning(bool isPinningThreads)
+{
+    m_Pimpl->m_ParticlesCPU.SetIsPinningThreads(isPinningThreads);
+}
+
+bool PhysicsParticle::IsUsingNativeBackend() const
+{
+    return m_Pimpl->m_Backend == &m_Pimpl->m_ParticlesCPU;
+}
+
+void PhysicsParticle::SetEnableSolverOnCPU(bool isSolvingOnCPU)
+{
+    // GPU stages have the priority in Simulate
+    m_IsUsingGrid3D         = isSolvingOnCPU;
+    m_SPHSimulation         = isSolvingOnCPU;
+    m_IsUsingAccelerator    = isSolvingOnCPU;
+    m_IsIntegrating         = isSolvingOnCPU;
+    m_IsSolvingSpring       = isSolvingOnCPU;
+    m_IsColliding           = isSolvingOnCPU;
+}
+
+void PhysicsParticle::SetEnableMultiRate(bool isUsingMultiRate)
+{
+    m_Pimpl->m_IsUsingMultiRate = isUsingMultiRate;
+    if (isUsingMultiRate && m_Pimpl->m_VerletIntegration.GetParticlesCount() > 0)
+    {
+        // Forces the per particle steps to restart from the current step
+        m_Pimpl->m_MultiRateStepping.Initialize(    m_Pimpl->m_VerletIntegration.GetParticlesCount(),
+                                                    m_Pimpl->m_VerletIntegration.GetDeltaT());
+    }
+}
+
+bool PhysicsParticle::IsUsingMultiRate() const
+{
+    return m_Pimpl->m_IsUsingMultiRate;
+}
+
+void PhysicsParticle::SetMultiRateLevelsCount(int levelsCount)
+{
+    m_Pimpl->m_MultiRateStepping.SetLevelsCount(levelsCount);
+}
+
+void PhysicsParticle::SetEnableSleeping(bool isUsingSleeping)
+{
+    m_Pimpl->m_IsUsingSleeping = isUsingSleeping;
+    if (isUsingSleeping && m_Pimpl->m_VerletIntegration.GetParticlesCount() > 0)
+    {
+        m_Pimpl->m_ParticlesSleeping.Initialize(m_Pimpl->m_VerletIntegration.GetParticlesCount());
+    }
+}
+
+bool PhysicsParticle::IsUsingSleeping() const
+{
+    return m_Pimpl->m_IsUsingSleeping;
+}
+
+void PhysicsParticle::SetSleepingThresholds(float speed, float acceleration)
+{
+    m_Pimpl->m_ParticlesSleeping.SetThresholds(speed, acceleration);
+}
+
+void PhysicsParticle::SetStepsBeforeSleeping(int stepsCount)
+{
+    m_Pimpl->m_ParticlesSleeping.SetStepsBeforeSleeping(stepsCount);
+}
+
+int PhysicsParticle::GetAwakeParticlesCount() const
+{
+    if ( ! m_Pimpl->m_IsUsingSleeping)
+    {
+        return m_Pimpl->m_VerletIntegration.GetParticlesCount();
+    }
+    return m_Pimpl->m_ParticlesSleeping.GetAwakeCount();
+}
+
+void PhysicsParticle::WakeUpParticles()
+{
+    if (m_Pimpl->m_IsUsingSleeping)
+    {
+        m_Pimpl->m_ParticlesSleeping.WakeUpAll();
+    }
+}
+
+vrMemoryUsage PhysicsParticle::GetMemoryUsage() const
+{
+    const MemoryArena& memoryArena = m_Pimpl->m_MemoryArena;
+
+    vrMemoryUsage memoryUsage;
+    memoryUsage.m_ReservedSize          = memoryArena.GetReservedSize();
+    memoryUsage.m_UsedSize              = memoryArena.GetUsedSize();
+    memoryUsage.m_ScratchPeakSize       = memoryArena.GetScratchPeakSize();
+    memoryUsage.m_HeapFallbacksCount    = memoryArena.GetHeapAllocationsCount();
+    memoryUsage.m_IsUsingLargePages     = memoryArena.IsUsingLargePages();
+
+    // The native backend arrays are in the arena of the backend
+    if (IsUsingNativeBackend())
+    {
+        const MemoryArena& backendArena = m_Pimpl->m_ParticlesCPU.GetMemoryArena();
+        memoryUsage.m_ReservedSize          += backendArena.GetReservedSize();
+        memoryUsage.m_UsedSize              += backendArena.GetUsedSize();
+        memoryUsage.m_HeapFallbacksCount    += backendArena.GetHeapAllocationsCount();
+        memoryUsage.m_IsUsingLargePages     = memoryUsage.m_IsUsingLargePages && backendArena.IsUsingLargePages();
+    }
+    return memoryUsage;
+}
+
+void PhysicsParticle::SetEnableAdaptiveTimeStep(bool isUsingAdaptiveTimeStep)
+{
+    m_Pimpl->m_IsUsingAdaptiveTimeStep = isUsingAdaptiveTimeStep;
+    if ( ! isUsingAdaptiveTimeStep)
+    {
+        // Back to the fixed step, twice to forget the previous one
+        SetDeltaT(1.0f / 60.0f);
+        SetDeltaT(1.0f / 60.0f);
+    }
+}
+
+bool PhysicsParticle::IsUsingAdaptiveTimeStep() const
+{
+    return m_Pimpl->m_IsUsingAdaptiveTimeStep;
+}
+
+void PhysicsParticle::SetTimeStepLimits(float minDeltaT, float maxDeltaT)
+{
+    m_Pimpl->m_AdaptiveTimeStep.SetDeltaTLimits(minDeltaT, maxDeltaT);
+}
+
+void PhysicsParticle::SetCourantFactor(float courantFactor)
+{
+    m_Pimpl->m_AdaptiveTimeStep.SetCourantFactor(courantFactor);
+}
+
+void PhysicsParticle::SetMaxSubStepsCount(int maxSubStepsCount)
+{
+    m_Pimpl->m_AdaptiveTimeStep.SetMaxSubStepsCount(maxSubStepsCount);
+}
+
+void PhysicsParticle::SetTimeStepLengthScale(float lengthScale)
+{
+    m_Pimpl->m_AdaptiveTimeStep.SetLengthScale(lengthScale);
+}
+
+int PhysicsParticle::GetSubStepsCount() const
+{
+    return m_Pimpl->m_SubStepsCount;
+}
+
+bool PhysicsParticle::SaveCheckpoint(const char *fileName)
+{
+    assert(GetParticlesCount() > 0 && "Initialize must be called first.");
+    assert( ! m_Pimpl->m_Backend->IsUsingInteroperability() && "Checkpoints need the particles on the host.");
+
+    // Their per particle states aren't in the file, a restart would start them again
+    if (m_Pimpl->m_SmoothedParticleHydrodynamics.GetPhasesCount() > 1 || m_Pimpl->m_ParticlesEmitter.IsActive() ||
+        m_Pimpl->m_IsUsingSleeping || m_Pimpl->m_IsUsingMultiRate)
+        return false;
+
+    PROFILE_BEGIN();
+
+    // Host copies of the last step, the densities are only read back for a checkpoint
+    m_Pimpl->m_Backend->ReadBackDensities();
+    ReadBack();
+
+    const PipelineDescription& pipeline = m_Pimpl->m_Pipeline;
+    const VerletIntegration& verlet = m_Pimpl->m_VerletIntegration;
+    const SmoothedParticleHydrodynamics& sph = m_Pimpl->m_SmoothedParticleHydrodynamics;
+    const ParticlesSpring& springs = m_Pimpl->m_ParticlesSpring;
+    const ParticlesAccelerator& accelerators = m_Pimpl->m_ParticlesAccelerator;
+    const ParticlesCollider& collider = m_Pimpl->m_ParticlesCollider;
+
+    unsigned int flags = 0;
+    SetFlag(flags, SimulationCheckpoint::eGridOnGPU,              pipeline.m_IsCreatingGridOnGPU);
+    SetFlag(flags, SimulationCheckpoint::eSPHAndIntegrateOnGPU,   pipeline.m_SPHAndIntegrateOnGPU);
+    SetFlag(flags, SimulationCheckpoint::eCollisionOnGPU,         pipeline.m_CollisionOnGPU);
+    SetFlag(flags, SimulationCheckpoint::eSpringOnGPU,            pipeline.m_SpringOnGPU);
+    SetFlag(flags, SimulationCheckpoint::eAcceleratorOnGPU,       pipeline.m_AcceleratorOnGPU);
+    SetFlag(flags, SimulationCheckpoint::eAnimation,              pipeline.m_IsUsingAnimation);
+    SetFlag(flags, SimulationCheckpoint::eHalfPreviousPositions,  pipeline.m_IsUsingHalfPreviousPositions);
+    SetFlag(flags, SimulationCheckpoint::eDeterministic,          pipeline.m_IsDeterministic);
+    SetFlag(flags, SimulationCheckpoint::eGrid3D,                 m_IsUsingGrid3D);
+    SetFlag(flags, SimulationCheckpoint::eSPHSimulation,          m_SPHSimulation);
+    SetFlag(flags, SimulationCheckpoint::eContinuousIntegration,  m_ContinuousIntegration);
+    SetFlag(flags, SimulationCheckpoint::eAccelerator,            m_IsUsingAccelerator);
+    SetFlag(flags, SimulationCheckpoint::eIntegrating,            m_IsIntegrating);
+    SetFlag(flags, SimulationCheckpoint::eSolvingSpring,          m_IsSolvingSpring);
+    SetFlag(flags, SimulationCheckpoint::eColliding,              m_IsColliding);
+    SetFlag(flags, SimulationCheckpoint::eAdaptiveTimeStep,       m_Pimpl->m_IsUsingAdaptiveTimeStep);
+    SetFlag(flags, SimulationCheckpoint::eMultiRate,              m_Pimpl->m_IsUsingMultiRate);
+    SetFlag(flags, SimulationCheckpoint::eSleeping,               m_Pimpl->m_IsUsingSleeping);
+
+    CheckpointHeader header;
+    memset(header.m_Sections, 0, sizeof(header.m_Sections));
+    header.m_Flags              = flags;
+    header.m_ParticlesCount     = verlet.GetParticlesCount();
+    header.m_ParticlesCapacity  = verlet.GetParticlesCapacity();
+    header.m_Damping            = verlet.GetDamping();
+    header.m_DeltaT             = verlet.GetDeltaT();
+    header.m_PreviousDeltaT     = verlet.GetPreviousDeltaT();
+    header.m_ClothCount         = m_Pimpl->m_ClothCount;
+    header.m_CommonAcceleration = verlet.GetCommonAcceleration();
+    header.m_SphParameters      = sph.GetParameters();
+
+    // Densities only exist with SPH
+    const size_t particlesCount = header.m_ParticlesCount;
+    const bool hasDensities = sph.GetParticlesCount() == header.m_ParticlesCount && sph.GetDensity() != NULL;
+    CheckpointSection *sections = header.m_Sections;
+    sections[SimulationCheckpoint::ePositions].m_Size           = particlesCount * sizeof(slmath::vec4);
+    sections[SimulationCheckpoint::ePreviousPositions].m_Size   = particlesCount * sizeof(slmath::vec4);
+    sections[SimulationCheckpoint::eDensities].m_Size           = hasDensities ? particlesCount * sizeof(float) : 0;
+    sections[SimulationCheckpoint::ePreviousDensities].m_Size   = hasDensities ? particlesCount * sizeof(float) : 0;
+    sections[SimulationCheckpoint::eSprings].m_Size             = springs.GetSpringsCount() * sizeof(Spring);
+    sections[SimulationCheckpoint::eInsideAabbs].m_Size         = collider.GetInsideAabbsCount() * sizeof(Aabb);
+    sections[SimulationCheckpoint::eOutsideAabbs].m_Size        = collider.GetOutsideAabbsCount() * sizeof(Aabb);
+    sections[SimulationCheckpoint::eInsideSpheres].m_Size       = collider.GetInsideSpheresCount() * sizeof(Sphere);
+    sections[SimulationCheckpoint::eOutsideSpheres].m_Size      = collider.GetOutsideSpheresCount() * sizeof(Sphere);
+    sections[SimulationCheckpoint::eAccelerators].m_Size        = accelerators.GetAcceleratorsCount() * sizeof(Accelerator);
+
+    char *image = m_Pimpl->m_CheckpointWriter.BeginWrite(SimulationCheckpoint::Layout(header));
+    SimulationCheckpoint::WriteHeader(image, header);
+    SimulationCheckpoint::WriteSection(image, header, SimulationCheckpoint::ePositions,         verlet.GetParticlePositions());
+    SimulationCheckpoint::WriteSection(image, header, SimulationCheckpoint::ePreviousPositions, verlet.GetParticlePreviousPositions());
+    SimulationCheckpoint::WriteSection(image, header, SimulationCheckpoint::eDensities,         sph.GetDensity());
+    SimulationCheckpoint::WriteSection(image, header, SimulationCheckpoint::ePreviousDensities, sph.GetPreviousDensity());
+    SimulationCheckpoint::WriteSection(image, header, SimulationCheckpoint::eSprings,           springs.GetSprings());
+    SimulationCheckpoint::WriteSection(image, header, SimulationCheckpoint::eInsideAabbs,       collider.GetInsideAabbs());
+    SimulationCheckpoint::WriteSection(image, header, SimulationCheckpoint::eOutsideAabbs,      collider.GetOutsideAabbs());
+    SimulationCheckpoint::WriteSection(image, header, SimulationCheckpoint::eInsideSpheres,     collider.GetInsideSpheres());
+    SimulationCheckpoint::WriteSection(image, header, SimulationCheckpoint::eOutsideSpheres,    collider.GetOutsideSpheres());
+    SimulationCheckpoint::WriteSection(image, header, SimulationCheckpoint::eAccelerators,      accelerators.GetAccelerators());
+    const bool isWriting = m_Pimpl->m_CheckpointWriter.EndWrite(fileName);
+
+    PROFILE_END("Save checkpoint");
+    return isWriting;
+}
+
+bool PhysicsParticle::WaitForCheckpoint()
+{
+    return m_Pimpl->m_CheckpointWriter.Wait();
+}
+
+bool PhysicsParticle::LoadCheckpoint(const char *fileName)
+{
+    assert(GetParticlesCount() == 0 && "LoadCheckpoint must be called in place of Initialize.");
+
+    SimulationCheckpoint checkpoint;
+    if ( ! checkpoint.Open(fileName))
+        return false;
+
+    PROFILE_BEGIN();
+
+    const CheckpointHeader& header = checkpoint.GetHeader();
+    const unsigned int flags = header.m_Flags;
+    PipelineDescription& pipeline = m_Pimpl->m_Pipeline;
+    pipeline.m_IsCreatingGridOnGPU          = HasFlag(flags, SimulationCheckpoint::eGridOnGPU);
+    pipeline.m_SPHAndIntegrateOnGPU         = HasFlag(flags, SimulationCheckpoint::eSPHAndIntegrateOnGPU);
+    pipeline.m_CollisionOnGPU               = HasFlag(flags, SimulationCheckpoint::eCollisionOnGPU);
+    pipeline.m_SpringOnGPU                  = HasFlag(flags, SimulationCheckpoint::eSpringOnGPU);
+    pipeline.m_AcceleratorOnGPU             = HasFlag(flags, SimulationCheckpoint::eAcceleratorOnGPU);
+    pipeline.m_IsUsingAnimation             = HasFlag(flags, SimulationCheckpoint::eAnimation);
+    pipeline.m_IsUsingHalfPreviousPositions = HasFlag(flags, SimulationCheckpoint::eHalfPreviousPositions);
+    pipeline.m_IsDeterministic              = HasFlag(flags, SimulationCheckpoint::eDeterministic);
+    m_IsUsingGrid3D                         = HasFlag(flags, SimulationCheckpoint::eGrid3D);
+    m_SPHSimulation                         = HasFlag(flags, SimulationCheckpoint::eSPHSimulation);
+    m_ContinuousIntegration                 = HasFlag(flags, SimulationCheckpoint::eContinuousIntegration);
+    m_IsUsingAccelerator                    = HasFlag(flags, SimulationCheckpoint::eAccelerator);
+    m_IsIntegrating                         = HasFlag(flags, SimulationCheckpoint::eIntegrating);
+    m_IsSolvingSpring                       = HasFlag(flags, SimulationCheckpoint::eSolvingSpring);
+    m_IsColliding                           = HasFlag(flags, SimulationCheckpoint::eColliding);
+    m_Pimpl->m_IsUsingAdaptiveTimeStep      = HasFlag(flags, SimulationCheckpoint::eAdaptiveTimeStep);
+    m_Pimpl->m_IsUsingMultiRate             = HasFlag(flags, SimulationCheckpoint::eMultiRate);
+    m_Pimpl->m_IsUsingSleeping              = HasFlag(flags, SimulationCheckpoint::eSleeping);
+
+    int count = 0;
+    const Spring *springs = checkpoint.GetSection<Spring>(SimulationCheckpoint::eSprings, count);
+    for (int i = 0; i < count; i++)
+    {
+        m_Pimpl->m_ParticlesSpring.AddSpring(springs[i]);
+    }
+    const Aabb *insideAabbs = checkpoint.GetSection<Aabb>(SimulationCheckpoint::eInsideAabbs, count);
+    for (int i = 0; i < count; i++)
+    {
+        m_Pimpl->m_ParticlesCollider.AddInsideAabb(insideAabbs[i]);
+    }
+    const Aabb *outsideAabbs = checkpoint.GetSection<Aabb>(SimulationCheckpoint::eOutsideAabbs, count);
+    for (int i = 0; i < count; i++)
+    {
+        m_Pimpl->m_ParticlesCollider.AddOutsideAabb(outsideAabbs[i]);
+    }
+    const Sphere *insideSpheres = checkpoint.GetSection<Sphere>(SimulationCheckpoint::eInsideSpheres, count);
+    for (int i = 0; i < count; i++)
+    {
+        m_Pimpl->m_ParticlesCollider.AddInsideSphere(insideSpheres[i]);
+    }
+    const Sphere *outsideSpheres = checkpoint.GetSection<Sphere>(SimulationCheckpoint::eOutsideSpheres, count);
+    for (int i = 0; i < count; i++)
+    {
+        m_Pimpl->m_ParticlesCollider.AddOutsideSphere(outsideSpheres[i]);
+    }
+    const Accelerator *accelerators = checkpoint.GetSection<Accelerator>(SimulationCheckpoint::eAccelerators, count);
+    for (int i = 0; i < count; i++)
+    {
+        m_Pimpl->m_ParticlesAccelerator.AddAccelerator(accelerators[i]);
+    }
+
+    // Steps before Initialize, twice for the previous one which corrects the Verlet velocity
+    m_Pimpl->m_VerletIntegration.SetDamping(header.m_Damping);
+    m_Pimpl->m_VerletIntegration.SetCommonAcceleration(header.m_CommonAcceleration);
+    SetDeltaT(header.m_PreviousDeltaT);
+    SetDeltaT(header.m_DeltaT);
+    m_Pimpl->m_SmoothedParticleHydrodynamics.SetParameters(header.m_SphParameters);
+    SetClothCount(header.m_ClothCount);
+
+    // Positions are read from the mapping, then the rest of the state replaces the initial one
+    SetParticlesCapacity(header.m_ParticlesCapacity);
+    const slmath::vec4 *positions = checkpoint.GetSection<slmath::vec4>(SimulationCheckpoint::ePositions, count);
+    Initialize(reinterpret_cast<vrVec4*>(const_cast<slmath::vec4*>(positions)), count);
+
+    const slmath::vec4 *previousPositions = checkpoint.GetSection<slmath::vec4>(SimulationCheckpoint::ePreviousPositions, count);
+    memcpy(m_Pimpl->m_VerletIntegration.GetParticlePreviousPositions(), previousPositions, count * sizeof(slmath::vec4));
+
+    SmoothedParticleHydrodynamics& sph = m_Pimpl->m_SmoothedParticleHydrodynamics;
+    const float *densities = checkpoint.GetSection<float>(SimulationCheckpoint::eDensities, count);
+    if (count == header.m_ParticlesCount && sph.GetParticlesCount() == count)
+    {
+        memcpy(sph.GetDensity(), densities, count * sizeof(float));
+    }
+    const float *previousDensities = checkpoint.GetSection<float>(SimulationCheckpoint::ePreviousDensities, count);
+    if (count == header.m_ParticlesCount && sph.GetParticlesCount() == count)
+    {
+        memcpy(sph.GetPreviousDensity(), previousDensities, count * sizeof(float));
+    }
+
+    PROFILE_END("Load checkpoint");
+    return true;
 }
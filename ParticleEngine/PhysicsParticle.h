@@ -15,6 +15,7 @@
     #define MYPROJECT_API 
 #endif
 
+#include <cstddef>
 
 struct ID3D11Device;
 struct ID3D11Buffer;
@@ -56,6 +57,23 @@ struct MYPROJECT_API vrSpring
     vrSpring():m_Pad(0) {}
 };
 
+// A particle emitter, particles are spawned in the sphere with the velocity.
+// The w of the position is copied in the particles
+struct MYPROJECT_API vrEmitter
+{
+    vrVec4  m_Position;
+    vrVec4  m_Velocity;
+    float   m_Radius;
+    // Particles by second
+    float   m_Rate;
+    // In seconds, negative for particles which never die
+    float   m_LifeTime;
+    // SPH phase of the particles
+    int     m_Phase;
+
+    vrEmitter():m_Phase(0) {}
+};
+
 // A particle accelerator
 // Type 0 is a force field,
 // Type 1 is a simple force, that uses only the direction vector
@@ -75,6 +93,18 @@ struct MYPROJECT_API vrAccelerator
     unsigned int    m_Type;
 };
 
+// Memory of a simulation, sizes are in bytes
+struct MYPROJECT_API vrMemoryUsage
+{
+    size_t  m_ReservedSize;
+    size_t  m_UsedSize;
+    // Biggest scratch used by a step
+    size_t  m_ScratchPeakSize;
+    // Arrays which didn't fit in the reservation, they came from the heap
+    int     m_HeapFallbacksCount;
+    bool    m_IsUsingLargePages;
+};
+
 
 class MYPROJECT_API PhysicsParticle
 {
@@ -96,6 +126,14 @@ public:
     void SetParticlesAnimation(vrVec4 *endsAnimation);
     void SetDamping(float damping);
 
+    // Multi phase SPH, only available with the CPU solver. The phase 0 uses the
+    // mass and gaz constant setters, returns the phase index
+    int AddFluidPhase(float mass, float gazConstant, float restDensity);
+    // Scales the pressure between two phases, 1 by default
+    void SetPhasesPressureFactor(int phase1, int phase2, float pressureFactor);
+    // Must be called after Initialize
+    void SetParticlesPhase(int firstIndex, int particlesCount, int phase);
+
     // Getters
     float GetParticlesMass() const;
     float GetParticlesGazConstant() const;
@@ -114,6 +152,11 @@ public:
     // Physics step
     void Simulate();
 
+    // Advances the simulation by frameTime, when the adaptive time step is enabled
+    // the frame is cut in as many stable sub steps as needed, when the multi rate
+    // is enabled each particle is integrated with its own power of two step
+    void Simulate(float frameTime);
+
     // Release allocated memory
     void Release();
 
@@ -129,13 +172,18 @@ public:
     void AddOutsideSphere(const vrSphere& sphere);
 
     // Accesor to modify them, the returned ponters could change when 
-    // collision geometries are added
+    // collision geometries are added. Shapes moved through the mutable pointers are
+    // uploaded again after a call to IncrementShapesGeneration
     vrAabb    *GetInsideAabbs();
+    const vrAabb *GetInsideAabbs() const;
     int GetInsideAabbsCount() const;
     vrSphere  *GetOutsideSpheres();
+    const vrSphere *GetOutsideSpheres() const;
     int GetOutsideSpheresCount() const;
     vrSphere  *GetInsideSpheres();
+    const vrSphere *GetInsideSpheres() const;
     int GetInsideSpheresCount() const;
+    void IncrementShapesGeneration();
 
     // Add a constraint between two particles
     void AddSpring(const vrSpring& spring);
@@ -147,6 +195,20 @@ public:
     void ClearAccelerators();
     void UpdateAccelerator(int index, const vrAccelerator& accelerator);
 
+    // Emitters and killers, only available with the CPU solver and without springs:
+    // Simulate asserts that every GPU or native stage is disabled. Particles are added
+    // and removed in the reserved capacity, indices of the particles change when some
+    // die. Dead particles are compacted on the simulating thread
+    // Maximum particles count, must be called before Initialize
+    void SetParticlesCapacity(int particlesCapacity);
+    int GetParticlesCapacity() const;
+    void AddEmitter(const vrEmitter& emitter);
+    void UpdateEmitter(int index, const vrEmitter& emitter);
+    void ClearEmitters();
+    // Particles inside a killer die
+    void AddKiller(const vrAabb& aabb);
+    void ClearKillers();
+
     
     // Physcal parameter
     // Grid and sph
@@ -156,6 +218,16 @@ public:
     void SetEnableSpringOnGPU(bool springOnGPU);
     void SetEnableAcceleratorOnGPU(bool acceleratorOnGPU);
     void SetEnableAnimation(bool enableAnimation);
+    // Previous positions stored on the device as half offsets, for the bandwidth bound
+    // scenes that accept a lower velocity precision. Must be called before InitializeOpenCL
+    void SetEnableHalfPreviousPositions(bool isUsingHalfPreviousPositions);
+    // Bit identical steps whatever the cores, devices and slabs count, the kernels are
+    // built without fused multiply add and the slabs are filled in the particles order.
+    // The native backend is already deterministic, the water scene steps in the same time
+    // (30 ms with or without, within the noise of one run to the next). On the devices it
+    // costs the fused instructions of the SPH and spring kernels and the slabs order, which
+    // isn't measured yet. Must be called before InitializeOpenCL
+    void SetEnableDeterminism(bool isDeterministic);
 
     // Cloth only for springs
     void SetClothCount(int clothCount);
@@ -167,9 +239,95 @@ public:
     void SetIsUsingInteroperability(bool isUsingInteroperability);
     bool IsUsingInteroperability() const;
 
+    // Particles computed on GPU stay on the device, by default they are read back
+    // at the end of each step. Without read back ReadBack must be called before
+    // using the positions
+    void SetEnableReadBack(bool isReadingBack);
+    void ReadBack();
+
     // Running physics on the CPU, GPU is used by default
     void SetIsUsingCPU(bool isUsingCPU);
 
+    // OpenCL device of the context used by the simulation, the first one by default.
+    // Must be called before InitializeOpenCL
+    void SetDeviceIndex(int deviceIndex);
+
+    // Splits the simulation across the devices of the context by slabs along x,
+    // 0 uses one slab by device and 1 goes back to a single device. Interoperability
+    // isn't supported, InitializeOpenCL keeps a single device for springs and animation.
+    // Must be called before InitializeOpenCL
+    void SetMultiDeviceSlabsCount(int slabsCount);
+
+    // SPH kernel compiled for the current SPH parameters, a change of the parameters
+    // compiles a new program once. Disabled by default
+    void SetEnableKernelSpecialization(bool isSpecializingKernels);
+
+    // OpenCL commands timed by their queue, they are added to the profiler trace
+    // while it is started. Must be called before InitializeOpenCL
+    void SetEnableQueueProfiling(bool isProfilingQueue);
+
+    // Running the OpenCL stages with native threads, for the machines without OpenCL.
+    // Must be called before InitializeOpenCL, interoperability isn't supported.
+    // It is the only backend when PARTICLES_GPU_DISABLED compiles the OpenCL ones out
+    void SetIsUsingNativeBackend(bool isUsingNativeBackend);
+    bool IsUsingNativeBackend() const;
+    // Threads of the native backend pinned over the NUMA nodes, a thread keeps the same
+    // range of particles from step to step. Must be called before InitializeOpenCL
+    void SetEnableThreadPinning(bool isPinningThreads);
+
+    // Solves grid, SPH, accelerators, integration, springs and collisions with the
+    // CPU solver, for the stages not enabled on GPU. Must be called before Initialize
+    void SetEnableSolverOnCPU(bool isSolvingOnCPU);
+
+    // Adaptive time step, disabled by default (one step of 1/60s per frame)
+    void SetEnableAdaptiveTimeStep(bool isUsingAdaptiveTimeStep);
+    bool IsUsingAdaptiveTimeStep() const;
+    void SetTimeStepLimits(float minDeltaT, float maxDeltaT);
+    void SetCourantFactor(float courantFactor);
+    void SetMaxSubStepsCount(int maxSubStepsCount);
+    // Distance a particle must not cross in a step when SPH doesn't give its smoothing
+    // length, 1 by default (a grid cell)
+    void SetTimeStepLengthScale(float lengthScale);
+    // Sub steps used by the last call to Simulate(frameTime)
+    int GetSubStepsCount() const;
+
+    // Multi rate time step, only available with the CPU solver.
+    // Particles in calm regions are skipped in SPH, integration and collision
+    void SetEnableMultiRate(bool isUsingMultiRate);
+    bool IsUsingMultiRate() const;
+    // Levels count, the biggest step is 2^(levelsCount - 1) times the smallest one
+    void SetMultiRateLevelsCount(int levelsCount);
+
+    // Sleeping, only available with the CPU solver and ignored by the multi rate.
+    // Resting particles are skipped by every stage, they are woken up by moving
+    // neighbors, accelerators and collision shapes changes
+    void SetEnableSleeping(bool isUsingSleeping);
+    bool IsUsingSleeping() const;
+    void SetSleepingThresholds(float speed, float acceleration);
+    void SetStepsBeforeSleeping(int stepsCount);
+    int GetAwakeParticlesCount() const;
+    void WakeUpParticles();
+
+    // Arrays sized by the particles capacity are allocated by Initialize in a single
+    // reservation, the steps only use its scratch and don't allocate
+    vrMemoryUsage GetMemoryUsage() const;
+
+    // Checkpoints hold the particles, densities, springs, colliders, accelerators, SPH
+    // parameters, cloth count and pipeline flags. The animation isn't saved.
+    // A simulation with several fluid phases, emitters or killers, sleeping or multi rate
+    // steps is refused, its restart would diverge.
+    // The state is copied on the calling thread then written by a background thread, a
+    // new checkpoint waits for the previous one. Returns false when the state is refused or
+    // the file can't be created
+    bool SaveCheckpoint(const char *fileName);
+    // Waits for the last checkpoint, returns false when it couldn't be written
+    bool WaitForCheckpoint();
+    // Restarts from a checkpoint in place of the setup and of Initialize. The file is
+    // mapped, the colliders and springs are added from the mapping and the particle
+    // sections are copied in the arrays of the simulation. InitializeOpenCL is called
+    // next. Returns false when the file isn't a checkpoint of this version
+    bool LoadCheckpoint(const char *fileName);
+
 private:
 
     // Internal methods called in Simulate methods
@@ -180,6 +338,25 @@ private:
     void AcceleratorsOnGPU();
     void Animate();
 
+    // Adaptive time step
+    float ComputeStableDeltaT() const;
+    void SetDeltaT(float deltaT);
+
+    // Multi rate time step
+    void SimulateMultiRate(float frameTime);
+    void SimulateActive(const int *activeIndices, int activeCount);
+
+    // Emitters, deltaT is the time elapsed to reach the current positions
+    void UpdateParticlesLife(float deltaT);
+
+    // Counters of the profiler trace, the neighbors are only counted by the CPU SPH
+    void SetProfilerCounters(int activeCount, bool isCountingNeighbors);
+
+    // Sleeping
+    void SimulateAwake();
+    void WakeUpAccelerator(const vrAccelerator& accelerator);
+    void WakeUpOnColliderMotion();
+
 
     // Internal boolean value without accesor
     bool m_IsUsingGrid3D;
@@ -11,13 +11,22 @@ struct PipelineDescription
     bool m_SpringOnGPU;
     bool m_AcceleratorOnGPU;
     bool m_IsUsingAnimation;
+    // Previous positions stored on the device as half offsets to the positions, less
+    // memory traffic for a lower velocity precision. Not supported by springs and animation
+    bool m_IsUsingHalfPreviousPositions;
+    // Bit identical results whatever the threads, devices and slabs count. The native
+    // backend already reduces in a fixed order, the kernels are built without fused
+    // multiply add and the slabs keep the particles in the order of a single device
+    bool m_IsDeterministic;
 
     PipelineDescription() : m_IsCreatingGridOnGPU(false),
                             m_SPHAndIntegrateOnGPU(false),
                             m_CollisionOnGPU(false),
                             m_SpringOnGPU(false),
                             m_AcceleratorOnGPU(false),
-                            m_IsUsingAnimation(false)
+                            m_IsUsingAnimation(false),
+                            m_IsUsingHalfPreviousPositions(false),
+                            m_IsDeterministic(false)
     {
     }
 };
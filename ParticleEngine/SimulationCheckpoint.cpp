@@ -0,0 +1,107 @@
+#include "SimulationCheckpoint.h"
+
+#include <assert.h>
+#include <cstring>
+
+
+namespace
+{
+    const unsigned long long s_SectionAlignment = 64;
+
+    unsigned long long AlignOffset(unsigned long long offset)
+    {
+        return (offset + s_SectionAlignment - 1) / s_SectionAlignment * s_SectionAlignment;
+    }
+}
+
+// "PCKP" in the first bytes of a little endian file
+const unsigned int SimulationCheckpoint::s_Magic     = 0x504B4350;
+const unsigned int SimulationCheckpoint::s_Version   = 2;
+
+size_t SimulationCheckpoint::Layout(CheckpointHeader& header)
+{
+    assert(sizeof(header.m_Sections) / sizeof(CheckpointSection) == eSectionsCount && "SimulationCheckpoint::Layout failed.");
+    header.m_Magic      = s_Magic;
+    header.m_Version    = s_Version;
+    header.m_HeaderSize = sizeof(CheckpointHeader);
+
+    unsigned long long offset = AlignOffset(sizeof(CheckpointHeader));
+    for (int i = 0; i < eSectionsCount; i++)
+    {
+        header.m_Sections[i].m_Offset = offset;
+        offset = AlignOffset(offset + header.m_Sections[i].m_Size);
+    }
+    header.m_FileSize = offset;
+    return static_cast<size_t>(offset);
+}
+
+void SimulationCheckpoint::WriteHeader(char *image, const CheckpointHeader& header)
+{
+    memcpy(image, &header, sizeof(CheckpointHeader));
+}
+
+void SimulationCheckpoint::WriteSection(char *image, const CheckpointHeader& header, Section section, const void *data)
+{
+    const CheckpointSection& description = header.m_Sections[section];
+    assert((description.m_Size == 0 || data != NULL) && "SimulationCheckpoint::WriteSection failed.");
+    if (description.m_Size > 0)
+    {
+        memcpy(image + description.m_Offset, data, static_cast<size_t>(description.m_Size));
+    }
+}
+
+SimulationCheckpoint::SimulationCheckpoint() : m_Header(NULL)
+{
+}
+
+bool SimulationCheckpoint::Open(const char *fileName)
+{
+    Close();
+    if ( ! m_File.Open(fileName))
+        return false;
+
+    m_Header = static_cast<const CheckpointHeader*>(m_File.GetData());
+    if ( ! IsValid())
+    {
+        Close();
+        return false;
+    }
+    return true;
+}
+
+void SimulationCheckpoint::Close()
+{
+    m_File.Close();
+    m_Header = NULL;
+}
+
+const CheckpointHeader& SimulationCheckpoint::GetHeader() const
+{
+    assert(m_Header != NULL && "SimulationCheckpoint::GetHeader failed.");
+    return *m_Header;
+}
+
+// Every section has to be in the file, a truncated write is refused
+bool SimulationCheckpoint::IsValid() const
+{
+    const unsigned long long fileSize = m_File.GetSize();
+    if (fileSize < sizeof(CheckpointHeader))
+        return false;
+    if (m_Header->m_Magic != s_Magic || m_Header->m_Version != s_Version ||
+        m_Header->m_HeaderSize != sizeof(CheckpointHeader) || m_Header->m_FileSize != fileSize)
+        return false;
+    if (m_Header->m_ParticlesCount <= 0 || m_Header->m_ParticlesCapacity < m_Header->m_ParticlesCount ||
+        m_Header->m_ClothCount <= 0)
+        return false;
+
+    for (int i = 0; i < eSectionsCount; i++)
+    {
+        const CheckpointSection& section = m_Header->m_Sections[i];
+        if (section.m_Offset % s_SectionAlignment != 0 || section.m_Offset > fileSize || section.m_Size > fileSize - section.m_Offset)
+            return false;
+    }
+
+    const unsigned long long positionsSize = static_cast<unsigned long long>(m_Header->m_ParticlesCount) * sizeof(slmath::vec4);
+    return  m_Header->m_Sections[ePositions].m_Size == positionsSize &&
+            m_Header->m_Sections[ePreviousPositions].m_Size == positionsSize;
+}
@@ -0,0 +1,118 @@
+#ifndef SIMULATION_CHECKPOINT
+#define SIMULATION_CHECKPOINT
+
+#include "SmoothedParticleHydrodynamics.h"
+#include "Utility/MappedFile.h"
+
+#include <cstddef>
+
+// A section of the file, its offset is 64 bytes aligned
+struct CheckpointSection
+{
+    unsigned long long  m_Offset;
+    unsigned long long  m_Size;
+};
+
+// First bytes of a checkpoint, the sections follow in the order of their enum
+struct CheckpointHeader
+{
+    unsigned int        m_Magic;
+    unsigned int        m_Version;
+    unsigned int        m_HeaderSize;
+    // Pipeline and solver flags, cf SimulationCheckpoint::Flags
+    unsigned int        m_Flags;
+    unsigned long long  m_FileSize;
+    int                 m_ParticlesCount;
+    int                 m_ParticlesCapacity;
+    float               m_Damping;
+    // Verlet steps, the previous one corrects the velocity
+    float               m_DeltaT;
+    float               m_PreviousDeltaT;
+    // Cloths sharing the springs, cf PhysicsParticle::SetClothCount
+    int                 m_ClothCount;
+    slmath::vec4        m_CommonAcceleration;
+    SphParameters       m_SphParameters;
+    // One by SimulationCheckpoint::Section
+    CheckpointSection   m_Sections[10];
+};
+
+// Versioned binary snapshot of a simulation, laid out as the arrays are in memory.
+// A checkpoint is mapped and its sections are used in place, nothing is parsed.
+// The layout is the one of the machine writing it, a checkpoint isn't portable across
+// endianness. A new version is needed each time a section or the header changes
+class SimulationCheckpoint
+{
+public:
+    enum Section
+    {
+        ePositions = 0,
+        ePreviousPositions,
+        eDensities,
+        ePreviousDensities,
+        eSprings,
+        eInsideAabbs,
+        eOutsideAabbs,
+        eInsideSpheres,
+        eOutsideSpheres,
+        eAccelerators,
+        eSectionsCount
+    };
+
+    enum Flags
+    {
+        // PipelineDescription
+        eGridOnGPU                  = 1 << 0,
+        eSPHAndIntegrateOnGPU       = 1 << 1,
+        eCollisionOnGPU             = 1 << 2,
+        eSpringOnGPU                = 1 << 3,
+        eAcceleratorOnGPU           = 1 << 4,
+        eAnimation                  = 1 << 5,
+        eHalfPreviousPositions      = 1 << 6,
+        eDeterministic              = 1 << 7,
+        // CPU solver
+        eGrid3D                     = 1 << 8,
+        eSPHSimulation              = 1 << 9,
+        eContinuousIntegration      = 1 << 10,
+        eAccelerator                = 1 << 11,
+        eIntegrating                = 1 << 12,
+        eSolvingSpring              = 1 << 13,
+        eColliding                  = 1 << 14,
+        // Time steps
+        eAdaptiveTimeStep           = 1 << 16,
+        eMultiRate                  = 1 << 17,
+        eSleeping                   = 1 << 18
+    };
+
+    static const unsigned int s_Magic;
+    static const unsigned int s_Version;
+
+    // Offsets of the sections from their sizes, returns the size of the file
+    static size_t Layout(CheckpointHeader& header);
+    // Copies the header and the sections in the image of the file
+    static void WriteHeader(char *image, const CheckpointHeader& header);
+    static void WriteSection(char *image, const CheckpointHeader& header, Section section, const void *data);
+
+    SimulationCheckpoint();
+
+    // Returns false when the file isn't a checkpoint of this version
+    bool Open(const char *fileName);
+    void Close();
+
+    const CheckpointHeader& GetHeader() const;
+    // Section in the mapped file, valid until Close
+    template <class T>
+    const T* GetSection(Section section, int& count) const
+    {
+        const CheckpointSection& description = m_Header->m_Sections[section];
+        count = static_cast<int>(description.m_Size / sizeof(T));
+        return reinterpret_cast<const T*>(static_cast<const char*>(m_File.GetData()) + description.m_Offset);
+    }
+
+private:
+    bool IsValid() const;
+
+    MappedFile              m_File;
+    const CheckpointHeader  *m_Header;
+};
+
+#endif // SIMULATION_CHECKPOINT
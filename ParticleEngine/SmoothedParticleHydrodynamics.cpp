@@ -4,84 +4,188 @@
 
 #include <slmath/slmath.h>
 #include <cmath>
-#include "Utility/Timer.h"
-#include "ParticlesGPU/ParticlesGPU.hpp"
+#include <algorithm>
+#include "Utility/Profiler.h"
+#include "Utility/Utility.h"
+#include "Utility/MemoryArena.h"
+#include "Utility/ThreadPool.h"
  
 
 using namespace slmath;
 
 
-SmoothedParticleHydrodynamics::SmoothedParticleHydrodynamics(Grid3D *grid3D) : m_Grid3D(grid3D),
+SmoothedParticleHydrodynamics::SmoothedParticleHydrodynamics(Grid3D *grid3D) : m_ParticlePositions(NULL),
                                                                 m_ParticlesCount(0),
-                                                                m_ParticlePositions(NULL),
+                                                                m_ParticlesCapacity(0),
+                                                                m_NeighborsCount(0),
+                                                                m_Grid3D(grid3D),
+                                                                m_MemoryArena(NULL),
                                                                 m_Pressure(NULL),
                                                                 m_Density(NULL),
-                                                                m_PreviousDensity(NULL)
+                                                                m_PreviousDensity(NULL),
+                                                                m_Phases(NULL),
+                                                                m_PhasesCount(1),
+                                                                m_ParametersGeneration(1)
 {
+    m_PhasesTable[0].m_Mass = m_SphParameters.m_Mass;
+    m_PhasesTable[0].m_GazConstant = m_SphParameters.m_GazConstant;
+    for (int i = 0; i < s_MaxPhasesCount; i++)
+    {
+        for (int j = 0; j < s_MaxPhasesCount; j++)
+        {
+            m_PhasesPressureFactors[i][j] = 1.0f;
+        }
+    }
 }
 
     
 
 SmoothedParticleHydrodynamics::~SmoothedParticleHydrodynamics()
 {
-  
-    if(m_Pressure)
-        delete[] m_Pressure;
-    if(m_Density)
-        delete[] m_Density;
-    if(m_PreviousDensity)
-        delete[] m_PreviousDensity;
-        
+    ReleaseMemory();
+}
+
+void SmoothedParticleHydrodynamics::ReleaseMemory()
+{
+    MemoryArena::DeleteArray(m_MemoryArena, m_Pressure);
+    MemoryArena::DeleteArray(m_MemoryArena, m_Density);
+    MemoryArena::DeleteArray(m_MemoryArena, m_PreviousDensity);
+    MemoryArena::DeleteArray(m_MemoryArena, m_Phases);
+
+    m_Pressure          = NULL;
+    m_Density           = NULL;
+    m_PreviousDensity   = NULL;
+    m_Phases            = NULL;
+    m_ParticlesCount    = 0;
+    m_ParticlesCapacity = 0;
 }
 
 void SmoothedParticleHydrodynamics::Initialize(slmath::vec4 *positions, int positionsCount)
 {
     m_ParticlePositions = positions;
      
-    Timer::GetInstance()->StartTimerProfile();
-    if (m_ParticlesCount != positionsCount)
+    PROFILE_BEGIN();
+    if (m_ParticlesCapacity < positionsCount)
     {
-        ReallocParticles(positionsCount);
+        Reserve(positionsCount);
     }
-    Timer::GetInstance()->StopTimerProfile("SPH: Allocate");
-    Timer::GetInstance()->StartTimerProfile();
+    m_ParticlesCount = positionsCount;
+    PROFILE_END("SPH: Allocate");
+    PROFILE_BEGIN();
     for (int i = 0; i < positionsCount; i++)
     {
         m_PreviousDensity[i] = 0.0f;
         m_Density[i] = 0.0f;
         m_Pressure[i] = slmath::vec4(0.0f);
+        m_Phases[i] = 0;
+    }
+    PROFILE_END("SPH: Set to 0");
+    PROFILE_BEGIN();
+    InitDensity(0, m_ParticlesCount);
+    PROFILE_END("SPH: Init density");
+}
+
+void SmoothedParticleHydrodynamics::Reserve(int particlesCapacity)
+{
+    assert(particlesCapacity > 0);
+    if (particlesCapacity <= m_ParticlesCapacity)
+        return;
+
+    slmath::vec4 *pressure  = MemoryArena::NewArray<slmath::vec4>(m_MemoryArena, particlesCapacity);
+    float *density          = MemoryArena::NewArray<float>(m_MemoryArena, particlesCapacity);
+    float *previousDensity  = MemoryArena::NewArray<float>(m_MemoryArena, particlesCapacity);
+    unsigned char *phases   = MemoryArena::NewArray<unsigned char>(m_MemoryArena, particlesCapacity);
+    for (int i = 0; i < particlesCapacity; i++)
+    {
+        phases[i] = 0;
+    }
+    for (int i = 0; i < m_ParticlesCount; i++)
+    {
+        pressure[i]         = m_Pressure[i];
+        density[i]          = m_Density[i];
+        previousDensity[i]  = m_PreviousDensity[i];
+        phases[i]           = m_Phases[i];
     }
-    Timer::GetInstance()->StopTimerProfile("SPH: Set to 0");
-    Timer::GetInstance()->StartTimerProfile();
-    InitDensity();
-    Timer::GetInstance()->StopTimerProfile("SPH: Init density");
+
+    MemoryArena::DeleteArray(m_MemoryArena, m_Pressure);
+    MemoryArena::DeleteArray(m_MemoryArena, m_Density);
+    MemoryArena::DeleteArray(m_MemoryArena, m_PreviousDensity);
+    MemoryArena::DeleteArray(m_MemoryArena, m_Phases);
+
+    m_ParticlesCapacity = particlesCapacity;
+    m_Pressure          = pressure;
+    m_Density           = density;
+    m_PreviousDensity   = previousDensity;
+    m_Phases            = phases;
+}
+
+void SmoothedParticleHydrodynamics::SetMemoryArena(MemoryArena *memoryArena)
+{
+    assert(m_ParticlesCapacity == 0 && "SmoothedParticleHydrodynamics::SetMemoryArena failed.");
+    m_MemoryArena = memoryArena;
 }
 
-void SmoothedParticleHydrodynamics::ReallocParticles(int particlesCount)
+size_t SmoothedParticleHydrodynamics::GetMemorySize(int particlesCapacity)
 {
-    delete[] m_Pressure;
-    delete[] m_Density;
-    delete[] m_PreviousDensity;
+    return  MemoryArena::GetArraySize<slmath::vec4>(particlesCapacity) +
+            2 * MemoryArena::GetArraySize<float>(particlesCapacity) +
+            MemoryArena::GetArraySize<unsigned char>(particlesCapacity);
+}
 
+void SmoothedParticleHydrodynamics::AddParticles(int particlesCount)
+{
+    assert(m_ParticlesCount + particlesCount <= m_ParticlesCapacity);
+    for (int i = m_ParticlesCount; i < m_ParticlesCount + particlesCount; i++)
+    {
+        m_Density[i] = 0.0f;
+        m_Pressure[i] = slmath::vec4(0.0f);
+    }
+    InitDensity(m_ParticlesCount, particlesCount);
+    m_ParticlesCount += particlesCount;
+}
+
+void SmoothedParticleHydrodynamics::CompactParticles(const int *sources, const int *destinations, int movesCount, int particlesCount)
+{
+    assert(particlesCount <= m_ParticlesCount);
+    for (int i = 0; i < movesCount; i++)
+    {
+        m_Pressure[destinations[i]]         = m_Pressure[sources[i]];
+        m_Density[destinations[i]]          = m_Density[sources[i]];
+        m_PreviousDensity[destinations[i]]  = m_PreviousDensity[sources[i]];
+        m_Phases[destinations[i]]           = m_Phases[sources[i]];
+    }
     m_ParticlesCount = particlesCount;
-    m_Pressure = new slmath::vec4[m_ParticlesCount];
-    m_Density = new float[m_ParticlesCount];
-    m_PreviousDensity = new float[m_ParticlesCount];
 }
 
 void SmoothedParticleHydrodynamics::SetParticlesMass(float mass)
 {
     m_SphParameters.m_Mass= mass;
+    m_PhasesTable[0].m_Mass = mass;
+    m_ParametersGeneration++;
 }
 
 void SmoothedParticleHydrodynamics::SetParticlesGazConstant(float gazConstant)
 {
     m_SphParameters.m_GazConstant = gazConstant;
+    m_PhasesTable[0].m_GazConstant = gazConstant;
+    m_ParametersGeneration++;
 }
 
 void SmoothedParticleHydrodynamics::SetParticlesMuViscosityt(float muViscosity)
 {
     m_SphParameters.m_MuViscosity = muViscosity;
+    m_ParametersGeneration++;
+}
+
+void SmoothedParticleHydrodynamics::SetDeltaT(float deltaT)
+{
+    // A constant step is uploaded only once
+    if (deltaT == m_SphParameters.m_DeltaT && deltaT == m_SphParameters.m_PreviousDeltaT)
+        return;
+
+    m_SphParameters.m_PreviousDeltaT = m_SphParameters.m_DeltaT;
+    m_SphParameters.m_DeltaT = deltaT;
+    m_ParametersGeneration++;
 }
 
 const SphParameters& SmoothedParticleHydrodynamics::GetParameters() const
@@ -89,6 +193,56 @@ const SphParameters& SmoothedParticleHydrodynamics::GetParameters() const
     return m_SphParameters;
 }
 
+void SmoothedParticleHydrodynamics::SetParameters(const SphParameters& parameters)
+{
+    m_SphParameters = parameters;
+    m_PhasesTable[0].m_Mass = parameters.m_Mass;
+    m_PhasesTable[0].m_GazConstant = parameters.m_GazConstant;
+    m_ParametersGeneration++;
+}
+
+unsigned int SmoothedParticleHydrodynamics::GetParametersGeneration() const
+{
+    return m_ParametersGeneration;
+}
+
+int SmoothedParticleHydrodynamics::AddPhase(const SphPhase& phase)
+{
+    assert(m_PhasesCount < s_MaxPhasesCount);
+    assert(phase.m_Mass > 0.0f && phase.m_GazConstant >= 0.0f && phase.m_RestDensity >= 0.0f);
+    m_PhasesTable[m_PhasesCount] = phase;
+    return m_PhasesCount++;
+}
+
+int SmoothedParticleHydrodynamics::GetPhasesCount() const
+{
+    return m_PhasesCount;
+}
+
+void SmoothedParticleHydrodynamics::SetPhasesPressureFactor(int phase1, int phase2, float pressureFactor)
+{
+    assert(phase1 >= 0 && phase1 < m_PhasesCount);
+    assert(phase2 >= 0 && phase2 < m_PhasesCount);
+    m_PhasesPressureFactors[phase1][phase2] = pressureFactor;
+    m_PhasesPressureFactors[phase2][phase1] = pressureFactor;
+}
+
+void SmoothedParticleHydrodynamics::SetParticlesPhase(int firstIndex, int particlesCount, int phase)
+{
+    assert(firstIndex >= 0 && firstIndex + particlesCount <= m_ParticlesCount);
+    assert(phase >= 0 && phase < m_PhasesCount);
+    for (int i = firstIndex; i < firstIndex + particlesCount; i++)
+    {
+        m_Phases[i] = static_cast<unsigned char>(phase);
+    }
+    InitDensity(firstIndex, particlesCount);
+}
+
+unsigned char *SmoothedParticleHydrodynamics::GetPhases() const
+{
+    return m_Phases;
+}
+
 int SmoothedParticleHydrodynamics::GetParticlesCount() const
 {
     return m_ParticlesCount;
@@ -109,6 +263,11 @@ float *SmoothedParticleHydrodynamics::GetPreviousDensity() const
     return m_PreviousDensity;
 }
 
+int SmoothedParticleHydrodynamics::GetNeighborsCount() const
+{
+    return m_NeighborsCount;
+}
+
 void SmoothedParticleHydrodynamics::Simulate(slmath::vec4 *positions, int positionsCount)
 {
     UNUSED_PARAMETER(positionsCount);
@@ -117,12 +276,12 @@ void SmoothedParticleHydrodynamics::Simulate(slmath::vec4 *positions, int positi
     
     m_ParticlePositions = positions;
 
-    Timer::GetInstance()->StartTimerProfile();
+    PROFILE_BEGIN();
 
     ComputePressureQuery();
     SwapDensityBuffer(); 
     
-    Timer::GetInstance()->StopTimerProfile("Compute pressure");
+    PROFILE_END("Compute pressure");
 
     for (int i = 0; i < m_ParticlesCount; i++)
     {
@@ -131,15 +290,45 @@ void SmoothedParticleHydrodynamics::Simulate(slmath::vec4 *positions, int positi
     }
 }
 
-void SmoothedParticleHydrodynamics::InitDensity()
+void SmoothedParticleHydrodynamics::Simulate(slmath::vec4 *positions, int positionsCount, const int *activeIndices, int activeCount)
 {
-    for (int i = 0; i < m_ParticlesCount; i++)
+    UNUSED_PARAMETER(positionsCount);
+    assert(m_ParticlesCount == positionsCount);
+
+    m_ParticlePositions = positions;
+
+    PROFILE_BEGIN();
+
+    ScratchArray<int> scratchNeighbors(m_MemoryArena, ThreadPool::GetThreadIndex(), 1024);
+    int *neighborsBuffer = scratchNeighbors.Get();
+    const int *particleOrderIndex = m_Grid3D->GetParticleOrderIndex();
+    m_NeighborsCount = 0;
+    for (int i = 0; i < activeCount; i++)
+    {
+        m_NeighborsCount += ComputeParticlePressureQuery(particleOrderIndex[activeIndices[i]], neighborsBuffer, 256);
+    }
+
+    // Densities can't be swapped, inactive particles keep their previous density.
+    // All the active densities are computed from the previous ones before copying them
+    for (int i = 0; i < activeCount; i++)
+    {
+        const int index = activeIndices[i];
+        m_PreviousDensity[index] = m_Density[index];
+        assert(slmath::check(m_Pressure[index]));
+    }
+
+    PROFILE_END("Compute pressure active");
+}
+
+void SmoothedParticleHydrodynamics::InitDensity(int firstIndex, int particlesCount)
+{
+    for (int i = firstIndex; i < firstIndex + particlesCount; i++)
     {
         m_PreviousDensity[i] = 0.0f;
         slmath::vec4 separation(0.0f);
 
         float distance = length(separation);
-        m_PreviousDensity[i] += m_SphParameters.m_Mass * ( 15 / (PI*m_SphParameters.m_H*m_SphParameters.m_H*m_SphParameters.m_H) ) * ((1 - distance / m_SphParameters.m_H)*(1 - distance / m_SphParameters.m_H)*(1 - distance / m_SphParameters.m_H));
+        m_PreviousDensity[i] += m_PhasesTable[m_Phases[i]].m_Mass * ( 15 / (PI*m_SphParameters.m_H*m_SphParameters.m_H*m_SphParameters.m_H) ) * ((1 - distance / m_SphParameters.m_H)*(1 - distance / m_SphParameters.m_H)*(1 - distance / m_SphParameters.m_H));
 
         assert(m_PreviousDensity[i] != 0.0f);
     }
@@ -235,57 +424,124 @@ void SmoothedParticleHydrodynamics::ComputePressureBigRange()
 
 void SmoothedParticleHydrodynamics::ComputePressureQuery()
 {
-    const float sqrMaxDistance = length(slmath::vec4(2.0f)) * length(slmath::vec4(2.0f));
-    UNREFERENCED_PARAMETER(sqrMaxDistance);
     int average = 0;
-    int neighborsBuffer[1024];
+    ScratchArray<int> scratchNeighbors(m_MemoryArena, ThreadPool::GetThreadIndex(), 1024);
+    int *neighborsBuffer = scratchNeighbors.Get();
 
-    Grid3D::ParticleCellOrder *particleOrder = m_Grid3D->GetParticleCellOrder();
-    
     for (int i = 0; i < m_ParticlesCount; i++)
     {
-        // int neighborsCount = m_Grid3D->ComputeHashNeighbors(i,  neighborsBuffer, 256);
-       //  int neighborsCount = m_Grid3D->GetNeighborsByParticleOrderHeuristic(i,  neighborsBuffer, 256);
-       int neighborsCount = m_Grid3D->GetNeighborsByParticleOrder(i,  neighborsBuffer, 256);
-        //int neighborsCount = m_Grid3D->GetNeighborsByParticleOrderFullGrid(i,  neighborsBuffer, 1024);
+        average += ComputeParticlePressureQuery(i, neighborsBuffer, 256);
+    }
+    m_NeighborsCount = average;
+     DEBUG_OUT("Average: \t" << average / m_ParticlesCount << "\n");
+}
 
-        average += neighborsCount;
+int SmoothedParticleHydrodynamics::ComputeParticlePressureQuery(int orderIndex, int *neighborsBuffer, int neighborsMaxCount)
+{
+    if (m_PhasesCount > 1)
+    {
+        return ComputeParticlePressureQueryMultiPhase(orderIndex, neighborsBuffer, neighborsMaxCount);
+    }
 
-        int indexParticle = particleOrder[i].m_ParticleIndex;
-        assert(m_PreviousDensity[indexParticle] != 0.0f);
-        m_Pressure[indexParticle] = slmath::vec4(0.0f);
-        m_Density[indexParticle] = 0.0f;
+    const float sqrMaxDistance = length(slmath::vec4(2.0f)) * length(slmath::vec4(2.0f));
+    UNUSED_PARAMETER(sqrMaxDistance);
 
-        for (int j = 0; j < neighborsCount; j++)
-        {
-            int indexParticleNeighbor = particleOrder[neighborsBuffer[j]].m_ParticleIndex;
-            assert(m_PreviousDensity[indexParticleNeighbor] != 0.0f);
-            slmath::vec4 separation = m_ParticlePositions[indexParticle] - m_ParticlePositions[indexParticleNeighbor];
-            float sqrDistance = slmath::dot(separation, separation);
-             
-            slmath::vec4 normal = separation;
+    Grid3D::ParticleCellOrder *particleOrder = m_Grid3D->GetParticleCellOrder();
 
-            // Add assert if none neighbors are false positives
-            //assert(sqrDistance <= sqrMaxDistance);
-            
-            if (sqrDistance < m_SphParameters.m_H)
-            {
-                float distance = 0.0;
-                if (sqrDistance > 0.0f)
-                 {
-                    distance = sqrtf(sqrDistance);
-                    normal /= distance;
-                 }
-                m_Density[indexParticle] += m_SphParameters.m_Mass * ( 15 / (PI*m_SphParameters.m_H*m_SphParameters.m_H*m_SphParameters.m_H) ) * ((1 - distance / m_SphParameters.m_H)*(1 - distance / m_SphParameters.m_H)*(1 - distance / m_SphParameters.m_H));
-                m_Pressure[indexParticle] += m_SphParameters.m_Mass / m_PreviousDensity[indexParticleNeighbor] * 
-                ((m_SphParameters.m_GazConstant * m_PreviousDensity[indexParticle] + m_SphParameters.m_GazConstant * m_PreviousDensity[indexParticleNeighbor]) * 0.5f)
-                 * (- 45 / (PI*m_SphParameters.m_H*m_SphParameters.m_H*m_SphParameters.m_H*m_SphParameters.m_H) ) * ((m_SphParameters.m_H - distance)*(m_SphParameters.m_H - distance)) * normal;
-            }
+    // int neighborsCount = m_Grid3D->ComputeHashNeighbors(orderIndex,  neighborsBuffer, 256);
+    //  int neighborsCount = m_Grid3D->GetNeighborsByParticleOrderHeuristic(orderIndex,  neighborsBuffer, 256);
+    int neighborsCount = m_Grid3D->GetNeighborsByParticleOrder(orderIndex,  neighborsBuffer, neighborsMaxCount);
+    //int neighborsCount = m_Grid3D->GetNeighborsByParticleOrderFullGrid(orderIndex,  neighborsBuffer, 1024);
+
+    int indexParticle = particleOrder[orderIndex].m_ParticleIndex;
+    assert(m_PreviousDensity[indexParticle] != 0.0f);
+    m_Pressure[indexParticle] = slmath::vec4(0.0f);
+    m_Density[indexParticle] = 0.0f;
+
+    for (int j = 0; j < neighborsCount; j++)
+    {
+        int indexParticleNeighbor = particleOrder[neighborsBuffer[j]].m_ParticleIndex;
+        assert(m_PreviousDensity[indexParticleNeighbor] != 0.0f);
+        slmath::vec4 separation = m_ParticlePositions[indexParticle] - m_ParticlePositions[indexParticleNeighbor];
+        float sqrDistance = slmath::dot(separation, separation);
+         
+        slmath::vec4 normal = separation;
+
+        // Add assert if none neighbors are false positives
+        //assert(sqrDistance <= sqrMaxDistance);
+        
+        if (sqrDistance < m_SphParameters.m_H)
+        {
+            float distance = 0.0;
+            if (sqrDistance > 0.0f)
+             {
+                distance = sqrtf(sqrDistance);
+                normal /= distance;
+             }
+            m_Density[indexParticle] += m_SphParameters.m_Mass * ( 15 / (PI*m_SphParameters.m_H*m_SphParameters.m_H*m_SphParameters.m_H) ) * ((1 - distance / m_SphParameters.m_H)*(1 - distance / m_SphParameters.m_H)*(1 - distance / m_SphParameters.m_H));
+            m_Pressure[indexParticle] += m_SphParameters.m_Mass / m_PreviousDensity[indexParticleNeighbor] * 
+            ((m_SphParameters.m_GazConstant * m_PreviousDensity[indexParticle] + m_SphParameters.m_GazConstant * m_PreviousDensity[indexParticleNeighbor]) * 0.5f)
+             * (- 45 / (PI*m_SphParameters.m_H*m_SphParameters.m_H*m_SphParameters.m_H*m_SphParameters.m_H) ) * ((m_SphParameters.m_H - distance)*(m_SphParameters.m_H - distance)) * normal;
         }
-       m_Pressure[indexParticle] =  -(m_SphParameters.m_Mass / m_PreviousDensity[indexParticle]) * m_Pressure[indexParticle];
+    }
+   m_Pressure[indexParticle] =  -(m_SphParameters.m_Mass / m_PreviousDensity[indexParticle]) * m_Pressure[indexParticle];
 
+   return neighborsCount;
+}
+
+// Same neighbor loop as the single phase one, masses, pressures and pressure
+// factors are read from the phase tables
+int SmoothedParticleHydrodynamics::ComputeParticlePressureQueryMultiPhase(int orderIndex, int *neighborsBuffer, int neighborsMaxCount)
+{
+    Grid3D::ParticleCellOrder *particleOrder = m_Grid3D->GetParticleCellOrder();
+    int neighborsCount = m_Grid3D->GetNeighborsByParticleOrder(orderIndex,  neighborsBuffer, neighborsMaxCount);
+
+    const float h = m_SphParameters.m_H;
+    const float densityKernel = 15 / (PI*h*h*h);
+    const float pressureKernel = - 45 / (PI*h*h*h*h);
+
+    int indexParticle = particleOrder[orderIndex].m_ParticleIndex;
+    assert(m_PreviousDensity[indexParticle] != 0.0f);
+    const int phase = m_Phases[indexParticle];
+    const SphPhase& particlePhase = m_PhasesTable[phase];
+    const float *pressureFactors = m_PhasesPressureFactors[phase];
+    // Negative pressures would clump the particles
+    const float pressure = std::max(0.0f, particlePhase.m_GazConstant * (m_PreviousDensity[indexParticle] - particlePhase.m_RestDensity));
+
+    m_Pressure[indexParticle] = slmath::vec4(0.0f);
+    m_Density[indexParticle] = 0.0f;
+
+    for (int j = 0; j < neighborsCount; j++)
+    {
+        int indexParticleNeighbor = particleOrder[neighborsBuffer[j]].m_ParticleIndex;
+        assert(m_PreviousDensity[indexParticleNeighbor] != 0.0f);
+        slmath::vec4 separation = m_ParticlePositions[indexParticle] - m_ParticlePositions[indexParticleNeighbor];
+        float sqrDistance = slmath::dot(separation, separation);
+         
+        slmath::vec4 normal = separation;
+        
+        if (sqrDistance < h)
+        {
+            float distance = 0.0;
+            if (sqrDistance > 0.0f)
+             {
+                distance = sqrtf(sqrDistance);
+                normal /= distance;
+             }
+
+            const int neighborPhase = m_Phases[indexParticleNeighbor];
+            const SphPhase& neighbor = m_PhasesTable[neighborPhase];
+            const float neighborPressure = std::max(0.0f, neighbor.m_GazConstant * (m_PreviousDensity[indexParticleNeighbor] - neighbor.m_RestDensity));
+
+            m_Density[indexParticle] += neighbor.m_Mass * densityKernel * ((1 - distance / h)*(1 - distance / h)*(1 - distance / h));
+            m_Pressure[indexParticle] += neighbor.m_Mass / m_PreviousDensity[indexParticleNeighbor] * 
+            ((pressure + neighborPressure) * 0.5f * pressureFactors[neighborPhase])
+             * pressureKernel * ((h - distance)*(h - distance)) * normal;
+        }
     }
-     DEBUG_OUT("Average: \t" << average / m_ParticlesCount << "\n");
+   m_Pressure[indexParticle] =  -(particlePhase.m_Mass / m_PreviousDensity[indexParticle]) * m_Pressure[indexParticle];
+
+   return neighborsCount;
 }
 
 void SmoothedParticleHydrodynamics::SwapDensityBuffer()
@@ -5,8 +5,9 @@
 
 class Grid3D;
 class ParticlesGPU;
+class MemoryArena;
 
-#include <slmath\vec4.h>
+#include <slmath/vec4.h>
 
 struct SphParameters
 {
@@ -16,17 +17,36 @@ struct SphParameters
     float m_DeltaT;
     float m_Mass;
     float m_H;
+    // Step used to reach the current positions, used for time corrected Verlet
+    float m_PreviousDeltaT;
 
     SphParameters():gravity(0.0f, -9.8f, 0.0f, 0.0f),
                     m_GazConstant(10.0f),
                     m_MuViscosity(10.0f),
                     m_DeltaT(1.0f / 60.0f),
                     m_Mass(10.0f),
-                    m_H(1.0f)
+                    m_H(1.0f),
+                    m_PreviousDeltaT(1.0f / 60.0f)
                     {
                     }
 };
 
+// Parameters of a fluid, the pressure is k * (density - rest density)
+struct SphPhase
+{
+    float m_Mass;
+    float m_GazConstant;
+    float m_RestDensity;
+    float m_Pad;
+
+    SphPhase(): m_Mass(10.0f),
+                m_GazConstant(10.0f),
+                m_RestDensity(0.0f),
+                m_Pad(0.0f)
+                {
+                }
+};
+
 class SmoothedParticleHydrodynamics
 {
 
@@ -37,26 +57,61 @@ public:
     void SetParticlesMass(float mass);
     void SetParticlesGazConstant(float gazConstant);
     void SetParticlesMuViscosityt(float muViscosity);
+    void SetDeltaT(float deltaT);
 
     const SphParameters& GetParameters() const;
+    // Every parameter at once, the steps included
+    void SetParameters(const SphParameters& parameters);
+    // Incremented by the setters, the backends compare it with the uploaded one
+    unsigned int GetParametersGeneration() const;
+
+    // Multi phase, the phase 0 uses the global mass and gaz constant.
+    // Single phase particles use the faster single phase loop.
+    // Returns the phase index
+    int AddPhase(const SphPhase& phase);
+    int GetPhasesCount() const;
+    // Scales the pressure between two phases, 1 by default
+    void SetPhasesPressureFactor(int phase1, int phase2, float pressureFactor);
+    // Particles must be initialized, their density is initialized again
+    void SetParticlesPhase(int firstIndex, int particlesCount, int phase);
+    // One byte by particle, written by the emitters before AddParticles
+    unsigned char *GetPhases() const;
 
     float *GetDensity() const;
     float *GetPreviousDensity() const;
 
     int GetParticlesCount() const;
+    // Neighbors found by the last Simulate, summed over the simulated particles
+    int GetNeighborsCount() const;
 
     slmath::vec4 *GetParticleAccelerations() const;
 
     void Initialize(slmath::vec4 *positions, int positionsCount);
+
+    // Capacity is reserved to add particles without reallocation, particles are kept
+    void Reserve(int particlesCapacity);
+    // The neighbors buffers are scratch arrays of the arena too
+    void SetMemoryArena(MemoryArena *memoryArena);
+    static size_t GetMemorySize(int particlesCapacity);
+    void ReleaseMemory();
+    // Initializes the density of the particles added after the last one,
+    // their phases must already be written
+    void AddParticles(int particlesCount);
+    // Moves the particles from sources to destinations then shrinks the count
+    void CompactParticles(const int *sources, const int *destinations, int movesCount, int particlesCount);
     void Simulate(slmath::vec4 *positions, int positionsCount);
+    // Only the particles of the active list are updated, the other ones keep
+    // their density and pressure. The grid must be up to date
+    void Simulate(slmath::vec4 *positions, int positionsCount, const int *activeIndices, int activeCount);
 
 
 private:
-    void ReallocParticles(int particlesCount);
-    void InitDensity();
+    void InitDensity(int firstIndex, int particlesCount);
     void ComputePressure();
     void ComputePressureBigRange();
     void ComputePressureQuery();
+    int ComputeParticlePressureQuery(int orderIndex, int *neighborsBuffer, int neighborsMaxCount);
+    int ComputeParticlePressureQueryMultiPhase(int orderIndex, int *neighborsBuffer, int neighborsMaxCount);
     void SwapDensityBuffer();
 
 private:
@@ -64,7 +119,10 @@ private:
     // References don't own these data
     slmath::vec4    *m_ParticlePositions;
     int             m_ParticlesCount;
+    int             m_ParticlesCapacity;
+    int             m_NeighborsCount;
     Grid3D          *m_Grid3D;
+    MemoryArena     *m_MemoryArena;
 
     // Specific SPH; data owned these data
     slmath::vec4    *m_Pressure;
@@ -72,8 +130,16 @@ private:
 
     float           *m_Density;
     float           *m_PreviousDensity;
+
+    // Phases are in a small side array, the tables fit in the cache
+    static const int s_MaxPhasesCount = 8;
+    unsigned char   *m_Phases;
+    SphPhase        m_PhasesTable[s_MaxPhasesCount];
+    float           m_PhasesPressureFactors[s_MaxPhasesCount][s_MaxPhasesCount];
+    int             m_PhasesCount;
     
     SphParameters m_SphParameters;
+    unsigned int  m_ParametersGeneration;
 };
 
 #endif // SMOOTHED_PARTTICLE_HYDRODYNAMICS
\ No newline at end of file
@@ -1,38 +1,74 @@
 #include "VerletIntegration.h"
 #include "Grid3D.h"
-#include "Utility/Timer.h"
+#include "Utility/Profiler.h"
+#include "Utility/MemoryArena.h"
+#include "Utility/ThreadPool.h"
 
 
-VerletIntegration::VerletIntegration() :    m_CommonAcceleration(slmath::vec4(0.0f, 0.0f, 0.0f, 0.0f)),
-                                            m_ParticlesCount(0),
-                                            m_NewProsition(NULL),
+VerletIntegration::VerletIntegration() :    m_NewProsition(NULL),
                                             m_ParticlePositions(NULL),
-                                            m_Accelerations(NULL),
                                             m_ParticlePreviousPositions(NULL),
+                                            m_Accelerations(NULL),
+                                            m_CommonAcceleration(slmath::vec4(0.0f, 0.0f, 0.0f, 0.0f)),
+                                            m_Grid3D(NULL),
+                                            m_MemoryArena(NULL),
+                                            m_ThreadPool(NULL),
                                             m_DeltaT(1.0f / 60.0f),
-                                            m_Damping(0.99f)
+                                            m_PreviousDeltaT(1.0f / 60.0f),
+                                            m_Damping(0.99f),
+                                            m_ParticlesCount(0),
+                                            m_ParticlesCapacity(0)
 {
 }
 VerletIntegration::~VerletIntegration()
 {
-    delete[] m_NewProsition;
-    delete[] m_ParticlePositions;
-    delete[] m_Accelerations;
-    delete[] m_ParticlePreviousPositions;
+    ReleaseMemory();
+}
+
+void VerletIntegration::ReleaseMemory()
+{
+    MemoryArena::DeleteArray(m_MemoryArena, m_NewProsition);
+    MemoryArena::DeleteArray(m_MemoryArena, m_ParticlePositions);
+    MemoryArena::DeleteArray(m_MemoryArena, m_Accelerations);
+    MemoryArena::DeleteArray(m_MemoryArena, m_ParticlePreviousPositions);
+
+    m_NewProsition              = NULL;
+    m_ParticlePositions         = NULL;
+    m_Accelerations             = NULL;
+    m_ParticlePreviousPositions = NULL;
+    m_ParticlesCount            = 0;
+    m_ParticlesCapacity         = 0;
 }
 
 void VerletIntegration::Initialize(slmath::vec4* positions, int particlesCount)
 {
     assert(particlesCount > 0);
-    if (m_ParticlesCount != particlesCount)
+    if (m_ParticlesCapacity < particlesCount)
     {
-        ReallocParticles(particlesCount);
+        Reserve(particlesCount);
     }
-    for (int i = 0; i < m_ParticlesCount; i++)
+    m_ParticlesCount = particlesCount;
+
+    slmath::vec4 *particlePositions = m_ParticlePositions;
+    slmath::vec4 *particlePreviousPositions = m_ParticlePreviousPositions;
+    slmath::vec4 *accelerations = m_Accelerations;
+    auto initialize = [=](int first, int last)
     {
-        m_ParticlePositions[i] = m_ParticlePreviousPositions[i] = positions[i];
-        /*m_Accelerations[i] = slmath::vec4(0.0f);
-        m_NewProsition[i] = slmath::vec4(0.0f);*/
+        for (int i = first; i < last; i++)
+        {
+            particlePositions[i] = particlePreviousPositions[i] = positions[i];
+            accelerations[i] = slmath::vec4(0.0f);
+            /*m_NewProsition[i] = slmath::vec4(0.0f);*/
+        }
+    };
+
+    if (m_ThreadPool != NULL)
+    {
+        m_ThreadPool->ParallelForStatic(m_ParticlesCount, initialize);
+    }
+    else
+    {
+        initialize(0, m_ParticlesCount);
     }
 }
 
@@ -41,6 +77,17 @@ void VerletIntegration::SetGrid3D(Grid3D *grid3D)
     m_Grid3D  = grid3D;
 }
 
+void VerletIntegration::SetThreadPool(ThreadPool *threadPool)
+{
+    m_ThreadPool = threadPool;
+}
+
+void VerletIntegration::SetMemoryArena(MemoryArena *memoryArena)
+{
+    assert(m_ParticlesCapacity == 0 && "VerletIntegration::SetMemoryArena failed.");
+    m_MemoryArena = memoryArena;
+}
+
 void VerletIntegration::SetCommonAcceleration(const slmath::vec4 &acceleration)
 {
     m_CommonAcceleration = acceleration;
@@ -51,6 +98,33 @@ void VerletIntegration::SetDamping(float damping)
     m_Damping = damping;
 }
 
+void VerletIntegration::SetDeltaT(float deltaT)
+{
+    assert(deltaT > 0.0f);
+    m_PreviousDeltaT = m_DeltaT;
+    m_DeltaT = deltaT;
+}
+
+float VerletIntegration::GetDeltaT() const
+{
+    return m_DeltaT;
+}
+
+float VerletIntegration::GetPreviousDeltaT() const
+{
+    return m_PreviousDeltaT;
+}
+
+const slmath::vec4 &VerletIntegration::GetCommonAcceleration() const
+{
+    return m_CommonAcceleration;
+}
+
+float VerletIntegration::GetDamping() const
+{
+    return m_Damping;
+}
+
 slmath::vec4 *VerletIntegration::GetParticlePositions() const
 {
     return m_ParticlePositions;
@@ -66,6 +140,33 @@ int VerletIntegration::GetParticlesCount() const
     return m_ParticlesCount;
 }
 
+int VerletIntegration::GetParticlesCapacity() const
+{
+    return m_ParticlesCapacity;
+}
+
+void VerletIntegration::AddParticles(int particlesCount)
+{
+    assert(m_ParticlesCount + particlesCount <= m_ParticlesCapacity);
+    for (int i = m_ParticlesCount; i < m_ParticlesCount + particlesCount; i++)
+    {
+        m_Accelerations[i] = slmath::vec4(0.0f);
+    }
+    m_ParticlesCount += particlesCount;
+}
+
+void VerletIntegration::CompactParticles(const int *sources, const int *destinations, int movesCount, int particlesCount)
+{
+    assert(particlesCount <= m_ParticlesCount);
+    for (int i = 0; i < movesCount; i++)
+    {
+        m_ParticlePositions[destinations[i]] = m_ParticlePositions[sources[i]];
+        m_ParticlePreviousPositions[destinations[i]] = m_ParticlePreviousPositions[sources[i]];
+        m_Accelerations[destinations[i]] = m_Accelerations[sources[i]];
+    }
+    m_ParticlesCount = particlesCount;
+}
+
 
 void VerletIntegration::AccumateAccelerations(slmath::vec4* accelerations, int particlesCount)
 {
@@ -76,31 +177,91 @@ void VerletIntegration::AccumateAccelerations(slmath::vec4* accelerations, int p
     }
 }
 
+void VerletIntegration::AccumateAccelerations(slmath::vec4* accelerations, const int *activeIndices, int activeCount)
+{
+    assert(activeCount <= m_ParticlesCount);
+    for (int i = 0 ; i < activeCount; i++)
+    {
+        const int index = activeIndices[i];
+        m_Accelerations[index] += accelerations[index];
+    }
+}
+
 
 void VerletIntegration::Integration()
 {
-    Timer::GetInstance()->StartTimerProfile();
-    const float dampingPlusOne = m_Damping + 1.0f;
+    PROFILE_BEGIN();
+    // Time corrected Verlet: the previous displacement is scaled by the steps ratio
+    const float dampingRatio = m_Damping * (m_DeltaT / m_PreviousDeltaT);
+    const float sqrDeltaT = m_DeltaT * m_DeltaT;
     for (int i = 0 ; i < m_ParticlesCount; i++)
     {
         slmath::vec4 acceleration = m_Accelerations[i] + m_CommonAcceleration;
-        m_ParticlePreviousPositions[i] = (m_ParticlePositions[i] * dampingPlusOne - 
-                                    m_ParticlePreviousPositions[i] * m_Damping) +
-                                    acceleration * m_DeltaT * m_DeltaT;
+        m_ParticlePreviousPositions[i] = m_ParticlePositions[i] + 
+                                    (m_ParticlePositions[i] - m_ParticlePreviousPositions[i]) * dampingRatio +
+                                    acceleration * sqrDeltaT;
 
         m_Accelerations[i] = slmath::vec4(0.0f);
     }
     SwapPositionBuffer();
-    Timer::GetInstance()->StopTimerProfile("Integrate");
+    PROFILE_END("Integrate");
+}
+
+void VerletIntegration::Integration(const int *activeIndices, int activeCount)
+{
+    PROFILE_BEGIN();
+    const float dampingRatio = m_Damping * (m_DeltaT / m_PreviousDeltaT);
+    const float sqrDeltaT = m_DeltaT * m_DeltaT;
+    // Buffers can't be swapped, inactive particles keep their positions
+    for (int i = 0 ; i < activeCount; i++)
+    {
+        const int index = activeIndices[i];
+        slmath::vec4 acceleration = m_Accelerations[index] + m_CommonAcceleration;
+        slmath::vec4 newPosition = m_ParticlePositions[index] + 
+                                    (m_ParticlePositions[index] - m_ParticlePreviousPositions[index]) * dampingRatio +
+                                    acceleration * sqrDeltaT;
+
+        m_ParticlePreviousPositions[index] = m_ParticlePositions[index];
+        m_ParticlePositions[index] = newPosition;
+
+        m_Accelerations[index] = slmath::vec4(0.0f);
+    }
+    PROFILE_END("Integrate active");
+}
+
+void VerletIntegration::Integration(const int *activeIndices, int activeCount, const float *deltaTs, float *previousDeltaTs)
+{
+    PROFILE_BEGIN();
+    // Buffers can't be swapped, inactive particles keep their positions
+    for (int i = 0 ; i < activeCount; i++)
+    {
+        const int index = activeIndices[i];
+        const float deltaT = deltaTs[index];
+        const float dampingRatio = m_Damping * (deltaT / previousDeltaTs[index]);
+
+        slmath::vec4 acceleration = m_Accelerations[index] + m_CommonAcceleration;
+        slmath::vec4 newPosition = m_ParticlePositions[index] + 
+                                    (m_ParticlePositions[index] - m_ParticlePreviousPositions[index]) * dampingRatio +
+                                    acceleration * deltaT * deltaT;
+
+        m_ParticlePreviousPositions[index] = m_ParticlePositions[index];
+        m_ParticlePositions[index] = newPosition;
+        previousDeltaTs[index] = deltaT;
+
+        m_Accelerations[index] = slmath::vec4(0.0f);
+    }
+    PROFILE_END("Integrate active");
 }
 
 void VerletIntegration::ContinuousIntegration()
 {
     const float m_H = 1.0f;
     const int maxIndexesCount = 1024;
-    int indexesOnTrajectory[maxIndexesCount ];
-    Timer::GetInstance()->StartTimerProfile();
-    const float dampingPlusOne = m_Damping + 1.0f;
+    ScratchArray<int> scratchIndexes(m_MemoryArena, ThreadPool::GetThreadIndex(), maxIndexesCount);
+    int *indexesOnTrajectory = scratchIndexes.Get();
+    PROFILE_BEGIN();
+    const float dampingRatio = m_Damping * (m_DeltaT / m_PreviousDeltaT);
+    const float sqrDeltaT = m_DeltaT * m_DeltaT;
 
     for (int i = 0 ; i < m_ParticlesCount; i++)
     {
@@ -112,15 +273,15 @@ void VerletIntegration::ContinuousIntegration()
         assert(m_NewProsition[index].w == 0.0f);
 
         slmath::vec4 acceleration = m_Accelerations[index] + m_CommonAcceleration;
-        slmath::vec4 newDesination = (m_ParticlePositions[index] * dampingPlusOne - 
-                                    m_ParticlePreviousPositions[index] * m_Damping) +
-                                    acceleration * m_DeltaT * m_DeltaT;
+        slmath::vec4 newDesination = m_ParticlePositions[index] + 
+                                    (m_ParticlePositions[index] - m_ParticlePreviousPositions[index]) * dampingRatio +
+                                    acceleration * sqrDeltaT;
 
        slmath::vec4 trajectory = newDesination - m_ParticlePositions[index];
 
 
-       int indexesOnTrajectoryCount = m_Grid3D->ComputeParticlesOnTrajectory(i, *(slmath::vec3*)&trajectory, 
-                                                                        *(slmath::vec3*)&m_ParticlePositions[index],
+       int indexesOnTrajectoryCount = m_Grid3D->ComputeParticlesOnTrajectory(i, trajectory.xyz(), 
+                                                                        m_ParticlePositions[index].xyz(),
                                                                         indexesOnTrajectory,
                                                                         maxIndexesCount);
         
@@ -175,7 +336,7 @@ void VerletIntegration::ContinuousIntegration()
     m_ParticlePreviousPositions = m_ParticlePositions;
     m_ParticlePositions = m_NewProsition;
     m_NewProsition = buffer;
-    Timer::GetInstance()->StopTimerProfile("Continuous Integrate");
+    PROFILE_END("Continuous Integrate");
 }
 
 
@@ -187,20 +348,36 @@ void VerletIntegration::SwapPositionBuffer()
     m_ParticlePositions = buffer;
 }
 
-void VerletIntegration::ReallocParticles(int particlesCount)
+void VerletIntegration::Reserve(int particlesCapacity)
 {
-    assert(particlesCount > 0);
-    if (m_ParticlePreviousPositions != NULL)
+    assert(particlesCapacity > 0);
+    if (particlesCapacity <= m_ParticlesCapacity)
+        return;
+
+    slmath::vec4 *positions         = MemoryArena::NewArray<slmath::vec4>(m_MemoryArena, particlesCapacity);
+    slmath::vec4 *previousPositions = MemoryArena::NewArray<slmath::vec4>(m_MemoryArena, particlesCapacity);
+    slmath::vec4 *accelerations     = MemoryArena::NewArray<slmath::vec4>(m_MemoryArena, particlesCapacity);
+    for (int i = 0; i < m_ParticlesCount; i++)
     {
-        delete[] m_ParticlePositions;
-        delete[] m_Accelerations;
-        delete[] m_ParticlePreviousPositions;
-        delete[] m_NewProsition;
+        positions[i]            = m_ParticlePositions[i];
+        previousPositions[i]    = m_ParticlePreviousPositions[i];
+        accelerations[i]        = m_Accelerations[i];
     }
 
-    m_ParticlesCount = particlesCount;
-    m_ParticlePositions         = new slmath::vec4[m_ParticlesCount];
-    m_ParticlePreviousPositions = new slmath::vec4[m_ParticlesCount];
-    /*m_Accelerations             = new slmath::vec4[m_ParticlesCount];
-    m_NewProsition              = new slmath::vec4[m_ParticlesCount];*/
+    MemoryArena::DeleteArray(m_MemoryArena, m_ParticlePositions);
+    MemoryArena::DeleteArray(m_MemoryArena, m_Accelerations);
+    MemoryArena::DeleteArray(m_MemoryArena, m_ParticlePreviousPositions);
+    MemoryArena::DeleteArray(m_MemoryArena, m_NewProsition);
+
+    m_ParticlesCapacity = particlesCapacity;
+    m_ParticlePositions         = positions;
+    m_ParticlePreviousPositions = previousPositions;
+    m_Accelerations             = accelerations;
+    m_NewProsition              = NULL;
+    /*m_NewProsition              = new slmath::vec4[m_ParticlesCapacity];*/
+}
+
+size_t VerletIntegration::GetMemorySize(int particlesCapacity)
+{
+    return 3 * MemoryArena::GetArraySize<slmath::vec4>(particlesCapacity);
 }
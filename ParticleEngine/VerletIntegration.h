@@ -6,6 +6,8 @@
 #include <slmath/slmath.h>
 
 class Grid3D;
+class MemoryArena;
+class ThreadPool;
 
 class VerletIntegration
 {
@@ -15,22 +17,47 @@ public:
     ~VerletIntegration();
     
     int GetParticlesCount() const;
+    int GetParticlesCapacity() const;
     slmath::vec4 *GetParticlePositions() const;
     slmath::vec4 *GetParticlePreviousPositions() const;
     void SetCommonAcceleration(const slmath::vec4 &acceleration);
     void SetDamping(float damping);
     void SetGrid3D(Grid3D *grid3D);
+    void SetMemoryArena(MemoryArena *memoryArena);
+    static size_t GetMemorySize(int particlesCapacity);
+    void ReleaseMemory();
+    // Initialize touches the arrays first with the static partition of the pool, so the pages
+    // are on the nodes of the threads stepping them. NULL touches them on the calling thread
+    void SetThreadPool(ThreadPool *threadPool);
+
+    // The previous step is kept to correct the Verlet velocity when the step changes
+    void SetDeltaT(float deltaT);
+    float GetDeltaT() const;
+    float GetPreviousDeltaT() const;
+    const slmath::vec4 &GetCommonAcceleration() const;
+    float GetDamping() const;
 
     void Initialize(slmath::vec4* positions, int particlesCount);
+
+    // Capacity is reserved to add particles without reallocation, particles are kept
+    void Reserve(int particlesCapacity);
+    // Particles written after the last one are added
+    void AddParticles(int particlesCount);
+    // Moves the particles from sources to destinations then shrinks the count
+    void CompactParticles(const int *sources, const int *destinations, int movesCount, int particlesCount);
     void AccumateAccelerations(slmath::vec4* accelerations, int particlesCount);
     void Integration();
     void ContinuousIntegration();
 
+    // Only the particles of the active list are integrated, inactive ones keep their positions
+    void AccumateAccelerations(slmath::vec4* accelerations, const int *activeIndices, int activeCount);
+    void Integration(const int *activeIndices, int activeCount);
+    // With their own step, steps are indexed by particle, previousDeltaTs is updated
+    void Integration(const int *activeIndices, int activeCount, const float *deltaTs, float *previousDeltaTs);
+
 
     void SwapPositionBuffer();
 private:
-    void ReallocParticles(int particlesCount);
-    
 
     slmath::vec4   *m_NewProsition;
     slmath::vec4   *m_ParticlePositions;
@@ -39,10 +66,14 @@ private:
     slmath::vec4    m_CommonAcceleration;
     
     Grid3D          *m_Grid3D;
+    MemoryArena     *m_MemoryArena;
+    ThreadPool      *m_ThreadPool;
 
     float           m_DeltaT;
+    float           m_PreviousDeltaT;
     float           m_Damping;
     int             m_ParticlesCount;
+    int             m_ParticlesCapacity;
 };
 
 
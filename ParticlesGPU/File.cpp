@@ -1,15 +1,28 @@
 #include "File.hpp"
+#include "Utility/Platform.h"
+
+#include <atomic>
 
 
 int File::writeBinaryToFile(const char* fileName, const char* birary, size_t numBytes)
 {
-    FILE *output = NULL;
-    fopen_s(&output, fileName, "wb");
+    // Written under a name of its own then renamed, another process never reads a partial
+    // file and two processes writing the same binary don't mix their bytes
+    static std::atomic<int> s_TemporaryFilesCount(0);
+    char suffix[64];
+    sprintf(suffix, ".%d.%d.tmp", GetProcessIdentifier(), s_TemporaryFilesCount++);
+    const std::string temporaryFileName = std::string(fileName) + suffix;
+
+    FILE *output = OpenFile(temporaryFileName.c_str(), "wb");
     if(output == NULL)
         return s_Failure;
 
-    fwrite(birary, sizeof(char), numBytes, output);
-    fclose(output);
+    const bool isWritten = fwrite(birary, sizeof(char), numBytes, output) == numBytes;
+    if (fclose(output) != 0 || ! isWritten || ! ReplaceFileAtomically(temporaryFileName.c_str(), fileName))
+    {
+        remove(temporaryFileName.c_str());
+        return s_Failure;
+    }
 
     return s_Success;
 }
@@ -17,29 +30,40 @@ int File::writeBinaryToFile(const char* fileName, const char* birary, size_t num
 int File::readBinaryFromFile(const char* fileName)
 {
     FILE * input = NULL;
-    size_t size = 0;
+    long size = 0;
     char* binary = NULL;
 
-    fopen_s(&input, fileName, "rb");
+    input = OpenFile(fileName, "rb");
     if(input == NULL)
     {
         return s_Failure;
     }
 
+    // An empty or truncated file is a failure, the caller builds from the source
     fseek(input, 0L, SEEK_END); 
     size = ftell(input);
     rewind(input);
+    if (size <= 0)
+    {
+        fclose(input);
+        return s_Failure;
+    }
+
     binary = (char*)malloc(size);
     if(binary == NULL)
     {
+        fclose(input);
         return s_Failure;
     }
-    fread(binary, sizeof(char), size, input);
+    const bool isRead = fread(binary, sizeof(char), size, input) == static_cast<size_t>(size);
     fclose(input);
-    m_Source.assign(binary, size);
+    if (isRead)
+    {
+        m_Source.assign(binary, size);
+    }
     free(binary);
 
-    return s_Success;
+    return isRead ? s_Success : s_Failure;
 }
 
 bool File::open(const char* fileName)
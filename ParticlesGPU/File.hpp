@@ -19,7 +19,7 @@ public:
     bool open(const char* fileName);
 
 	//
-	//writeBinaryToFile
+	//writeBinaryToFile, through a temporary file renamed over fileName
 	//@param fileName Name of the file
 	//@param binary char binary array
 	//@param numBytes number of bytes
@@ -28,7 +28,7 @@ public:
     int writeBinaryToFile(const char* fileName, const char* binary, size_t numBytes);
 
 	//
-	//readBinaryToFile
+	//readBinaryToFile, an empty or truncated file is a failure
 	//@param fileName name of file
 	//@return true if success else false
 	//
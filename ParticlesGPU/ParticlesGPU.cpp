@@ -11,17 +11,24 @@
 #include "ParticleEngine/ParticlesSpring.h"
 #include "ParticleEngine/ParticlesAccelerator.h"
 #include "Utility/Utility.h"
-#include "Utility/Timer.h"
+#include "Utility/HalfFloat.h"
+#include "Utility/Profiler.h"
 
 
-#include <CL/cl_d3d11.h>
-#include <CL/cl_d3d11_ext.h>
+#ifdef _WIN32
+    #include <CL/cl_d3d11.h>
+    #include <CL/cl_d3d11_ext.h>
+#endif // _WIN32
 #include <CL/cl_ext.h>
 
 
-#pragma warning( disable : 4996 )
+#ifdef _MSC_VER
+    #pragma warning( disable : 4996 )
+#endif // _MSC_VER
 
 
+// Direct3D 11 interoperability only exists on Windows
+#ifdef _WIN32
 clGetDeviceIDsFromD3D11KHR_fn       clGetDeviceIDsFromD3D11KHR      = NULL;
 clCreateFromD3D11BufferKHR_fn		clCreateFromD3D11BufferKHR      = NULL;
 clCreateFromD3D11Texture2DKHR_fn	clCreateFromD3D11Texture2DKHR   = NULL;
@@ -35,6 +42,7 @@ clCreateFromD3D11Texture2DNV_fn		clCreateFromD3D11Texture2DNV   = NULL;
 clCreateFromD3D11Texture3DNV_fn     clCreateFromD3D11Texture3DNV   = NULL;
 clEnqueueAcquireD3D11ObjectsNV_fn	clEnqueueAcquireD3D11ObjectsNV = NULL;
 clEnqueueReleaseD3D11ObjectsNV_fn	clEnqueueReleaseD3D11ObjectsNV = NULL;
+#endif // _WIN32
 
 
 
@@ -44,49 +52,112 @@ clEnqueueReleaseD3D11ObjectsNV_fn	clEnqueueReleaseD3D11ObjectsNV = NULL;
 
 
 bool                ParticlesGPU::s_IsSetup             = false;
-bool                ParticlesGPU::s_ProgramIsCompiled   = false;
+bool                ParticlesGPU::s_ProgramIsCompiled[s_ContextCount];
 bool                ParticlesGPU::s_IsAmdHardware       = false;
 
 cl_context          ParticlesGPU::s_Context[s_ContextCount];
 cl_device_id*       ParticlesGPU::s_Devices[s_ContextCount];
-cl_program          ParticlesGPU::s_Program;
+int                 ParticlesGPU::s_DevicesCount[s_ContextCount];
+cl_program          ParticlesGPU::s_Program[s_ContextCount];
+std::map<std::string, cl_program> ParticlesGPU::s_SpecializedPrograms[s_ContextCount];
 cl_platform_id      ParticlesGPU::s_PlatformId;
 
+const char          *ParticlesGPU::s_CommandZoneNames[eZonesCount] =
+{
+    "ComputeMinMax",
+    "ReduceBounds",
+    "CreateGrid",
+    "RadixHistogram",
+    "RadixScan",
+    "RadixScatter",
+    "ClearCellTable",
+    "BuildCellTable",
+    "ComputeSPH",
+    "CopyBuffer",
+    "ComputeCollision",
+    "ComputeSpring",
+    "ComputeAccelerator",
+    "ComputeAnimation",
+    "Write buffer",
+    "Read buffer",
+    "Copy buffer",
+    "Command"
+};
+
 
 ParticlesGPU::ParticlesGPU() :
         m_ParticlesCount(0),
+        m_ParticlesCapacity(0),
+        m_ClothCount(1),
         m_LocalThreads(1),
+        m_LocalThreadsMinMax(1),
+        m_GlobalThreadsMinMax(1),
+        m_CellTableSize(0),
+        m_MaxWorkGroupSize(1),
+        m_IsUsingInteroperability(false),
+        m_ContextIndex(0),
+        m_DeltaT(1.0f / 60.0f),
+        m_PreviousDeltaT(1.0f / 60.0f),
         m_Positions(NULL),
         m_PreviousPositions(NULL),
         m_NeighborsInfo(NULL),
         m_Pressures(NULL),
         m_Density(NULL),
-        m_DeviceId(0),
-        m_ByteRWSupport(true),
-        m_ClothCount(1),
-        m_IsUsingInteroperability(false),
-        m_ContextIndex(0),
         m_PositionsBuffer(NULL),
         m_PreviousPositionsBuffer(NULL),
         m_NeighborsInfoBuffer(NULL),
         m_NeighborsInfoBuffer2(NULL),
         m_OutputBuffer(NULL),
+        m_OutputPreviousPositionsBuffer(NULL),
         m_SpheresBuffer(NULL),
         m_SpheresInBuffer(NULL),
         m_AabbsBuffer(NULL),
         m_SpringsBuffer(NULL),
         m_AcceleratorsBuffer(NULL),
         m_GridInfoBuffer(NULL),
+        m_RadixHistogramsBuffer(NULL),
+        m_CellTableBuffer(NULL),
         m_MinMaxBuffer(NULL),
         m_PreviousDensityBuffer(NULL),
         m_OutputDensityBuffer(NULL),
         m_SphParametersBuffer(NULL),
         m_StartsAnimationBuffer(NULL),
         m_EndsAnimationBuffer(NULL),
+        m_StagingBuffer(NULL),
+        m_StagedSphParameters(NULL),
+        m_StagedGridInfo(NULL),
+        m_StagedSpheres(NULL),
+        m_StagedSpheresIn(NULL),
+        m_StagedAabbs(NULL),
+        m_StagedAccelerators(NULL),
+        m_StagedPreviousPositions(NULL),
+        m_LastEvent(NULL),
+        m_ProfiledCommandsCount(0),
+        m_ProfilerTrackId(-1),
+        m_IsProfilingCommands(false),
+        m_IsReadingPositions(false),
+        m_IsReadingPreviousPositions(false),
+        m_IsPositionsOnDevice(false),
+        m_IsPreviousPositionsOnDevice(false),
+        m_IsReadingBackDensities(false),
+        m_IsReadingDensities(false),
+        m_ShapesGeneration(0),
+        m_UploadedShapesGeneration(0),
+        m_AcceleratorsGeneration(0),
+        m_UploadedAcceleratorsGeneration(0),
+        m_SphParametersGeneration(0),
+        m_UploadedSphParametersGeneration(0),
+        m_IsSpecializingKernels(false),
+        m_ByteRWSupport(true),
+        m_DeviceId(0),
         m_CreateGridKernel(NULL),
-        m_SortLocalKernel(NULL),
-        m_MergeSortKernel(NULL),
+        m_RadixHistogramKernel(NULL),
+        m_RadixScanKernel(NULL),
+        m_RadixScatterKernel(NULL),
+        m_ClearCellTableKernel(NULL),
+        m_BuildCellTableKernel(NULL),
         m_MinMaxKernel(NULL),
+        m_ReduceBoundsKernel(NULL),
         m_SPHIntegrateKernel(NULL),
         m_CopyBufferKernel(NULL),
         m_CollisionKernel(NULL),
@@ -110,6 +181,23 @@ void ParticlesGPU::SetAnimationTime(float animationTime)
     m_AnimationTime = animationTime;
 }
 
+void ParticlesGPU::SetIsSpecializingKernels(bool isSpecializingKernels)
+{
+    m_IsSpecializingKernels = isSpecializingKernels;
+}
+
+bool ParticlesGPU::IsSpecializingKernels() const
+{
+    return m_IsSpecializingKernels;
+}
+
+void ParticlesGPU::SetDeltaT(float deltaT)
+{
+    assert(deltaT > 0.0f);
+    m_PreviousDeltaT = m_DeltaT;
+    m_DeltaT = deltaT;
+}
+
 void ParticlesGPU::SetIsUsingCPU(bool isUsingCPU)
 {
     if (isUsingCPU)
@@ -127,6 +215,62 @@ bool ParticlesGPU::IsUsingCPU() const
     return m_ContextIndex == 1;
 }
 
+void ParticlesGPU::SetDeviceIndex(int deviceIndex)
+{
+    assert(deviceIndex >= 0);
+    m_DeviceId = deviceIndex;
+}
+
+int ParticlesGPU::GetDeviceIndex() const
+{
+    return m_DeviceId;
+}
+
+int ParticlesGPU::GetDevicesCount(bool isUsingCPU)
+{
+    assert(s_IsSetup && "ParticlesGPU::Setup must be called first.");
+    return s_DevicesCount[isUsingCPU ? 1 : 0];
+}
+
+void ParticlesGPU::SetIsReadingDensities(bool isReadingDensities)
+{
+    m_IsReadingBackDensities = isReadingDensities;
+}
+
+void ParticlesGPU::SetIsProfilingCommands(bool isProfilingCommands)
+{
+    m_IsProfilingCommands = isProfilingCommands;
+}
+
+void ParticlesGPU::SetActiveParticlesCount(int particlesCount)
+{
+    assert(particlesCount > 0 && particlesCount <= m_ParticlesCapacity);
+    if (particlesCount == m_ParticlesCount)
+        return;
+
+    // Buffers keep the capacity size, only the launched work items change
+    m_ParticlesCount = particlesCount;
+    ComputeLaunchSizes(particlesCount);
+    assert(( ! m_Pipeline.m_IsCreatingGridOnGPU || m_LocalThreads >= 16) && "The radix sort needs at least 16 work items by work group.");
+
+    // Particles are uploaded again with the new count
+    InvalidateDeviceParticles();
+}
+
+void ParticlesGPU::ComputeLaunchSizes(int particlesCount)
+{
+    m_GlobalThreads = slmath::roundToPowerOf2(particlesCount);
+    m_LocalThreads  = slmath::min(slmath::roundToPowerOf2((particlesCount >> 1) + 1), m_MaxWorkGroupSize);
+    m_WorkGroupCount = m_GlobalThreads / m_LocalThreads;
+
+    // Each work item of the bounds first pass reads two particles
+    m_GlobalThreadsMinMax = std::max(m_GlobalThreads / 2, static_cast<size_t>(1));
+    m_LocalThreadsMinMax  = std::min(m_GlobalThreadsMinMax, m_LocalThreads);
+
+    // At most one cell by particle, the table stays at most half full so the probes are short
+    m_CellTableSize = 2 * m_GlobalThreads;
+}
+
 void ParticlesGPU::SetIsUsingInteroperability(bool isUsingInteroperability)
 {
     m_IsUsingInteroperability = isUsingInteroperability;
@@ -200,7 +344,8 @@ void ParticlesGPU::UpdateInput(slmath::vec4 *positions, float * density, int *ne
 
 
 void ParticlesGPU::UpdateInputSPH(  slmath::vec4 *positions, slmath::vec4 *previousPositions, float * density, 
-                                    int *neighborInfo, int *gridInfo, const SphParameters& sphParameters)
+                                    int *neighborInfo, int *gridInfo, const SphParameters& sphParameters,
+                                    unsigned int parametersGeneration)
 {
     assert(gridInfo[0] == m_ParticlesCount);
 
@@ -211,12 +356,14 @@ void ParticlesGPU::UpdateInputSPH(  slmath::vec4 *positions, slmath::vec4 *previ
     m_GridInfo          = reinterpret_cast<cl_int4*>(gridInfo);
     m_NeighborsInfo     = reinterpret_cast<cl_int2*>(neighborInfo);
     m_SphParameters     = &sphParameters;
+    m_SphParametersGeneration = parametersGeneration;
 }
 
 void ParticlesGPU::UpdateInputCollision(slmath::vec4 *positions, slmath::vec4 *previousPositions, int particlesCount, 
                                         const Sphere *spheres, int spheresCount,
                                         const Sphere *spheresIn, int spheresInCount,
-                                        const Aabb *aabbs, int aabbsCount)
+                                        const Aabb *aabbs, int aabbsCount,
+                                        unsigned int shapesGeneration)
 {
     assert( spheresCount <= MAX_SHAPES_COUNT);
     assert( spheresInCount <= MAX_SHAPES_COUNT);
@@ -234,6 +381,7 @@ void ParticlesGPU::UpdateInputCollision(slmath::vec4 *positions, slmath::vec4 *p
     m_ShapesCount.s[1] = spheresInCount;
     m_ShapesCount.s[2] = 2 * aabbsCount;
     m_ShapesCount.s[3] = 0;
+    m_ShapesGeneration = shapesGeneration;
 }
 
 void ParticlesGPU::UpdateInputSpring(slmath::vec4 *positions, int particlesCount, const Spring *springs, int springsCount)
@@ -249,7 +397,8 @@ void ParticlesGPU::UpdateInputSpring(slmath::vec4 *positions, int particlesCount
 }
 
 void ParticlesGPU::UpdateInputAccelerator(  slmath::vec4 *positions, slmath::vec4 *previousPositions, int particlesCount, 
-                                            const Accelerator *accelerators, int acceleratorsCount)
+                                            const Accelerator *accelerators, int acceleratorsCount,
+                                            unsigned int acceleratorsGeneration)
 {
     UNUSED_PARAMETER(particlesCount);
     assert(particlesCount == m_ParticlesCount);
@@ -261,6 +410,7 @@ void ParticlesGPU::UpdateInputAccelerator(  slmath::vec4 *positions, slmath::vec
     m_Positions = reinterpret_cast<cl_float4*>(positions);
     m_PreviousPositions = reinterpret_cast<cl_float4*>(previousPositions);
     m_Accelerators = accelerators;
+    m_AcceleratorsGeneration = acceleratorsGeneration;
 }
 
 void ParticlesGPU::UpdateInputAnimation(slmath::vec4 *positions, slmath::vec4 *ends, int particlesCount)
@@ -271,25 +421,233 @@ void ParticlesGPU::UpdateInputAnimation(slmath::vec4 *positions, slmath::vec4 *e
     m_EndsAnimation = reinterpret_cast<cl_float4*>(ends);
 }
 
+std::string ParticlesGPU::GetProgramBinaryFileName(int contextIndex, int deviceIndex, const std::string& source, const char *buildOptions)
+{
+    char platformName[s_TextSizeOnStack];
+    char deviceName[s_TextSizeOnStack];
+    char driverVersion[s_TextSizeOnStack];
+    memset(platformName, 0, s_TextSizeOnStack);
+    memset(deviceName, 0, s_TextSizeOnStack);
+    memset(driverVersion, 0, s_TextSizeOnStack);
+
+    // Two platforms can expose the same device, an ICD binary is only loaded by its own
+    cl_platform_id platform = NULL;
+    cl_int status = clGetDeviceInfo(s_Devices[contextIndex][deviceIndex], CL_DEVICE_PLATFORM, sizeof(cl_platform_id), &platform, NULL);
+    assert(status == CL_SUCCESS && "clGetDeviceInfo(CL_DEVICE_PLATFORM) failed");
+    status = clGetPlatformInfo(platform, CL_PLATFORM_NAME, s_TextSizeOnStack - 1, platformName, NULL);
+    assert(status == CL_SUCCESS && "clGetPlatformInfo(CL_PLATFORM_NAME) failed");
+    status = clGetDeviceInfo(s_Devices[contextIndex][deviceIndex], CL_DEVICE_NAME, s_TextSizeOnStack - 1, deviceName, NULL);
+    assert(status == CL_SUCCESS && "clGetDeviceInfo(CL_DEVICE_NAME) failed");
+    status = clGetDeviceInfo(s_Devices[contextIndex][deviceIndex], CL_DRIVER_VERSION, s_TextSizeOnStack - 1, driverVersion, NULL);
+    assert(status == CL_SUCCESS && "clGetDeviceInfo(CL_DRIVER_VERSION) failed");
+    UNUSED_PARAMETER(status);
+
+    // FNV-1a of everything changing the binary, the terminating zeros separate the fields
+    const char *fields[] = {source.c_str(), platformName, deviceName, driverVersion, buildOptions};
+    const int fieldsCount = sizeof(fields) / sizeof(fields[0]);
+    unsigned long long hash = 14695981039346656037ULL;
+    for (int i = 0; i < fieldsCount; i++)
+    {
+        const char *character = fields[i];
+        do
+        {
+            hash ^= static_cast<unsigned char>(*character);
+            hash *= 1099511628211ULL;
+        }
+        while (*character++ != '\0');
+    }
+
+    // Same relative directory as the kernel source, '/' is a separator on every platform
+    char fileName[64];
+    sprintf(fileName, "openCL/ParticlesGPU_Kernels_%016llx.bin", hash);
+    return std::string(fileName);
+}
+
+int ParticlesGPU::LoadProgramBinaries(int contextIndex, const std::string& source, const char *buildOptions, cl_program *program)
+{
+    // One binary by device of the context, all of them are needed
+    const int devicesCount = s_DevicesCount[contextIndex];
+    File *binaryFiles = new File[devicesCount];
+    const unsigned char **binaries = new const unsigned char *[devicesCount];
+    size_t *binarySizes = new size_t[devicesCount];
+    cl_int *binaryStatus = new cl_int[devicesCount];
+
+    cl_int status = CL_SUCCESS;
+    for (int i = 0; i < devicesCount && status == CL_SUCCESS; i++)
+    {
+        const std::string binaryFileName = GetProgramBinaryFileName(contextIndex, i, source, buildOptions);
+        if (binaryFiles[i].readBinaryFromFile(binaryFileName.c_str()) != 0)
+        {
+            status = CL_INVALID_BINARY;
+            break;
+        }
+        binaries[i] = reinterpret_cast<const unsigned char *>(binaryFiles[i].source().c_str());
+        binarySizes[i] = binaryFiles[i].source().size();
+        binaryStatus[i] = CL_SUCCESS;
+    }
+
+    if (status == CL_SUCCESS)
+    {
+        *program = clCreateProgramWithBinary(   s_Context[contextIndex],
+                                                devicesCount,
+                                                s_Devices[contextIndex],
+                                                binarySizes,
+                                                binaries,
+                                                binaryStatus,
+                                                &status);
+        for (int i = 0; i < devicesCount && status == CL_SUCCESS; i++)
+        {
+            status = binaryStatus[i];
+        }
+
+        // A binary still needs to be built, it is fast
+        if (status == CL_SUCCESS)
+        {
+            status = clBuildProgram(*program, devicesCount, s_Devices[contextIndex], buildOptions, NULL, NULL);
+        }
+        if (status != CL_SUCCESS)
+        {
+            if (*program != NULL)
+            {
+                clReleaseProgram(*program);
+                *program = NULL;
+            }
+            status = CL_INVALID_BINARY;
+        }
+    }
+
+    delete[] binaryStatus;
+    delete[] binarySizes;
+    delete[] binaries;
+    delete[] binaryFiles;
+    return status;
+}
+
+void ParticlesGPU::SaveProgramBinaries(int contextIndex, const std::string& source, const char *buildOptions, cl_program program)
+{
+    // The program is built for every device of the context, in the context order
+    const int devicesCount = s_DevicesCount[contextIndex];
+    size_t *binarySizes = new size_t[devicesCount];
+    cl_int status = clGetProgramInfo(program, CL_PROGRAM_BINARY_SIZES, sizeof(size_t) * devicesCount, binarySizes, NULL);
+    if (status != CL_SUCCESS)
+    {
+        delete[] binarySizes;
+        return;
+    }
+
+    unsigned char **binaries = new unsigned char *[devicesCount];
+    for (int i = 0; i < devicesCount; i++)
+    {
+        binaries[i] = new unsigned char[std::max(binarySizes[i], static_cast<size_t>(1))];
+    }
+
+    status = clGetProgramInfo(program, CL_PROGRAM_BINARIES, sizeof(unsigned char *) * devicesCount, binaries, NULL);
+    for (int i = 0; i < devicesCount && status == CL_SUCCESS; i++)
+    {
+        if (binarySizes[i] == 0)
+            continue;
+
+        // A failed write only costs a compilation at the next launch
+        const std::string binaryFileName = GetProgramBinaryFileName(contextIndex, i, source, buildOptions);
+        File binaryFile;
+        if (binaryFile.writeBinaryToFile(binaryFileName.c_str(), reinterpret_cast<const char *>(binaries[i]), binarySizes[i]) != 0)
+        {
+            DEBUG_OUT("Failed to write kernel binary: " << binaryFileName.c_str() << std::endl);
+        }
+    }
+
+    for (int i = 0; i < devicesCount; i++)
+    {
+        delete[] binaries[i];
+    }
+    delete[] binaries;
+    delete[] binarySizes;
+}
+
 int ParticlesGPU::BuildOpenCLProgram(int contextIndex)
 {
-    if (s_ProgramIsCompiled)
+    if (s_ProgramIsCompiled[contextIndex])
     {
         return CL_SUCCESS;
     }
 
+    cl_int status = CompileProgram(contextIndex, "", &s_Program[contextIndex]);
+
+    // Success to be sure to compile just once
+    s_ProgramIsCompiled[contextIndex] = (status == CL_SUCCESS);
+    return status;
+}
+
+cl_program ParticlesGPU::GetSpecializedProgram(int contextIndex, const std::string& buildOptions)
+{
+    // Variants stay built until StaticRelease, a scene going back to known parameters reuses its program
+    std::map<std::string, cl_program>& programs = s_SpecializedPrograms[contextIndex];
+    std::map<std::string, cl_program>::iterator variant = programs.find(buildOptions);
+    if (variant != programs.end())
+    {
+        return variant->second;
+    }
+
+    cl_program program = NULL;
+    if (CompileProgram(contextIndex, buildOptions.c_str(), &program) != CL_SUCCESS)
+    {
+        if (program != NULL)
+        {
+            clReleaseProgram(program);
+        }
+        return NULL;
+    }
+    programs[buildOptions] = program;
+    return program;
+}
+
+std::string ParticlesGPU::GetSPHBuildOptions(const SphParameters& sphParameters)
+{
+    // Same coefficients as the generic ComputeSPH, 9 digits give back the same floats
+    const float PI = 3.141592659f;
+    const float mass = sphParameters.m_Mass;
+    const float h = sphParameters.m_H;
+    const float sqrH = h * h;
+
+    char buildOptions[512];
+    sprintf(buildOptions,   "-D SPH_SPECIALIZED -D SPH_MASS=%.9ef -D SPH_H=%.9ef -D SPH_MU_VISCOSITY=%.9ef "
+                            "-D SPH_INVERSE_H=%.9ef -D SPH_SELF_DENSITY=%.9ef -D SPH_DENSITY_COEFFICIENT=%.9ef "
+                            "-D SPH_PRESSURE_COEFFICIENT=%.9ef -D SPH_VISCOSITY_COEFFICIENT=%.9ef",
+                            mass,
+                            h,
+                            sphParameters.m_MuViscosity,
+                            1.0f / h,
+                            4.0f * mass  / (PI*sqrH*sqrH*sqrH),
+                            mass * ( 15.0f / (PI*h*sqrH) ),
+                            mass * sphParameters.m_GazConstant * 0.5f * ( 45.0f / (PI*sqrH*sqrH) ),
+                            mass * ( 45.0f / (PI*sqrH*sqrH*sqrH) ));
+    return std::string(buildOptions);
+}
+
+int ParticlesGPU::CompileProgram(int contextIndex, const char *buildOptions, cl_program *program)
+{
     cl_int status = CL_SUCCESS;
     File kernelFile;
     
-    std::string kernelFileName("openCL\\ParticlesGPU_Kernels.cl");
+    std::string kernelFileName("openCL/ParticlesGPU_Kernels.cl");
     if(!kernelFile.open(kernelFileName.c_str()))
     {
         DEBUG_OUT("Failed to load kernel file: " << kernelFileName.c_str() << std::endl);
         assert(false && "Failed to load kernel file");
     }
+
+    // Binaries are cached by source, platform, device, driver and options. The source is
+    // compiled on a miss and when the runtime rejects the binary, the new one replaces it
+    *program = NULL;
+    if (LoadProgramBinaries(contextIndex, kernelFile.source(), buildOptions, program) == CL_SUCCESS)
+    {
+        return CL_SUCCESS;
+    }
+    DEBUG_OUT("Kernel binary missing or rejected, compiling: " << kernelFileName.c_str() << std::endl);
+
     const char * source = kernelFile.source().c_str();
     size_t sourceSize[] = {strlen(source)};
-    s_Program = clCreateProgramWithSource(s_Context[contextIndex],
+    *program = clCreateProgramWithSource(s_Context[contextIndex],
                                         1,
                                         &source,
                                         sourceSize,
@@ -299,7 +657,7 @@ int ParticlesGPU::BuildOpenCLProgram(int contextIndex)
 
     
     // Create a cl program executable for all the devices specified
-    status = clBuildProgram(s_Program, 1, s_Devices[contextIndex], "", NULL, NULL);
+    status = clBuildProgram(*program, s_DevicesCount[contextIndex], s_Devices[contextIndex], buildOptions, NULL, NULL);
     if(status != CL_SUCCESS)
     {
         if(status == CL_BUILD_PROGRAM_FAILURE)
@@ -310,7 +668,7 @@ int ParticlesGPU::BuildOpenCLProgram(int contextIndex)
             memset(buildLog, 0, s_TextSizeOnStack);
 
             logStatus = clGetProgramBuildInfo (
-                            s_Program, 
+                            *program, 
                             s_Devices[contextIndex][0], 
                             CL_PROGRAM_BUILD_LOG, 
                             s_TextSizeOnStack, 
@@ -319,7 +677,6 @@ int ParticlesGPU::BuildOpenCLProgram(int contextIndex)
 
             if(logStatus != CL_SUCCESS)
             {
-                free(buildLog);
                 return logStatus;
             }
 
@@ -327,14 +684,13 @@ int ParticlesGPU::BuildOpenCLProgram(int contextIndex)
             DEBUG_OUT( " ************************************************\n");
             DEBUG_OUT( buildLog << std::endl);
             DEBUG_OUT( " ************************************************\n");
-            free(buildLog);
             assert(logStatus != CL_SUCCESS  && "clGetProgramBuildInfo failed.");
         }
 
         assert(status == CL_SUCCESS  && "clBuildProgram failed.");
+        return status;
     }
-    // Success to be sure to compile just once
-    s_ProgramIsCompiled = true;
+    SaveProgramBinaries(contextIndex, kernelFile.source(), buildOptions, *program);
     return status;
 }
 
@@ -410,9 +766,20 @@ int ParticlesGPU::Setup(ID3D11Device* d3D11Device /*= NULL*/)
                       NULL,
                       NULL,
                       &status);
+
+        // A platform doesn't always have both device types, the missing context stays empty
+        s_Devices[contextIndex] = NULL;
+        s_DevicesCount[contextIndex] = 0;
+        if (status == CL_DEVICE_NOT_FOUND)
+        {
+            DEBUG_OUT("No OpenCL device of type " << dTypes[contextIndex] << std::endl);
+            s_Context[contextIndex] = NULL;
+            status = CL_SUCCESS;
+            continue;
+        }
         assert(status == CL_SUCCESS  && "clCreateContextFromType failed.");
 
-       
+#ifdef _WIN32
         if (d3D11Device != NULL && dTypes[contextIndex] == CL_DEVICE_TYPE_GPU)
         {
 
@@ -437,6 +804,7 @@ int ParticlesGPU::Setup(ID3D11Device* d3D11Device /*= NULL*/)
                 assert(status == 0 && "clGetDeviceIDsFromD3D11KHR failed.");
 
                 s_Devices[contextIndex] = new cl_device_id[deviceCount];
+                s_DevicesCount[contextIndex] = deviceCount;
                 assert(s_Devices[contextIndex] != NULL && "Failed to allocate memory (devices).");
 
 
@@ -464,6 +832,7 @@ int ParticlesGPU::Setup(ID3D11Device* d3D11Device /*= NULL*/)
                 assert(status == 0 && "clGetDeviceIDsFromD3D11NV failed.");
 
                 s_Devices[contextIndex] = new cl_device_id[deviceCount];
+                s_DevicesCount[contextIndex] = deviceCount;
                 assert(s_Devices[contextIndex] != NULL && "Failed to allocate memory (devices).");
 
 
@@ -481,10 +850,13 @@ int ParticlesGPU::Setup(ID3D11Device* d3D11Device /*= NULL*/)
 
         }
         else
+#else // _WIN32
+        assert(d3D11Device == NULL && "Interoperability needs Direct3D 11.");
+        UNUSED_PARAMETER(d3D11Device);
+#endif // _WIN32
         {
             // First, get the size of device list data
             size_t deviceListSize = 0;
-	        int status = 0;
 	        status = clGetContextInfo(
                          s_Context[contextIndex],
                          CL_CONTEXT_DEVICES, 
@@ -504,6 +876,7 @@ int ParticlesGPU::Setup(ID3D11Device* d3D11Device /*= NULL*/)
 	        // 
 
             s_Devices[contextIndex] = new cl_device_id[deviceCount];
+            s_DevicesCount[contextIndex] = deviceCount;
 
             assert(s_Devices[contextIndex] != NULL && "Failed to allocate memory (devices).");
 
@@ -551,36 +924,67 @@ int ParticlesGPU::CreeateKernels()
     
     cl_int status = 0;
 
+    // The precision defines select a variant of the generic program
+    cl_program program = s_Program[m_ContextIndex];
+    if ( ! m_ProgramBuildOptions.empty())
+    {
+        program = GetSpecializedProgram(m_ContextIndex, m_ProgramBuildOptions);
+        if (program == NULL)
+        {
+            assert(false && "Failed to build the program variant.");
+            return CL_BUILD_PROGRAM_FAILURE;
+        }
+    }
+
     if (m_Pipeline.m_IsCreatingGridOnGPU)
     {
         // get a kernel object handle for a kernel with the given name
-        m_CreateGridKernel = clCreateKernel(s_Program, "CreateGrid", &status);
+        m_CreateGridKernel = clCreateKernel(program, "CreateGrid", &status);
         assert(status == CL_SUCCESS && "clCreateKernel CreateGrid failed");
 
         // get a kernel object handle for a kernel with the given name
-        m_SortLocalKernel = clCreateKernel(s_Program, "SortLocalGridCells", &status);
-        assert(status == CL_SUCCESS && "clCreateKernel SortLocalGridCells failed");
+        m_RadixHistogramKernel = clCreateKernel(program, "RadixHistogram", &status);
+        assert(status == CL_SUCCESS && "clCreateKernel RadixHistogram failed");
+
+        // get a kernel object handle for a kernel with the given name
+        m_RadixScanKernel = clCreateKernel(program, "RadixScan", &status);
+        assert(status == CL_SUCCESS && "clCreateKernel RadixScan failed");
 
         // get a kernel object handle for a kernel with the given name
-        m_MergeSortKernel = clCreateKernel(s_Program, "MergeSortGridCells", &status);
-        assert(status == CL_SUCCESS && "clCreateKernel m_MergeSortKernel failed");
+        m_RadixScatterKernel = clCreateKernel(program, "RadixScatter", &status);
+        assert(status == CL_SUCCESS && "clCreateKernel RadixScatter failed");
+
+        if (m_Pipeline.m_SPHAndIntegrateOnGPU)
+        {
+            // get a kernel object handle for a kernel with the given name
+            m_ClearCellTableKernel = clCreateKernel(program, "ClearCellTable", &status);
+            assert(status == CL_SUCCESS && "clCreateKernel ClearCellTable failed");
+
+            // get a kernel object handle for a kernel with the given name
+            m_BuildCellTableKernel = clCreateKernel(program, "BuildCellTable", &status);
+            assert(status == CL_SUCCESS && "clCreateKernel BuildCellTable failed");
+        }
 
         // get a kernel object handle for a kernel with the given name
-        m_MinMaxKernel = clCreateKernel(s_Program, "ComputeMinMax", &status);
+        m_MinMaxKernel = clCreateKernel(program, "ComputeMinMax", &status);
         assert(status == CL_SUCCESS && "clCreateKernel ComputeMinMax failed");
+
+        // get a kernel object handle for a kernel with the given name
+        m_ReduceBoundsKernel = clCreateKernel(program, "ReduceBounds", &status);
+        assert(status == CL_SUCCESS && "clCreateKernel ReduceBounds failed");
     }
 
     if (m_Pipeline.m_SPHAndIntegrateOnGPU)
     {
         // get a kernel object handle for a kernel with the given name
-        m_SPHIntegrateKernel = clCreateKernel(s_Program, "ComputeSPH", &status);
+        m_SPHIntegrateKernel = clCreateKernel(program, "ComputeSPH", &status);
         assert(status == CL_SUCCESS && "clCreateKernel ComputeSPH failed");
     }
 
     if (m_Pipeline.m_CollisionOnGPU)
     {
         // get a kernel object handle for a kernel with the given name
-        m_CollisionKernel = clCreateKernel(s_Program, "ComputeCollision", &status);
+        m_CollisionKernel = clCreateKernel(program, "ComputeCollision", &status);
         assert(status == CL_SUCCESS && "clCreateKernel ComputeCollision failed");
     }
 
@@ -588,30 +992,36 @@ int ParticlesGPU::CreeateKernels()
     if (m_Pipeline.m_SpringOnGPU)
     {
         // get a kernel object handle for a kernel with the given name
-        m_SpringKernel = clCreateKernel(s_Program, "ComputeSpring", &status);
+        m_SpringKernel = clCreateKernel(program, "ComputeSpring", &status);
         assert(status == CL_SUCCESS && "clCreateKernel ComputeSpring failed");
     }
 
     if (m_Pipeline.m_AcceleratorOnGPU)
     {
         // get a kernel object handle for a kernel with the given name
-        m_AcceleratorKernel = clCreateKernel(s_Program, "ComputeAccelerator", &status);
+        m_AcceleratorKernel = clCreateKernel(program, "ComputeAccelerator", &status);
         assert(status == CL_SUCCESS && "clCreateKernel ComputeAccelerator failed");
     }
 
     if (m_Pipeline.m_IsUsingAnimation)
     {
         // get a kernel object handle for a kernel with the given name
-        m_AnimationKernel = clCreateKernel(s_Program, "ComputeAnimation", &status);
+        m_AnimationKernel = clCreateKernel(program, "ComputeAnimation", &status);
         assert(status == CL_SUCCESS && "clCreateKernel ComputeAnimation failed");
     }
 
     if (m_Pipeline.m_SPHAndIntegrateOnGPU || m_Pipeline.m_IsUsingAnimation)
     {
         // get a kernel object handle for a kernel with the given name
-        m_CopyBufferKernel = clCreateKernel(s_Program, "CopyBuffer", &status);
+        m_CopyBufferKernel = clCreateKernel(program, "CopyBuffer", &status);
         assert(status == CL_SUCCESS && "clCreateKernel CopyBuffer failed");
     }
+
+    Profiler *profiler = Profiler::GetInstance();
+    for (int i = 0; i < eZonesCount; i++)
+    {
+        m_CommandZoneIds[i] = m_IsProfilingCommands ? profiler->RegisterZone(s_CommandZoneNames[i]) : -1;
+    }
     
     return status;
 }
@@ -621,7 +1031,8 @@ int ParticlesGPU::CreateBuffers(ID3D11Buffer *d3D11buffer)
     cl_int status = 0;
 
     // Create command queue
-    cl_command_queue_properties prop = 0;
+    // Timing the commands costs a little on some drivers, it is only done when asked
+    cl_command_queue_properties prop = m_IsProfilingCommands ? CL_QUEUE_PROFILING_ENABLE : 0;
     m_CommandQueue = clCreateCommandQueue(
             s_Context[m_ContextIndex], 
             s_Devices[m_ContextIndex][m_DeviceId], 
@@ -647,6 +1058,7 @@ int ParticlesGPU::CreateBuffers(ID3D11Buffer *d3D11buffer)
     }
     else
     {
+#ifdef _WIN32
         if (s_IsAmdHardware)
         {
             INITPFN(clCreateFromD3D11BufferKHR);
@@ -677,17 +1089,26 @@ int ParticlesGPU::CreateBuffers(ID3D11Buffer *d3D11buffer)
 
             assert(status == CL_SUCCESS &&  "clCreateFromD3D11BufferNV failed. (m_PositionsBuffer)");
         }
+#else // _WIN32
+        assert(false && "Interoperability needs Direct3D 11.");
+        return CL_INVALID_OPERATION;
+#endif // _WIN32
     }
 
      // Input buffer
     m_PreviousPositionsBuffer = clCreateBuffer(
         s_Context[m_ContextIndex],
         CL_MEM_READ_WRITE,
-        sizeof(cl_float4) * m_ParticlesCount,
+        GetPreviousPositionSize() * m_ParticlesCount,
         NULL,
         &status);
     assert(status == CL_SUCCESS &&  "clCreateBuffer failed. (m_PreviousPositionsBuffer)");
 
+    if (m_Pipeline.m_IsUsingHalfPreviousPositions)
+    {
+        m_StagedPreviousPositions = new cl_half[4 * m_ParticlesCount];
+    }
+
 
     if (m_Pipeline.m_IsUsingAnimation)
     {
@@ -763,14 +1184,6 @@ int ParticlesGPU::CreateBuffers(ID3D11Buffer *d3D11buffer)
         &status);
         assert(status == CL_SUCCESS &&  "clCreateBuffer failed. (m_GridInfoBuffer)");
 
-        m_MinMaxBuffer  = clCreateBuffer(
-            s_Context[m_ContextIndex],
-            CL_MEM_READ_WRITE,
-            2 * sizeof(cl_float4),
-            NULL,
-            &status);
-        assert(status == CL_SUCCESS &&  "clCreateBuffer failed. (m_MinMaxBuffer)");
-
         // Output positions buffer used to synch global barrier
         m_OutputBuffer = clCreateBuffer(s_Context[m_ContextIndex], 
                                         CL_MEM_READ_WRITE,
@@ -778,6 +1191,15 @@ int ParticlesGPU::CreateBuffers(ID3D11Buffer *d3D11buffer)
                                         NULL, 
                                         &status);
         assert(status == CL_SUCCESS &&  "clCreateBuffer failed. (m_OutputBuffer)");
+
+        // Previous positions double buffer
+        m_OutputPreviousPositionsBuffer = clCreateBuffer(
+            s_Context[m_ContextIndex],
+            CL_MEM_READ_WRITE,
+            GetPreviousPositionSize() * m_ParticlesCount,
+            NULL,
+            &status);
+        assert(status == CL_SUCCESS &&  "clCreateBuffer failed. (m_OutputPreviousPositionsBuffer)");
     }
 
     if (m_Pipeline.m_CollisionOnGPU)
@@ -838,36 +1260,171 @@ int ParticlesGPU::CreateBuffers(ID3D11Buffer *d3D11buffer)
     {
         m_AcceleratorsBuffer = NULL;
     }
+
+    status = CreateStagingBuffer();
     
     return status;
 }
 
 
+int ParticlesGPU::CreateStagingBuffer()
+{
+    cl_int status = CL_SUCCESS;
+
+    // Every staged array starts on 16 bytes
+    const size_t sphParametersSize  = (sizeof(SphParameters) + 15) & ~15;
+    const size_t gridInfoSize       = sizeof(cl_int4);
+    const size_t shapesSize         = sizeof(cl_float4) * 4 * MAX_SHAPES_COUNT;
+    const size_t acceleratorsSize   = sizeof(Accelerator) * m_AcceleratorsCount;
+
+    m_StagingBuffer = clCreateBuffer(   s_Context[m_ContextIndex],
+                                        CL_MEM_READ_ONLY | CL_MEM_ALLOC_HOST_PTR,
+                                        sphParametersSize + gridInfoSize + shapesSize + acceleratorsSize,
+                                        NULL,
+                                        &status);
+    assert(status == CL_SUCCESS &&  "clCreateBuffer failed. (m_StagingBuffer)");
+
+    // Mapped for the lifetime of the buffer, the host only writes in it
+    char *staging = static_cast<char *>(clEnqueueMapBuffer(  m_CommandQueue,
+                                                            m_StagingBuffer,
+                                                            CL_TRUE,
+                                                            CL_MAP_WRITE,
+                                                            0,
+                                                            sphParametersSize + gridInfoSize + shapesSize + acceleratorsSize,
+                                                            0,
+                                                            NULL,
+                                                            NULL,
+                                                            &status));
+    assert(status == CL_SUCCESS &&  "clEnqueueMapBuffer failed. (m_StagingBuffer)");
+
+    m_StagedSphParameters   = reinterpret_cast<SphParameters *>(staging);
+    m_StagedGridInfo        = reinterpret_cast<cl_int4 *>(staging + sphParametersSize);
+    m_StagedSpheres         = reinterpret_cast<cl_float4 *>(staging + sphParametersSize + gridInfoSize);
+    m_StagedSpheresIn       = m_StagedSpheres + MAX_SHAPES_COUNT;
+    m_StagedAabbs           = m_StagedSpheresIn + MAX_SHAPES_COUNT;
+    m_StagedAccelerators    = reinterpret_cast<Accelerator *>(staging + sphParametersSize + gridInfoSize + shapesSize);
+
+    return status;
+}
+
+int ParticlesGPU::UploadParticles(bool isUploadingPreviousPositions)
+{
+    cl_int status = CL_SUCCESS;
+
+    if ( ! m_IsPositionsOnDevice)
+    {
+        // Enqueue write from m_Positions to m_PositionsBuffer
+        cl_event writeEvt;
+        status = clEnqueueWriteBuffer(m_CommandQueue, 
+                                      m_PositionsBuffer, 
+                                      CL_FALSE,
+                                      0, 
+                                      sizeof(cl_float4) * m_ParticlesCount,
+                                      m_Positions, 
+                                      GetWaitEventsCount(),
+                                      GetWaitEvents(),
+                                      &writeEvt);
+        assert(status == CL_SUCCESS &&  "clEnqueueWriteBuffer failed. (m_PositionsBuffer)");
+        ChainEvent(writeEvt);
+        m_IsPositionsOnDevice = true;
+    }
+
+    if (isUploadingPreviousPositions && ! m_IsPreviousPositionsOnDevice)
+    {
+        const void *previousPositions = m_PreviousPositions;
+        if (m_Pipeline.m_IsUsingHalfPreviousPositions)
+        {
+            EncodePreviousPositions(0, m_ParticlesCount);
+            previousPositions = m_StagedPreviousPositions;
+        }
+
+        // Enqueue write from m_PreviousPositions to m_PreviousPositionsBuffer
+        cl_event writeEvt2;
+        status = clEnqueueWriteBuffer(m_CommandQueue, 
+                                      m_PreviousPositionsBuffer, 
+                                      CL_FALSE,
+                                      0, 
+                                      GetPreviousPositionSize() * m_ParticlesCount,
+                                      previousPositions, 
+                                      GetWaitEventsCount(),
+                                      GetWaitEvents(),
+                                      &writeEvt2);
+        assert(status == CL_SUCCESS &&  "clEnqueueWriteBuffer failed. (m_PreviousPositionsBuffer)");
+        ChainEvent(writeEvt2);
+        m_IsPreviousPositionsOnDevice = true;
+    }
+
+    return status;
+}
+
+size_t ParticlesGPU::GetPreviousPositionSize() const
+{
+    return m_Pipeline.m_IsUsingHalfPreviousPositions ? 4 * sizeof(cl_half) : sizeof(cl_float4);
+}
+
+void ParticlesGPU::EncodePreviousPositions(int first, int count)
+{
+    // Same offsets as StorePreviousPosition in the kernels, the w lane comes from the position
+    for (int i = first; i < first + count; i++)
+    {
+        cl_half *offset = m_StagedPreviousPositions + 4 * i;
+        offset[0] = FloatToHalf(m_Positions[i].s[0] - m_PreviousPositions[i].s[0]);
+        offset[1] = FloatToHalf(m_Positions[i].s[1] - m_PreviousPositions[i].s[1]);
+        offset[2] = FloatToHalf(m_Positions[i].s[2] - m_PreviousPositions[i].s[2]);
+        offset[3] = 0;
+    }
+}
+
+void ParticlesGPU::DecodePreviousPositions(int first, int count)
+{
+    for (int i = first; i < first + count; i++)
+    {
+        const cl_half *offset = m_StagedPreviousPositions + 4 * i;
+        m_PreviousPositions[i].s[0] = m_Positions[i].s[0] - HalfToFloat(offset[0]);
+        m_PreviousPositions[i].s[1] = m_Positions[i].s[1] - HalfToFloat(offset[1]);
+        m_PreviousPositions[i].s[2] = m_Positions[i].s[2] - HalfToFloat(offset[2]);
+        m_PreviousPositions[i].s[3] = m_Positions[i].s[3];
+    }
+}
+
+void ParticlesGPU::InvalidateDeviceParticles()
+{
+    m_IsPositionsOnDevice = false;
+    m_IsPreviousPositionsOnDevice = false;
+}
+
 int ParticlesGPU::InitializeCreateGrid()
 {
     assert(m_Pipeline.m_IsCreatingGridOnGPU);
 
     cl_int status;
-    cl_event writeEvt;
 
-     // Enqueue write from m_Positions to m_PositionsBuffer
+    // Particles stay on the device, they are uploaded once
+    status = UploadParticles(false);
+    assert(status == CL_SUCCESS &&  "UploadParticles failed.");
+
+    // The particles count is written once, the grid kernel only writes the axis lengths
+    m_StagedGridInfo->s[0] = m_ParticlesCount;
+    m_StagedGridInfo->s[1] = 0;
+    m_StagedGridInfo->s[2] = 0;
+    m_StagedGridInfo->s[3] = 0;
+
+    cl_event writeEvt2;
     status = clEnqueueWriteBuffer(m_CommandQueue,
-                                  m_PositionsBuffer,
+                                  m_GridInfoBuffer,
                                   CL_FALSE,
                                   0,
-                                  sizeof(cl_float4) * m_ParticlesCount,
-                                  m_Positions,
-                                  0,
-                                  NULL,
-                                  &writeEvt);
-
-    assert(status == CL_SUCCESS &&  "clEnqueueWriteBuffer failed. (m_PositionsBuffer)");
+                                  sizeof(cl_int4),
+                                  m_StagedGridInfo,
+                                  GetWaitEventsCount(),
+                                  GetWaitEvents(),
+                                  &writeEvt2);
+    assert(status == CL_SUCCESS &&  "clEnqueueWriteBuffer failed. (m_GridInfoBuffer)");
+    ChainEvent(writeEvt2);
 
-     status = clFlush(m_CommandQueue);
+    status = clFlush(m_CommandQueue);
     assert(status == CL_SUCCESS &&  "clFlush failed.");
 
-    // No clFinish command queue because there is one before running kernel !
-
     return status;
 
 }
@@ -875,16 +1432,11 @@ int ParticlesGPU::InitializeCreateGrid()
 int ParticlesGPU::CreateGrid()
 {
 
-    Timer::GetInstance()->StartTimerProfile();
+    PROFILE_BEGIN();
     // This kernel won't support les than 10 work items
     assert(m_LocalThreads > 10);
     cl_int status;
 
-
-    // All the command in queue must be finihed before continuing to process
-    status = clFinish(m_CommandQueue);
-    assert(status == CL_SUCCESS &&  "clFinish failed.");
-
     // Find the minimum and the maximum position
 
     
@@ -902,70 +1454,111 @@ int ParticlesGPU::CreateGrid()
                             NULL);
     assert(status == CL_SUCCESS &&  "clSetKernelArg failed. (localPos)");
 
-    // global memory
+    // Bounds of each work group
     status = clSetKernelArg(m_MinMaxKernel, 
                             2,
                             sizeof(cl_mem), 
                             (void *)&m_MinMaxBuffer); 
     assert(status == CL_SUCCESS &&  "clSetKernelArg failed. (m_MinMaxBuffer)");
 
-
-    size_t globalThreadMinMax = m_GlobalThreads / 2;
-    size_t localThreadMinMax = std::min(globalThreadMinMax, m_LocalThreads);
-    
-    cl_event ndrEvt;
+    // The biggest cell index is reset
+    status = clSetKernelArg(m_MinMaxKernel, 
+                            3,
+                            sizeof(cl_mem), 
+                            (void *)&m_GridInfoBuffer); 
+    assert(status == CL_SUCCESS &&  "clSetKernelArg failed. (m_GridInfoBuffer)");
 
     // Enqueue m_MinMaxKernel kernel
+    cl_event ndrEvt;
     status = clEnqueueNDRangeKernel(
         m_CommandQueue,
         m_MinMaxKernel,
         1,
         NULL,
-        &globalThreadMinMax,
-        &localThreadMinMax,
-        0,
-        NULL,
+        &m_GlobalThreadsMinMax,
+        &m_LocalThreadsMinMax,
+        GetWaitEventsCount(),
+        GetWaitEvents(),
         &ndrEvt);
     assert(status == CL_SUCCESS &&  "clEnqueueNDRangeKernel failed.");
+    ChainEvent(ndrEvt, eZoneComputeMinMax);
 
-    status = clFlush(m_CommandQueue);
-    assert(status == CL_SUCCESS &&  "clFlush failed.");
-
-    // All the command in queue must be finihed before continuing to process
-    status = clFinish(m_CommandQueue);
-    assert(status == CL_SUCCESS &&  "clFinish failed.");
-
-    // Create grid
-
-    // Setup kernel arguments
-    status = clSetKernelArg(m_CreateGridKernel, 
-                            0, 
-                            sizeof(cl_mem), 
-                            (void *)&m_PositionsBuffer); 
-    assert(status == CL_SUCCESS &&  "clSetKernelArg failed. (m_PositionsBuffer)");
+    // Reduce the bounds of each work group once, in a single work group. A dispatch of its
+    // own, cf ReduceBounds for why it isn't fused with the key generation
 
-     
-    // global memory
-    status = clSetKernelArg(m_CreateGridKernel, 
-                            1,
+    // Bounds of each work group, the first ones are replaced by the bounds
+    status = clSetKernelArg(m_ReduceBoundsKernel, 
+                            0,
                             sizeof(cl_mem), 
                             (void *)&m_MinMaxBuffer); 
     assert(status == CL_SUCCESS &&  "clSetKernelArg failed. (m_MinMaxBuffer)");
 
-    // Neighbors info
-    status = clSetKernelArg(m_CreateGridKernel,
-                            2,
+    // Axis lengths of the grid
+    status = clSetKernelArg(m_ReduceBoundsKernel,
+                            1,
                             sizeof(cl_mem), 
-                            (void *)&m_NeighborsInfoBuffer); 
-    assert(status == CL_SUCCESS &&  "clSetKernelArg failed. (m_NeighborsInfoBuffer)");
+                            (void *)&m_GridInfoBuffer); 
+    assert(status == CL_SUCCESS &&  "clSetKernelArg failed. (m_GridInfoBuffer)");
 
-    status = clSetKernelArg(m_CreateGridKernel,
+     // local memory
+    status = clSetKernelArg(m_ReduceBoundsKernel,
+                            2,
+                            2 * m_LocalThreads * sizeof(cl_float4),
+                            NULL);
+    assert(status == CL_SUCCESS &&  "clSetKernelArg failed. (localBounds)");
+
+    cl_int partialBoundsCount = static_cast<cl_int>(m_GlobalThreadsMinMax / m_LocalThreadsMinMax);
+    status = clSetKernelArg(m_ReduceBoundsKernel,
+                            3,
+                            sizeof(cl_int),
+                            (void *)&partialBoundsCount);
+    assert(status == CL_SUCCESS &&  "clSetKernelArg failed. (partialBoundsCount)");
+
+    cl_event ndrEvt3;
+    status = clEnqueueNDRangeKernel(
+        m_CommandQueue,
+        m_ReduceBoundsKernel,
+        1,
+        NULL,
+        &m_LocalThreads,
+        &m_LocalThreads,
+        GetWaitEventsCount(),
+        GetWaitEvents(),
+        &ndrEvt3);
+    assert(status == CL_SUCCESS &&  "clEnqueueNDRangeKernel failed.");
+    ChainEvent(ndrEvt3, eZoneReduceBounds);
+
+    // Create grid
+
+    // Setup kernel arguments
+    status = clSetKernelArg(m_CreateGridKernel, 
+                            0, 
+                            sizeof(cl_mem), 
+                            (void *)&m_PositionsBuffer); 
+    assert(status == CL_SUCCESS &&  "clSetKernelArg failed. (m_PositionsBuffer)");
+
+    // Bounds reduced by ReduceBounds
+    status = clSetKernelArg(m_CreateGridKernel, 
+                            1,
+                            sizeof(cl_mem), 
+                            (void *)&m_MinMaxBuffer); 
+    assert(status == CL_SUCCESS &&  "clSetKernelArg failed. (m_MinMaxBuffer)");
+
+    // Neighbors info
+    status = clSetKernelArg(m_CreateGridKernel,
+                            2,
+                            sizeof(cl_mem), 
+                            (void *)&m_NeighborsInfoBuffer); 
+    assert(status == CL_SUCCESS &&  "clSetKernelArg failed. (m_NeighborsInfoBuffer)");
+
+    status = clSetKernelArg(m_CreateGridKernel,
                             3,
                             sizeof(cl_mem), 
                             (void *)&m_GridInfoBuffer); 
     assert(status == CL_SUCCESS &&  "clSetKernelArg failed. (m_GridInfoBuffer)");
 
     // Enqueue the kernel to create the grid
+    cl_event ndrEvt2;
     status = clEnqueueNDRangeKernel(
         m_CommandQueue,
         m_CreateGridKernel,
@@ -973,19 +1566,13 @@ int ParticlesGPU::CreateGrid()
         NULL,
         &m_GlobalThreads,
         &m_LocalThreads,
-        0,
-        NULL,
-        &ndrEvt);
+        GetWaitEventsCount(),
+        GetWaitEvents(),
+        &ndrEvt2);
     assert(status == CL_SUCCESS &&  "clEnqueueNDRangeKernel failed.");
+    ChainEvent(ndrEvt2, eZoneCreateGrid);
 
-    status = clFlush(m_CommandQueue);
-    assert(status == CL_SUCCESS &&  "clFlush failed.");
-
-    // All the command in queue must be finihed before continuing to process
-    status = clFinish(m_CommandQueue);
-    assert(status == CL_SUCCESS &&  "clFinish failed.");
-
-    Timer::GetInstance()->StopTimerProfile("Create Grid : Grid Creation");
+    PROFILE_END("Create Grid : Grid Creation");
 
     return status;
 }
@@ -1025,155 +1612,204 @@ assert(m_Pipeline.m_IsCreatingGridOnGPU);
     assert(status == CL_SUCCESS);
 
     // End Test
-#endif DEBUG
+#endif // DEBUG
 }
 
 int ParticlesGPU::SortGrid()
 {
-    cl_int status;
-    cl_event ndrEvt;
+    cl_int status = CL_SUCCESS;
     
-    Timer::GetInstance()->StartTimerProfile();
-
-    // Sort grid cells
-
-    // Neighbors info
-    status = clSetKernelArg(m_SortLocalKernel,
-                            0,
-                            sizeof(cl_mem), 
-                            (void *)&m_NeighborsInfoBuffer); 
-    assert(status == CL_SUCCESS &&  "clSetKernelArg failed. (m_NeighborsInfoBuffer)");
-
-    // Neighbors info buffer
-    status = clSetKernelArg(m_SortLocalKernel,
-                            1,
-                            sizeof(cl_mem), 
-                            (void *)&m_NeighborsInfoBuffer2); 
-    assert(status == CL_SUCCESS &&  "clSetKernelArg failed. (m_NeighborsInfoBuffer 2 )");
-
+    PROFILE_BEGIN();
+
+    // Sort grid cells with a radix sort, 4 bits by pass.
+    // Passes ping pong between the two buffers, the pass count is even so the
+    // result ends in m_NeighborsInfoBuffer. Passes above the biggest cell index
+    // are skipped on the device
+    const int passesCount = 8;
+    cl_int groupsCount = static_cast<cl_int>(m_WorkGroupCount);
+    cl_mem inputBuffer = m_NeighborsInfoBuffer;
+    cl_mem outputBuffer = m_NeighborsInfoBuffer2;
+
+    for (int i = 0; i < passesCount; i++)
+    {
+        cl_int shift = i * 4;
+
+        // Count the digits of each work group
+        status = clSetKernelArg(m_RadixHistogramKernel, 0, sizeof(cl_mem), (void *)&inputBuffer); 
+        assert(status == CL_SUCCESS &&  "clSetKernelArg failed. (inputBuffer)");
+        status = clSetKernelArg(m_RadixHistogramKernel, 1, sizeof(cl_mem), (void *)&m_RadixHistogramsBuffer); 
+        assert(status == CL_SUCCESS &&  "clSetKernelArg failed. (m_RadixHistogramsBuffer)");
+        status = clSetKernelArg(m_RadixHistogramKernel, 2, sizeof(cl_mem), (void *)&m_GridInfoBuffer); 
+        assert(status == CL_SUCCESS &&  "clSetKernelArg failed. (m_GridInfoBuffer)");
+        status = clSetKernelArg(m_RadixHistogramKernel, 3, sizeof(cl_int), (void *)&shift); 
+        assert(status == CL_SUCCESS &&  "clSetKernelArg failed. (shift)");
+
+        cl_event histogramEvt;
+        status = clEnqueueNDRangeKernel(
+            m_CommandQueue,
+            m_RadixHistogramKernel,
+            1,
+            NULL,
+            &m_GlobalThreads,
+            &m_LocalThreads,
+            GetWaitEventsCount(),
+            GetWaitEvents(),
+            &histogramEvt);
+        assert(status == CL_SUCCESS &&  "clEnqueueNDRangeKernel failed.");
+        ChainEvent(histogramEvt, eZoneRadixHistogram);
+
+        // Scan the histograms in a single work group to find the output offsets
+        status = clSetKernelArg(m_RadixScanKernel, 0, sizeof(cl_mem), (void *)&m_RadixHistogramsBuffer); 
+        assert(status == CL_SUCCESS &&  "clSetKernelArg failed. (m_RadixHistogramsBuffer)");
+        status = clSetKernelArg(m_RadixScanKernel, 1, m_LocalThreads * sizeof(cl_int), NULL); 
+        assert(status == CL_SUCCESS &&  "clSetKernelArg failed. (localScan)");
+        status = clSetKernelArg(m_RadixScanKernel, 2, sizeof(cl_mem), (void *)&m_GridInfoBuffer); 
+        assert(status == CL_SUCCESS &&  "clSetKernelArg failed. (m_GridInfoBuffer)");
+        status = clSetKernelArg(m_RadixScanKernel, 3, sizeof(cl_int), (void *)&shift); 
+        assert(status == CL_SUCCESS &&  "clSetKernelArg failed. (shift)");
+        status = clSetKernelArg(m_RadixScanKernel, 4, sizeof(cl_int), (void *)&groupsCount); 
+        assert(status == CL_SUCCESS &&  "clSetKernelArg failed. (groupsCount)");
+
+        cl_event scanEvt;
+        status = clEnqueueNDRangeKernel(
+            m_CommandQueue,
+            m_RadixScanKernel,
+            1,
+            NULL,
+            &m_LocalThreads,
+            &m_LocalThreads,
+            GetWaitEventsCount(),
+            GetWaitEvents(),
+            &scanEvt);
+        assert(status == CL_SUCCESS &&  "clEnqueueNDRangeKernel failed.");
+        ChainEvent(scanEvt, eZoneRadixScan);
+
+        // Sort each work group locally and scatter it at the scanned offsets
+        status = clSetKernelArg(m_RadixScatterKernel, 0, sizeof(cl_mem), (void *)&inputBuffer); 
+        assert(status == CL_SUCCESS &&  "clSetKernelArg failed. (inputBuffer)");
+        status = clSetKernelArg(m_RadixScatterKernel, 1, sizeof(cl_mem), (void *)&outputBuffer); 
+        assert(status == CL_SUCCESS &&  "clSetKernelArg failed. (outputBuffer)");
+        status = clSetKernelArg(m_RadixScatterKernel, 2, sizeof(cl_mem), (void *)&m_RadixHistogramsBuffer); 
+        assert(status == CL_SUCCESS &&  "clSetKernelArg failed. (m_RadixHistogramsBuffer)");
+        status = clSetKernelArg(m_RadixScatterKernel, 3, m_LocalThreads * sizeof(cl_int2), NULL); 
+        assert(status == CL_SUCCESS &&  "clSetKernelArg failed. (localKeys)");
+        status = clSetKernelArg(m_RadixScatterKernel, 4, m_LocalThreads * sizeof(cl_int), NULL); 
+        assert(status == CL_SUCCESS &&  "clSetKernelArg failed. (localScan)");
+        status = clSetKernelArg(m_RadixScatterKernel, 5, sizeof(cl_mem), (void *)&m_GridInfoBuffer); 
+        assert(status == CL_SUCCESS &&  "clSetKernelArg failed. (m_GridInfoBuffer)");
+        status = clSetKernelArg(m_RadixScatterKernel, 6, sizeof(cl_int), (void *)&shift); 
+        assert(status == CL_SUCCESS &&  "clSetKernelArg failed. (shift)");
+
+        cl_event scatterEvt;
+        status = clEnqueueNDRangeKernel(
+            m_CommandQueue,
+            m_RadixScatterKernel,
+            1,
+            NULL,
+            &m_GlobalThreads,
+            &m_LocalThreads,
+            GetWaitEventsCount(),
+            GetWaitEvents(),
+            &scatterEvt);
+        assert(status == CL_SUCCESS &&  "clEnqueueNDRangeKernel failed.");
+        ChainEvent(scatterEvt, eZoneRadixScatter);
 
-    // Enqueue the kernel to sort the grid
-    status = clEnqueueNDRangeKernel(
-        m_CommandQueue,
-        m_SortLocalKernel,
-        1,
-        NULL,
-        &m_GlobalThreads,
-        &m_LocalThreads,
-        0,
-        NULL,
-        &ndrEvt);
-    assert(status == CL_SUCCESS &&  "clEnqueueNDRangeKernel failed.");
+        std::swap(inputBuffer, outputBuffer);
+    }
+    assert(inputBuffer == m_NeighborsInfoBuffer && "The sorted grid must end in m_NeighborsInfoBuffer.");
 
     status = clFlush(m_CommandQueue);
     assert(status == CL_SUCCESS &&  "clFlush failed.");
 
-    // All the command in queue must be finihed before continuing to process
-    status = clFinish(m_CommandQueue);
-    assert(status == CL_SUCCESS &&  "clFinish failed.");
+    // This info is requiered for SPH, the device one is written at initialization
+    m_GridInfo[0].s[0] = m_ParticlesCount;
 
+    
+    PROFILE_END("Create Grid : Sort on GPU");
+    // Test function
+    #ifdef DEBUG
+        // Enqueue the results to application pointer
+        cl_event readEvt2;
+        status = clEnqueueReadBuffer(
+            m_CommandQueue, 
+            m_NeighborsInfoBuffer,
+            CL_FALSE,
+            0,
+            m_ParticlesCount * sizeof(cl_int2),
+            m_NeighborsInfo,
+            GetWaitEventsCount(),
+            GetWaitEvents(),
+            &readEvt2);
+        assert(status == CL_SUCCESS &&  "clEnqueueReadBuffer failed.");
+        ChainEvent(readEvt2);
 
-    // Selection Merge sort on GPU
+        // Debug only, the host needs the result now
+        status = WaitForLastEvent();
+        assert(status == CL_SUCCESS &&  "WaitForLastEvent failed.");
 
-    // Neighbors info
-    status = clSetKernelArg(m_MergeSortKernel,
-                            0,
-                            sizeof(cl_mem), 
-                            (void *)&m_NeighborsInfoBuffer); 
-    assert(status == CL_SUCCESS &&  "clSetKernelArg failed. (m_NeighborsInfoBuffer)");
+        CheckOutputGrid();
+    #endif // DEBUG
 
-    // Neighbors info buffer
-    status = clSetKernelArg(m_MergeSortKernel,
-                            1,
-                            sizeof(cl_mem), 
-                            (void *)&m_NeighborsInfoBuffer2); 
-    assert(status == CL_SUCCESS &&  "clSetKernelArg failed. (m_NeighborsInfoBuffer 2 )");
+    return status;
+}
 
+int ParticlesGPU::BuildCellTable()
+{
+    cl_int status;
 
-    // Counters and / or for selection
-    status = clSetKernelArg(m_MergeSortKernel,
-                            2,
-                            m_LocalThreads * sizeof(cl_int2), 
-                            NULL); 
-    assert(status == CL_SUCCESS &&  "clSetKernelArg failed. (counters)");
+    PROFILE_BEGIN();
 
+    status = clSetKernelArg(m_ClearCellTableKernel, 0, sizeof(cl_mem), (void *)&m_CellTableBuffer); 
+    assert(status == CL_SUCCESS &&  "clSetKernelArg failed. (m_CellTableBuffer)");
 
-    // Enqueue the kernel to merge the sort
+    size_t localThreadsTable = std::min(m_CellTableSize, m_LocalThreads);
+    cl_event clearEvt;
     status = clEnqueueNDRangeKernel(
         m_CommandQueue,
-        m_MergeSortKernel,
+        m_ClearCellTableKernel,
         1,
         NULL,
-        &m_GlobalThreads,
-        &m_LocalThreads,
-        0,
-        NULL,
-        &ndrEvt);
+        &m_CellTableSize,
+        &localThreadsTable,
+        GetWaitEventsCount(),
+        GetWaitEvents(),
+        &clearEvt);
     assert(status == CL_SUCCESS &&  "clEnqueueNDRangeKernel failed.");
+    ChainEvent(clearEvt, eZoneClearCellTable);
 
-    status = clFlush(m_CommandQueue);
-    assert(status == CL_SUCCESS &&  "clFlush failed.");
+    cl_int tableMask = static_cast<cl_int>(m_CellTableSize - 1);
 
-    // All the command in queue must be finihed before continuing to process
-    status = clFinish(m_CommandQueue);
-    assert(status == CL_SUCCESS &&  "clFinish failed.");
+    status = clSetKernelArg(m_BuildCellTableKernel, 0, sizeof(cl_mem), (void *)&m_NeighborsInfoBuffer); 
+    assert(status == CL_SUCCESS &&  "clSetKernelArg failed. (m_NeighborsInfoBuffer)");
+    status = clSetKernelArg(m_BuildCellTableKernel, 1, sizeof(cl_mem), (void *)&m_CellTableBuffer); 
+    assert(status == CL_SUCCESS &&  "clSetKernelArg failed. (m_CellTableBuffer)");
+    status = clSetKernelArg(m_BuildCellTableKernel, 2, sizeof(cl_mem), (void *)&m_GridInfoBuffer); 
+    assert(status == CL_SUCCESS &&  "clSetKernelArg failed. (m_GridInfoBuffer)");
+    status = clSetKernelArg(m_BuildCellTableKernel, 3, sizeof(cl_int), (void *)&tableMask); 
+    assert(status == CL_SUCCESS &&  "clSetKernelArg failed. (tableMask)");
 
-    // Enqueue the results to application pointer    
-    cl_event readEvt3;
-    status = clEnqueueReadBuffer(
-        m_CommandQueue, 
-        m_GridInfoBuffer, 
-        CL_FALSE,
-        0,
-        sizeof(cl_int4),
-        m_GridInfo,
-        0,
+    cl_event buildEvt;
+    status = clEnqueueNDRangeKernel(
+        m_CommandQueue,
+        m_BuildCellTableKernel,
+        1,
         NULL,
-        &readEvt3);
-    assert(status == CL_SUCCESS &&  "clEnqueueReadBuffer failed.");
+        &m_GlobalThreads,
+        &m_LocalThreads,
+        GetWaitEventsCount(),
+        GetWaitEvents(),
+        &buildEvt);
+    assert(status == CL_SUCCESS &&  "clEnqueueNDRangeKernel failed.");
+    ChainEvent(buildEvt, eZoneBuildCellTable);
 
     status = clFlush(m_CommandQueue);
     assert(status == CL_SUCCESS &&  "clFlush failed.");
 
-    // All the command in queue must be finihed before continuing to process
-    status = clFinish(m_CommandQueue);
-    assert(status == CL_SUCCESS &&  "clFinish failed.");
-
-    // This info is requiered for SPH
-    m_GridInfo[0].s[0] = m_ParticlesCount;
-
-    
-    Timer::GetInstance()->StopTimerProfile("Create Grid : Sort on GPU");
-    // Test function
-    #ifdef DEBUG
-        // Enqueue the results to application pointer
-        cl_event readEvt2;
-        status = clEnqueueReadBuffer(
-            m_CommandQueue, 
-            m_NeighborsInfoBuffer2,
-            CL_FALSE,
-            0,
-            m_ParticlesCount * sizeof(cl_int2),
-            m_NeighborsInfo,
-            0,
-            NULL,
-            &readEvt2);
-        assert(status == CL_SUCCESS &&  "clEnqueueReadBuffer failed.");
-
-        status = clFlush(m_CommandQueue);
-        assert(status == CL_SUCCESS &&  "clFlush failed.");
-
-        // All the command in queue must be finihed before continuing to process
-        status = clFinish(m_CommandQueue);
-        assert(status == CL_SUCCESS &&  "clFinish failed.");
-
-        CheckOutputGrid();
-    #endif // DEBUG
+    PROFILE_END("Create Grid : Cell table");
 
     return status;
 }
 
-
 int ParticlesGPU::runKernelCreateGrid()
 {
     assert(m_Pipeline.m_IsCreatingGridOnGPU);
@@ -1181,6 +1817,11 @@ int ParticlesGPU::runKernelCreateGrid()
     assert(status == CL_SUCCESS &&  "Grid Creation.");
     status = SortGrid();
     assert(status == CL_SUCCESS &&  "Sort Grid.");
+    if (m_Pipeline.m_SPHAndIntegrateOnGPU)
+    {
+        status = BuildCellTable();
+        assert(status == CL_SUCCESS &&  "Build Cell Table.");
+    }
     return status;
 }
 
@@ -1223,13 +1864,20 @@ int ParticlesGPU::runKernelMinTest()
                             NULL);
     assert(status == CL_SUCCESS &&  "clSetKernelArg failed. (localPos)");
 
-    // global memory
+    // Bounds of each work group
     status = clSetKernelArg(m_MinMaxKernel, 
                             2,
                             sizeof(cl_mem), 
                             (void *)&m_MinMaxBuffer); 
     assert(status == CL_SUCCESS &&  "clSetKernelArg failed. (m_MinMaxBuffer)");
 
+    // The biggest cell index is reset
+    status = clSetKernelArg(m_MinMaxKernel, 
+                            3,
+                            sizeof(cl_mem), 
+                            (void *)&m_GridInfoBuffer); 
+    assert(status == CL_SUCCESS &&  "clSetKernelArg failed. (m_GridInfoBuffer)");
+
 
     // 
     //Enqueue a kernel run call.
@@ -1239,8 +1887,8 @@ int ParticlesGPU::runKernelMinTest()
         m_MinMaxKernel,
         1,
         NULL,
-        &m_GlobalThreads,
-        &m_LocalThreads,
+        &m_GlobalThreadsMinMax,
+        &m_LocalThreadsMinMax,
         0,
         NULL,
         &ndrEvt);
@@ -1254,14 +1902,16 @@ int ParticlesGPU::runKernelMinTest()
     assert(status == CL_SUCCESS &&  "clFinish failed.");
     
     // Enqueue the results to application pointer
+    const size_t partialBoundsCount = m_GlobalThreadsMinMax / m_LocalThreadsMinMax;
+    cl_float4 *partialBounds = new cl_float4[2 * partialBoundsCount];
     cl_event readEvt;
     status = clEnqueueReadBuffer(
         m_CommandQueue, 
         m_MinMaxBuffer, 
         CL_FALSE,
         0,
-        2 * sizeof(cl_float4),
-        m_Pressures,
+        2 * partialBoundsCount * sizeof(cl_float4),
+        partialBounds,
         0,
         NULL,
         &readEvt);
@@ -1274,6 +1924,19 @@ int ParticlesGPU::runKernelMinTest()
     status = clFinish(m_CommandQueue);
     assert(status == CL_SUCCESS &&  "clFinish failed.");
 
+    // The last reduction is done by ReduceBounds on the device
+    m_Pressures[0] = partialBounds[0];
+    m_Pressures[1] = partialBounds[1];
+    for (size_t i = 1; i < partialBoundsCount; i++)
+    {
+        for (int j = 0; j < 3; j++)
+        {
+            m_Pressures[0].s[j] = std::min(m_Pressures[0].s[j], partialBounds[2 * i].s[j]);
+            m_Pressures[1].s[j] = std::max(m_Pressures[1].s[j], partialBounds[2 * i + 1].s[j]);
+        }
+    }
+    delete[] partialBounds;
+
     
     CheckOutputMinMax();
     
@@ -1287,38 +1950,9 @@ int ParticlesGPU::InitializeKernelSPH()
     assert(m_Pipeline.m_SPHAndIntegrateOnGPU);
     m_SwapBufferSPH = false;
     cl_int status;
-    // Enqueue write from m_Positions to m_PositionsBuffer
-    cl_event writeEvt;
-    status = clEnqueueWriteBuffer(m_CommandQueue, 
-                                  m_PositionsBuffer, 
-                                  CL_FALSE,
-                                  0, 
-                                  sizeof(cl_float4) * m_ParticlesCount,
-                                  m_Positions, 
-                                  0, 
-                                  NULL, 
-                                  &writeEvt);
-    assert(status == CL_SUCCESS &&  "clEnqueueWriteBuffer failed. (m_PositionsBuffer)");
-
-    status = clFlush(m_CommandQueue);
-    assert(status == CL_SUCCESS &&  "clFlush failed.");
-
-    // Enqueue write from m_PreviousPositions to m_PreviousPositionsBuffer
-    cl_event writeEvt2;
-    status = clEnqueueWriteBuffer(m_CommandQueue, 
-                                  m_PreviousPositionsBuffer, 
-                                  CL_FALSE,
-                                  0, 
-                                  sizeof(cl_float4) * m_ParticlesCount,
-                                  m_PreviousPositions, 
-                                  0, 
-                                  NULL, 
-                                  &writeEvt2);
-    assert(status == CL_SUCCESS &&  "clEnqueueWriteBuffer failed. (m_PreviousPositionsBuffer)");
-
-    status = clFlush(m_CommandQueue);
-    assert(status == CL_SUCCESS &&  "clFlush failed.");
-
+    // Particles stay on the device, they are uploaded once
+    status = UploadParticles(true);
+    assert(status == CL_SUCCESS &&  "UploadParticles failed.");
 
     // Enqueue write from m_Density to m_PreviousDensityBuffer
     cl_event writeEvt3;
@@ -1328,16 +1962,48 @@ int ParticlesGPU::InitializeKernelSPH()
                                   0, 
                                   sizeof(cl_float) * m_ParticlesCount,
                                   m_Density, 
-                                  0, 
-                                  NULL, 
+                                  GetWaitEventsCount(),
+                                  GetWaitEvents(),
                                   &writeEvt3);
     assert(status == CL_SUCCESS &&  "clEnqueueWriteBuffer failed. (m_PreviousDensityBuffer)");
+    ChainEvent(writeEvt3);
 
     status = clFlush(m_CommandQueue);
     assert(status == CL_SUCCESS &&  "clFlush failed.");
 
-    // No clFinish command queue because there is one before running kernel !
+    return status;
+}
+
+int ParticlesGPU::SpecializeSPHKernel()
+{
+    // Only the scene constants are in the options, a new step doesn't change the program
+    const std::string buildOptions = m_ProgramBuildOptions + GetSPHBuildOptions(*m_SphParameters);
+    if (buildOptions == m_SPHBuildOptions)
+    {
+        return CL_SUCCESS;
+    }
+
+    cl_program program = GetSpecializedProgram(m_ContextIndex, buildOptions);
+    if (program == NULL)
+    {
+        // The generic kernel still works
+        DEBUG_OUT("Failed to build the specialized SPH kernel: " << buildOptions.c_str() << std::endl);
+        return CL_BUILD_PROGRAM_FAILURE;
+    }
+
+    cl_int status = CL_SUCCESS;
+    cl_kernel kernel = clCreateKernel(program, "ComputeSPH", &status);
+    assert(status == CL_SUCCESS && "clCreateKernel ComputeSPH failed");
+    if (status != CL_SUCCESS)
+    {
+        return status;
+    }
 
+    // Enqueued runs keep the previous kernel alive
+    status = clReleaseKernel(m_SPHIntegrateKernel);
+    assert(status == CL_SUCCESS &&  "clReleaseKernel failed.(m_SPHIntegrateKernel)");
+    m_SPHIntegrateKernel = kernel;
+    m_SPHBuildOptions = buildOptions;
     return status;
 }
 
@@ -1345,40 +2011,31 @@ int ParticlesGPU::runKernelSPH()
 {
     assert(m_Pipeline.m_SPHAndIntegrateOnGPU);
     cl_int status;
-    cl_event writeEvt4;
-    status = clEnqueueWriteBuffer(m_CommandQueue, 
-                                  m_GridInfoBuffer, 
-                                  CL_TRUE,
-                                  0, 
-                                  sizeof(cl_int4),
-                                  m_GridInfo, 
-                                  0, 
-                                  NULL, 
-                                  &writeEvt4);
-    assert(status == CL_SUCCESS &&  "clEnqueueWriteBuffer failed. (m_GridInfoBuffer)");
 
-    status = clFlush(m_CommandQueue);
-    assert(status == CL_SUCCESS &&  "clFlush failed.");
+    // Parameters are uploaded only when they have changed, through the pinned staging memory
+    if (m_SphParametersGeneration != m_UploadedSphParametersGeneration)
+    {
+        if (m_IsSpecializingKernels)
+        {
+            SpecializeSPHKernel();
+        }
 
-    // Enqueue write from m_SphParameters to m_SphParametersBuffer
-    cl_event writeEvt5;
-    status = clEnqueueWriteBuffer(m_CommandQueue, 
-                                  m_SphParametersBuffer, 
-                                  CL_TRUE,
-                                  0, 
-                                  sizeof(SphParameters),
-                                  m_SphParameters, 
-                                  0, 
-                                  NULL, 
-                                  &writeEvt5);
-    assert(status == CL_SUCCESS &&  "clEnqueueWriteBuffer failed. (m_GridInfoBuffer)");
-
-    status = clFlush(m_CommandQueue);
-    assert(status == CL_SUCCESS &&  "clFlush failed.");
-
-    // All the command in queue must be finihed before continuing to process
-    status = clFinish(m_CommandQueue);
-    assert(status == CL_SUCCESS &&  "clFinish failed.");
+        memcpy(m_StagedSphParameters, m_SphParameters, sizeof(SphParameters));
+
+        cl_event writeEvt;
+        status = clEnqueueWriteBuffer(m_CommandQueue, 
+                                      m_SphParametersBuffer, 
+                                      CL_FALSE,
+                                      0, 
+                                      sizeof(SphParameters),
+                                      m_StagedSphParameters, 
+                                      GetWaitEventsCount(),
+                                      GetWaitEvents(),
+                                      &writeEvt);
+        assert(status == CL_SUCCESS &&  "clEnqueueWriteBuffer failed. (m_SphParametersBuffer)");
+        ChainEvent(writeEvt);
+        m_UploadedSphParametersGeneration = m_SphParametersGeneration;
+    }
 
     // Setup kernel arguments
     status = clSetKernelArg(m_SPHIntegrateKernel, 
@@ -1396,29 +2053,35 @@ int ParticlesGPU::runKernelSPH()
     status = clSetKernelArg(m_SPHIntegrateKernel, 
                             2, 
                             sizeof(cl_mem), 
-                            (void *)&m_NeighborsInfoBuffer2); 
-    assert(status == CL_SUCCESS &&  "clSetKernelArg failed. (m_NeighborsInfoBuffer2)");
+                            (void *)&m_OutputPreviousPositionsBuffer); 
+    assert(status == CL_SUCCESS &&  "clSetKernelArg failed. (m_OutputPreviousPositionsBuffer)");
 
     status = clSetKernelArg(m_SPHIntegrateKernel, 
                             3, 
                             sizeof(cl_mem), 
+                            (void *)&m_NeighborsInfoBuffer); 
+    assert(status == CL_SUCCESS &&  "clSetKernelArg failed. (m_NeighborsInfoBuffer)");
+
+    status = clSetKernelArg(m_SPHIntegrateKernel, 
+                            4, 
+                            sizeof(cl_mem), 
                             (void *)&m_GridInfoBuffer); 
     assert(status == CL_SUCCESS &&  "clSetKernelArg failed. (m_GridInfo)");
 
     status = clSetKernelArg(m_SPHIntegrateKernel, 
-                            4, 
+                            5, 
                             sizeof(cl_mem), 
                             (void *)&m_SphParametersBuffer); 
     assert(status == CL_SUCCESS &&  "clSetKernelArg failed. (m_SphParameters)");
 
     status = clSetKernelArg(m_SPHIntegrateKernel, 
-                            5, 
+                            6, 
                             sizeof(cl_mem), 
                             (void *)&m_OutputBuffer); 
     assert(status == CL_SUCCESS &&  "clSetKernelArg failed. (m_OutputBuffer)");
 
-    cl_int firstIndex = m_SwapBufferSPH ? 7 : 6;
-    cl_int secondIndex = m_SwapBufferSPH ? 6 : 7;
+    cl_int firstIndex = m_SwapBufferSPH ? 8 : 7;
+    cl_int secondIndex = m_SwapBufferSPH ? 7 : 8;
 
     status = clSetKernelArg(m_SPHIntegrateKernel, 
                             firstIndex, 
@@ -1432,6 +2095,44 @@ int ParticlesGPU::runKernelSPH()
                             (void *)&m_OutputDensityBuffer); 
     assert(status == CL_SUCCESS &&  "clSetKernelArg failed. (m_OutputDensityBuffer)");
 
+    status = clSetKernelArg(m_SPHIntegrateKernel, 
+                            9, 
+                            sizeof(cl_mem), 
+                            (void *)&m_CellTableBuffer); 
+    assert(status == CL_SUCCESS &&  "clSetKernelArg failed. (m_CellTableBuffer)");
+
+    cl_int cellTableMask = static_cast<cl_int>(m_CellTableSize - 1);
+    status = clSetKernelArg(m_SPHIntegrateKernel, 
+                            10, 
+                            sizeof(cl_int), 
+                            (void *)&cellTableMask); 
+    assert(status == CL_SUCCESS &&  "clSetKernelArg failed. (cellTableMask)");
+
+    // The neighbors of each work group are staged in local memory, one tile at a time
+    status = clSetKernelArg(m_SPHIntegrateKernel, 
+                            11, 
+                            m_LocalThreads * sizeof(cl_float4), 
+                            NULL); 
+    assert(status == CL_SUCCESS &&  "clSetKernelArg failed. (localPositions)");
+
+    status = clSetKernelArg(m_SPHIntegrateKernel, 
+                            12, 
+                            m_LocalThreads * sizeof(cl_float4), 
+                            NULL); 
+    assert(status == CL_SUCCESS &&  "clSetKernelArg failed. (localPreviousPositions)");
+
+    status = clSetKernelArg(m_SPHIntegrateKernel, 
+                            13, 
+                            m_LocalThreads * sizeof(cl_float), 
+                            NULL); 
+    assert(status == CL_SUCCESS &&  "clSetKernelArg failed. (localDensities)");
+
+    status = clSetKernelArg(m_SPHIntegrateKernel, 
+                            14, 
+                            m_LocalThreads * sizeof(cl_int), 
+                            NULL); 
+    assert(status == CL_SUCCESS &&  "clSetKernelArg failed. (localCells)");
+
     // Swap buffer next time
     m_SwapBufferSPH = ! m_SwapBufferSPH;
 
@@ -1446,17 +2147,14 @@ int ParticlesGPU::runKernelSPH()
         NULL,
         &m_GlobalThreads,
         &m_LocalThreads,
-        0,
-        NULL,
+        GetWaitEventsCount(),
+        GetWaitEvents(),
         &ndrEvt);
     assert(status == CL_SUCCESS &&  "clEnqueueNDRangeKernel failed.");
+    ChainEvent(ndrEvt, eZoneComputeSPH);
 
-    status = clFlush(m_CommandQueue);
-    assert(status == CL_SUCCESS &&  "clFlush failed.");
-
-    // All the command in queue must be finihed before continuing to process
-    status = clFinish(m_CommandQueue);
-    assert(status == CL_SUCCESS &&  "clFinish failed.");
+    // The next commands read the previous positions written by this run
+    std::swap(m_PreviousPositionsBuffer, m_OutputPreviousPositionsBuffer);
 
     // Copy position output in the positions
 
@@ -1485,61 +2183,18 @@ int ParticlesGPU::runKernelSPH()
         NULL,
         &m_GlobalThreads,
         &m_LocalThreads,
-        0,
-        NULL,
+        GetWaitEventsCount(),
+        GetWaitEvents(),
         &ndrEvt2);
     assert(status == CL_SUCCESS &&  "clEnqueueNDRangeKernel failed.");
+    ChainEvent(ndrEvt2, eZoneCopyBufferKernel);
 
     status = clFlush(m_CommandQueue);
     assert(status == CL_SUCCESS &&  "clFlush failed.");
 
-    // All the command in queue must be finihed before continuing to process
-    status = clFinish(m_CommandQueue);
-    assert(status == CL_SUCCESS &&  "clFinish failed.");
-
-    if ( ! m_IsUsingInteroperability)
-    {
-        // Enqueue the results to application pointer
-        cl_event readEvt;
-        status = clEnqueueReadBuffer(
-            m_CommandQueue, 
-            m_PositionsBuffer, 
-            CL_FALSE,
-            0,
-            m_ParticlesCount* sizeof(cl_float4),
-            m_Positions,
-            0,
-            NULL,
-            &readEvt);
-        assert(status == CL_SUCCESS &&  "clEnqueueReadBuffer failed.");
-
-        status = clFlush(m_CommandQueue);
-        assert(status == CL_SUCCESS &&  "clFlush failed.");
-
-
-        // Enqueue the results to application pointer
-        cl_event readEvt2;
-        status = clEnqueueReadBuffer(
-            m_CommandQueue, 
-            m_PreviousPositionsBuffer, 
-            CL_FALSE,
-            0,
-            m_ParticlesCount* sizeof(cl_float4),
-            m_PreviousPositions,
-            0,
-            NULL,
-            &readEvt2);
-        assert(status == CL_SUCCESS &&  "clEnqueueReadBuffer failed.");
-
-        status = clFlush(m_CommandQueue);
-        assert(status == CL_SUCCESS &&  "clFlush failed.");
-
-        // All the command in queue must be finihed before continuing to process
-        status = clFinish(m_CommandQueue);
-        assert(status == CL_SUCCESS &&  "clFinish failed.");
-    }
-
-// 
+    m_IsReadingPositions = true;
+    m_IsReadingPreviousPositions = true;
+    m_IsReadingDensities = m_IsReadingBackDensities;
 
     return status;
 }
@@ -1548,42 +2203,14 @@ int ParticlesGPU::InitializeKernelCollision()
 {
     cl_int status;
 
-    // Enqueue write from m_Positions to m_PositionsBuffer
-    cl_event writeEvt;
-    status = clEnqueueWriteBuffer(m_CommandQueue, 
-                                  m_PositionsBuffer, 
-                                  CL_FALSE,
-                                  0, 
-                                  sizeof(cl_float4) * m_ParticlesCount,
-                                  m_Positions, 
-                                  0, 
-                                  NULL, 
-                                  &writeEvt);
-    assert(status == CL_SUCCESS &&  "clEnqueueWriteBuffer failed. (m_PositionsBuffer)");
+    // Particles stay on the device, they are uploaded once
+    status = UploadParticles(true);
+    assert(status == CL_SUCCESS &&  "UploadParticles failed.");
 
     status = clFlush(m_CommandQueue);
     assert(status == CL_SUCCESS &&  "clFlush failed.");
 
-    // Enqueue write from m_Positions to m_PreviousPositionsBuffer
-    cl_event writeEvt4;
-    status = clEnqueueWriteBuffer(m_CommandQueue, 
-                                  m_PreviousPositionsBuffer, 
-                                  CL_FALSE,
-                                  0, 
-                                  sizeof(cl_float4) * m_ParticlesCount,
-                                  m_PreviousPositions, 
-                                  0, 
-                                  NULL, 
-                                  &writeEvt4);
-    assert(status == CL_SUCCESS &&  "clEnqueueWriteBuffer failed. (m_PreviousPositionsBuffer)");
-
-    status = clFlush(m_CommandQueue);
-    assert(status == CL_SUCCESS &&  "clFlush failed.");
-
-    // No clFinish command queue because there is one before running kernel !
-
     return status;
-
 }
 
 
@@ -1592,58 +2219,58 @@ int ParticlesGPU::runKernelCollision()
     assert(m_Pipeline.m_CollisionOnGPU);
     cl_int status;
 
-    // Enqueue write from m_Spheres to m_SpheresBuffer
-    cl_event writeEvt2;
-    status = clEnqueueWriteBuffer(m_CommandQueue, 
-                                  m_SpheresBuffer, 
-                                  CL_FALSE,
-                                  0, 
-                                  sizeof(cl_float4) * slmath::max(m_ShapesCount.s[0], 1),
-                                  m_Spheres, 
-                                  0, 
-                                  NULL, 
-                                  &writeEvt2);
-    assert(status == CL_SUCCESS &&  "clEnqueueWriteBuffer failed. (m_Spheres)");
-
-     status = clFlush(m_CommandQueue);
-    assert(status == CL_SUCCESS &&  "clFlush failed.");
-
-    // Enqueue write from m_Spheres to m_SpheresInBuffer
-    cl_event writeEvt3;
-    status = clEnqueueWriteBuffer(m_CommandQueue, 
-                                  m_SpheresInBuffer, 
-                                  CL_FALSE,
-                                  0, 
-                                  sizeof(cl_float4) * slmath::max(m_ShapesCount.s[1], 1),
-                                  m_SpheresIn, 
-                                  0, 
-                                  NULL, 
-                                  &writeEvt3);
-    assert(status == CL_SUCCESS &&  "clEnqueueWriteBuffer failed. (m_Spheres)");
-
-     status = clFlush(m_CommandQueue);
-    assert(status == CL_SUCCESS &&  "clFlush failed.");
-
-
-    // Enqueue write from m_Aabbs to m_AabbsBuffer
-    cl_event writeEvt4;
-    status = clEnqueueWriteBuffer(m_CommandQueue, 
-                                  m_AabbsBuffer,
-                                  CL_FALSE,
-                                  0, 
-                                  sizeof(cl_float4) * slmath::max(m_ShapesCount.s[2], 1),
-                                  m_Aabbs, 
-                                  0, 
-                                  NULL, 
-                                  &writeEvt4);
-    assert(status == CL_SUCCESS &&  "clEnqueueWriteBuffer failed. (m_AabbsBuffer)");
-
-     status = clFlush(m_CommandQueue);
-    assert(status == CL_SUCCESS &&  "clFlush failed.");
-
-    // All the command in queue must be finihed before continuing to process
-    status = clFinish(m_CommandQueue);
-    assert(status == CL_SUCCESS &&  "clFinish failed.");
+    // Shapes are uploaded only when they have changed
+    if (m_ShapesGeneration != m_UploadedShapesGeneration)
+    {
+        // Shapes are copied in the pinned staging memory.
+        // At least one shape is written, the staging memory is always valid
+        memcpy(m_StagedSpheres, m_Spheres, sizeof(cl_float4) * m_ShapesCount.s[0]);
+        memcpy(m_StagedSpheresIn, m_SpheresIn, sizeof(cl_float4) * m_ShapesCount.s[1]);
+        memcpy(m_StagedAabbs, m_Aabbs, sizeof(cl_float4) * m_ShapesCount.s[2]);
+
+        // Enqueue write from m_Spheres to m_SpheresBuffer
+        cl_event writeEvt2;
+        status = clEnqueueWriteBuffer(m_CommandQueue, 
+                                      m_SpheresBuffer, 
+                                      CL_FALSE,
+                                      0, 
+                                      sizeof(cl_float4) * slmath::max(m_ShapesCount.s[0], 1),
+                                      m_StagedSpheres, 
+                                      GetWaitEventsCount(),
+                                      GetWaitEvents(),
+                                      &writeEvt2);
+        assert(status == CL_SUCCESS &&  "clEnqueueWriteBuffer failed. (m_Spheres)");
+        ChainEvent(writeEvt2);
+
+        // Enqueue write from m_Spheres to m_SpheresInBuffer
+        cl_event writeEvt3;
+        status = clEnqueueWriteBuffer(m_CommandQueue, 
+                                      m_SpheresInBuffer, 
+                                      CL_FALSE,
+                                      0, 
+                                      sizeof(cl_float4) * slmath::max(m_ShapesCount.s[1], 1),
+                                      m_StagedSpheresIn, 
+                                      GetWaitEventsCount(),
+                                      GetWaitEvents(),
+                                      &writeEvt3);
+        assert(status == CL_SUCCESS &&  "clEnqueueWriteBuffer failed. (m_Spheres)");
+        ChainEvent(writeEvt3);
+
+        // Enqueue write from m_Aabbs to m_AabbsBuffer
+        cl_event writeEvt4;
+        status = clEnqueueWriteBuffer(m_CommandQueue, 
+                                      m_AabbsBuffer,
+                                      CL_FALSE,
+                                      0, 
+                                      sizeof(cl_float4) * slmath::max(m_ShapesCount.s[2], 1),
+                                      m_StagedAabbs, 
+                                      GetWaitEventsCount(),
+                                      GetWaitEvents(),
+                                      &writeEvt4);
+        assert(status == CL_SUCCESS &&  "clEnqueueWriteBuffer failed. (m_AabbsBuffer)");
+        ChainEvent(writeEvt4);
+        m_UploadedShapesGeneration = m_ShapesGeneration;
+    }
 
     // Setup kernel arguments
     status = clSetKernelArg(m_CollisionKernel, 
@@ -1693,83 +2320,28 @@ int ParticlesGPU::runKernelCollision()
         NULL,
         &m_GlobalThreads,
         &m_LocalThreads,
-        0,
-        NULL,
+        GetWaitEventsCount(),
+        GetWaitEvents(),
         &ndrEvt);
     assert(status == CL_SUCCESS &&  "clEnqueueNDRangeKernel failed.");
+    ChainEvent(ndrEvt, eZoneComputeCollision);
 
     status = clFlush(m_CommandQueue);
     assert(status == CL_SUCCESS &&  "clFlush failed.");
 
-    // All the command in queue must be finihed before continuing to process
-    status = clFinish(m_CommandQueue);
-    assert(status == CL_SUCCESS &&  "clFinish failed.");
-
-    if ( ! m_IsUsingInteroperability)
-    {
-        // Enqueue the results to application pointer
-        cl_event readEvt;
-        status = clEnqueueReadBuffer(
-            m_CommandQueue, 
-            m_PositionsBuffer, 
-            CL_FALSE,
-            0,
-            m_ParticlesCount* sizeof(cl_float4),
-            m_Positions,
-            0,
-            NULL,
-            &readEvt);
-        assert(status == CL_SUCCESS &&  "clEnqueueReadBuffer failed.");
-
-        status = clFlush(m_CommandQueue);
-        assert(status == CL_SUCCESS &&  "clFlush failed.");
-
-
-        // Enqueue the results to application pointer
-        cl_event readEvt2;
-        status = clEnqueueReadBuffer(
-            m_CommandQueue, 
-            m_PreviousPositionsBuffer, 
-            CL_FALSE,
-            0,
-            m_ParticlesCount* sizeof(cl_float4),
-            m_PreviousPositions,
-            0,
-            NULL,
-            &readEvt2);
-        assert(status == CL_SUCCESS &&  "clEnqueueReadBuffer failed.");
-
-        status = clFlush(m_CommandQueue);
-        assert(status == CL_SUCCESS &&  "clFlush failed.");
-
-        // All the command in queue must be finihed before continuing to process
-        status = clFinish(m_CommandQueue);
-        assert(status == CL_SUCCESS &&  "clFinish failed.");
-    }
+    m_IsReadingPositions = true;
+    m_IsReadingPreviousPositions = true;
 
     return status;
 }
 
-
 int ParticlesGPU::InitializeKernelSpring()
 {
     assert(m_Pipeline.m_SpringOnGPU);
     cl_int status;
-    // Enqueue write from m_Positions to m_PositionsBuffer
-    cl_event writeEvt;
-    status = clEnqueueWriteBuffer(m_CommandQueue, 
-                                  m_PositionsBuffer, 
-                                  CL_FALSE,
-                                  0, 
-                                  sizeof(cl_float4) * m_ParticlesCount,
-                                  m_Positions, 
-                                  0, 
-                                  NULL, 
-                                  &writeEvt);
-    assert(status == CL_SUCCESS &&  "clEnqueueWriteBuffer failed. (m_PositionsBuffer)");
-
-    status = clFlush(m_CommandQueue);
-    assert(status == CL_SUCCESS &&  "clFlush failed.");
+    // Particles stay on the device, they are uploaded once
+    status = UploadParticles(false);
+    assert(status == CL_SUCCESS &&  "UploadParticles failed.");
 
     // Enqueue write from m_Springs to m_SpringsBuffer
     cl_event writeEvt3;
@@ -1779,16 +2351,15 @@ int ParticlesGPU::InitializeKernelSpring()
                                   0, 
                                   sizeof(Spring) * m_SpringsCount,
                                   m_Springs, 
-                                  0, 
-                                  NULL, 
+                                  GetWaitEventsCount(),
+                                  GetWaitEvents(),
                                   &writeEvt3);
     assert(status == CL_SUCCESS &&  "clEnqueueWriteBuffer failed. (m_Springs)");
+    ChainEvent(writeEvt3);
 
     status = clFlush(m_CommandQueue);
     assert(status == CL_SUCCESS &&  "clFlush failed.");
 
-    // No clFinish command queue because there is one before running kernel !
-
     return status;
 }
 
@@ -1797,10 +2368,6 @@ int ParticlesGPU::runKernelSpring()
     assert(m_Pipeline.m_SpringOnGPU);
     cl_int status;
 
-    // All buffer must be written before sending args
-    status = clFinish(m_CommandQueue);
-    assert(status == CL_SUCCESS &&  "clFinish failed.");
-    
     // Setup kernel arguments
     status = clSetKernelArg(m_SpringKernel, 
                             0, 
@@ -1831,42 +2398,16 @@ int ParticlesGPU::runKernelSpring()
         NULL,
         &m_GlobalThreadsSpring,
         &m_LocalThreadsSpring,
-        0,
-        NULL,
+        GetWaitEventsCount(),
+        GetWaitEvents(),
         &ndrEvt);
     assert(status == CL_SUCCESS &&  "clEnqueueNDRangeKernel failed.");
+    ChainEvent(ndrEvt, eZoneComputeSpring);
 
     status = clFlush(m_CommandQueue);
     assert(status == CL_SUCCESS &&  "clFlush failed.");
 
-    // Kernel must be finished before reading data
-    status = clFinish(m_CommandQueue);
-    assert(status == CL_SUCCESS &&  "clFinish failed.");
-    
-
-    if (!m_IsUsingInteroperability)
-    {
-        // Enqueue the results to application pointer
-        cl_event readEvt;
-        status = clEnqueueReadBuffer(
-            m_CommandQueue, 
-            m_PositionsBuffer, 
-            CL_FALSE,
-            0,
-            m_ParticlesCount* sizeof(cl_float4),
-            m_Positions,
-            0,
-            NULL,
-            &readEvt);
-        assert(status == CL_SUCCESS &&  "clEnqueueReadBuffer failed.");
-
-        status = clFlush(m_CommandQueue);
-        assert(status == CL_SUCCESS &&  "clFlush failed.");
-
-         // Block until all output data are ready
-        status = clFinish(m_CommandQueue);
-        assert(status == CL_SUCCESS &&  "clFinish failed.");
-    }
+    m_IsReadingPositions = true;
 
     return status;
 }
@@ -1875,41 +2416,13 @@ int ParticlesGPU::InitializeKernelAccelerator()
 {
     cl_int status;
 
-    // Enqueue write from m_Positions to m_PositionsBuffer
-    cl_event writeEvt;
-    status = clEnqueueWriteBuffer(m_CommandQueue, 
-                                  m_PositionsBuffer, 
-                                  CL_FALSE,
-                                  0, 
-                                  sizeof(cl_float4) * m_ParticlesCount,
-                                  m_Positions, 
-                                  0, 
-                                  NULL, 
-                                  &writeEvt);
-    assert(status == CL_SUCCESS &&  "clEnqueueWriteBuffer failed. (m_PositionsBuffer)");
-
-    status = clFlush(m_CommandQueue);
-    assert(status == CL_SUCCESS &&  "clFlush failed.");
-
-
-    // Enqueue write from m_PreviousPositions to m_PreviousPositionsBuffer
-    cl_event writeEvt2;
-    status = clEnqueueWriteBuffer(m_CommandQueue, 
-                                  m_PreviousPositionsBuffer, 
-                                  CL_FALSE,
-                                  0, 
-                                  sizeof(cl_float4) * m_ParticlesCount,
-                                  m_PreviousPositions, 
-                                  0, 
-                                  NULL, 
-                                  &writeEvt2);
-    assert(status == CL_SUCCESS &&  "clEnqueueWriteBuffer failed. (m_PreviousPositionsBuffer)");
+    // Particles stay on the device, they are uploaded once
+    status = UploadParticles(true);
+    assert(status == CL_SUCCESS &&  "UploadParticles failed.");
 
     status = clFlush(m_CommandQueue);
     assert(status == CL_SUCCESS &&  "clFlush failed.");
 
-    // No clFinish command queue because there is one before running kernel !
-
     return status;
 }
 
@@ -1918,30 +2431,29 @@ int ParticlesGPU::runKernelAccelerator()
     assert(m_Pipeline.m_AcceleratorOnGPU);
     cl_int status;
 
-    // Enqueue write from m_Accelerators to m_AcceleratorsBuffer
-    cl_event writeEvt3;
-    status = clEnqueueWriteBuffer(m_CommandQueue, 
-                                  m_AcceleratorsBuffer, 
-                                  CL_FALSE,
-                                  0, 
-                                  sizeof(Accelerator) * m_AcceleratorsCount,
-                                  m_Accelerators, 
-                                  0, 
-                                  NULL, 
-                                  &writeEvt3);
-    assert(status == CL_SUCCESS &&  "clEnqueueWriteBuffer failed. (m_AcceleratorsBuffer)");
-
-    status = clFlush(m_CommandQueue);
-    assert(status == CL_SUCCESS &&  "clFlush failed.");
-
+    // Accelerators are uploaded only when they have changed
+    if (m_AcceleratorsGeneration != m_UploadedAcceleratorsGeneration)
+    {
+        // Accelerators are copied in the pinned staging memory, the host array can be changed right after
+        memcpy(m_StagedAccelerators, m_Accelerators, sizeof(Accelerator) * m_AcceleratorsCount);
+
+        // Enqueue write from m_Accelerators to m_AcceleratorsBuffer
+        cl_event writeEvt3;
+        status = clEnqueueWriteBuffer(m_CommandQueue, 
+                                      m_AcceleratorsBuffer, 
+                                      CL_FALSE,
+                                      0, 
+                                      sizeof(Accelerator) * m_AcceleratorsCount,
+                                      m_StagedAccelerators, 
+                                      GetWaitEventsCount(),
+                                      GetWaitEvents(),
+                                      &writeEvt3);
+        assert(status == CL_SUCCESS &&  "clEnqueueWriteBuffer failed. (m_AcceleratorsBuffer)");
+        ChainEvent(writeEvt3);
+        m_UploadedAcceleratorsGeneration = m_AcceleratorsGeneration;
+    }
 
-    // All buffer must be written before sending args
-    status = clFinish(m_CommandQueue);
-    assert(status == CL_SUCCESS &&  "clFinish failed.");
-    
     // Setup kernel arguments
-
-    
     status = clSetKernelArg(m_AcceleratorKernel, 
                             0, 
                             sizeof(cl_mem), 
@@ -1966,71 +2478,40 @@ int ParticlesGPU::runKernelAccelerator()
                             (void *)&m_AcceleratorsCount); 
     assert(status == CL_SUCCESS &&  "clSetKernelArg failed. (m_AcceleratorsCount)");
 
- 
-    // 
-    //Enqueue a kernel run call.
-    //
-    cl_event ndrEvt;
-    status = clEnqueueNDRangeKernel(
-        m_CommandQueue,
-        m_AcceleratorKernel,
-        1,
-        NULL,
-        &m_GlobalThreads,
-        &m_LocalThreads,
-        0,
-        NULL,
-        &ndrEvt);
-    assert(status == CL_SUCCESS &&  "clEnqueueNDRangeKernel failed.");
-
-    status = clFlush(m_CommandQueue);
-    assert(status == CL_SUCCESS &&  "clFlush failed.");
-
-    // Kernel must be finished before reading data
-    status = clFinish(m_CommandQueue);
-    assert(status == CL_SUCCESS &&  "clFinish failed.");
-
-    if (! m_IsUsingInteroperability)
-    {
-         // Enqueue the results to application pointer
-        cl_event readEvt;
-        status = clEnqueueReadBuffer(
-            m_CommandQueue, 
-            m_PreviousPositionsBuffer, 
-            CL_FALSE,
-            0,
-            m_ParticlesCount* sizeof(cl_float4),
-            m_PreviousPositions,
-            0,
-            NULL,
-            &readEvt);
-        assert(status == CL_SUCCESS &&  "clEnqueueReadBuffer failed.");
-
-        status = clFlush(m_CommandQueue);
-        assert(status == CL_SUCCESS &&  "clFlush failed.");
+    status = clSetKernelArg(m_AcceleratorKernel, 
+                            4, 
+                            sizeof(cl_float), 
+                            (void *)&m_DeltaT); 
+    assert(status == CL_SUCCESS &&  "clSetKernelArg failed. (m_DeltaT)");
 
+    status = clSetKernelArg(m_AcceleratorKernel, 
+                            5, 
+                            sizeof(cl_float), 
+                            (void *)&m_PreviousDeltaT); 
+    assert(status == CL_SUCCESS &&  "clSetKernelArg failed. (m_PreviousDeltaT)");
 
-        // Enqueue the results to application pointer
-        status = clEnqueueReadBuffer(
-            m_CommandQueue, 
-            m_PositionsBuffer, 
-            CL_FALSE,
-            0,
-            m_ParticlesCount* sizeof(cl_float4),
-            m_Positions,
-            0,
-            NULL,
-            &readEvt);
-        assert(status == CL_SUCCESS &&  "clEnqueueReadBuffer failed.");
+    // 
+    //Enqueue a kernel run call.
+    //
+    cl_event ndrEvt;
+    status = clEnqueueNDRangeKernel(
+        m_CommandQueue,
+        m_AcceleratorKernel,
+        1,
+        NULL,
+        &m_GlobalThreads,
+        &m_LocalThreads,
+        GetWaitEventsCount(),
+        GetWaitEvents(),
+        &ndrEvt);
+    assert(status == CL_SUCCESS &&  "clEnqueueNDRangeKernel failed.");
+    ChainEvent(ndrEvt, eZoneComputeAccelerator);
 
-        status = clFlush(m_CommandQueue);
-        assert(status == CL_SUCCESS &&  "clFlush failed.");
+    status = clFlush(m_CommandQueue);
+    assert(status == CL_SUCCESS &&  "clFlush failed.");
 
-         // Block until all output data are ready
-        status = clFinish(m_CommandQueue);
-        assert(status == CL_SUCCESS &&  "clFinish failed.");
-    }
-   
+    m_IsReadingPositions = true;
+    m_IsReadingPreviousPositions = true;
 
     return status;
 }
@@ -2048,18 +2529,15 @@ int ParticlesGPU::InitializeKernelAnimation()
                                   0, 
                                   sizeof(cl_float4) * m_ParticlesCount,
                                   m_EndsAnimation, 
-                                  0, 
-                                  NULL, 
+                                  GetWaitEventsCount(),
+                                  GetWaitEvents(),
                                   &writeEvt3);
     assert(status == CL_SUCCESS &&  "clEnqueueWriteBuffer failed. (m_EndsAnimationBuffer)");
+    ChainEvent(writeEvt3);
 
     status = clFlush(m_CommandQueue);
     assert(status == CL_SUCCESS &&  "clFlush failed.");
 
-    // Block until all output data are ready
-    status = clFinish(m_CommandQueue);
-    assert(status == CL_SUCCESS &&  "clFinish failed.");
-
     return status;
 }
 
@@ -2095,18 +2573,13 @@ int ParticlesGPU::runKernelAnimation()
             NULL,
             &m_GlobalThreads,
             &m_LocalThreads,
-            0,
-            NULL,
+            GetWaitEventsCount(),
+            GetWaitEvents(),
             &ndrEvt2);
         assert(status == CL_SUCCESS &&  "clEnqueueNDRangeKernel failed.");
-
-        status = clFlush(m_CommandQueue);
-        assert(status == CL_SUCCESS &&  "clFlush failed.");
-
+        ChainEvent(ndrEvt2, eZoneCopyBufferKernel);
     }
 
-
-
     // Setup kernel arguments
     status = clSetKernelArg(m_AnimationKernel, 
                             0, 
@@ -2144,41 +2617,360 @@ int ParticlesGPU::runKernelAnimation()
         NULL,
         &m_GlobalThreads,
         &m_LocalThreads,
-        0,
-        NULL,
+        GetWaitEventsCount(),
+        GetWaitEvents(),
         &ndrEvt);
     assert(status == CL_SUCCESS &&  "clEnqueueNDRangeKernel failed.");
+    ChainEvent(ndrEvt, eZoneComputeAnimation);
 
     status = clFlush(m_CommandQueue);
     assert(status == CL_SUCCESS &&  "clFlush failed.");
 
-    // Kernel must be finished before reading data
-    status = clFinish(m_CommandQueue);
-    assert(status == CL_SUCCESS &&  "clFinish failed.");
+    m_IsReadingPositions = true;
+
+    return status;
+}
+
+cl_uint ParticlesGPU::GetWaitEventsCount() const
+{
+    return m_LastEvent != NULL ? 1 : 0;
+}
+
+const cl_event *ParticlesGPU::GetWaitEvents() const
+{
+    return m_LastEvent != NULL ? &m_LastEvent : NULL;
+}
+
+void ParticlesGPU::ChainEvent(cl_event event, CommandZone zone /*= eZoneCommand*/)
+{
+    if (m_LastEvent != NULL)
+    {
+        cl_int status = clReleaseEvent(m_LastEvent);
+        UNUSED_PARAMETER(status);
+        assert(status == CL_SUCCESS &&  "clReleaseEvent failed.");
+    }
+    m_LastEvent = event;
+
+    // Kept until the next wait, the commands are timed once they are done
+    if (m_IsProfilingCommands && m_ProfiledCommandsCount < s_MaxProfiledCommandsCount && Profiler::GetInstance()->IsTracing())
+    {
+        cl_int status = clRetainEvent(event);
+        UNUSED_PARAMETER(status);
+        assert(status == CL_SUCCESS &&  "clRetainEvent failed.");
+
+        m_ProfiledCommands[m_ProfiledCommandsCount].m_Event = event;
+        m_ProfiledCommands[m_ProfiledCommandsCount].m_Zone = zone;
+        m_ProfiledCommandsCount++;
+    }
+}
+
+int ParticlesGPU::WaitForLastEvent()
+{
+    cl_int status = CL_SUCCESS;
+    if (m_LastEvent != NULL)
+    {
+        status = clWaitForEvents(1, &m_LastEvent);
+        assert(status == CL_SUCCESS &&  "clWaitForEvents failed.");
+
+        status = clReleaseEvent(m_LastEvent);
+        assert(status == CL_SUCCESS &&  "clReleaseEvent failed.");
+        m_LastEvent = NULL;
+
+        // The queue is in order, every chained command is done
+        ReportProfiledCommands();
+    }
+    return status;
+}
+
+void ParticlesGPU::ReportProfiledCommands()
+{
+    if (m_ProfiledCommandsCount == 0)
+        return;
+
+    Profiler *profiler = Profiler::GetInstance();
+    const double ticksPerNanosecond = Profiler::GetTicksPerMillisecond() / 1000000.0;
+
+    // The device clock has its own origin, the last command is aligned on the end of the wait
+    const long long hostEnd = Profiler::GetTicks();
+    cl_ulong deviceEnd = 0;
+    cl_int status = clGetEventProfilingInfo(m_ProfiledCommands[m_ProfiledCommandsCount - 1].m_Event,
+                                            CL_PROFILING_COMMAND_END, sizeof(cl_ulong), &deviceEnd, NULL);
+
+    for (int i = 0; i < m_ProfiledCommandsCount; i++)
+    {
+        cl_event event = m_ProfiledCommands[i].m_Event;
+        cl_ulong start = 0;
+        cl_ulong end = 0;
+        if (status == CL_SUCCESS)
+        {
+            status = clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_START, sizeof(cl_ulong), &start, NULL);
+            status |= clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_END, sizeof(cl_ulong), &end, NULL);
+        }
+
+        if (status == CL_SUCCESS)
+        {
+            CommandZone zone = m_ProfiledCommands[i].m_Zone;
+            if (zone == eZoneCommand)
+            {
+                cl_command_type commandType = 0;
+                clGetEventInfo(event, CL_EVENT_COMMAND_TYPE, sizeof(cl_command_type), &commandType, NULL);
+                zone =  commandType == CL_COMMAND_WRITE_BUFFER  ? eZoneWriteBuffer :
+                        commandType == CL_COMMAND_READ_BUFFER   ? eZoneReadBuffer :
+                        commandType == CL_COMMAND_COPY_BUFFER   ? eZoneCopyBuffer : eZoneCommand;
+            }
+
+            const long long startOffset = static_cast<long long>(deviceEnd) - static_cast<long long>(start);
+            const long long endOffset = static_cast<long long>(deviceEnd) - static_cast<long long>(end);
+            profiler->AddRecord(m_ProfilerTrackId, m_CommandZoneIds[zone],
+                                hostEnd - static_cast<long long>(startOffset * ticksPerNanosecond),
+                                hostEnd - static_cast<long long>(endOffset * ticksPerNanosecond));
+        }
+
+        cl_int releaseStatus = clReleaseEvent(event);
+        UNUSED_PARAMETER(releaseStatus);
+        assert(releaseStatus == CL_SUCCESS &&  "clReleaseEvent failed.");
+    }
+
+    // Profiling information is missing when the queue was not created to time its commands
+    assert(status == CL_SUCCESS &&  "clGetEventProfilingInfo failed.");
+    m_ProfiledCommandsCount = 0;
+}
+
+bool ParticlesGPU::HasPendingReadBack() const
+{
+    return ! m_IsUsingInteroperability && (m_IsReadingPositions || m_IsReadingPreviousPositions || m_IsReadingDensities);
+}
+
+// Before the first step the swap flag points to the uploaded densities
+void ParticlesGPU::ReadBackDensities()
+{
+    if (m_Pipeline.m_SPHAndIntegrateOnGPU && m_Density != NULL)
+    {
+        m_IsReadingDensities = true;
+    }
+}
+
+int ParticlesGPU::Synchronize(bool isReadingBack)
+{
+    cl_int status = CL_SUCCESS;
+    if (m_LastEvent == NULL && ! (isReadingBack && HasPendingReadBack()))
+        return status;
+
+    PROFILE_BEGIN();
+
+    // Half offsets are decoded with the positions read back in the same synchronization
+    const bool isDecodingPreviousPositions = isReadingBack && ! m_IsUsingInteroperability &&
+                                             m_IsReadingPreviousPositions && m_Pipeline.m_IsUsingHalfPreviousPositions;
+
+    // Without read back the results stay on the device, they are read by a next synchronization
+    if (isReadingBack && ! m_IsUsingInteroperability)
+    {
+        if (m_IsReadingPreviousPositions)
+        {
+            // Enqueue the results to application pointer
+            cl_event readEvt;
+            status = clEnqueueReadBuffer(
+                m_CommandQueue, 
+                m_PreviousPositionsBuffer, 
+                CL_FALSE,
+                0,
+                m_ParticlesCount * GetPreviousPositionSize(),
+                isDecodingPreviousPositions ? static_cast<void*>(m_StagedPreviousPositions) : static_cast<void*>(m_PreviousPositions),
+                GetWaitEventsCount(),
+                GetWaitEvents(),
+                &readEvt);
+            assert(status == CL_SUCCESS &&  "clEnqueueReadBuffer failed.");
+            ChainEvent(readEvt);
+        }
+
+        if (m_IsReadingPositions || isDecodingPreviousPositions)
+        {
+            // Enqueue the results to application pointer
+            cl_event readEvt2;
+            status = clEnqueueReadBuffer(
+                m_CommandQueue, 
+                m_PositionsBuffer, 
+                CL_FALSE,
+                0,
+                m_ParticlesCount* sizeof(cl_float4),
+                m_Positions,
+                GetWaitEventsCount(),
+                GetWaitEvents(),
+                &readEvt2);
+            assert(status == CL_SUCCESS &&  "clEnqueueReadBuffer failed.");
+            ChainEvent(readEvt2);
+        }
+
+        if (m_IsReadingDensities)
+        {
+            cl_event readEvt3;
+            status = clEnqueueReadBuffer(
+                m_CommandQueue, 
+                GetDensityBuffer(), 
+                CL_FALSE,
+                0,
+                m_ParticlesCount * sizeof(cl_float),
+                m_Density,
+                GetWaitEventsCount(),
+                GetWaitEvents(),
+                &readEvt3);
+            assert(status == CL_SUCCESS &&  "clEnqueueReadBuffer failed. (densities)");
+            ChainEvent(readEvt3);
+        }
+    }
+    if (isReadingBack)
+    {
+        m_IsReadingPositions = false;
+        m_IsReadingPreviousPositions = false;
+        m_IsReadingDensities = false;
+    }
+
+    // Block until all output data are ready
+    status = WaitForLastEvent();
+    assert(status == CL_SUCCESS &&  "WaitForLastEvent failed.");
+
+    if (isDecodingPreviousPositions)
+    {
+        DecodePreviousPositions(0, m_ParticlesCount);
+    }
+
+    PROFILE_END("GPU synchronization");
+    return status;
+}
+
+// Output of the last SPH step, the swap flag already points to the next output
+cl_mem ParticlesGPU::GetDensityBuffer() const
+{
+    return m_SwapBufferSPH ? m_OutputDensityBuffer : m_PreviousDensityBuffer;
+}
+
+int ParticlesGPU::ReadParticles(int first, int count)
+{
+    assert(first >= 0 && count >= 0 && first + count <= m_ParticlesCount);
+    assert( ! m_IsUsingInteroperability);
+    cl_int status = CL_SUCCESS;
+    if (count == 0)
+        return status;
+
+    const size_t previousPositionSize = GetPreviousPositionSize();
+    cl_event readEvt;
+    status = clEnqueueReadBuffer(
+        m_CommandQueue,
+        m_PreviousPositionsBuffer,
+        CL_FALSE,
+        first * previousPositionSize,
+        count * previousPositionSize,
+        m_Pipeline.m_IsUsingHalfPreviousPositions ? static_cast<void*>(m_StagedPreviousPositions + 4 * first) :
+                                                    static_cast<void*>(m_PreviousPositions + first),
+        GetWaitEventsCount(),
+        GetWaitEvents(),
+        &readEvt);
+    assert(status == CL_SUCCESS &&  "clEnqueueReadBuffer failed.");
+    ChainEvent(readEvt);
+
+    cl_event readEvt2;
+    status = clEnqueueReadBuffer(
+        m_CommandQueue,
+        m_PositionsBuffer,
+        CL_FALSE,
+        first * sizeof(cl_float4),
+        count * sizeof(cl_float4),
+        m_Positions + first,
+        GetWaitEventsCount(),
+        GetWaitEvents(),
+        &readEvt2);
+    assert(status == CL_SUCCESS &&  "clEnqueueReadBuffer failed.");
+    ChainEvent(readEvt2);
 
-    if (! m_IsUsingInteroperability)
+    if (m_Pipeline.m_SPHAndIntegrateOnGPU && m_Density != NULL)
     {
-         // Enqueue the results to application pointer
-        cl_event readEvt;
+        cl_event readEvt3;
         status = clEnqueueReadBuffer(
-            m_CommandQueue, 
-            m_PositionsBuffer, 
+            m_CommandQueue,
+            GetDensityBuffer(),
             CL_FALSE,
-            0,
-            m_ParticlesCount* sizeof(cl_float4),
-            m_Positions,
-            0,
-            NULL,
-            &readEvt);
-        assert(status == CL_SUCCESS &&  "clEnqueueReadBuffer failed.");
+            first * sizeof(cl_float),
+            count * sizeof(cl_float),
+            m_Density + first,
+            GetWaitEventsCount(),
+            GetWaitEvents(),
+            &readEvt3);
+        assert(status == CL_SUCCESS &&  "clEnqueueReadBuffer failed. (densities)");
+        ChainEvent(readEvt3);
+    }
 
-        status = clFlush(m_CommandQueue);
-        assert(status == CL_SUCCESS &&  "clFlush failed.");
+    status = WaitForLastEvent();
+    assert(status == CL_SUCCESS &&  "WaitForLastEvent failed.");
 
-         // Block until all output data are ready
-        status = clFinish(m_CommandQueue);
-        assert(status == CL_SUCCESS &&  "clFinish failed.");
+    if (m_Pipeline.m_IsUsingHalfPreviousPositions)
+    {
+        DecodePreviousPositions(first, count);
+    }
+
+    return status;
+}
+
+int ParticlesGPU::WriteParticles(int first, int count)
+{
+    assert(first >= 0 && count >= 0 && first + count <= m_ParticlesCount);
+    assert( ! m_IsUsingInteroperability);
+    cl_int status = CL_SUCCESS;
+    if (count == 0)
+        return status;
+
+    cl_event writeEvt;
+    status = clEnqueueWriteBuffer(m_CommandQueue,
+                                  m_PositionsBuffer,
+                                  CL_FALSE,
+                                  first * sizeof(cl_float4),
+                                  count * sizeof(cl_float4),
+                                  m_Positions + first,
+                                  GetWaitEventsCount(),
+                                  GetWaitEvents(),
+                                  &writeEvt);
+    assert(status == CL_SUCCESS &&  "clEnqueueWriteBuffer failed. (m_PositionsBuffer)");
+    ChainEvent(writeEvt);
+
+    const void *previousPositions = m_PreviousPositions + first;
+    if (m_Pipeline.m_IsUsingHalfPreviousPositions)
+    {
+        EncodePreviousPositions(first, count);
+        previousPositions = m_StagedPreviousPositions + 4 * first;
+    }
+
+    const size_t previousPositionSize = GetPreviousPositionSize();
+    cl_event writeEvt2;
+    status = clEnqueueWriteBuffer(m_CommandQueue,
+                                  m_PreviousPositionsBuffer,
+                                  CL_FALSE,
+                                  first * previousPositionSize,
+                                  count * previousPositionSize,
+                                  previousPositions,
+                                  GetWaitEventsCount(),
+                                  GetWaitEvents(),
+                                  &writeEvt2);
+    assert(status == CL_SUCCESS &&  "clEnqueueWriteBuffer failed. (m_PreviousPositionsBuffer)");
+    ChainEvent(writeEvt2);
+
+    if (m_Pipeline.m_SPHAndIntegrateOnGPU && m_Density != NULL)
+    {
+        cl_event writeEvt3;
+        status = clEnqueueWriteBuffer(m_CommandQueue,
+                                      GetDensityBuffer(),
+                                      CL_FALSE,
+                                      first * sizeof(cl_float),
+                                      count * sizeof(cl_float),
+                                      m_Density + first,
+                                      GetWaitEventsCount(),
+                                      GetWaitEvents(),
+                                      &writeEvt3);
+        assert(status == CL_SUCCESS &&  "clEnqueueWriteBuffer failed. (densities)");
+        ChainEvent(writeEvt3);
     }
+
+    status = clFlush(m_CommandQueue);
+    assert(status == CL_SUCCESS &&  "clFlush failed.");
+
     return status;
 }
 
@@ -2186,11 +2978,39 @@ int ParticlesGPU::runKernelAnimation()
 int ParticlesGPU::Initialize(    int particlesCount, int springsCount, int acceleratorsCount,
                                 const PipelineDescription& pipeline, ID3D11Buffer *d3D11buffer /*= NULL*/)
 {
+    assert(s_Context[m_ContextIndex] != NULL && "No OpenCL device of this type.");
+    assert(static_cast<int>(m_DeviceId) < s_DevicesCount[m_ContextIndex] && "Device index out of range.");
+
     m_ParticlesCount    = particlesCount;
+    m_ParticlesCapacity = particlesCount;
     m_SpringsCount      = springsCount;
     m_AcceleratorsCount = acceleratorsCount;
     m_Pipeline          = pipeline;
 
+    // New device buffers, everything is uploaded again
+    InvalidateDeviceParticles();
+    m_UploadedShapesGeneration          = 0;
+    m_UploadedAcceleratorsGeneration    = 0;
+    m_UploadedSphParametersGeneration   = 0;
+    // The SPH kernel is created from the generic program
+    m_SPHBuildOptions.clear();
+
+    // Springs and animation move the positions without the previous ones, the offsets would move with them
+    assert( ! (pipeline.m_IsUsingHalfPreviousPositions && (pipeline.m_SpringOnGPU || pipeline.m_IsUsingAnimation)) &&
+            "Half previous positions don't support springs and animation.");
+    m_ProgramBuildOptions = pipeline.m_IsUsingHalfPreviousPositions ? "-D HALF_PREVIOUS_POSITIONS " : "";
+    if (pipeline.m_IsDeterministic)
+    {
+        m_ProgramBuildOptions += "-D DETERMINISTIC ";
+    }
+
+    if (m_IsProfilingCommands && m_ProfilerTrackId < 0)
+    {
+        const std::string trackName =   std::string("OpenCL queue (") + (m_ContextIndex == 1 ? "CPU " : "GPU ") +
+                                        std::to_string(m_DeviceId) + ")";
+        m_ProfilerTrackId = Profiler::GetInstance()->AcquireTrack(trackName.c_str());
+    }
+
     int status = CreeateKernels();
 
     if(status != CL_SUCCESS)
@@ -2206,9 +3026,6 @@ int ParticlesGPU::Initialize(    int particlesCount, int springsCount, int accel
         return status;
     }
 
-    m_GlobalThreads = slmath::roundToPowerOf2(particlesCount);
-
-    
     // Maximum work group size
     size_t maxWorkGroupSize;
     status = clGetDeviceInfo(
@@ -2219,7 +3036,9 @@ int ParticlesGPU::Initialize(    int particlesCount, int springsCount, int accel
                     NULL);
    assert(status == CL_SUCCESS &&  "clGetDeviceIDs(CL_DEVICE_MAX_WORK_GROUP_SIZE) failed");
 
-    m_LocalThreads  = slmath::min(slmath::roundToPowerOf2((particlesCount >> 1) + 1), maxWorkGroupSize);
+    // Buffers are sized for the capacity, a smaller active count uses smaller launches
+    m_MaxWorkGroupSize = maxWorkGroupSize;
+    ComputeLaunchSizes(particlesCount);
 
     //Get max work item dimensions
     size_t maxWorkItemDims;
@@ -2245,9 +3064,40 @@ int ParticlesGPU::Initialize(    int particlesCount, int springsCount, int accel
     assert (m_LocalThreads <= maxWorkItemSizes[0] && m_LocalThreads <= maxWorkGroupSize && 
             "Unsupported: Device does not support requested number of work items.\n");
 
-    m_WorkGroupCount = m_GlobalThreads / m_LocalThreads;
     m_Counters = new int[m_WorkGroupCount];
 
+    if (m_Pipeline.m_IsCreatingGridOnGPU)
+    {
+        m_MinMaxBuffer  = clCreateBuffer(
+            s_Context[m_ContextIndex],
+            CL_MEM_READ_WRITE,
+            2 * (m_GlobalThreadsMinMax / m_LocalThreadsMinMax) * sizeof(cl_float4),
+            NULL,
+            &status);
+        assert(status == CL_SUCCESS &&  "clCreateBuffer failed. (m_MinMaxBuffer)");
+
+        // The radix sort needs one count by digit for each work group
+        assert(m_LocalThreads >= 16 && "The radix sort needs at least 16 work items by work group.");
+        m_RadixHistogramsBuffer = clCreateBuffer(
+            s_Context[m_ContextIndex],
+            CL_MEM_READ_WRITE,
+            sizeof(cl_int) * 16 * m_WorkGroupCount,
+            NULL,
+            &status);
+        assert(status == CL_SUCCESS &&  "clCreateBuffer failed. (m_RadixHistogramsBuffer)");
+    }
+
+    if (m_Pipeline.m_IsCreatingGridOnGPU && m_Pipeline.m_SPHAndIntegrateOnGPU)
+    {
+        m_CellTableBuffer = clCreateBuffer(
+            s_Context[m_ContextIndex],
+            CL_MEM_READ_WRITE,
+            sizeof(cl_int4) * m_CellTableSize,
+            NULL,
+            &status);
+        assert(status == CL_SUCCESS &&  "clCreateBuffer failed. (m_CellTableBuffer)");
+    }
+
     int workItemsCount = m_SpringsCount / 12;
 
     m_GlobalThreadsSpring = slmath::roundToPowerOf2(workItemsCount );
@@ -2267,7 +3117,17 @@ int ParticlesGPU::cleanup()
     assert(m_ByteRWSupport);
 
 
-    cl_int status = CL_SUCCESS;
+    cl_int status = WaitForLastEvent();
+    m_IsReadingPositions = false;
+    m_IsReadingPreviousPositions = false;
+    m_IsReadingDensities = false;
+
+    // No read back is pending in the staged offsets anymore
+    delete []m_StagedPreviousPositions;
+    m_StagedPreviousPositions = NULL;
+
+    Profiler::GetInstance()->ReleaseTrack(m_ProfilerTrackId);
+    m_ProfilerTrackId = -1;
 
     // Release openCL buffer
     if (m_PositionsBuffer)
@@ -2300,6 +3160,12 @@ int ParticlesGPU::cleanup()
         assert(status == CL_SUCCESS &&  "clReleaseMemObject failed.(m_OutputBuffer)");
     }
 
+    if (m_OutputPreviousPositionsBuffer)
+    {
+        status = clReleaseMemObject(m_OutputPreviousPositionsBuffer);
+        assert(status == CL_SUCCESS &&  "clReleaseMemObject failed.(m_OutputPreviousPositionsBuffer)");
+    }
+
     if (m_SpringsCount > 0)
     {
         status = clReleaseMemObject(m_SpringsBuffer);
@@ -2312,6 +3178,40 @@ int ParticlesGPU::cleanup()
         assert(status == CL_SUCCESS &&  "clReleaseMemObject failed.(m_AcceleratorsBuffer)");
     }
 
+    if (m_StagingBuffer)
+    {
+        status = clEnqueueUnmapMemObject(m_CommandQueue, m_StagingBuffer, m_StagedSphParameters, 0, NULL, NULL);
+        assert(status == CL_SUCCESS &&  "clEnqueueUnmapMemObject failed.(m_StagingBuffer)");
+
+        status = clFinish(m_CommandQueue);
+        assert(status == CL_SUCCESS &&  "clFinish failed.");
+
+        status = clReleaseMemObject(m_StagingBuffer);
+        assert(status == CL_SUCCESS &&  "clReleaseMemObject failed.(m_StagingBuffer)");
+        m_StagingBuffer = NULL;
+    }
+
+    if (m_MinMaxBuffer)
+    {
+        status = clReleaseMemObject(m_MinMaxBuffer);
+        assert(status == CL_SUCCESS &&  "clReleaseMemObject failed.(m_MinMaxBuffer)");
+        m_MinMaxBuffer = NULL;
+    }
+
+    if (m_RadixHistogramsBuffer)
+    {
+        status = clReleaseMemObject(m_RadixHistogramsBuffer);
+        assert(status == CL_SUCCESS &&  "clReleaseMemObject failed.(m_RadixHistogramsBuffer)");
+        m_RadixHistogramsBuffer = NULL;
+    }
+
+    if (m_CellTableBuffer)
+    {
+        status = clReleaseMemObject(m_CellTableBuffer);
+        assert(status == CL_SUCCESS &&  "clReleaseMemObject failed.(m_CellTableBuffer)");
+        m_CellTableBuffer = NULL;
+    }
+
     // Releases OpenCL kernels
     
     if (m_SPHIntegrateKernel)
@@ -2326,6 +3226,48 @@ int ParticlesGPU::cleanup()
         assert(status == CL_SUCCESS &&  "clReleaseKernel failed.(m_CollisionKernel)");
     }
 
+    if (m_RadixHistogramKernel)
+    {
+        status = clReleaseKernel(m_RadixHistogramKernel);
+        assert(status == CL_SUCCESS &&  "clReleaseKernel failed.(m_RadixHistogramKernel)");
+        m_RadixHistogramKernel = NULL;
+    }
+
+    if (m_RadixScanKernel)
+    {
+        status = clReleaseKernel(m_RadixScanKernel);
+        assert(status == CL_SUCCESS &&  "clReleaseKernel failed.(m_RadixScanKernel)");
+        m_RadixScanKernel = NULL;
+    }
+
+    if (m_RadixScatterKernel)
+    {
+        status = clReleaseKernel(m_RadixScatterKernel);
+        assert(status == CL_SUCCESS &&  "clReleaseKernel failed.(m_RadixScatterKernel)");
+        m_RadixScatterKernel = NULL;
+    }
+
+    if (m_ClearCellTableKernel)
+    {
+        status = clReleaseKernel(m_ClearCellTableKernel);
+        assert(status == CL_SUCCESS &&  "clReleaseKernel failed.(m_ClearCellTableKernel)");
+        m_ClearCellTableKernel = NULL;
+    }
+
+    if (m_BuildCellTableKernel)
+    {
+        status = clReleaseKernel(m_BuildCellTableKernel);
+        assert(status == CL_SUCCESS &&  "clReleaseKernel failed.(m_BuildCellTableKernel)");
+        m_BuildCellTableKernel = NULL;
+    }
+
+    if (m_ReduceBoundsKernel)
+    {
+        status = clReleaseKernel(m_ReduceBoundsKernel);
+        assert(status == CL_SUCCESS &&  "clReleaseKernel failed.(m_ReduceBoundsKernel)");
+        m_ReduceBoundsKernel = NULL;
+    }
+
     // Release command queue
     if (m_CommandQueue)
     {
@@ -2338,14 +3280,33 @@ int ParticlesGPU::cleanup()
 
 int ParticlesGPU::StaticRelease()
 {
-    cl_int status = clReleaseProgram(s_Program);
-    assert(status == CL_SUCCESS &&  "clReleaseProgram failed.(s_Program)");
-    
-    for (int contextIndex = 0; contextIndex < s_ContextCount; contextIndex)
+    cl_int status = CL_SUCCESS;
+    for (int contextIndex = 0; contextIndex < s_ContextCount; contextIndex++)
     {
-        status = clReleaseContext(s_Context[contextIndex]);
-        assert(status == CL_SUCCESS &&  "clReleaseContext failed.");
-        delete s_Devices[contextIndex];
+        if (s_ProgramIsCompiled[contextIndex])
+        {
+            status = clReleaseProgram(s_Program[contextIndex]);
+            assert(status == CL_SUCCESS &&  "clReleaseProgram failed.(s_Program)");
+            s_ProgramIsCompiled[contextIndex] = false;
+        }
+
+        std::map<std::string, cl_program>& programs = s_SpecializedPrograms[contextIndex];
+        for (std::map<std::string, cl_program>::iterator variant = programs.begin(); variant != programs.end(); ++variant)
+        {
+            status = clReleaseProgram(variant->second);
+            assert(status == CL_SUCCESS &&  "clReleaseProgram failed.(s_SpecializedPrograms)");
+        }
+        programs.clear();
+
+        if (s_Context[contextIndex] != NULL)
+        {
+            status = clReleaseContext(s_Context[contextIndex]);
+            assert(status == CL_SUCCESS &&  "clReleaseContext failed.");
+            s_Context[contextIndex] = NULL;
+        }
+        delete[] s_Devices[contextIndex];
+        s_Devices[contextIndex] = NULL;
+        s_DevicesCount[contextIndex] = 0;
     }
     s_IsSetup = false;
 
@@ -3,7 +3,10 @@
 #define PARTICLES_GPU
 
 #include <CL/cl.h>
+#include <string>
+#include <map>
 #include "ParticleEngine/PipelineDescription.h"
+#include "ParticleEngine/ParticlesBackend.h"
 
 namespace slmath
 {
@@ -23,9 +26,12 @@ struct ID3D11Buffer;
 #define MAX_SHAPES_COUNT 25
 
 
-class ParticlesGPU
+// OpenCL backend
+class ParticlesGPU : public ParticlesBackend
 {
     cl_int  m_ParticlesCount;
+    // Particles count of the buffers, the active count can be smaller
+    cl_int  m_ParticlesCapacity;
     cl_int  m_SpringsCount;
     cl_int  m_AcceleratorsCount;
 
@@ -35,7 +41,11 @@ class ParticlesGPU
     size_t  m_GlobalThreads;
     size_t  m_LocalThreadsSpring;
     size_t  m_GlobalThreadsSpring;
+    size_t  m_LocalThreadsMinMax;
+    size_t  m_GlobalThreadsMinMax;
     size_t  m_WorkGroupCount;
+    size_t  m_CellTableSize;
+    size_t  m_MaxWorkGroupSize;
 
     bool m_IsUsingInteroperability;
     int  m_ContextIndex;
@@ -47,6 +57,8 @@ class ParticlesGPU
     cl_int4     *m_GridInfo;
     cl_int4     m_ShapesCount;
     cl_float    m_AnimationTime;
+    cl_float    m_DeltaT;
+    cl_float    m_PreviousDeltaT;
 
     //Host buffers
     cl_float4           *m_Positions;
@@ -70,12 +82,20 @@ class ParticlesGPU
     cl_mem  m_NeighborsInfoBuffer;
     cl_mem  m_NeighborsInfoBuffer2;
     cl_mem  m_OutputBuffer;
+    // Previous positions written by ComputeSPH, swapped with m_PreviousPositionsBuffer after each run
+    cl_mem  m_OutputPreviousPositionsBuffer;
     cl_mem  m_SpheresBuffer;
     cl_mem  m_SpheresInBuffer;
     cl_mem  m_AabbsBuffer;
     cl_mem  m_SpringsBuffer;
     cl_mem  m_AcceleratorsBuffer;
     cl_mem  m_GridInfoBuffer;
+    // Digit counts of each work group for the radix sort, scanned in place
+    cl_mem  m_RadixHistogramsBuffer;
+    // Range of the sorted particles of each occupied cell, hashed by cell index
+    cl_mem  m_CellTableBuffer;
+    // Bounds of each ComputeMinMax work group, minimum then maximum. ReduceBounds
+    // replaces the first ones by the bounds of all the particles
     cl_mem  m_MinMaxBuffer;
     cl_mem  m_PreviousDensityBuffer;
     cl_mem  m_OutputDensityBuffer;
@@ -83,19 +103,101 @@ class ParticlesGPU
     cl_mem  m_StartsAnimationBuffer;
     cl_mem  m_EndsAnimationBuffer;
 
+    // Pinned memory mapped once, small uploads are copied in it and written without blocking
+    cl_mem              m_StagingBuffer;
+    SphParameters       *m_StagedSphParameters;
+    cl_int4             *m_StagedGridInfo;
+    cl_float4           *m_StagedSpheres;
+    cl_float4           *m_StagedSpheresIn;
+    cl_float4           *m_StagedAabbs;
+    Accelerator         *m_StagedAccelerators;
+    // Half offsets of the previous positions, encoded and decoded by the host
+    cl_half             *m_StagedPreviousPositions;
+
+    // Last enqueued command, each command waits for it so the queue can be out of order
+    cl_event            m_LastEvent;
+
+    // Zones of the commands in the profiler trace, the unnamed commands are named by their type
+    enum CommandZone
+    {
+        eZoneComputeMinMax = 0,
+        eZoneReduceBounds,
+        eZoneCreateGrid,
+        eZoneRadixHistogram,
+        eZoneRadixScan,
+        eZoneRadixScatter,
+        eZoneClearCellTable,
+        eZoneBuildCellTable,
+        eZoneComputeSPH,
+        eZoneCopyBufferKernel,
+        eZoneComputeCollision,
+        eZoneComputeSpring,
+        eZoneComputeAccelerator,
+        eZoneComputeAnimation,
+        eZoneWriteBuffer,
+        eZoneReadBuffer,
+        eZoneCopyBuffer,
+        eZoneCommand,
+        eZonesCount
+    };
+    static const char   *s_CommandZoneNames[eZonesCount];
+
+    // Commands timed by the queue while the profiler traces, reported after each wait
+    struct ProfiledCommand
+    {
+        cl_event    m_Event;
+        CommandZone m_Zone;
+    };
+    static const int    s_MaxProfiledCommandsCount = 256;
+    ProfiledCommand     m_ProfiledCommands[s_MaxProfiledCommandsCount];
+    int                 m_ProfiledCommandsCount;
+    // Registered with the kernels, the reports don't look the names up
+    int                 m_CommandZoneIds[eZonesCount];
+    int                 m_ProfilerTrackId;
+    bool                m_IsProfilingCommands;
+    // Results are read back once by Synchronize
+    bool                m_IsReadingPositions;
+    bool                m_IsReadingPreviousPositions;
+
+    // Particles stay on the device between steps, they are uploaded only at initialization
+    bool                m_IsPositionsOnDevice;
+    bool                m_IsPreviousPositionsOnDevice;
+
+    // Densities are read back only when asked, a multi device simulation needs them on the host
+    bool                m_IsReadingBackDensities;
+    bool                m_IsReadingDensities;
+
+    // Host generations compared with the uploaded ones, only changed data are uploaded
+    unsigned int        m_ShapesGeneration;
+    unsigned int        m_UploadedShapesGeneration;
+    unsigned int        m_AcceleratorsGeneration;
+    unsigned int        m_UploadedAcceleratorsGeneration;
+    unsigned int        m_SphParametersGeneration;
+    unsigned int        m_UploadedSphParametersGeneration;
+
+    // The SPH kernel comes from a program specialized for the current parameters,
+    // its build options are empty when it is the generic one
+    bool                m_IsSpecializingKernels;
+    std::string         m_SPHBuildOptions;
+    // Options of every program used by the instance, the previous positions precision
+    std::string         m_ProgramBuildOptions;
+
 
     cl_bool m_ByteRWSupport;
 
 
-    // CPU and GPU context
-    const static int s_ContextCount = 1;
+    // GPU and CPU contexts, each one has all the devices of its type and its own programs
+    const static int s_ContextCount = 2;
     // CL objects
     static cl_context          s_Context[s_ContextCount];
     static cl_device_id*       s_Devices[s_ContextCount];
-    static cl_program          s_Program;
+    static int                 s_DevicesCount[s_ContextCount];
+    static cl_program          s_Program[s_ContextCount];
+    // Programs built with scene constants, by build options
+    static std::map<std::string, cl_program> s_SpecializedPrograms[s_ContextCount];
     static cl_platform_id      s_PlatformId;
     static bool                s_IsSetup;
-    static bool                s_ProgramIsCompiled;
+    static bool                s_ProgramIsCompiled[s_ContextCount];
     static bool                s_IsAmdHardware;
 
     cl_uint             m_DeviceId;
@@ -104,9 +206,13 @@ class ParticlesGPU
     
     // Kernels
     cl_kernel m_CreateGridKernel;
-    cl_kernel m_SortLocalKernel;
-    cl_kernel m_MergeSortKernel;
+    cl_kernel m_RadixHistogramKernel;
+    cl_kernel m_RadixScanKernel;
+    cl_kernel m_RadixScatterKernel;
+    cl_kernel m_ClearCellTableKernel;
+    cl_kernel m_BuildCellTableKernel;
     cl_kernel m_MinMaxKernel;
+    cl_kernel m_ReduceBoundsKernel;
     cl_kernel m_SPHIntegrateKernel;
     cl_kernel m_CopyBufferKernel;
     cl_kernel m_CollisionKernel;
@@ -123,6 +229,21 @@ public:
 
     void SetIsUsingCPU(bool isUsingCPU);
     bool IsUsingCPU() const;
+
+    // Device of the context used by this instance, must be set before Initialize
+    void SetDeviceIndex(int deviceIndex);
+    int GetDeviceIndex() const;
+    static int GetDevicesCount(bool isUsingCPU);
+
+    // The first particlesCount particles of the host arrays are simulated,
+    // at most the count given to Initialize. The particles are uploaded again
+    void SetActiveParticlesCount(int particlesCount);
+
+    // The SPH densities are read back by Synchronize with the particles
+    void SetIsReadingDensities(bool isReadingDensities);
+    // The queue times its commands, they are added to the profiler trace on a track
+    // of the queue while a trace is started. Must be set before Initialize
+    void SetIsProfilingCommands(bool isProfilingCommands);
     void SetIsUsingInteroperability(bool isUsingInteroperability);
     bool IsUsingInteroperability() const;
 
@@ -132,6 +253,13 @@ public:
     // Function used only for animation
     void SetAnimationTime(float animationTime);
 
+    // Step used by the accelerator integration, the previous one corrects the Verlet velocity
+    void SetDeltaT(float deltaT);
+
+    // SPH kernel compiled with the scene constants, a program is built for each new set of parameters
+    void SetIsSpecializingKernels(bool isSpecializingKernels);
+    bool IsSpecializingKernels() const;
+
     static int Setup(ID3D11Device *d3D11Device = NULL);
     static int StaticRelease();
 
@@ -158,30 +286,76 @@ public:
     // Update functions 
     void UpdateInputCreateGrid(slmath::vec4 *positions, slmath::vec4 *outMin, int *neighborInfo, int *neighborInfo2, int *gridInfo);
     void UpdateInput(slmath::vec4 *positions, float * density, int *neighborInfo, int *gridInfo, slmath::vec4 *outPressure);
-    void UpdateInputSPH(slmath::vec4 *positions, slmath::vec4 *previousPositions, float * density, int *neighborInfo, int *gridInfo, const SphParameters& sphParameters);
+    // The generations tell when the parameters, shapes or accelerators must be uploaded again
+    void UpdateInputSPH(slmath::vec4 *positions, slmath::vec4 *previousPositions, float * density, int *neighborInfo, int *gridInfo, 
+                        const SphParameters& sphParameters, unsigned int parametersGeneration);
     void UpdateInputCollision(slmath::vec4 *positions, slmath::vec4 *previousPositions, int particlesCount, 
                                             const Sphere *spheres, int spheresCount,
                                             const Sphere *spheresIn, int spheresInCount,
-                                            const Aabb *aabbs, int aabbsCount);
+                                            const Aabb *aabbs, int aabbsCount,
+                                            unsigned int shapesGeneration);
     void UpdateInputSpring(slmath::vec4 *positions, int particlesCount, const Spring *springs, int springsCount);
     void UpdateInputAccelerator(slmath::vec4 *positions, slmath::vec4 *previousPositions, int particlesCount, 
-                                const Accelerator *accelerators, int acceleratorsCount);
+                                const Accelerator *accelerators, int acceleratorsCount,
+                                unsigned int acceleratorsGeneration);
+
+    // Host particles are uploaded again by the next initialize kernel calls
+    void InvalidateDeviceParticles();
     void UpdateInputAnimation(slmath::vec4 *positions, slmath::vec4 *ends, int particlesCount);
 
+    // Reads back the results and waits for the enqueued commands, single sync point of a step.
+    // Without read back the host particles are out of date until a synchronization reads them
+    int Synchronize(bool isReadingBack = true);
+    // Reads back the particles of [first; first + count[ and waits for them, with their
+    // densities when the SPH runs. The pending read back of Synchronize is unchanged
+    int ReadParticles(int first, int count);
+    // Uploads the host particles of [first; first + count[ after the enqueued commands,
+    // the host arrays must not change before the next synchronization
+    int WriteParticles(int first, int count);
+    bool HasPendingReadBack() const;
+    void ReadBackDensities();
+
     int cleanup();
 
 
 private:
     static int BuildOpenCLProgram(int contextIndex);
+    static int CompileProgram(int contextIndex, const char *buildOptions, cl_program *program);
+    // Specialized program variants
+    static cl_program GetSpecializedProgram(int contextIndex, const std::string& buildOptions);
+    static std::string GetSPHBuildOptions(const SphParameters& sphParameters);
+    int SpecializeSPHKernel();
+    // Kernel binary cache, a binary by device
+    static std::string GetProgramBinaryFileName(int contextIndex, int deviceIndex, const std::string& source, const char *buildOptions);
+    static int LoadProgramBinaries(int contextIndex, const std::string& source, const char *buildOptions, cl_program *program);
+    static void SaveProgramBinaries(int contextIndex, const std::string& source, const char *buildOptions, cl_program program);
+    void ComputeLaunchSizes(int particlesCount);
     int  CreateBuffers(ID3D11Buffer *d3D11buffer);
     int  CreeateKernels();
+    int  CreateStagingBuffer();
+    int  UploadParticles(bool isUploadingPreviousPositions);
+    // Size of a previous position in the device buffer
+    size_t GetPreviousPositionSize() const;
+    void EncodePreviousPositions(int first, int count);
+    void DecodePreviousPositions(int first, int count);
+    // Densities of the last SPH step, read by the next one
+    cl_mem GetDensityBuffer() const;
     void CheckOutputMinMax();
     void CheckOutputGrid();
 
     int SortGrid();
+    int BuildCellTable();
     int CreateGrid();
     void TestSort();
 
+    // Event chain
+    cl_uint GetWaitEventsCount() const;
+    const cl_event *GetWaitEvents() const;
+    // The zone of the command in the profiler trace, eZoneCommand is resolved from the command type
+    void ChainEvent(cl_event event, CommandZone zone = eZoneCommand);
+    int WaitForLastEvent();
+    void ReportProfiledCommands();
+
     const static int s_TextSizeOnStack = 10240;
 };
 
@@ -0,0 +1,924 @@
+#include "ParticlesMultiGPU.hpp"
+#include "ParticlesGPU.hpp"
+
+#include <slmath/slmath.h>
+#include <assert.h>
+#include <algorithm>
+#include <float.h>
+#include <math.h>
+
+#include "ParticleEngine/SmoothedParticleHydrodynamics.h"
+#include "ParticleEngine/ParticlesCollider.h"
+#include "ParticleEngine/ParticlesAccelerator.h"
+#include "Utility/Utility.h"
+#include "Utility/Profiler.h"
+
+
+ParticlesMultiGPU::ParticlesMultiGPU() :    m_Slabs(NULL),
+                                            m_SlabsCount(0),
+                                            m_ActiveSlabsCount(0),
+                                            m_IsUsingCPU(false),
+                                            m_IsSpecializingKernels(false),
+                                            m_IsProfilingCommands(false),
+                                            m_ParticlesCount(0),
+                                            m_InitialAcceleratorsCount(0),
+                                            m_ClothCount(1),
+                                            m_AnimationTime(0.0f),
+                                            m_DeltaT(1.0f / 60.0f),
+                                            m_PreviousDeltaT(1.0f / 60.0f),
+                                            m_Positions(NULL),
+                                            m_PreviousPositions(NULL),
+                                            m_Density(NULL),
+                                            m_SphParameters(NULL),
+                                            m_SphParametersGeneration(0),
+                                            m_Spheres(NULL),
+                                            m_SpheresIn(NULL),
+                                            m_Aabbs(NULL),
+                                            m_SpheresCount(0),
+                                            m_SpheresInCount(0),
+                                            m_AabbsCount(0),
+                                            m_ShapesGeneration(0),
+                                            m_Accelerators(NULL),
+                                            m_AcceleratorsCount(0),
+                                            m_AcceleratorsGeneration(0),
+                                            m_SlabsLimits(NULL),
+                                            m_SortedX(NULL),
+                                            m_Owners(NULL),
+                                            m_OwnedSlots(NULL),
+                                            m_IsPartitioned(false),
+                                            m_HaloWidth(0.0f),
+                                            m_IsStepPending(false),
+                                            m_IsReadBackPending(false),
+                                            m_StepsSinceReadBack(0)
+{
+}
+
+ParticlesMultiGPU::~ParticlesMultiGPU()
+{
+    ReleaseSlabs();
+}
+
+void ParticlesMultiGPU::SetSlabsCount(int slabsCount)
+{
+    assert(slabsCount >= 0);
+    assert(m_Slabs == NULL && "SetSlabsCount must be called before Initialize.");
+    m_SlabsCount = slabsCount;
+}
+
+int ParticlesMultiGPU::GetSlabsCount() const
+{
+    return m_ActiveSlabsCount;
+}
+
+void ParticlesMultiGPU::SetIsUsingCPU(bool isUsingCPU)
+{
+    m_IsUsingCPU = isUsingCPU;
+}
+
+void ParticlesMultiGPU::SetIsSpecializingKernels(bool isSpecializingKernels)
+{
+    m_IsSpecializingKernels = isSpecializingKernels;
+    for (int i = 0; i < m_ActiveSlabsCount; i++)
+    {
+        if (m_Slabs[i].m_Device != NULL)
+        {
+            m_Slabs[i].m_Device->SetIsSpecializingKernels(isSpecializingKernels);
+        }
+    }
+}
+
+void ParticlesMultiGPU::SetIsProfilingCommands(bool isProfilingCommands)
+{
+    m_IsProfilingCommands = isProfilingCommands;
+}
+
+void ParticlesMultiGPU::SetClothCount(int clothCount)
+{
+    m_ClothCount = clothCount;
+    for (int i = 0; i < m_ActiveSlabsCount; i++)
+    {
+        if (m_Slabs[i].m_Device != NULL)
+        {
+            m_Slabs[i].m_Device->SetClothCount(clothCount);
+        }
+    }
+}
+
+void ParticlesMultiGPU::SetAnimationTime(float animationTime)
+{
+    m_AnimationTime = animationTime;
+    for (int i = 0; i < m_ActiveSlabsCount; i++)
+    {
+        if (m_Slabs[i].m_Device != NULL)
+        {
+            m_Slabs[i].m_Device->SetAnimationTime(animationTime);
+        }
+    }
+}
+
+void ParticlesMultiGPU::SetDeltaT(float deltaT)
+{
+    assert(deltaT > 0.0f);
+    m_PreviousDeltaT = m_DeltaT;
+    m_DeltaT = deltaT;
+    for (int i = 0; i < m_ActiveSlabsCount; i++)
+    {
+        if (m_Slabs[i].m_Device != NULL)
+        {
+            m_Slabs[i].m_Device->SetDeltaT(deltaT);
+        }
+    }
+}
+
+bool ParticlesMultiGPU::IsUsingInteroperability() const
+{
+    return false;
+}
+
+int ParticlesMultiGPU::Initialize(  int particlesCount, int springsCount, int acceleratorsCount,
+                                    const PipelineDescription& pipeline, ID3D11Buffer *d3D11buffer)
+{
+    UNUSED_PARAMETER(springsCount);
+    assert(particlesCount > 0);
+
+    // Springs and animation index the particles of the whole simulation, interoperability
+    // shares a single buffer
+    if (d3D11buffer != NULL || pipeline.m_SpringOnGPU || pipeline.m_IsUsingAnimation)
+        return CL_INVALID_OPERATION;
+
+    ReleaseSlabs();
+
+    const int devicesCount = ParticlesGPU::GetDevicesCount(m_IsUsingCPU);
+    assert(devicesCount > 0 && "No OpenCL device in the context.");
+
+    m_ParticlesCount = particlesCount;
+    m_InitialAcceleratorsCount = acceleratorsCount;
+    m_Pipeline = pipeline;
+    m_ActiveSlabsCount = (m_SlabsCount > 0) ? m_SlabsCount : devicesCount;
+
+    m_Slabs = new Slab[m_ActiveSlabsCount];
+    m_SlabsLimits = new float[m_ActiveSlabsCount];
+    m_SortedX = new float[particlesCount];
+    m_Owners = new int[particlesCount];
+    m_OwnedSlots = new int[particlesCount];
+
+    // Devices and arrays are sized by the first partition
+    for (int i = 0; i < m_ActiveSlabsCount; i++)
+    {
+        Slab& slab = m_Slabs[i];
+        slab.m_Device               = NULL;
+        slab.m_Capacity             = 0;
+        slab.m_Positions            = NULL;
+        slab.m_PreviousPositions    = NULL;
+        slab.m_Density              = NULL;
+        slab.m_Indices              = NULL;
+        slab.m_Types                = NULL;
+        slab.m_PartitionX           = NULL;
+        slab.m_NeighborsInfo        = NULL;
+        slab.m_NeighborsInfo2       = NULL;
+        slab.m_Bounds               = NULL;
+        slab.m_GridInfo[0]          = 0;
+        slab.m_GridInfo[1]          = 0;
+        slab.m_GridInfo[2]          = 0;
+        slab.m_GridInfo[3]          = 0;
+        slab.m_OwnedCount           = 0;
+        slab.m_Count                = 0;
+        slab.m_BandFirst            = 0;
+        slab.m_BandEnd              = 0;
+        slab.m_HaloFirst            = 0;
+        slab.m_HaloEnd              = 0;
+    }
+
+    return CL_SUCCESS;
+}
+
+// A quarter more than the first partition needs, the halo changes with the next ones
+int ParticlesMultiGPU::ReserveSlab(int slabIndex, int count)
+{
+    Slab& slab = m_Slabs[slabIndex];
+    if (count <= slab.m_Capacity)
+        return CL_SUCCESS;
+
+    cl_int status = CL_SUCCESS;
+    if (slab.m_Device != NULL)
+    {
+        status |= slab.m_Device->cleanup();
+        ReleaseSlab(slab);
+    }
+
+    const int capacity = std::min(count + count / 4, m_ParticlesCount);
+    slab.m_Capacity             = capacity;
+    slab.m_Positions            = new slmath::vec4[capacity];
+    slab.m_PreviousPositions    = new slmath::vec4[capacity];
+    slab.m_Density              = new float[capacity];
+    slab.m_Indices              = new int[capacity];
+    slab.m_Types                = new unsigned char[capacity];
+    slab.m_PartitionX           = new float[capacity];
+    slab.m_NeighborsInfo        = new int[2 * capacity];
+    slab.m_NeighborsInfo2       = new int[2 * capacity];
+    slab.m_Bounds               = new slmath::vec4[capacity];
+
+    ParticlesGPU *device = new ParticlesGPU;
+    device->SetIsUsingCPU(m_IsUsingCPU);
+    device->SetDeviceIndex(slabIndex % ParticlesGPU::GetDevicesCount(m_IsUsingCPU));
+    device->SetIsSpecializingKernels(m_IsSpecializingKernels);
+    device->SetIsProfilingCommands(m_IsProfilingCommands);
+    // Densities are read back with the particles, the halos need them
+    device->SetIsReadingDensities(true);
+    device->SetClothCount(m_ClothCount);
+    device->SetAnimationTime(m_AnimationTime);
+    device->SetDeltaT(m_PreviousDeltaT);
+    device->SetDeltaT(m_DeltaT);
+
+    status |= device->Initialize(capacity, 0, m_InitialAcceleratorsCount, m_Pipeline);
+    assert(status == CL_SUCCESS &&  "ParticlesGPU::Initialize failed.");
+    slab.m_Device = device;
+
+    return status;
+}
+
+// Particles are partitioned by the first stage of a step, the initialize functions have nothing to upload
+int ParticlesMultiGPU::InitializeCreateGrid()
+{
+    return CL_SUCCESS;
+}
+
+int ParticlesMultiGPU::InitializeKernelSPH()
+{
+    return CL_SUCCESS;
+}
+
+int ParticlesMultiGPU::InitializeKernelCollision()
+{
+    return CL_SUCCESS;
+}
+
+int ParticlesMultiGPU::InitializeKernelAccelerator()
+{
+    return CL_SUCCESS;
+}
+
+int ParticlesMultiGPU::InitializeKernelSpring()
+{
+    assert(false && "Springs can't be split in slabs.");
+    return CL_INVALID_OPERATION;
+}
+
+int ParticlesMultiGPU::InitializeKernelAnimation()
+{
+    assert(false && "Animation can't be split in slabs.");
+    return CL_INVALID_OPERATION;
+}
+
+void ParticlesMultiGPU::UpdateInputCreateGrid(slmath::vec4 *positions, slmath::vec4 *outMin, int *neighborInfo, int *neighborInfo2, int *gridInfo)
+{
+    // The grid is built by each device for its slab
+    UNUSED_PARAMETER(outMin);
+    UNUSED_PARAMETER(neighborInfo);
+    UNUSED_PARAMETER(neighborInfo2);
+    UNUSED_PARAMETER(gridInfo);
+
+    m_Positions = positions;
+}
+
+void ParticlesMultiGPU::UpdateInputSPH( slmath::vec4 *positions, slmath::vec4 *previousPositions, float * density, int *neighborInfo, int *gridInfo,
+                                        const SphParameters& sphParameters, unsigned int parametersGeneration)
+{
+    UNUSED_PARAMETER(neighborInfo);
+    UNUSED_PARAMETER(gridInfo);
+
+    m_Positions                 = positions;
+    m_PreviousPositions         = previousPositions;
+    m_Density                   = density;
+    m_SphParameters             = &sphParameters;
+    m_SphParametersGeneration   = parametersGeneration;
+}
+
+void ParticlesMultiGPU::UpdateInputCollision(   slmath::vec4 *positions, slmath::vec4 *previousPositions, int particlesCount,
+                                                const Sphere *spheres, int spheresCount,
+                                                const Sphere *spheresIn, int spheresInCount,
+                                                const Aabb *aabbs, int aabbsCount,
+                                                unsigned int shapesGeneration)
+{
+    UNUSED_PARAMETER(particlesCount);
+    assert(particlesCount == m_ParticlesCount);
+
+    m_Positions         = positions;
+    m_PreviousPositions = previousPositions;
+    m_Spheres           = spheres;
+    m_SpheresIn         = spheresIn;
+    m_Aabbs             = aabbs;
+    m_SpheresCount      = spheresCount;
+    m_SpheresInCount    = spheresInCount;
+    m_AabbsCount        = aabbsCount;
+    m_ShapesGeneration  = shapesGeneration;
+}
+
+void ParticlesMultiGPU::UpdateInputSpring(slmath::vec4 *positions, int particlesCount, const Spring *springs, int springsCount)
+{
+    UNUSED_PARAMETER(positions);
+    UNUSED_PARAMETER(particlesCount);
+    UNUSED_PARAMETER(springs);
+    UNUSED_PARAMETER(springsCount);
+    assert(false && "Springs can't be split in slabs.");
+}
+
+void ParticlesMultiGPU::UpdateInputAccelerator( slmath::vec4 *positions, slmath::vec4 *previousPositions, int particlesCount,
+                                                const Accelerator *accelerators, int acceleratorsCount,
+                                                unsigned int acceleratorsGeneration)
+{
+    UNUSED_PARAMETER(particlesCount);
+    assert(particlesCount == m_ParticlesCount);
+
+    m_Positions                 = positions;
+    m_PreviousPositions         = previousPositions;
+    m_Accelerators              = accelerators;
+    m_AcceleratorsCount         = acceleratorsCount;
+    m_AcceleratorsGeneration    = acceleratorsGeneration;
+}
+
+void ParticlesMultiGPU::UpdateInputAnimation(slmath::vec4 *positions, slmath::vec4 *ends, int particlesCount)
+{
+    UNUSED_PARAMETER(positions);
+    UNUSED_PARAMETER(ends);
+    UNUSED_PARAMETER(particlesCount);
+    assert(false && "Animation can't be split in slabs.");
+}
+
+void ParticlesMultiGPU::ComputeSlabsLimits()
+{
+    for (int i = 0; i < m_ParticlesCount; i++)
+    {
+        m_SortedX[i] = m_Positions[i].x;
+    }
+
+    // Each selection only looks after the previous limit
+    int first = 0;
+    for (int i = 1; i < m_ActiveSlabsCount; i++)
+    {
+        const int nth = std::max(i * m_ParticlesCount / m_ActiveSlabsCount, first);
+        std::nth_element(m_SortedX + first, m_SortedX + nth, m_SortedX + m_ParticlesCount);
+        m_SlabsLimits[i - 1] = m_SortedX[nth];
+        first = nth;
+    }
+}
+
+// Slabs before and after the owner closer than the halo width to x, the owner included
+void ParticlesMultiGPU::GetHaloSlabs(float x, int owner, int *first, int *last) const
+{
+    int s = owner;
+    while (s > 0 && x < m_SlabsLimits[s - 1] + m_HaloWidth)
+    {
+        s--;
+    }
+    *first = s;
+
+    s = owner;
+    while (s < m_ActiveSlabsCount - 1 && x >= m_SlabsLimits[s] - m_HaloWidth)
+    {
+        s++;
+    }
+    *last = s;
+}
+
+void ParticlesMultiGPU::AddParticle(Slab& slab, int index, SlotType type)
+{
+    const int slot = slab.m_Count++;
+    slab.m_Positions[slot]          = m_Positions[index];
+    slab.m_PreviousPositions[slot]  = m_PreviousPositions[index];
+    slab.m_Density[slot]            = (m_Density != NULL) ? m_Density[index] : 0.0f;
+    slab.m_Indices[slot]            = index;
+    slab.m_Types[slot]              = static_cast<unsigned char>(type);
+    if (type != eHalo)
+    {
+        slab.m_PartitionX[slot] = m_Positions[index].x;
+        slab.m_OwnedCount++;
+        m_OwnedSlots[index] = slot;
+    }
+}
+
+// Twice h, the neighbors within h of an owned particle stay in the halo while both move less than h
+float ParticlesMultiGPU::GetHaloWidth() const
+{
+    return (m_Pipeline.m_SPHAndIntegrateOnGPU && m_SphParameters != NULL) ? 2.0f * m_SphParameters->m_H : 0.0f;
+}
+
+int ParticlesMultiGPU::PartitionParticles()
+{
+    assert(m_Slabs != NULL && "Initialize must be called first.");
+    assert(m_Positions != NULL && m_PreviousPositions != NULL);
+
+    PROFILE_BEGIN();
+
+    const int slabsCount = m_ActiveSlabsCount;
+    float *limitsEnd = m_SlabsLimits + slabsCount - 1;
+    cl_int status = CL_SUCCESS;
+
+    // The pending halo uploads read the slabs
+    for (int s = 0; s < slabsCount; s++)
+    {
+        if (m_Slabs[s].m_Device != NULL)
+        {
+            status |= m_Slabs[s].m_Device->Synchronize(false);
+        }
+        m_Slabs[s].m_OwnedCount = 0;
+        m_Slabs[s].m_Count = 0;
+    }
+
+    ComputeSlabsLimits();
+    m_HaloWidth = GetHaloWidth();
+
+    // The counts of the slabs are known before they are filled
+    for (int i = 0; i < m_ParticlesCount; i++)
+    {
+        const float x = m_Positions[i].x;
+        const int owner = static_cast<int>(std::upper_bound(m_SlabsLimits, limitsEnd, x) - m_SlabsLimits);
+        m_Owners[i] = owner;
+
+        int first, last;
+        GetHaloSlabs(x, owner, &first, &last);
+        for (int s = first; s <= last; s++)
+        {
+            m_Slabs[s].m_Count++;
+        }
+    }
+    for (int s = 0; s < slabsCount; s++)
+    {
+        if (m_Slabs[s].m_Count > 0)
+        {
+            status |= ReserveSlab(s, m_Slabs[s].m_Count);
+        }
+        m_Slabs[s].m_Count = 0;
+    }
+
+    if (m_Pipeline.m_IsDeterministic)
+    {
+        // Owned and halo particles in the order of the simulation. The stable sort of a slab
+        // then gives each cell the order it has on a single device, the SPH sums are the same
+        for (int i = 0; i < m_ParticlesCount; i++)
+        {
+            const int owner = m_Owners[i];
+            int first, last;
+            GetHaloSlabs(m_Positions[i].x, owner, &first, &last);
+            const SlotType ownedType = (first < last) ? eBand : eInterior;
+            for (int s = first; s <= last; s++)
+            {
+                AddParticle(m_Slabs[s], i, (s == owner) ? ownedType : eHalo);
+            }
+        }
+    }
+    else
+    {
+        // The interior, the band then the halo, each one is a single range of the slab
+        for (int pass = 0; pass < 3; pass++)
+        {
+            for (int i = 0; i < m_ParticlesCount; i++)
+            {
+                const int owner = m_Owners[i];
+                int first, last;
+                GetHaloSlabs(m_Positions[i].x, owner, &first, &last);
+                const bool isInBand = first < last;
+                if (pass == 0 && ! isInBand)
+                {
+                    AddParticle(m_Slabs[owner], i, eInterior);
+                }
+                else if (pass == 1 && isInBand)
+                {
+                    AddParticle(m_Slabs[owner], i, eBand);
+                }
+                else if (pass == 2 && isInBand)
+                {
+                    for (int s = first; s <= last; s++)
+                    {
+                        if (s != owner)
+                        {
+                            AddParticle(m_Slabs[s], i, eHalo);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    for (int s = 0; s < slabsCount; s++)
+    {
+        Slab& slab = m_Slabs[s];
+        // Particles at the same x all go to the upper slab, the lower one can be empty
+        if (slab.m_Count == 0)
+            continue;
+
+        slab.m_BandFirst = slab.m_Count;
+        slab.m_BandEnd = 0;
+        slab.m_HaloFirst = slab.m_Count;
+        slab.m_HaloEnd = 0;
+        for (int i = 0; i < slab.m_Count; i++)
+        {
+            if (slab.m_Types[i] == eBand)
+            {
+                slab.m_BandFirst = std::min(slab.m_BandFirst, i);
+                slab.m_BandEnd = i + 1;
+            }
+            else if (slab.m_Types[i] == eHalo)
+            {
+                slab.m_HaloFirst = std::min(slab.m_HaloFirst, i);
+                slab.m_HaloEnd = i + 1;
+            }
+        }
+
+        ParticlesGPU *device = slab.m_Device;
+        slab.m_GridInfo[0] = slab.m_Count;
+        device->SetActiveParticlesCount(slab.m_Count);
+        device->InvalidateDeviceParticles();
+
+        if (m_Pipeline.m_AcceleratorOnGPU)
+        {
+            device->UpdateInputAccelerator( slab.m_Positions, slab.m_PreviousPositions, slab.m_Count,
+                                            m_Accelerators, m_AcceleratorsCount, m_AcceleratorsGeneration);
+            status |= device->InitializeKernelAccelerator();
+        }
+        if (m_Pipeline.m_CollisionOnGPU)
+        {
+            device->UpdateInputCollision(   slab.m_Positions, slab.m_PreviousPositions, slab.m_Count,
+                                            m_Spheres, m_SpheresCount,
+                                            m_SpheresIn, m_SpheresInCount,
+                                            m_Aabbs, m_AabbsCount,
+                                            m_ShapesGeneration);
+            status |= device->InitializeKernelCollision();
+        }
+        if (m_Pipeline.m_IsCreatingGridOnGPU)
+        {
+            device->UpdateInputCreateGrid(slab.m_Positions, slab.m_Bounds, slab.m_NeighborsInfo, slab.m_NeighborsInfo2, slab.m_GridInfo);
+            status |= device->InitializeCreateGrid();
+        }
+        if (m_Pipeline.m_SPHAndIntegrateOnGPU)
+        {
+            assert(m_SphParameters != NULL);
+            device->UpdateInputSPH( slab.m_Positions, slab.m_PreviousPositions, slab.m_Density, slab.m_NeighborsInfo, slab.m_GridInfo,
+                                    *m_SphParameters, m_SphParametersGeneration);
+            status |= device->InitializeKernelSPH();
+        }
+        assert(status == CL_SUCCESS &&  "Slab upload failed.");
+    }
+
+    m_IsPartitioned = true;
+    m_IsReadBackPending = false;
+    m_StepsSinceReadBack = 0;
+
+    PROFILE_END("Partition slabs");
+
+    return status;
+}
+
+// The host particles are partitioned when they aren't on the devices, or when h changes the halo
+int ParticlesMultiGPU::PrepareStep()
+{
+    cl_int status = CL_SUCCESS;
+    if (m_IsPartitioned && GetHaloWidth() != m_HaloWidth)
+    {
+        status |= ReadBackSlabs();
+        m_IsPartitioned = false;
+    }
+    if ( ! m_IsPartitioned)
+    {
+        status |= PartitionParticles();
+    }
+
+    m_IsStepPending = true;
+    m_IsReadBackPending = true;
+    return status;
+}
+
+// Each device flushes its own queue, the slabs run concurrently until Synchronize
+int ParticlesMultiGPU::runKernelCreateGrid()
+{
+    cl_int status = PrepareStep();
+    for (int s = 0; s < m_ActiveSlabsCount; s++)
+    {
+        if (m_Slabs[s].m_Count > 0)
+        {
+            status |= m_Slabs[s].m_Device->runKernelCreateGrid();
+        }
+    }
+    return status;
+}
+
+// Parameters, shapes and accelerators can change between the partitions
+int ParticlesMultiGPU::runKernelSPH()
+{
+    cl_int status = PrepareStep();
+    for (int s = 0; s < m_ActiveSlabsCount; s++)
+    {
+        Slab& slab = m_Slabs[s];
+        if (slab.m_Count > 0)
+        {
+            slab.m_Device->UpdateInputSPH(  slab.m_Positions, slab.m_PreviousPositions, slab.m_Density, slab.m_NeighborsInfo, slab.m_GridInfo,
+                                            *m_SphParameters, m_SphParametersGeneration);
+            status |= slab.m_Device->runKernelSPH();
+        }
+    }
+    return status;
+}
+
+int ParticlesMultiGPU::runKernelCollision()
+{
+    cl_int status = PrepareStep();
+    for (int s = 0; s < m_ActiveSlabsCount; s++)
+    {
+        Slab& slab = m_Slabs[s];
+        if (slab.m_Count > 0)
+        {
+            slab.m_Device->UpdateInputCollision(slab.m_Positions, slab.m_PreviousPositions, slab.m_Count,
+                                                m_Spheres, m_SpheresCount,
+                                                m_SpheresIn, m_SpheresInCount,
+                                                m_Aabbs, m_AabbsCount,
+                                                m_ShapesGeneration);
+            status |= slab.m_Device->runKernelCollision();
+        }
+    }
+    return status;
+}
+
+int ParticlesMultiGPU::runKernelAccelerator()
+{
+    cl_int status = PrepareStep();
+    for (int s = 0; s < m_ActiveSlabsCount; s++)
+    {
+        Slab& slab = m_Slabs[s];
+        if (slab.m_Count > 0)
+        {
+            slab.m_Device->UpdateInputAccelerator(  slab.m_Positions, slab.m_PreviousPositions, slab.m_Count,
+                                                    m_Accelerators, m_AcceleratorsCount, m_AcceleratorsGeneration);
+            status |= slab.m_Device->runKernelAccelerator();
+        }
+    }
+    return status;
+}
+
+int ParticlesMultiGPU::runKernelSpring()
+{
+    assert(false && "Springs can't be split in slabs.");
+    return CL_INVALID_OPERATION;
+}
+
+int ParticlesMultiGPU::runKernelAnimation()
+{
+    assert(false && "Animation can't be split in slabs.");
+    return CL_INVALID_OPERATION;
+}
+
+void ParticlesMultiGPU::InvalidateDeviceParticles()
+{
+    // The next stage partitions the host particles
+    m_IsPartitioned = false;
+    m_IsStepPending = false;
+    m_IsReadBackPending = false;
+}
+
+// Reads back every slab and writes the owned particles in the simulation arrays
+int ParticlesMultiGPU::ReadBackSlabs()
+{
+    cl_int status = CL_SUCCESS;
+    for (int s = 0; s < m_ActiveSlabsCount; s++)
+    {
+        if (m_Slabs[s].m_Count > 0)
+        {
+            status |= m_Slabs[s].m_Device->Synchronize(true);
+        }
+    }
+    assert(status == CL_SUCCESS &&  "ParticlesGPU::Synchronize failed.");
+
+    if (m_IsReadBackPending)
+    {
+        const bool isWritingDensity = m_Pipeline.m_SPHAndIntegrateOnGPU && m_Density != NULL;
+        for (int s = 0; s < m_ActiveSlabsCount; s++)
+        {
+            const Slab& slab = m_Slabs[s];
+            for (int i = 0; i < slab.m_Count; i++)
+            {
+                if (slab.m_Types[i] == eHalo)
+                    continue;
+
+                const int index = slab.m_Indices[i];
+                m_Positions[index]          = slab.m_Positions[i];
+                m_PreviousPositions[index]  = slab.m_PreviousPositions[i];
+                if (isWritingDensity)
+                {
+                    m_Density[index] = slab.m_Density[i];
+                }
+            }
+        }
+    }
+
+    m_IsReadBackPending = false;
+    m_StepsSinceReadBack = 0;
+    return status;
+}
+
+// The halos hold every neighbor within h while the owned particles stay in their slab and
+// move less than h since the partition
+bool ParticlesMultiGPU::IsPartitionValid() const
+{
+    if (m_HaloWidth == 0.0f)
+        return true;
+
+    const float maxMove = 0.5f * m_HaloWidth;
+    for (int s = 0; s < m_ActiveSlabsCount; s++)
+    {
+        const Slab& slab = m_Slabs[s];
+        const float lower = (s > 0) ? m_SlabsLimits[s - 1] : -FLT_MAX;
+        const float upper = (s < m_ActiveSlabsCount - 1) ? m_SlabsLimits[s] : FLT_MAX;
+        for (int i = 0; i < slab.m_Count; i++)
+        {
+            if (slab.m_Types[i] == eHalo)
+                continue;
+
+            const float x = slab.m_Positions[i].x;
+            if (x < lower || x >= upper || fabsf(x - slab.m_PartitionX[i]) >= maxMove)
+                return false;
+        }
+    }
+    return true;
+}
+
+// Copies the bands in the halos of the other slabs, the bands are read back first unless
+// the whole slabs just were
+int ParticlesMultiGPU::ExchangeHalos(bool isReadingBands)
+{
+    cl_int status = CL_SUCCESS;
+    if (m_HaloWidth == 0.0f)
+        return status;
+
+    if (isReadingBands)
+    {
+        for (int s = 0; s < m_ActiveSlabsCount; s++)
+        {
+            const Slab& slab = m_Slabs[s];
+            if (slab.m_BandFirst < slab.m_BandEnd)
+            {
+                status |= slab.m_Device->ReadParticles(slab.m_BandFirst, slab.m_BandEnd - slab.m_BandFirst);
+            }
+        }
+    }
+
+    for (int s = 0; s < m_ActiveSlabsCount; s++)
+    {
+        Slab& slab = m_Slabs[s];
+        for (int i = slab.m_HaloFirst; i < slab.m_HaloEnd; i++)
+        {
+            if (slab.m_Types[i] != eHalo)
+                continue;
+
+            const int index = slab.m_Indices[i];
+            const Slab& owner = m_Slabs[m_Owners[index]];
+            const int ownedSlot = m_OwnedSlots[index];
+            slab.m_Positions[i]         = owner.m_Positions[ownedSlot];
+            slab.m_PreviousPositions[i] = owner.m_PreviousPositions[ownedSlot];
+            slab.m_Density[i]           = owner.m_Density[ownedSlot];
+        }
+
+        // Owned particles aren't written, a deterministic halo is uploaded by runs
+        int first = slab.m_HaloFirst;
+        while (first < slab.m_HaloEnd)
+        {
+            int last = first;
+            while (last < slab.m_HaloEnd && slab.m_Types[last] == eHalo)
+            {
+                last++;
+            }
+            if (last > first)
+            {
+                status |= slab.m_Device->WriteParticles(first, last - first);
+                first = last;
+            }
+            else
+            {
+                first++;
+            }
+        }
+    }
+
+    return status;
+}
+
+int ParticlesMultiGPU::Synchronize(bool isReadingBack)
+{
+    if ( ! m_IsPartitioned)
+        return CL_SUCCESS;
+
+    PROFILE_BEGIN();
+
+    if (m_IsStepPending)
+    {
+        m_StepsSinceReadBack++;
+    }
+
+    // Everything is read back when asked, and regularly to check the partition
+    cl_int status = CL_SUCCESS;
+    const bool isReadingAll = m_IsReadBackPending && (isReadingBack || m_StepsSinceReadBack >= s_FullReadBackPeriod);
+    if (isReadingAll)
+    {
+        status |= ReadBackSlabs();
+        if ( ! IsPartitionValid())
+        {
+            // The next stage partitions the host particles again
+            m_IsPartitioned = false;
+            m_IsStepPending = false;
+        }
+    }
+
+    if (m_IsStepPending)
+    {
+        status |= ExchangeHalos( ! isReadingAll);
+        m_IsStepPending = false;
+    }
+
+    // The halo uploads are done before the next step
+    for (int s = 0; s < m_ActiveSlabsCount; s++)
+    {
+        if (m_Slabs[s].m_Count > 0)
+        {
+            status |= m_Slabs[s].m_Device->Synchronize(false);
+        }
+    }
+    assert(status == CL_SUCCESS &&  "ParticlesMultiGPU::Synchronize failed.");
+
+    PROFILE_END("Exchange slabs");
+
+    return status;
+}
+
+bool ParticlesMultiGPU::HasPendingReadBack() const
+{
+    return m_IsReadBackPending;
+}
+
+// Densities of the slabs are always read back with the particles
+void ParticlesMultiGPU::ReadBackDensities()
+{
+}
+
+void ParticlesMultiGPU::ReleaseSlab(Slab& slab)
+{
+    delete slab.m_Device;
+    delete[] slab.m_Positions;
+    delete[] slab.m_PreviousPositions;
+    delete[] slab.m_Density;
+    delete[] slab.m_Indices;
+    delete[] slab.m_Types;
+    delete[] slab.m_PartitionX;
+    delete[] slab.m_NeighborsInfo;
+    delete[] slab.m_NeighborsInfo2;
+    delete[] slab.m_Bounds;
+
+    slab.m_Device               = NULL;
+    slab.m_Capacity             = 0;
+    slab.m_Positions            = NULL;
+    slab.m_PreviousPositions    = NULL;
+    slab.m_Density              = NULL;
+    slab.m_Indices              = NULL;
+    slab.m_Types                = NULL;
+    slab.m_PartitionX           = NULL;
+    slab.m_NeighborsInfo        = NULL;
+    slab.m_NeighborsInfo2       = NULL;
+    slab.m_Bounds               = NULL;
+}
+
+void ParticlesMultiGPU::ReleaseSlabs()
+{
+    for (int s = 0; s < m_ActiveSlabsCount; s++)
+    {
+        ReleaseSlab(m_Slabs[s]);
+    }
+
+    delete[] m_Slabs;
+    delete[] m_SlabsLimits;
+    delete[] m_SortedX;
+    delete[] m_Owners;
+    delete[] m_OwnedSlots;
+
+    m_Slabs             = NULL;
+    m_SlabsLimits       = NULL;
+    m_SortedX           = NULL;
+    m_Owners            = NULL;
+    m_OwnedSlots        = NULL;
+    m_ActiveSlabsCount  = 0;
+    m_IsPartitioned     = false;
+    m_IsStepPending     = false;
+    m_IsReadBackPending = false;
+}
+
+int ParticlesMultiGPU::cleanup()
+{
+    cl_int status = CL_SUCCESS;
+    for (int s = 0; s < m_ActiveSlabsCount; s++)
+    {
+        if (m_Slabs[s].m_Device != NULL)
+        {
+            status |= m_Slabs[s].m_Device->cleanup();
+        }
+    }
+
+    ReleaseSlabs();
+
+    return status;
+}
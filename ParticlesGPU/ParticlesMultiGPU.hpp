@@ -0,0 +1,185 @@
+#ifndef PARTICLES_MULTI_GPU
+#define PARTICLES_MULTI_GPU
+
+#include "ParticleEngine/ParticlesBackend.h"
+#include "ParticleEngine/PipelineDescription.h"
+
+class ParticlesGPU;
+
+// Splits one simulation across the OpenCL devices of a context by slabs along x.
+// A partition cuts the host particles at the x quantiles, so the slabs own the same count.
+// Owned particles closer than 2h to another slab (the band) are copied in that slab (its
+// halo), they are simulated with it but only the owned particles are written back.
+// Particles stay on the devices between steps, Synchronize only reads back the bands and
+// writes them in the halos. Everything is read back when asked, and at least every
+// s_FullReadBackPeriod steps to check that no owned particle left its slab or moved
+// more than h since the partition, else the next step partitions again. The margin of h
+// assumes a particle moves less than h in these steps. Deterministic slabs keep the
+// particles order, their halos are written by runs of slots.
+// Springs and animation work on particle indices, Initialize rejects them.
+// Several CPU devices of PoCL (POCL_DEVICES="pthread pthread") are enough to run it
+class ParticlesMultiGPU : public ParticlesBackend
+{
+public:
+    ParticlesMultiGPU();
+    ~ParticlesMultiGPU();
+
+    // 0 uses one slab by device, more slabs than devices share the devices.
+    // Must be called before Initialize
+    void SetSlabsCount(int slabsCount);
+    // Slabs used by the simulation, 0 before Initialize
+    int GetSlabsCount() const;
+    void SetIsUsingCPU(bool isUsingCPU);
+    void SetIsSpecializingKernels(bool isSpecializingKernels);
+    // Each slab has its own queue track in the profiler trace
+    void SetIsProfilingCommands(bool isProfilingCommands);
+
+    void SetClothCount(int clothCount);
+    void SetAnimationTime(float animationTime);
+    void SetDeltaT(float deltaT);
+    bool IsUsingInteroperability() const;
+
+    int Initialize( int particlesCount, int springsCount, int acceleratorsCount,
+                    const PipelineDescription& pipeline, ID3D11Buffer *d3D11buffer = NULL);
+
+    int InitializeCreateGrid();
+    int InitializeKernelSPH();
+    int InitializeKernelCollision();
+    int InitializeKernelAccelerator();
+    int InitializeKernelSpring();
+    int InitializeKernelAnimation();
+
+    int runKernelCreateGrid();
+    int runKernelSPH();
+    int runKernelCollision();
+    int runKernelSpring();
+    int runKernelAccelerator();
+    int runKernelAnimation();
+
+    void UpdateInputCreateGrid(slmath::vec4 *positions, slmath::vec4 *outMin, int *neighborInfo, int *neighborInfo2, int *gridInfo);
+    void UpdateInputSPH(slmath::vec4 *positions, slmath::vec4 *previousPositions, float * density, int *neighborInfo, int *gridInfo,
+                        const SphParameters& sphParameters, unsigned int parametersGeneration);
+    void UpdateInputCollision(  slmath::vec4 *positions, slmath::vec4 *previousPositions, int particlesCount,
+                                const Sphere *spheres, int spheresCount,
+                                const Sphere *spheresIn, int spheresInCount,
+                                const Aabb *aabbs, int aabbsCount,
+                                unsigned int shapesGeneration);
+    void UpdateInputSpring(slmath::vec4 *positions, int particlesCount, const Spring *springs, int springsCount);
+    void UpdateInputAccelerator(slmath::vec4 *positions, slmath::vec4 *previousPositions, int particlesCount,
+                                const Accelerator *accelerators, int acceleratorsCount,
+                                unsigned int acceleratorsGeneration);
+    void UpdateInputAnimation(slmath::vec4 *positions, slmath::vec4 *ends, int particlesCount);
+
+    void InvalidateDeviceParticles();
+    int Synchronize(bool isReadingBack = true);
+    bool HasPendingReadBack() const;
+    void ReadBackDensities();
+
+    int cleanup();
+
+private:
+    enum SlotType
+    {
+        eInterior = 0,
+        eBand,
+        eHalo
+    };
+
+    // Device and host copy of the particles of a slab: the interior ones, the band then
+    // the halo. Deterministic slabs keep the particles order instead
+    struct Slab
+    {
+        // Created by the first partition with room for more particles, again when they don't fit
+        ParticlesGPU    *m_Device;
+        int             m_Capacity;
+        slmath::vec4    *m_Positions;
+        slmath::vec4    *m_PreviousPositions;
+        float           *m_Density;
+        // Index of each particle in the simulation arrays
+        int             *m_Indices;
+        unsigned char   *m_Types;
+        // x of the owned particles at the partition
+        float           *m_PartitionX;
+        int             *m_NeighborsInfo;
+        int             *m_NeighborsInfo2;
+        // Output of the bounds reduction
+        slmath::vec4    *m_Bounds;
+        int             m_GridInfo[4];
+        int             m_OwnedCount;
+        int             m_Count;
+        // Slots holding the band and the halo, the ranges have other slots only when
+        // the slabs are deterministic
+        int             m_BandFirst;
+        int             m_BandEnd;
+        int             m_HaloFirst;
+        int             m_HaloEnd;
+    };
+
+    // Full read back of the particles at least every this many steps
+    static const int    s_FullReadBackPeriod = 4;
+
+    int PrepareStep();
+    int PartitionParticles();
+    int ReserveSlab(int slabIndex, int count);
+    void ComputeSlabsLimits();
+    void GetHaloSlabs(float x, int owner, int *first, int *last) const;
+    void AddParticle(Slab& slab, int index, SlotType type);
+    float GetHaloWidth() const;
+    int ReadBackSlabs();
+    bool IsPartitionValid() const;
+    int ExchangeHalos(bool isReadingBands);
+    void ReleaseSlab(Slab& slab);
+    void ReleaseSlabs();
+
+    Slab                *m_Slabs;
+    int                 m_SlabsCount;
+    int                 m_ActiveSlabsCount;
+    bool                m_IsUsingCPU;
+    bool                m_IsSpecializingKernels;
+    bool                m_IsProfilingCommands;
+
+    // Kept for the devices created by the partitions
+    int                 m_ParticlesCount;
+    int                 m_InitialAcceleratorsCount;
+    int                 m_ClothCount;
+    float               m_AnimationTime;
+    float               m_DeltaT;
+    float               m_PreviousDeltaT;
+    PipelineDescription m_Pipeline;
+
+    // Simulation arrays given by the update functions
+    slmath::vec4        *m_Positions;
+    slmath::vec4        *m_PreviousPositions;
+    float               *m_Density;
+    const SphParameters *m_SphParameters;
+    unsigned int        m_SphParametersGeneration;
+    const Sphere        *m_Spheres;
+    const Sphere        *m_SpheresIn;
+    const Aabb          *m_Aabbs;
+    int                 m_SpheresCount;
+    int                 m_SpheresInCount;
+    int                 m_AabbsCount;
+    unsigned int        m_ShapesGeneration;
+    const Accelerator   *m_Accelerators;
+    int                 m_AcceleratorsCount;
+    unsigned int        m_AcceleratorsGeneration;
+
+    // Lower x limit of each slab after the first one, and the x values sorted around them
+    float               *m_SlabsLimits;
+    float               *m_SortedX;
+    // Owner slab of each particle and its index in the slab
+    int                 *m_Owners;
+    int                 *m_OwnedSlots;
+
+    // Particles are on the devices until the host ones are invalidated or a check fails
+    bool                m_IsPartitioned;
+    // Distance to the other slabs of the halo particles, 0 without SPH
+    float               m_HaloWidth;
+    // Stages ran since the last halo exchange
+    bool                m_IsStepPending;
+    // The devices have results the host particles don't have
+    bool                m_IsReadBackPending;
+    int                 m_StepsSinceReadBack;
+};
+
+#endif // PARTICLES_MULTI_GPU
@@ -0,0 +1,13 @@
+#ifndef HEAP_COUNTER
+#define HEAP_COUNTER
+
+// Counts the heap allocations of the process. The global operator new of the replay is
+// replaced by one counting its calls, so the allocations of the libraries built with
+// the replay are counted with its own
+class HeapCounter
+{
+public:
+    static long long GetAllocationsCount();
+};
+
+#endif // HEAP_COUNTER
@@ -0,0 +1,112 @@
+#include "SceneReplay.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+
+// Headless replay of the demo scenes, no window is needed.
+//     scene_replay [--scene=<name>] [--frames=<count>] [--warmup=<count>] [--delta_t=<seconds>]
+//                  [--native] [--pin_threads] [--cpu_device] [--device=<index>] [--seed=<seed>] [--csv=<file>]
+//                  [--deterministic] [--counters] [--cache=<file>] [--list]
+// --native is implied when the OpenCL backends are compiled out (PARTICLES_GPU_DISABLED)
+// --pin_threads pins the native backend threads over the NUMA nodes
+// --deterministic gives the same checksum whatever the cores and devices count
+// --counters reports the hardware counters of the stages, Linux perf_event only
+// --cache writes the particles of the measured frames for offline rendering
+namespace
+{
+    const char* GetValue(const char *argument, const char *option)
+    {
+        const size_t length = strlen(option);
+        return strncmp(argument, option, length) == 0 ? argument + length : NULL;
+    }
+
+    void PrintUsage()
+    {
+        printf( "scene_replay [--scene=<name>] [--frames=<count>] [--warmup=<count>] [--delta_t=<seconds>]\n"
+                "             [--native] [--pin_threads] [--cpu_device] [--device=<index>] [--seed=<seed>] [--csv=<file>]\n"
+                "             [--deterministic] [--counters] [--cache=<file>] [--list]\n");
+    }
+}
+
+int main(int argc, char **argv)
+{
+    ReplayOptions options;
+    for (int i = 1; i < argc; i++)
+    {
+        const char *argument = argv[i];
+        const char *value = NULL;
+        if ((value = GetValue(argument, "--scene=")) != NULL)
+        {
+            options.m_SceneName = value;
+        }
+        else if ((value = GetValue(argument, "--frames=")) != NULL)
+        {
+            options.m_FramesCount = atoi(value) > 0 ? atoi(value) : 1;
+        }
+        else if ((value = GetValue(argument, "--warmup=")) != NULL)
+        {
+            options.m_WarmupFramesCount = atoi(value) > 0 ? atoi(value) : 0;
+        }
+        else if ((value = GetValue(argument, "--delta_t=")) != NULL)
+        {
+            options.m_DeltaT = static_cast<float>(atof(value));
+        }
+        else if (strcmp(argument, "--native") == 0)
+        {
+            options.m_IsUsingNativeBackend = true;
+        }
+        else if (strcmp(argument, "--pin_threads") == 0)
+        {
+            options.m_IsPinningThreads = true;
+        }
+        else if (strcmp(argument, "--cpu_device") == 0)
+        {
+            options.m_IsUsingCPU = true;
+        }
+        else if ((value = GetValue(argument, "--device=")) != NULL)
+        {
+            options.m_DeviceIndex = atoi(value);
+        }
+        else if ((value = GetValue(argument, "--seed=")) != NULL)
+        {
+            options.m_Seed = static_cast<unsigned int>(strtoul(value, NULL, 10));
+        }
+        else if (strcmp(argument, "--deterministic") == 0)
+        {
+            options.m_IsDeterministic = true;
+        }
+        else if ((value = GetValue(argument, "--csv=")) != NULL)
+        {
+            options.m_CsvFileName = value;
+        }
+        else if (strcmp(argument, "--counters") == 0)
+        {
+            options.m_IsUsingHardwareCounters = true;
+        }
+        else if ((value = GetValue(argument, "--cache=")) != NULL)
+        {
+            options.m_CacheFileName = value;
+        }
+        else if (strcmp(argument, "--list") == 0)
+        {
+            SceneReplay::ListScenes();
+            return 0;
+        }
+        else
+        {
+            PrintUsage();
+            return strcmp(argument, "--help") == 0 ? 0 : 1;
+        }
+    }
+
+    if (options.m_DeltaT <= 0.0f)
+    {
+        fprintf(stderr, "The delta t must be positive\n");
+        return 1;
+    }
+
+    SceneReplay replay(options);
+    return replay.Run();
+}
@@ -0,0 +1,481 @@
+#include "SceneReplay.h"
+#include "HeapCounter.h"
+#include "Framework/BaseScene.h"
+#include "Framework/Scenes/AnimationScene.h"
+#include "Framework/Scenes/ClothScene.h"
+#include "Framework/Scenes/GalaxyScene.h"
+#include "Framework/Scenes/RainScene.h"
+#include "Framework/Scenes/TestGridScene.h"
+#include "Framework/Scenes/TransitionScene.h"
+#include "Framework/Scenes/WaterScene.h"
+#include "Utility/Platform.h"
+#include "Utility/Profiler.h"
+
+#include <algorithm>
+#include <assert.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+
+namespace
+{
+    const char *s_SceneNames[] = { "water", "grid", "cloth", "galaxy", "rain", "animation", "transition" };
+    const int s_ScenesCount = sizeof(s_SceneNames) / sizeof(s_SceneNames[0]);
+}
+
+SceneReplay::SceneReplay(const ReplayOptions& options)
+ : m_Options(options)
+ , m_ParticlesCount(0)
+ , m_IsCountingHardware(false)
+ , m_FramesHeapAllocationsCount(0)
+{
+}
+
+BaseScene* SceneReplay::CreateScene(const char *name)
+{
+    // Same order as the demos keys of the framework
+    if (strcmp(name, "water") == 0)
+        return new WaterScene;
+    if (strcmp(name, "grid") == 0)
+        return new TestGridScene;
+    if (strcmp(name, "cloth") == 0)
+        return new ClothScene;
+    if (strcmp(name, "galaxy") == 0)
+        return new GalaxyScene;
+    if (strcmp(name, "rain") == 0)
+        return new RainScene;
+    if (strcmp(name, "animation") == 0)
+        return new AnimationScene;
+    if (strcmp(name, "transition") == 0)
+        return new TransitionScene;
+    return NULL;
+}
+
+void SceneReplay::ListScenes()
+{
+    for (int i = 0; i < s_ScenesCount; i++)
+    {
+        printf("%s\n", s_SceneNames[i]);
+    }
+}
+
+int SceneReplay::Run()
+{
+    BaseScene *scene = CreateScene(m_Options.m_SceneName);
+    if (scene == NULL)
+    {
+        fprintf(stderr, "Unknown scene %s\n", m_Options.m_SceneName);
+        return 1;
+    }
+
+    // Before the scene starts the threads of its simulations, they are counted
+    Profiler *profiler = Profiler::GetInstance();
+    if (m_Options.m_IsUsingHardwareCounters)
+    {
+        m_IsCountingHardware = profiler->SetEnableHardwareCounters(true);
+        if ( ! m_IsCountingHardware)
+        {
+            fprintf(stderr, "Hardware counters are unavailable, check perf_event_paranoid\n");
+        }
+    }
+
+    // Scenes scripted on the time follow the frames, a replay gives the same states
+    scene->SetRandomSeed(m_Options.m_Seed);
+    scene->SetCamera(&m_Camera);
+    scene->SetIsUsingWallClock(false);
+    scene->Initialize();
+
+    for (int i = 0; i < scene->GetPhysicsParticlesCount(); i++)
+    {
+        PhysicsParticle& physicsParticle = scene->GetPhysicsParticle(i);
+        physicsParticle.SetIsUsingInteroperability(false);
+        if (m_Options.m_IsUsingNativeBackend)
+        {
+            physicsParticle.SetIsUsingNativeBackend(true);
+        }
+        if (m_Options.m_IsUsingCPU)
+        {
+            physicsParticle.SetIsUsingCPU(true);
+        }
+        if (m_Options.m_IsPinningThreads)
+        {
+            physicsParticle.SetEnableThreadPinning(true);
+        }
+        if (m_Options.m_IsDeterministic)
+        {
+            physicsParticle.SetEnableDeterminism(true);
+        }
+        if (m_Options.m_DeviceIndex >= 0)
+        {
+            physicsParticle.SetDeviceIndex(m_Options.m_DeviceIndex);
+        }
+        m_ParticlesCount += physicsParticle.GetParticlesCount();
+    }
+    scene->InitializeOpenCL();
+
+    // The initialization zones are not reported
+    profiler->EndFrame();
+
+    for (int i = 0; i < m_Options.m_WarmupFramesCount; i++)
+    {
+        scene->Simulate(m_Options.m_DeltaT);
+        profiler->EndFrame();
+    }
+
+    if (m_Options.m_CacheFileName != NULL && ! m_CacheWriter.Open(m_Options.m_CacheFileName))
+    {
+        fprintf(stderr, "Can't create the cache %s\n", m_Options.m_CacheFileName);
+        scene->Release();
+        delete scene;
+        return 1;
+    }
+
+    const HardwareCounters& hardwareCounters = profiler->GetHardwareCounters();
+    long long startCounters[HardwareCounters::eCountersCount];
+    long long counters[HardwareCounters::eCountersCount];
+
+    m_FramesHeapAllocationsCount = 0;
+    m_Frames.reserve(m_Options.m_FramesCount);
+    for (int i = 0; i < m_Options.m_FramesCount; i++)
+    {
+        const long long heapAllocationsCount = HeapCounter::GetAllocationsCount();
+        hardwareCounters.Read(startCounters);
+        const long long start = Profiler::GetTicks();
+        scene->Simulate(m_Options.m_DeltaT);
+        const double frameTime = (Profiler::GetTicks() - start) / Profiler::GetTicksPerMillisecond();
+        hardwareCounters.Read(counters);
+        m_FramesHeapAllocationsCount += HeapCounter::GetAllocationsCount() - heapAllocationsCount;
+        for (int j = 0; j < HardwareCounters::eCountersCount; j++)
+        {
+            counters[j] -= startCounters[j];
+        }
+
+        profiler->EndFrame();
+        RecordFrame(frameTime, counters);
+
+        // Out of the frame time, the worker encodes it during the next frame
+        if (m_CacheWriter.IsOpen())
+        {
+            WriteCacheFrame(*scene);
+        }
+    }
+    const bool isCacheWritten = m_CacheWriter.Close();
+
+    const unsigned long long checksum = ComputeChecksum(*scene);
+    m_MemoryUsage = GetMemoryUsage(*scene);
+    scene->Release();
+    delete scene;
+
+    if (m_IsCountingHardware)
+    {
+        profiler->SetEnableHardwareCounters(false);
+    }
+
+    Report(checksum);
+    if ( ! isCacheWritten)
+    {
+        fprintf(stderr, "Can't write the cache %s\n", m_Options.m_CacheFileName);
+        return 1;
+    }
+    return WriteCsv() ? 0 : 1;
+}
+
+unsigned long long SceneReplay::ComputeChecksum(BaseScene& scene)
+{
+    unsigned long long hash = 14695981039346656037ULL;
+    for (int i = 0; i < scene.GetPhysicsParticlesCount(); i++)
+    {
+        const PhysicsParticle& physicsParticle = scene.GetPhysicsParticle(i);
+        const unsigned char *bytes = reinterpret_cast<const unsigned char *>(physicsParticle.GetParticlePositions());
+        const size_t bytesCount = physicsParticle.GetParticlesCount() * sizeof(vrVec4);
+        for (size_t j = 0; j < bytesCount; j++)
+        {
+            hash ^= bytes[j];
+            hash *= 1099511628211ULL;
+        }
+    }
+    return hash;
+}
+
+vrMemoryUsage SceneReplay::GetMemoryUsage(BaseScene& scene)
+{
+    vrMemoryUsage memoryUsage;
+    memset(&memoryUsage, 0, sizeof(memoryUsage));
+    for (int i = 0; i < scene.GetPhysicsParticlesCount(); i++)
+    {
+        const vrMemoryUsage simulationUsage = scene.GetPhysicsParticle(i).GetMemoryUsage();
+        memoryUsage.m_ReservedSize          += simulationUsage.m_ReservedSize;
+        memoryUsage.m_UsedSize              += simulationUsage.m_UsedSize;
+        memoryUsage.m_ScratchPeakSize       = std::max(memoryUsage.m_ScratchPeakSize, simulationUsage.m_ScratchPeakSize);
+        memoryUsage.m_HeapFallbacksCount    += simulationUsage.m_HeapFallbacksCount;
+        memoryUsage.m_IsUsingLargePages     = memoryUsage.m_IsUsingLargePages || simulationUsage.m_IsUsingLargePages;
+    }
+    return memoryUsage;
+}
+
+// The simulations of the scene are one after the other in a frame
+void SceneReplay::WriteCacheFrame(BaseScene& scene)
+{
+    m_CacheWriter.BeginFrame();
+    for (int i = 0; i < scene.GetPhysicsParticlesCount(); i++)
+    {
+        const PhysicsParticle& physicsParticle = scene.GetPhysicsParticle(i);
+        m_CacheWriter.AddParticles(physicsParticle.GetParticlePositions(), physicsParticle.GetParticlesCount());
+    }
+    m_CacheWriter.EndFrame();
+}
+
+void SceneReplay::RecordFrame(double frameTime, const long long counters[HardwareCounters::eCountersCount])
+{
+    const Profiler *profiler = Profiler::GetInstance();
+
+    Frame frame;
+    frame.m_Time = frameTime;
+    memcpy(frame.m_Counters, counters, sizeof(frame.m_Counters));
+    const int zonesCount = profiler->GetZonesCount();
+    frame.m_ZonesTime.resize(zonesCount);
+    frame.m_ZonesCount.resize(zonesCount);
+    if (m_IsCountingHardware)
+    {
+        frame.m_ZonesCounters.resize(zonesCount * HardwareCounters::eCountersCount);
+    }
+    for (int i = 0; i < zonesCount; i++)
+    {
+        const Profiler::ZoneStatistics& statistics = profiler->GetFrameStatistics(i);
+        frame.m_ZonesTime[i] = statistics.m_Time;
+        frame.m_ZonesCount[i] = statistics.m_Count;
+        if (statistics.m_Count > 0)
+        {
+            m_ZonesDepth.resize(zonesCount, 0);
+            m_ZonesDepth[i] = statistics.m_Depth;
+        }
+        if (m_IsCountingHardware)
+        {
+            memcpy(&frame.m_ZonesCounters[i * HardwareCounters::eCountersCount], statistics.m_Counters, sizeof(statistics.m_Counters));
+        }
+    }
+    m_Frames.push_back(frame);
+}
+
+double SceneReplay::GetPercentile(const std::vector<double>& sortedTimes, double percentile)
+{
+    assert(!sortedTimes.empty() && "SceneReplay::GetPercentile failed.");
+    size_t rank = static_cast<size_t>(percentile * sortedTimes.size() / 100.0 + 0.5);
+    rank = std::max<size_t>(rank, 1);
+    rank = std::min(rank, sortedTimes.size());
+    return sortedTimes[rank - 1];
+}
+
+void SceneReplay::PrintStage(const char *name, int depth, std::vector<double>& times)
+{
+    if (times.empty())
+        return;
+
+    double totalTime = 0.0;
+    for (size_t i = 0; i < times.size(); i++)
+    {
+        totalTime += times[i];
+    }
+    std::sort(times.begin(), times.end());
+
+    printf("%*s%-*s %8d %10.3f %10.3f %10.3f %10.3f %10.3f\n", depth * 2, "", 40 - depth * 2, name,
+            static_cast<int>(times.size()), totalTime / times.size(),
+            GetPercentile(times, 50.0), GetPercentile(times, 90.0), GetPercentile(times, 99.0), times.back());
+}
+
+void SceneReplay::Report(unsigned long long checksum) const
+{
+    const Profiler *profiler = Profiler::GetInstance();
+
+    printf("Scene %s, %d particles, %d frames of %.3f ms after %d warmup frames\n", m_Options.m_SceneName,
+            m_ParticlesCount, m_Options.m_FramesCount, m_Options.m_DeltaT * 1000.0f, m_Options.m_WarmupFramesCount);
+    printf("%-40s %8s %10s %10s %10s %10s %10s\n", "Stage (ms)", "Frames", "Mean", "p50", "p90", "p99", "Max");
+
+    std::vector<double> times;
+    times.reserve(m_Frames.size());
+    for (size_t i = 0; i < m_Frames.size(); i++)
+    {
+        times.push_back(m_Frames[i].m_Time);
+    }
+    PrintStage("Frame", 0, times);
+
+    // A stage is reported over the frames it was run
+    for (int i = 0; i < profiler->GetZonesCount(); i++)
+    {
+        times.clear();
+        for (size_t j = 0; j < m_Frames.size(); j++)
+        {
+            const Frame& frame = m_Frames[j];
+            if (i < static_cast<int>(frame.m_ZonesCount.size()) && frame.m_ZonesCount[i] > 0)
+            {
+                times.push_back(frame.m_ZonesTime[i]);
+            }
+        }
+        // Zones are nested in the frame
+        const int depth = i < static_cast<int>(m_ZonesDepth.size()) ? m_ZonesDepth[i] + 1 : 1;
+        PrintStage(profiler->GetZoneName(i), depth, times);
+    }
+
+    if (m_IsCountingHardware)
+    {
+        ReportCounters();
+    }
+    ReportMemory();
+    if (m_Options.m_CacheFileName != NULL)
+    {
+        ReportCache();
+    }
+
+    printf("Checksum %016llx\n", checksum);
+    fflush(stdout);
+}
+
+void SceneReplay::PrintStageCounters(  const char *name, int depth, int framesCount, double time,
+                                        const long long counters[HardwareCounters::eCountersCount])
+{
+    if (framesCount == 0)
+        return;
+
+    const double cycles = static_cast<double>(counters[HardwareCounters::eCycles]);
+    printf("%*s%-*s %8d %14.4g %6.2f %14.4g %14.4g %8.2f\n", depth * 2, "", 40 - depth * 2, name, framesCount,
+            cycles / framesCount, cycles > 0.0 ? counters[HardwareCounters::eInstructions] / cycles : 0.0,
+            static_cast<double>(counters[HardwareCounters::eLastLevelCacheMisses]) / framesCount,
+            static_cast<double>(counters[HardwareCounters::eBranchMisses]) / framesCount,
+            HardwareCounters::GetBandwidth(counters[HardwareCounters::eLastLevelCacheMisses], time));
+}
+
+// Means by frame of the frames the stage was run, the bandwidth is estimated from the misses
+void SceneReplay::ReportMemory() const
+{
+    const double megaByte = 1024.0 * 1024.0;
+    printf("Memory %.2f MB reserved%s, %.2f MB used, %.1f KB scratch peak, %d arrays out of the reservation, "
+           "%lld heap allocations during the frames\n",
+            m_MemoryUsage.m_ReservedSize / megaByte, m_MemoryUsage.m_IsUsingLargePages ? " in large pages" : "",
+            m_MemoryUsage.m_UsedSize / megaByte, m_MemoryUsage.m_ScratchPeakSize / 1024.0,
+            m_MemoryUsage.m_HeapFallbacksCount, m_FramesHeapAllocationsCount);
+}
+
+void SceneReplay::ReportCache() const
+{
+    const double megaByte = 1024.0 * 1024.0;
+    const unsigned long long encodedSize = m_CacheWriter.GetEncodedSize();
+    printf("Cache %d frames, %.2f MB encoded for %.2f MB of particles (%.1f:1)\n", m_CacheWriter.GetFramesCount(),
+            encodedSize / megaByte, m_CacheWriter.GetRawSize() / megaByte,
+            encodedSize > 0 ? static_cast<double>(m_CacheWriter.GetRawSize()) / encodedSize : 0.0);
+}
+
+void SceneReplay::ReportCounters() const
+{
+    const Profiler *profiler = Profiler::GetInstance();
+
+    printf("%-40s %8s %14s %6s %14s %14s %8s\n", "Stage counters", "Frames", "Cycles", "IPC", "LLC misses", "Br misses", "GB/s");
+
+    long long counters[HardwareCounters::eCountersCount] = { 0 };
+    double time = 0.0;
+    for (size_t i = 0; i < m_Frames.size(); i++)
+    {
+        time += m_Frames[i].m_Time;
+        for (int j = 0; j < HardwareCounters::eCountersCount; j++)
+        {
+            counters[j] += m_Frames[i].m_Counters[j];
+        }
+    }
+    PrintStageCounters("Frame", 0, static_cast<int>(m_Frames.size()), time, counters);
+
+    for (int i = 0; i < profiler->GetZonesCount(); i++)
+    {
+        int framesCount = 0;
+        time = 0.0;
+        memset(counters, 0, sizeof(counters));
+        for (size_t j = 0; j < m_Frames.size(); j++)
+        {
+            const Frame& frame = m_Frames[j];
+            if (i < static_cast<int>(frame.m_ZonesCount.size()) && frame.m_ZonesCount[i] > 0)
+            {
+                framesCount++;
+                time += frame.m_ZonesTime[i];
+                for (int k = 0; k < HardwareCounters::eCountersCount; k++)
+                {
+                    counters[k] += frame.m_ZonesCounters[i * HardwareCounters::eCountersCount + k];
+                }
+            }
+        }
+
+        const int depth = i < static_cast<int>(m_ZonesDepth.size()) ? m_ZonesDepth[i] + 1 : 1;
+        PrintStageCounters(profiler->GetZoneName(i), depth, framesCount, time, counters);
+    }
+}
+
+bool SceneReplay::WriteCsv() const
+{
+    if (m_Options.m_CsvFileName == NULL)
+        return true;
+
+    FILE *csvFile = OpenFile(m_Options.m_CsvFileName, "w");
+    if (csvFile == NULL)
+    {
+        fprintf(stderr, "Can't open %s\n", m_Options.m_CsvFileName);
+        return false;
+    }
+
+    // A column by stage, empty when the stage was not run in the frame
+    const Profiler *profiler = Profiler::GetInstance();
+    const int zonesCount = profiler->GetZonesCount();
+    // The counters follow their stage
+    fprintf(csvFile, "frame,frame_ms");
+    if (m_IsCountingHardware)
+    {
+        for (int i = 0; i < HardwareCounters::eCountersCount; i++)
+        {
+            fprintf(csvFile, ",frame_%s", HardwareCounters::GetName(i));
+        }
+    }
+    for (int i = 0; i < zonesCount; i++)
+    {
+        fprintf(csvFile, ",%s", profiler->GetZoneName(i));
+        for (int j = 0; m_IsCountingHardware && j < HardwareCounters::eCountersCount; j++)
+        {
+            fprintf(csvFile, ",%s %s", profiler->GetZoneName(i), HardwareCounters::GetName(j));
+        }
+    }
+    fprintf(csvFile, "\n");
+
+    for (size_t i = 0; i < m_Frames.size(); i++)
+    {
+        const Frame& frame = m_Frames[i];
+        fprintf(csvFile, "%d,%.6f", static_cast<int>(i), frame.m_Time);
+        for (int j = 0; m_IsCountingHardware && j < HardwareCounters::eCountersCount; j++)
+        {
+            fprintf(csvFile, ",%lld", frame.m_Counters[j]);
+        }
+        for (int j = 0; j < zonesCount; j++)
+        {
+            const bool isRun = j < static_cast<int>(frame.m_ZonesCount.size()) && frame.m_ZonesCount[j] > 0;
+            if (isRun)
+            {
+                fprintf(csvFile, ",%.6f", frame.m_ZonesTime[j]);
+            }
+            else
+            {
+                fprintf(csvFile, ",");
+            }
+
+            for (int k = 0; m_IsCountingHardware && k < HardwareCounters::eCountersCount; k++)
+            {
+                if (isRun)
+                {
+                    fprintf(csvFile, ",%lld", frame.m_ZonesCounters[j * HardwareCounters::eCountersCount + k]);
+                }
+                else
+                {
+                    fprintf(csvFile, ",");
+                }
+            }
+        }
+        fprintf(csvFile, "\n");
+    }
+
+    fclose(csvFile);
+    return true;
+}
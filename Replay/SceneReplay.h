@@ -0,0 +1,115 @@
+#ifndef SCENE_REPLAY
+#define SCENE_REPLAY
+
+#include "Framework/Camera.h"
+#include "ParticleEngine/ParticleCacheWriter.h"
+#include "ParticleEngine/PhysicsParticle.h"
+#include "Utility/HardwareCounters.h"
+
+#include <vector>
+
+class BaseScene;
+
+struct ReplayOptions
+{
+    const char      *m_SceneName;
+    int             m_FramesCount;
+    // Frames simulated before the measure, not reported
+    int             m_WarmupFramesCount;
+    // Seconds by frame
+    float           m_DeltaT;
+    // Backend of every simulation of the scene, the scene choice when not forced
+    bool            m_IsUsingNativeBackend;
+    bool            m_IsUsingCPU;
+    // Native backend threads pinned over the NUMA nodes
+    bool            m_IsPinningThreads;
+    // Device of the OpenCL context, the scene choice when negative
+    int             m_DeviceIndex;
+    // Seed of the scene generators, the one of the demos by default
+    unsigned int    m_Seed;
+    // Bit identical positions whatever the cores and devices count
+    bool            m_IsDeterministic;
+    // Per frame timings also written as CSV when not NULL
+    const char      *m_CsvFileName;
+    // Hardware counters of the stages reported next to their times
+    bool            m_IsUsingHardwareCounters;
+    // Particles of the measured frames written in a ParticleCache when not NULL
+    const char      *m_CacheFileName;
+
+    ReplayOptions() :   m_SceneName("water"),
+                        m_FramesCount(600),
+                        m_WarmupFramesCount(60),
+                        m_DeltaT(1 / 60.0f),
+                        m_IsUsingNativeBackend(false),
+                        m_IsUsingCPU(false),
+                        m_IsPinningThreads(false),
+                        m_DeviceIndex(-1),
+                        m_Seed(1),
+                        m_IsDeterministic(false),
+                        m_CsvFileName(NULL),
+                        m_IsUsingHardwareCounters(false),
+                        m_CacheFileName(NULL)
+    {
+    }
+};
+
+// Runs a demo scene without renderer for a fixed count of frames of the simulated time.
+// Each frame the profiler zones give the time of the stages, the report has their
+// percentiles and a checksum of the final positions of every simulation
+class SceneReplay
+{
+public:
+    explicit SceneReplay(const ReplayOptions& options);
+
+    // Returns NULL for an unknown name
+    static BaseScene* CreateScene(const char *name);
+    static void ListScenes();
+
+    // Returns 0 on success
+    int Run();
+
+    // FNV-1a over the positions of every simulation of the scene
+    static unsigned long long ComputeChecksum(BaseScene& scene);
+    // Sum over every simulation of the scene
+    static vrMemoryUsage GetMemoryUsage(BaseScene& scene);
+
+private:
+    struct Frame
+    {
+        double                  m_Time;
+        // By profiler zone, the zones registered after the frame are missing
+        std::vector<double>     m_ZonesTime;
+        std::vector<int>        m_ZonesCount;
+        // Hardware counters of the frame and of each zone, 0 and empty without them
+        long long               m_Counters[HardwareCounters::eCountersCount];
+        std::vector<long long>  m_ZonesCounters;
+    };
+
+    void RecordFrame(double frameTime, const long long counters[HardwareCounters::eCountersCount]);
+    void Report(unsigned long long checksum) const;
+    void ReportCounters() const;
+    void ReportMemory() const;
+    void ReportCache() const;
+    void WriteCacheFrame(BaseScene& scene);
+    bool WriteCsv() const;
+
+    // Nearest rank, the times are sorted
+    static double GetPercentile(const std::vector<double>& sortedTimes, double percentile);
+    static void PrintStage(const char *name, int depth, std::vector<double>& times);
+    static void PrintStageCounters(const char *name, int depth, int framesCount, double time,
+                                   const long long counters[HardwareCounters::eCountersCount]);
+
+    ReplayOptions       m_Options;
+    Camera              m_Camera;
+    std::vector<Frame>  m_Frames;
+    // Depth of each zone in the frames it was run
+    std::vector<int>    m_ZonesDepth;
+    int                 m_ParticlesCount;
+    bool                m_IsCountingHardware;
+    vrMemoryUsage       m_MemoryUsage;
+    // Heap allocations of the process while the measured frames were simulated
+    long long           m_FramesHeapAllocationsCount;
+    ParticleCacheWriter m_CacheWriter;
+};
+
+#endif // SCENE_REPLAY
@@ -3,6 +3,10 @@
 
 #include <slmath/vec3.h>
 #include <new>
+#include <stdlib.h>
+#ifdef _WIN32
+#include <malloc.h>
+#endif
 
 SLMATH_BEGIN()
 
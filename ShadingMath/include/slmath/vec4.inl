@@ -147,12 +147,23 @@ inline float& vec4::operator[]( size_t i )
 
 inline void* vec4::operator new[] (size_t size)
 {
-    return _aligned_malloc(sizeof(slmath::vec4) * size, 256);
+#ifdef _WIN32
+    void* ptr = _aligned_malloc(sizeof(slmath::vec4) * size, 256);
+#else
+    void* ptr = 0;
+    if ( posix_memalign(&ptr, 256, sizeof(slmath::vec4) * size) != 0 )
+        ptr = 0;
+#endif
+    return ptr;
 }
 
 inline void vec4::operator delete[] (void *ptr)
 {
+#ifdef _WIN32
     _aligned_free(ptr);
+#else
+    free(ptr);
+#endif
 }
 
 inline vec3& vec4::xyz()
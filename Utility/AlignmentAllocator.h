@@ -1,8 +1,9 @@
 #ifndef ALIGNMENT_ALLOCATOR_H
 #define ALIGNMENT_ALLOCATOR_H
 
+#include "Platform.h"
+
 #include <stdlib.h>
-#include <malloc.h>
 
 template <typename T, std::size_t N = 16>
 class AlignmentAllocator {
@@ -34,11 +35,11 @@ public:
   }
 
   inline pointer allocate (size_type n) {
-     return (pointer)_aligned_malloc(n*sizeof(value_type), N);
+     return (pointer)AlignedMalloc(n*sizeof(value_type), N);
   }
 
   inline void deallocate (pointer p, size_type) {
-    _aligned_free (p);
+    AlignedFree (p);
   }
 
   inline void construct (pointer p, const value_type & wert) {
@@ -46,7 +47,7 @@ public:
   }
 
   inline void destroy (pointer p) {
-    p; // To avoid a warning not use variable
+    (void)p; // To avoid a warning not use variable
     p->~value_type ();
   }
 
@@ -0,0 +1,84 @@
+#ifndef HALF_FLOAT
+#define HALF_FLOAT
+
+#include <cstring>
+
+// IEEE 754 half precision conversions, the same as vstore_half and vload_half of OpenCL.
+// Rounds to the nearest even, too big values give infinity
+inline unsigned short FloatToHalf(float value)
+{
+    unsigned int bits;
+    memcpy(&bits, &value, sizeof(bits));
+
+    const unsigned int sign = (bits >> 16) & 0x8000;
+    const unsigned int absoluteBits = bits & 0x7fffffff;
+
+    // Infinity and NaN
+    if (absoluteBits >= 0x7f800000)
+        return static_cast<unsigned short>(sign | 0x7c00 | (absoluteBits > 0x7f800000 ? 0x200 : 0));
+
+    // 65520 and more are rounded to infinity
+    if (absoluteBits >= 0x477ff000)
+        return static_cast<unsigned short>(sign | 0x7c00);
+
+    // Subnormal half, 2^-25 and less are rounded to zero
+    if (absoluteBits < 0x38800000)
+    {
+        if (absoluteBits <= 0x33000000)
+            return static_cast<unsigned short>(sign);
+
+        const unsigned int mantissa = (absoluteBits & 0x7fffff) | 0x800000;
+        const unsigned int shift = 126 - (absoluteBits >> 23);
+        const unsigned int halfway = 1u << (shift - 1);
+        const unsigned int remainder = mantissa & ((1u << shift) - 1);
+        unsigned int half = mantissa >> shift;
+        if (remainder > halfway || (remainder == halfway && (half & 1)))
+            half++;
+        return static_cast<unsigned short>(sign | half);
+    }
+
+    // Exponent bias from 127 to 15, a carry of the rounding goes in the exponent
+    unsigned int half = (absoluteBits - 0x38000000) >> 13;
+    const unsigned int remainder = absoluteBits & 0x1fff;
+    if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1)))
+        half++;
+    return static_cast<unsigned short>(sign | half);
+}
+
+inline float HalfToFloat(unsigned short value)
+{
+    const unsigned int sign = (value & 0x8000) << 16;
+    unsigned int exponent = (value >> 10) & 0x1f;
+    unsigned int mantissa = value & 0x3ff;
+
+    unsigned int bits;
+    if (exponent == 0x1f)
+    {
+        bits = sign | 0x7f800000 | (mantissa << 13);
+    }
+    else if (exponent != 0)
+    {
+        bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+    }
+    else if (mantissa == 0)
+    {
+        bits = sign;
+    }
+    else
+    {
+        // Subnormal half, normalized in float
+        exponent = 113;
+        while ((mantissa & 0x400) == 0)
+        {
+            mantissa <<= 1;
+            exponent--;
+        }
+        bits = sign | (exponent << 23) | ((mantissa & 0x3ff) << 13);
+    }
+
+    float result;
+    memcpy(&result, &bits, sizeof(result));
+    return result;
+}
+
+#endif // HALF_FLOAT
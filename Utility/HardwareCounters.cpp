@@ -0,0 +1,134 @@
+#include "HardwareCounters.h"
+
+#include <assert.h>
+#include <cstring>
+
+#ifdef __linux__
+    #include <linux/perf_event.h>
+    #include <sys/ioctl.h>
+    #include <sys/syscall.h>
+    #include <unistd.h>
+#endif // __linux__
+
+
+namespace
+{
+    const char *s_CounterNames[HardwareCounters::eCountersCount] = { "cycles", "instructions", "llc_misses", "branch_misses" };
+
+#ifdef __linux__
+    // The generic events, the cache misses event is the last level cache on x86 and ARM
+    const unsigned long long s_CounterEvents[HardwareCounters::eCountersCount] = {  PERF_COUNT_HW_CPU_CYCLES,
+                                                                                    PERF_COUNT_HW_INSTRUCTIONS,
+                                                                                    PERF_COUNT_HW_CACHE_MISSES,
+                                                                                    PERF_COUNT_HW_BRANCH_MISSES };
+
+    int OpenEvent(unsigned long long event)
+    {
+        perf_event_attr attributes;
+        memset(&attributes, 0, sizeof(attributes));
+        attributes.type             = PERF_TYPE_HARDWARE;
+        attributes.size             = sizeof(attributes);
+        attributes.config           = event;
+        attributes.disabled         = 1;
+        attributes.inherit          = 1;
+        attributes.exclude_kernel   = 1;
+        attributes.exclude_hv       = 1;
+
+        // Calling thread and its future threads, on any CPU
+        const long descriptor = syscall(__NR_perf_event_open, &attributes, 0, -1, -1, 0);
+        if (descriptor < 0)
+            return -1;
+
+        ioctl(static_cast<int>(descriptor), PERF_EVENT_IOC_RESET, 0);
+        ioctl(static_cast<int>(descriptor), PERF_EVENT_IOC_ENABLE, 0);
+        return static_cast<int>(descriptor);
+    }
+#endif // __linux__
+}
+
+HardwareCounters::HardwareCounters()
+{
+    for (int i = 0; i < eCountersCount; i++)
+    {
+        m_Descriptors[i] = -1;
+    }
+}
+
+HardwareCounters::~HardwareCounters()
+{
+    Close();
+}
+
+bool HardwareCounters::Open()
+{
+    Close();
+
+#ifdef __linux__
+    // Counters are separated, an inherited group can't be read at once
+    for (int i = 0; i < eCountersCount; i++)
+    {
+        m_Descriptors[i] = OpenEvent(s_CounterEvents[i]);
+    }
+#endif // __linux__
+
+    return IsOpen();
+}
+
+void HardwareCounters::Close()
+{
+    for (int i = 0; i < eCountersCount; i++)
+    {
+#ifdef __linux__
+        if (m_Descriptors[i] >= 0)
+        {
+            close(m_Descriptors[i]);
+        }
+#endif // __linux__
+        m_Descriptors[i] = -1;
+    }
+}
+
+bool HardwareCounters::IsOpen() const
+{
+    for (int i = 0; i < eCountersCount; i++)
+    {
+        if (m_Descriptors[i] >= 0)
+            return true;
+    }
+    return false;
+}
+
+bool HardwareCounters::IsAvailable(int counter) const
+{
+    assert(counter >= 0 && counter < eCountersCount && "HardwareCounters::IsAvailable failed.");
+    return m_Descriptors[counter] >= 0;
+}
+
+void HardwareCounters::Read(long long values[eCountersCount]) const
+{
+    for (int i = 0; i < eCountersCount; i++)
+    {
+        values[i] = 0;
+#ifdef __linux__
+        // The count of an inherited event is the sum of the threads
+        long long value = 0;
+        if (m_Descriptors[i] >= 0 && read(m_Descriptors[i], &value, sizeof(value)) == sizeof(value))
+        {
+            values[i] = value;
+        }
+#endif // __linux__
+    }
+}
+
+const char* HardwareCounters::GetName(int counter)
+{
+    assert(counter >= 0 && counter < eCountersCount && "HardwareCounters::GetName failed.");
+    return s_CounterNames[counter];
+}
+
+double HardwareCounters::GetBandwidth(long long lastLevelCacheMisses, double milliseconds)
+{
+    if (milliseconds <= 0.0)
+        return 0.0;
+    return lastLevelCacheMisses * static_cast<double>(s_CacheLineSize) / (milliseconds * 1.0e6);
+}
@@ -0,0 +1,49 @@
+#ifndef HARDWARE_COUNTERS
+#define HARDWARE_COUNTERS
+
+// Hardware counters of the process, read with perf_event on Linux. The threads created
+// after Open are counted with the calling one, so a sample taken around a parallel stage
+// covers its workers. The samples are taken by the thread which opened the counters: one
+// taken by a worker would count the other threads too. Counters are only counted in user
+// mode, they stay unavailable on the other systems, on hardware without them or when
+// perf_event_paranoid forbids them
+class HardwareCounters
+{
+public:
+    enum Counter
+    {
+        eCycles,
+        eInstructions,
+        eLastLevelCacheMisses,
+        eBranchMisses,
+        eCountersCount
+    };
+
+    // Bytes brought from memory by a last level cache miss, for the bandwidth estimate
+    static const int s_CacheLineSize = 64;
+
+    HardwareCounters();
+    ~HardwareCounters();
+
+    // Returns false when no counter could be opened
+    bool Open();
+    void Close();
+    bool IsOpen() const;
+    bool IsAvailable(int counter) const;
+
+    // Counts since Open, 0 for the unavailable counters. Not synchronized with Close
+    void Read(long long values[eCountersCount]) const;
+
+    static const char* GetName(int counter);
+    // Memory bandwidth estimated from the last level cache misses, in GB/s
+    static double GetBandwidth(long long lastLevelCacheMisses, double milliseconds);
+
+private:
+    HardwareCounters(const HardwareCounters&);
+    HardwareCounters& operator=(const HardwareCounters&);
+
+    // perf_event file descriptors, -1 when unavailable
+    int m_Descriptors[eCountersCount];
+};
+
+#endif // HARDWARE_COUNTERS
@@ -0,0 +1,131 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+    #include <windows.h>
+#else // _WIN32
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif // _WIN32
+
+
+MappedFile::MappedFile() :  m_Data(NULL),
+                            m_Size(0)
+#ifdef _WIN32
+                            , m_File(INVALID_HANDLE_VALUE)
+                            , m_Mapping(NULL)
+#endif // _WIN32
+{
+}
+
+MappedFile::~MappedFile()
+{
+    Close();
+}
+
+#ifdef _WIN32
+bool MappedFile::Open(const char *fileName)
+{
+    Close();
+
+    m_File = CreateFileA(fileName, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (m_File == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER size;
+    if ( ! GetFileSizeEx(m_File, &size) || size.QuadPart == 0)
+    {
+        Close();
+        return false;
+    }
+
+    m_Mapping = CreateFileMappingA(m_File, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (m_Mapping == NULL)
+    {
+        Close();
+        return false;
+    }
+
+    m_Data = MapViewOfFile(m_Mapping, FILE_MAP_READ, 0, 0, 0);
+    if (m_Data == NULL)
+    {
+        Close();
+        return false;
+    }
+    m_Size = static_cast<size_t>(size.QuadPart);
+    return true;
+}
+
+void MappedFile::Close()
+{
+    if (m_Data != NULL)
+    {
+        UnmapViewOfFile(m_Data);
+    }
+    if (m_Mapping != NULL)
+    {
+        CloseHandle(m_Mapping);
+    }
+    if (m_File != INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(m_File);
+    }
+    m_Data      = NULL;
+    m_Size      = 0;
+    m_Mapping   = NULL;
+    m_File      = INVALID_HANDLE_VALUE;
+}
+#else // _WIN32
+// The mapping keeps the file, the descriptor is closed at once
+bool MappedFile::Open(const char *fileName)
+{
+    Close();
+
+    const int file = open(fileName, O_RDONLY);
+    if (file < 0)
+        return false;
+
+    struct stat status;
+    if (fstat(file, &status) != 0 || status.st_size == 0)
+    {
+        close(file);
+        return false;
+    }
+
+    const size_t size = static_cast<size_t>(status.st_size);
+    void *data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, file, 0);
+    close(file);
+    if (data == MAP_FAILED)
+        return false;
+
+    m_Data = data;
+    m_Size = size;
+    return true;
+}
+
+void MappedFile::Close()
+{
+    if (m_Data != NULL)
+    {
+        munmap(const_cast<void*>(m_Data), m_Size);
+    }
+    m_Data = NULL;
+    m_Size = 0;
+}
+#endif // _WIN32
+
+bool MappedFile::IsOpen() const
+{
+    return m_Data != NULL;
+}
+
+const void* MappedFile::GetData() const
+{
+    return m_Data;
+}
+
+size_t MappedFile::GetSize() const
+{
+    return m_Size;
+}
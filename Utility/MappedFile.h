@@ -0,0 +1,35 @@
+#ifndef MAPPED_FILE
+#define MAPPED_FILE
+
+#include <cstddef>
+
+// Whole file mapped read only in the address space, its content is used in place.
+// Pages are only read from the disk when they are touched
+class MappedFile
+{
+public:
+    MappedFile();
+    ~MappedFile();
+
+    // Closes the previous file, returns false when the file can't be mapped
+    bool Open(const char *fileName);
+    void Close();
+    bool IsOpen() const;
+
+    // Page aligned
+    const void* GetData() const;
+    size_t GetSize() const;
+
+private:
+    MappedFile(const MappedFile&);
+    MappedFile& operator=(const MappedFile&);
+
+    const void  *m_Data;
+    size_t      m_Size;
+#ifdef _WIN32
+    void        *m_File;
+    void        *m_Mapping;
+#endif // _WIN32
+};
+
+#endif // MAPPED_FILE
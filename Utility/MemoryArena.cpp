@@ -0,0 +1,261 @@
+#include "MemoryArena.h"
+
+#include <assert.h>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef _WIN32
+    #include <windows.h>
+    #include <malloc.h>
+#else // _WIN32
+    #include <sys/mman.h>
+#endif // _WIN32
+
+
+namespace
+{
+#ifdef _WIN32
+    // Large pages need the lock pages in memory privilege, the block is committed at once
+    char* MapMemory(size_t& size, bool& isUsingLargePages)
+    {
+        const SIZE_T largePageSize = GetLargePageMinimum();
+        if (largePageSize > 0)
+        {
+            const size_t largeSize = (size + largePageSize - 1) / largePageSize * largePageSize;
+            void *memory = VirtualAlloc(NULL, largeSize, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+            if (memory != NULL)
+            {
+                size = largeSize;
+                isUsingLargePages = true;
+                return static_cast<char*>(memory);
+            }
+        }
+
+        isUsingLargePages = false;
+        return static_cast<char*>(VirtualAlloc(NULL, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE));
+    }
+
+    void UnmapMemory(char *memory, size_t size)
+    {
+        (void)size;
+        VirtualFree(memory, 0, MEM_RELEASE);
+    }
+
+    void* AllocateHeap(size_t size)
+    {
+        return _aligned_malloc(size, MemoryArena::s_Alignment);
+    }
+
+    void FreeHeap(void *memory)
+    {
+        _aligned_free(memory);
+    }
+#else // _WIN32
+    const size_t s_HugePageSize = 2 * 1024 * 1024;
+
+    // Explicit huge pages are only there when the system reserved some,
+    // otherwise the transparent huge pages are asked for the block
+    char* MapMemory(size_t& size, bool& isUsingLargePages)
+    {
+        const size_t hugeSize = (size + s_HugePageSize - 1) / s_HugePageSize * s_HugePageSize;
+        void *memory = mmap(NULL, hugeSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (memory != MAP_FAILED)
+        {
+            size = hugeSize;
+            isUsingLargePages = true;
+            return static_cast<char*>(memory);
+        }
+
+        isUsingLargePages = false;
+        memory = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (memory == MAP_FAILED)
+            return NULL;
+        madvise(memory, size, MADV_HUGEPAGE);
+        return static_cast<char*>(memory);
+    }
+
+    void UnmapMemory(char *memory, size_t size)
+    {
+        munmap(memory, size);
+    }
+
+    void* AllocateHeap(size_t size)
+    {
+        void *memory = NULL;
+        if (posix_memalign(&memory, MemoryArena::s_Alignment, size) != 0)
+            return NULL;
+        return memory;
+    }
+
+    void FreeHeap(void *memory)
+    {
+        free(memory);
+    }
+#endif // _WIN32
+}
+
+// Initialized in the class, defined here for the callers taking them by reference
+const size_t MemoryArena::s_Alignment;
+const int    MemoryArena::s_MaxThreadsCount;
+
+MemoryArena::MemoryArena() :    m_Memory(NULL),
+                                m_ReservedSize(0),
+                                m_UsedSize(0),
+                                m_Scratch(NULL),
+                                m_ScratchSizeByThread(0),
+                                m_ThreadsCount(0),
+                                m_IsUsingLargePages(false),
+                                m_HeapAllocationsCount(0)
+{
+    memset(m_ScratchRegions, 0, sizeof(m_ScratchRegions));
+}
+
+MemoryArena::~MemoryArena()
+{
+    Release();
+}
+
+size_t MemoryArena::AlignSize(size_t size)
+{
+    return (size + s_Alignment - 1) / s_Alignment * s_Alignment;
+}
+
+bool MemoryArena::Reserve(size_t size, size_t scratchSizeByThread, int threadsCount)
+{
+    assert(threadsCount >= 0 && threadsCount <= s_MaxThreadsCount && "MemoryArena::Reserve failed.");
+    Release();
+
+    const size_t persistentSize = AlignSize(size);
+    scratchSizeByThread = AlignSize(scratchSizeByThread);
+    size_t reservedSize = persistentSize + scratchSizeByThread * threadsCount;
+    if (reservedSize == 0)
+        return false;
+
+    m_Memory = MapMemory(reservedSize, m_IsUsingLargePages);
+    if (m_Memory == NULL)
+        return false;
+
+    m_ReservedSize          = reservedSize;
+    m_Scratch               = m_Memory + persistentSize;
+    m_ScratchSizeByThread   = scratchSizeByThread;
+    m_ThreadsCount          = threadsCount;
+    return true;
+}
+
+void MemoryArena::Release()
+{
+    if (m_Memory != NULL)
+    {
+        UnmapMemory(m_Memory, m_ReservedSize);
+    }
+    m_Memory                = NULL;
+    m_ReservedSize          = 0;
+    m_UsedSize              = 0;
+    m_Scratch               = NULL;
+    m_ScratchSizeByThread   = 0;
+    m_ThreadsCount          = 0;
+    m_IsUsingLargePages     = false;
+    memset(m_ScratchRegions, 0, sizeof(m_ScratchRegions));
+}
+
+bool MemoryArena::IsReserved() const
+{
+    return m_Memory != NULL;
+}
+
+void* MemoryArena::Allocate(size_t size)
+{
+    size = AlignSize(size);
+    if (m_Memory != NULL && m_UsedSize + size <= static_cast<size_t>(m_Scratch - m_Memory))
+    {
+        void *memory = m_Memory + m_UsedSize;
+        m_UsedSize += size;
+        return memory;
+    }
+
+    m_HeapAllocationsCount++;
+    return AllocateHeap(size);
+}
+
+void MemoryArena::Free(void *memory)
+{
+    if (memory != NULL && ! Owns(memory))
+    {
+        FreeHeap(memory);
+    }
+}
+
+bool MemoryArena::Owns(const void *memory) const
+{
+    const char *address = static_cast<const char*>(memory);
+    return m_Memory != NULL && address >= m_Memory && address < m_Memory + m_ReservedSize;
+}
+
+void* MemoryArena::AllocateScratch(int threadIndex, size_t size)
+{
+    size = AlignSize(size);
+    if (threadIndex < m_ThreadsCount)
+    {
+        ScratchRegion& region = m_ScratchRegions[threadIndex];
+        if (region.m_UsedSize + size <= m_ScratchSizeByThread)
+        {
+            void *memory = m_Scratch + threadIndex * m_ScratchSizeByThread + region.m_UsedSize;
+            region.m_UsedSize += size;
+            if (region.m_UsedSize > region.m_PeakSize)
+            {
+                region.m_PeakSize = region.m_UsedSize;
+            }
+            return memory;
+        }
+    }
+
+    m_HeapAllocationsCount++;
+    return AllocateHeap(size);
+}
+
+void MemoryArena::FreeScratch(int threadIndex, void *memory, size_t size)
+{
+    if ( ! Owns(memory))
+    {
+        FreeHeap(memory);
+        return;
+    }
+
+    ScratchRegion& region = m_ScratchRegions[threadIndex];
+    size = AlignSize(size);
+    assert(m_Scratch + threadIndex * m_ScratchSizeByThread + region.m_UsedSize - size == memory && "MemoryArena::FreeScratch failed.");
+    region.m_UsedSize -= size;
+}
+
+size_t MemoryArena::GetReservedSize() const
+{
+    return m_ReservedSize;
+}
+
+size_t MemoryArena::GetUsedSize() const
+{
+    return m_UsedSize;
+}
+
+size_t MemoryArena::GetScratchPeakSize() const
+{
+    size_t peakSize = 0;
+    for (int i = 0; i < m_ThreadsCount; i++)
+    {
+        if (m_ScratchRegions[i].m_PeakSize > peakSize)
+        {
+            peakSize = m_ScratchRegions[i].m_PeakSize;
+        }
+    }
+    return peakSize;
+}
+
+int MemoryArena::GetHeapAllocationsCount() const
+{
+    return m_HeapAllocationsCount;
+}
+
+bool MemoryArena::IsUsingLargePages() const
+{
+    return m_IsUsingLargePages;
+}
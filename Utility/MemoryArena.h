@@ -0,0 +1,142 @@
+#ifndef MEMORY_ARENA
+#define MEMORY_ARENA
+
+#include <atomic>
+#include <cstddef>
+
+// Memory of a simulation, reserved once in a single block backed by large pages when the
+// system gives them. The arrays sized by the particles capacity are bump allocated at
+// initialization and only given back by Release, so nothing is allocated while simulating.
+// The end of the block is cut in a scratch region by thread, its arrays are released in the
+// reverse order of their allocation, see ScratchArray. Every allocation is 64 bytes aligned,
+// the ones which don't fit come from the heap and are counted.
+// A component is given the arena by its SetMemoryArena before its Reserve, its static
+// GetMemorySize is the size its Reserve takes
+class MemoryArena
+{
+public:
+    static const size_t s_Alignment         = 64;
+    static const int    s_MaxThreadsCount   = 64;
+
+    MemoryArena();
+    ~MemoryArena();
+
+    // Releases the previous block, returns false when nothing could be reserved
+    bool Reserve(size_t size, size_t scratchSizeByThread, int threadsCount);
+    void Release();
+    bool IsReserved() const;
+
+    // Called at initialization by a single thread. Free only releases the heap allocations
+    void* Allocate(size_t size);
+    void Free(void *memory);
+    bool Owns(const void *memory) const;
+
+    // Each thread uses its own index, the last allocation is freed first
+    void* AllocateScratch(int threadIndex, size_t size);
+    void FreeScratch(int threadIndex, void *memory, size_t size);
+
+    // Size of an array in the arena, to compute the size to reserve
+    template <class T>
+    static size_t GetArraySize(int count)
+    {
+        return AlignSize(count * sizeof(T));
+    }
+
+    // Arrays of the simulation components, they come from the heap without arena
+    template <class T>
+    static T* NewArray(MemoryArena *memoryArena, int count)
+    {
+        if (memoryArena == NULL)
+            return new T[count];
+        return static_cast<T*>(memoryArena->Allocate(count * sizeof(T)));
+    }
+
+    template <class T>
+    static void DeleteArray(MemoryArena *memoryArena, T *array)
+    {
+        if (memoryArena == NULL)
+        {
+            delete[] array;
+            return;
+        }
+        memoryArena->Free(array);
+    }
+
+    // Usage, sizes are in bytes
+    size_t GetReservedSize() const;
+    size_t GetUsedSize() const;
+    // Biggest scratch used by a thread
+    size_t GetScratchPeakSize() const;
+    int GetHeapAllocationsCount() const;
+    bool IsUsingLargePages() const;
+
+private:
+    MemoryArena(const MemoryArena&);
+    MemoryArena& operator=(const MemoryArena&);
+
+    static size_t AlignSize(size_t size);
+
+    // A cache line by region, the threads don't share their counters
+    struct ScratchRegion
+    {
+        size_t  m_UsedSize;
+        size_t  m_PeakSize;
+        char    m_Padding[s_Alignment - 2 * sizeof(size_t)];
+    };
+
+    char                *m_Memory;
+    size_t              m_ReservedSize;
+    size_t              m_UsedSize;
+    // Scratch regions are after the persistent part
+    char                *m_Scratch;
+    size_t              m_ScratchSizeByThread;
+    int                 m_ThreadsCount;
+    ScratchRegion       m_ScratchRegions[s_MaxThreadsCount];
+    bool                m_IsUsingLargePages;
+    std::atomic<int>    m_HeapAllocationsCount;
+};
+
+// Scratch array of a scope, from the region of the thread or from the heap without arena
+template <class T>
+class ScratchArray
+{
+public:
+    ScratchArray(MemoryArena *memoryArena, int threadIndex, int count) :   m_MemoryArena(memoryArena),
+                                                                            m_ThreadIndex(threadIndex),
+                                                                            m_Size(count * sizeof(T))
+    {
+        if (m_MemoryArena != NULL)
+        {
+            m_Array = static_cast<T*>(m_MemoryArena->AllocateScratch(m_ThreadIndex, m_Size));
+        }
+        else
+        {
+            m_Array = new T[count];
+        }
+    }
+
+    ~ScratchArray()
+    {
+        if (m_MemoryArena != NULL)
+        {
+            m_MemoryArena->FreeScratch(m_ThreadIndex, m_Array, m_Size);
+        }
+        else
+        {
+            delete[] m_Array;
+        }
+    }
+
+    T* Get() const { return m_Array; }
+
+private:
+    ScratchArray(const ScratchArray&);
+    ScratchArray& operator=(const ScratchArray&);
+
+    MemoryArena *m_MemoryArena;
+    int         m_ThreadIndex;
+    size_t      m_Size;
+    T           *m_Array;
+};
+
+#endif // MEMORY_ARENA
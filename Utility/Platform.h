@@ -0,0 +1,100 @@
+#ifndef PLATFORM
+#define PLATFORM
+
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef _WIN32
+    #include <io.h>
+    #include <malloc.h>
+    #include <process.h>
+    #include <windows.h>
+#else // _WIN32
+    #include <unistd.h>
+#endif // _WIN32
+
+// Secure CRT functions of Visual C++ and their standard equivalents elsewhere
+
+// Returns NULL when the file can't be opened
+inline FILE* OpenFile(const char *fileName, const char *mode)
+{
+#ifdef _WIN32
+    FILE *file = NULL;
+    if (fopen_s(&file, fileName, mode) != 0)
+        return NULL;
+    return file;
+#else // _WIN32
+    return fopen(fileName, mode);
+#endif // _WIN32
+}
+
+// The copy is truncated to the destination and always terminated
+template <size_t N>
+inline void CopyString(char (&destination)[N], const char *source)
+{
+#ifdef _WIN32
+    strncpy_s(destination, source, _TRUNCATE);
+#else // _WIN32
+    strncpy(destination, source, N - 1);
+    destination[N - 1] = '\0';
+#endif // _WIN32
+}
+
+// The alignment is a power of 2, the memory is given back by AlignedFree
+inline void* AlignedMalloc(size_t size, size_t alignment)
+{
+#ifdef _WIN32
+    return _aligned_malloc(size, alignment);
+#else // _WIN32
+    void *memory = NULL;
+    if (posix_memalign(&memory, alignment < sizeof(void*) ? sizeof(void*) : alignment, size) != 0)
+        return NULL;
+    return memory;
+#endif // _WIN32
+}
+
+inline void AlignedFree(void *memory)
+{
+#ifdef _WIN32
+    _aligned_free(memory);
+#else // _WIN32
+    free(memory);
+#endif // _WIN32
+}
+
+// Used to name the temporary files of the process
+inline int GetProcessIdentifier()
+{
+#ifdef _WIN32
+    return _getpid();
+#else // _WIN32
+    return static_cast<int>(getpid());
+#endif // _WIN32
+}
+
+// Flushes the stream and the system cache of the file to the disk, returns false when it failed
+inline bool SyncFile(FILE *file)
+{
+    if (fflush(file) != 0)
+        return false;
+#ifdef _WIN32
+    return _commit(_fileno(file)) == 0;
+#else // _WIN32
+    return fsync(fileno(file)) == 0;
+#endif // _WIN32
+}
+
+// Replaces destination by source in one step on the same volume, a reader opens either
+// the old file or the new one. rename doesn't replace an existing file on Windows
+inline bool ReplaceFileAtomically(const char *source, const char *destination)
+{
+#ifdef _WIN32
+    return MoveFileExA(source, destination, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else // _WIN32
+    return rename(source, destination) == 0;
+#endif // _WIN32
+}
+
+#endif // PLATFORM
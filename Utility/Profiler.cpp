@@ -0,0 +1,701 @@
+#include "Profiler.h"
+#include "Utility.h"
+#include "Platform.h"
+
+#include <assert.h>
+#include <chrono>
+#include <cstring>
+#include <string>
+#include <algorithm>
+
+
+struct Profiler::ThreadBuffer
+{
+    // Single producer ring, the owner thread writes and EndFrame reads
+    Record                      m_Records[s_RecordsCount];
+    std::atomic<unsigned int>   m_WriteIndex;
+    std::atomic<unsigned int>   m_ReadIndex;
+    std::atomic<unsigned int>   m_DroppedCount;
+    std::atomic<bool>           m_IsUsed;
+
+    // Owner thread state, the started zones
+    long long                   m_Starts[s_MaxDepth];
+    int                         m_Depth;
+    // Hardware counters at the begin of the started zones, the ring is allocated by the
+    // owner thread the first time they are sampled
+    long long                   m_StartCounters[s_MaxDepth][HardwareCounters::eCountersCount];
+    bool                        m_IsCounted[s_MaxDepth];
+    long long                   (*m_RecordsCounters)[HardwareCounters::eCountersCount];
+
+    // Changed under the buffers mutex, the generation tells the trace to name the track again
+    char                        m_Name[s_MaxTrackNameSize];
+    std::atomic<unsigned int>   m_NameGeneration;
+
+    // EndFrame state, time of the nested zones not yet given to their parent
+    long long                   m_ChildrenTicks[s_MaxDepth + 1];
+    unsigned int                m_TracedNameGeneration;
+
+    ThreadBuffer() :    m_WriteIndex(0),
+                        m_ReadIndex(0),
+                        m_DroppedCount(0),
+                        m_IsUsed(true),
+                        m_Depth(0),
+                        m_RecordsCounters(NULL),
+                        m_NameGeneration(1),
+                        m_TracedNameGeneration(0)
+    {
+        memset(m_Name, 0, sizeof(m_Name));
+        memset(m_ChildrenTicks, 0, sizeof(m_ChildrenTicks));
+        memset(m_IsCounted, 0, sizeof(m_IsCounted));
+    }
+
+    ~ThreadBuffer()
+    {
+        delete []m_RecordsCounters;
+    }
+
+    void SetName(const char *name)
+    {
+        if (name != NULL)
+        {
+            CopyString(m_Name, name);
+        }
+        else
+        {
+            m_Name[0] = '\0';
+        }
+        m_NameGeneration.fetch_add(1, std::memory_order_release);
+    }
+};
+
+namespace
+{
+    // Gives the buffer back when its thread exits, a new thread reuses it
+    struct ThreadBufferOwner
+    {
+        void                *m_Buffer;
+        std::atomic<bool>   *m_IsUsed;
+
+        ThreadBufferOwner() : m_Buffer(NULL), m_IsUsed(NULL) {}
+        ~ThreadBufferOwner()
+        {
+            if (m_IsUsed != NULL)
+            {
+                m_IsUsed->store(false, std::memory_order_release);
+            }
+        }
+    };
+
+    thread_local ThreadBufferOwner t_ThreadBufferOwner;
+
+    // Zone and track names are plain text, only the quotes and the control characters are escaped
+    void WriteJsonString(FILE *file, const char *text)
+    {
+        fputc('"', file);
+        for (; *text != '\0'; text++)
+        {
+            const unsigned char character = static_cast<unsigned char>(*text);
+            if (character == '"' || character == '\\')
+            {
+                fputc('\\', file);
+                fputc(character, file);
+            }
+            else if (character < 0x20)
+            {
+                fprintf(file, "\\u%04x", character);
+            }
+            else
+            {
+                fputc(character, file);
+            }
+        }
+        fputc('"', file);
+    }
+}
+
+Profiler::Profiler() :  m_ZonesCount(0),
+                        m_ThreadBuffersCount(0),
+                        m_CountersCount(0),
+                        m_FrameStart(GetTicks()),
+                        m_FrameTime(0.0),
+                        m_DroppedRecordsCount(0),
+                        m_CountingBuffer(NULL),
+                        m_TraceFile(NULL),
+                        m_TraceStart(0),
+                        m_IsFirstTraceEvent(true),
+                        m_IsTracing(false)
+{
+    memset(m_ZoneNames, 0, sizeof(m_ZoneNames));
+    memset(m_ThreadBuffers, 0, sizeof(m_ThreadBuffers));
+    memset(m_CounterNames, 0, sizeof(m_CounterNames));
+    memset(m_CounterValues, 0, sizeof(m_CounterValues));
+    memset(m_IsCounterSet, 0, sizeof(m_IsCounterSet));
+    memset(m_FrameStatistics, 0, sizeof(m_FrameStatistics));
+}
+
+Profiler::~Profiler()
+{
+    StopTrace();
+
+    const int buffersCount = m_ThreadBuffersCount.load(std::memory_order_acquire);
+    for (int i = 0; i < buffersCount; i++)
+    {
+        delete m_ThreadBuffers[i];
+    }
+}
+
+Profiler* Profiler::GetInstance()
+{
+    // Built once even when several threads start profiling together
+    static Profiler s_Profiler;
+    return &s_Profiler;
+}
+
+int Profiler::RegisterZone(const char *name)
+{
+    assert(name != NULL);
+
+    std::unique_lock<std::mutex> lock(m_ZonesMutex);
+    const int zonesCount = m_ZonesCount.load(std::memory_order_relaxed);
+    for (int i = 0; i < zonesCount; i++)
+    {
+        if (strcmp(m_ZoneNames[i], name) == 0)
+            return i;
+    }
+
+    assert(zonesCount < s_MaxZonesCount && "Too many profiler zones.");
+    if (zonesCount == s_MaxZonesCount)
+    {
+        // The last zone takes the others
+        return s_MaxZonesCount - 1;
+    }
+
+    m_ZoneNames[zonesCount] = name;
+    m_ZonesCount.store(zonesCount + 1, std::memory_order_release);
+    return zonesCount;
+}
+
+int Profiler::FindZone(const char *name) const
+{
+    std::unique_lock<std::mutex> lock(m_ZonesMutex);
+    const int zonesCount = m_ZonesCount.load(std::memory_order_relaxed);
+    for (int i = 0; i < zonesCount; i++)
+    {
+        if (strcmp(m_ZoneNames[i], name) == 0)
+            return i;
+    }
+    return -1;
+}
+
+int Profiler::GetZonesCount() const
+{
+    return m_ZonesCount.load(std::memory_order_acquire);
+}
+
+const char* Profiler::GetZoneName(int zoneId) const
+{
+    assert(zoneId >= 0 && zoneId < GetZonesCount());
+    return m_ZoneNames[zoneId];
+}
+
+Profiler::ThreadBuffer* Profiler::AcquireThreadBuffer(const char *name)
+{
+    std::unique_lock<std::mutex> lock(m_ThreadBuffersMutex);
+
+    const int buffersCount = m_ThreadBuffersCount.load(std::memory_order_relaxed);
+    for (int i = 0; i < buffersCount; i++)
+    {
+        bool isUsed = false;
+        if (m_ThreadBuffers[i]->m_IsUsed.compare_exchange_strong(isUsed, true, std::memory_order_acquire))
+        {
+            // Records of the previous owner are still read by EndFrame
+            m_ThreadBuffers[i]->m_Depth = 0;
+            m_ThreadBuffers[i]->SetName(name);
+            return m_ThreadBuffers[i];
+        }
+    }
+
+    assert(buffersCount < s_MaxThreadsCount && "Too many profiled threads.");
+    if (buffersCount == s_MaxThreadsCount)
+        return NULL;
+
+    m_ThreadBuffers[buffersCount] = new ThreadBuffer();
+    m_ThreadBuffers[buffersCount]->SetName(name);
+    m_ThreadBuffersCount.store(buffersCount + 1, std::memory_order_release);
+    return m_ThreadBuffers[buffersCount];
+}
+
+Profiler::ThreadBuffer* Profiler::GetThreadBuffer()
+{
+    ThreadBuffer *buffer = static_cast<ThreadBuffer*>(t_ThreadBufferOwner.m_Buffer);
+    if (buffer == NULL)
+    {
+        // Once by thread, the only allocation of the profiler
+        buffer = AcquireThreadBuffer(NULL);
+        if (buffer != NULL)
+        {
+            t_ThreadBufferOwner.m_Buffer = buffer;
+            t_ThreadBufferOwner.m_IsUsed = &buffer->m_IsUsed;
+        }
+    }
+    return buffer;
+}
+
+void Profiler::SetThreadName(const char *name)
+{
+    ThreadBuffer *buffer = GetThreadBuffer();
+    if (buffer == NULL)
+        return;
+
+    std::unique_lock<std::mutex> lock(m_ThreadBuffersMutex);
+    buffer->SetName(name);
+}
+
+int Profiler::AcquireTrack(const char *name)
+{
+    ThreadBuffer *buffer = AcquireThreadBuffer(name);
+    if (buffer == NULL)
+        return -1;
+
+    const int buffersCount = m_ThreadBuffersCount.load(std::memory_order_acquire);
+    for (int i = 0; i < buffersCount; i++)
+    {
+        if (m_ThreadBuffers[i] == buffer)
+            return i;
+    }
+    return -1;
+}
+
+void Profiler::ReleaseTrack(int trackId)
+{
+    if (trackId < 0)
+        return;
+
+    assert(trackId < m_ThreadBuffersCount.load(std::memory_order_acquire));
+    m_ThreadBuffers[trackId]->m_IsUsed.store(false, std::memory_order_release);
+}
+
+void Profiler::AddRecord(int trackId, int zoneId, long long start, long long end)
+{
+    if (trackId < 0)
+        return;
+
+    assert(trackId < m_ThreadBuffersCount.load(std::memory_order_acquire));
+    ThreadBuffer *buffer = m_ThreadBuffers[trackId];
+
+    const unsigned int writeIndex = buffer->m_WriteIndex.load(std::memory_order_relaxed);
+    if (writeIndex - buffer->m_ReadIndex.load(std::memory_order_acquire) >= static_cast<unsigned int>(s_RecordsCount))
+    {
+        buffer->m_DroppedCount.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    Record& record = buffer->m_Records[writeIndex % s_RecordsCount];
+    record.m_Start  = start;
+    record.m_End    = end;
+    record.m_ZoneId = static_cast<unsigned short>(zoneId);
+    record.m_Depth  = 0;
+    record.m_HasCounters = false;
+    buffer->m_WriteIndex.store(writeIndex + 1, std::memory_order_release);
+}
+
+void Profiler::SetCounter(const char *name, double value)
+{
+    assert(name != NULL);
+
+    std::unique_lock<std::mutex> lock(m_CountersMutex);
+    int counterIndex = 0;
+    while (counterIndex < m_CountersCount && strcmp(m_CounterNames[counterIndex], name) != 0)
+    {
+        counterIndex++;
+    }
+
+    if (counterIndex == m_CountersCount)
+    {
+        assert(m_CountersCount < s_MaxCountersCount && "Too many profiler counters.");
+        if (m_CountersCount == s_MaxCountersCount)
+            return;
+
+        m_CounterNames[m_CountersCount++] = name;
+    }
+
+    m_CounterValues[counterIndex] = value;
+    m_IsCounterSet[counterIndex] = true;
+}
+
+void Profiler::Begin()
+{
+    ThreadBuffer *buffer = GetThreadBuffer();
+    if (buffer == NULL)
+        return;
+
+    assert(buffer->m_Depth < s_MaxDepth && "Profiler zones are nested too deeply.");
+    if (buffer->m_Depth < s_MaxDepth)
+    {
+        // Counters first, the zone time doesn't include their read
+        const bool isCounted = buffer == m_CountingBuffer.load(std::memory_order_relaxed);
+        buffer->m_IsCounted[buffer->m_Depth] = isCounted;
+        if (isCounted)
+        {
+            m_HardwareCounters.Read(buffer->m_StartCounters[buffer->m_Depth]);
+        }
+        buffer->m_Starts[buffer->m_Depth] = GetTicks();
+    }
+    buffer->m_Depth++;
+}
+
+float Profiler::End(int zoneId)
+{
+    const long long end = GetTicks();
+    ThreadBuffer *buffer = GetThreadBuffer();
+    if (buffer == NULL)
+        return 0.0f;
+
+    assert(buffer->m_Depth > 0 && "Profiler::End without Begin.");
+    if (buffer->m_Depth == 0)
+        return 0.0f;
+
+    const int depth = --buffer->m_Depth;
+    if (depth >= s_MaxDepth)
+        return 0.0f;
+
+    const long long start = buffer->m_Starts[depth];
+    const unsigned int writeIndex = buffer->m_WriteIndex.load(std::memory_order_relaxed);
+    if (writeIndex - buffer->m_ReadIndex.load(std::memory_order_acquire) >= static_cast<unsigned int>(s_RecordsCount))
+    {
+        buffer->m_DroppedCount.fetch_add(1, std::memory_order_relaxed);
+    }
+    else
+    {
+        Record& record = buffer->m_Records[writeIndex % s_RecordsCount];
+        record.m_Start  = start;
+        record.m_End    = end;
+        record.m_ZoneId = static_cast<unsigned short>(zoneId);
+        record.m_Depth  = static_cast<unsigned short>(depth);
+        record.m_HasCounters = buffer->m_IsCounted[depth] && buffer == m_CountingBuffer.load(std::memory_order_relaxed);
+        if (record.m_HasCounters)
+        {
+            // Published to EndFrame by the write index
+            if (buffer->m_RecordsCounters == NULL)
+            {
+                buffer->m_RecordsCounters = new long long[s_RecordsCount][HardwareCounters::eCountersCount];
+            }
+
+            long long *counters = buffer->m_RecordsCounters[writeIndex % s_RecordsCount];
+            m_HardwareCounters.Read(counters);
+            for (int i = 0; i < HardwareCounters::eCountersCount; i++)
+            {
+                counters[i] -= buffer->m_StartCounters[depth][i];
+            }
+        }
+        buffer->m_WriteIndex.store(writeIndex + 1, std::memory_order_release);
+    }
+
+    return static_cast<float>((end - start) / GetTicksPerMillisecond());
+}
+
+void Profiler::EndFrame()
+{
+    const long long frameEnd = GetTicks();
+    const double ticksPerMillisecond = GetTicksPerMillisecond();
+    const double ticksPerMicrosecond = ticksPerMillisecond / 1000.0;
+
+    const int zonesCount = m_ZonesCount.load(std::memory_order_acquire);
+    for (int i = 0; i < zonesCount; i++)
+    {
+        ZoneStatistics& statistics  = m_FrameStatistics[i];
+        statistics.m_Name           = m_ZoneNames[i];
+        statistics.m_Depth          = 0;
+        statistics.m_Count          = 0;
+        statistics.m_Time           = 0.0;
+        statistics.m_ExclusiveTime  = 0.0;
+        statistics.m_MaxTime        = 0.0;
+        statistics.m_CountedCount   = 0;
+        memset(statistics.m_Counters, 0, sizeof(statistics.m_Counters));
+    }
+    m_DroppedRecordsCount = 0;
+
+    const int buffersCount = m_ThreadBuffersCount.load(std::memory_order_acquire);
+    for (int i = 0; i < buffersCount; i++)
+    {
+        ThreadBuffer& buffer = *m_ThreadBuffers[i];
+        const unsigned int writeIndex = buffer.m_WriteIndex.load(std::memory_order_acquire);
+        unsigned int readIndex = buffer.m_ReadIndex.load(std::memory_order_relaxed);
+
+        if (m_TraceFile != NULL && readIndex != writeIndex &&
+            buffer.m_TracedNameGeneration != buffer.m_NameGeneration.load(std::memory_order_acquire))
+        {
+            std::unique_lock<std::mutex> lock(m_ThreadBuffersMutex);
+            buffer.m_TracedNameGeneration = buffer.m_NameGeneration.load(std::memory_order_relaxed);
+            WriteTrackName(i, buffer.m_Name);
+        }
+
+        for (; readIndex != writeIndex; readIndex++)
+        {
+            const Record& record = buffer.m_Records[readIndex % s_RecordsCount];
+            const long long ticks = record.m_End - record.m_Start;
+
+            // A zone is written when it ends, its nested zones are written before it
+            const int depth = record.m_Depth;
+            const long long childrenTicks = buffer.m_ChildrenTicks[depth + 1];
+            buffer.m_ChildrenTicks[depth + 1] = 0;
+            if (depth > 0)
+            {
+                buffer.m_ChildrenTicks[depth] += ticks;
+            }
+
+            ZoneStatistics& statistics = m_FrameStatistics[record.m_ZoneId];
+            const double time = ticks / ticksPerMillisecond;
+            if (statistics.m_Count == 0)
+            {
+                statistics.m_Depth = depth;
+            }
+            statistics.m_Count++;
+            statistics.m_Time           += time;
+            statistics.m_ExclusiveTime  += (ticks - childrenTicks) / ticksPerMillisecond;
+            statistics.m_MaxTime        = std::max(statistics.m_MaxTime, time);
+
+            const long long *counters = NULL;
+            if (record.m_HasCounters)
+            {
+                counters = buffer.m_RecordsCounters[readIndex % s_RecordsCount];
+                statistics.m_CountedCount++;
+                for (int j = 0; j < HardwareCounters::eCountersCount; j++)
+                {
+                    statistics.m_Counters[j] += counters[j];
+                }
+            }
+
+            if (m_TraceFile != NULL)
+            {
+                WriteTraceSeparator();
+                fputs("{\"name\":", m_TraceFile);
+                WriteJsonString(m_TraceFile, m_ZoneNames[record.m_ZoneId]);
+                fprintf(m_TraceFile, ",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f",
+                        i, (record.m_Start - m_TraceStart) / ticksPerMicrosecond, ticks / ticksPerMicrosecond);
+                if (counters != NULL)
+                {
+                    // Shown with the slice
+                    fputs(",\"args\":{", m_TraceFile);
+                    for (int j = 0; j < HardwareCounters::eCountersCount; j++)
+                    {
+                        fprintf(m_TraceFile, "%s\"%s\":%lld", j > 0 ? "," : "", HardwareCounters::GetName(j), counters[j]);
+                    }
+                    fputc('}', m_TraceFile);
+                }
+                fputc('}', m_TraceFile);
+            }
+        }
+
+        buffer.m_ReadIndex.store(readIndex, std::memory_order_release);
+        m_DroppedRecordsCount += buffer.m_DroppedCount.exchange(0, std::memory_order_relaxed);
+    }
+
+    m_FrameTime = (frameEnd - m_FrameStart) / ticksPerMillisecond;
+    m_FrameStart = frameEnd;
+
+    if (m_TraceFile != NULL)
+    {
+        const double timeStamp = (frameEnd - m_TraceStart) / ticksPerMicrosecond;
+        WriteTraceSeparator();
+        fprintf(m_TraceFile, "{\"name\":\"Frame time\",\"ph\":\"C\",\"pid\":1,\"ts\":%.3f,\"args\":{\"value\":%.3f}}",
+                timeStamp, m_FrameTime);
+
+        std::unique_lock<std::mutex> lock(m_CountersMutex);
+        for (int i = 0; i < m_CountersCount; i++)
+        {
+            if ( ! m_IsCounterSet[i])
+                continue;
+
+            WriteTraceSeparator();
+            fputs("{\"name\":", m_TraceFile);
+            WriteJsonString(m_TraceFile, m_CounterNames[i]);
+            fprintf(m_TraceFile, ",\"ph\":\"C\",\"pid\":1,\"ts\":%.3f,\"args\":{\"value\":%.17g}}",
+                    timeStamp, m_CounterValues[i]);
+        }
+        lock.unlock();
+
+        // A frame at a time, a crash loses at most the last one
+        fflush(m_TraceFile);
+    }
+
+    std::unique_lock<std::mutex> lock(m_CountersMutex);
+    memset(m_IsCounterSet, 0, sizeof(m_IsCounterSet));
+}
+
+const Profiler::ZoneStatistics& Profiler::GetFrameStatistics(int zoneId) const
+{
+    assert(zoneId >= 0 && zoneId < s_MaxZonesCount);
+    return m_FrameStatistics[zoneId];
+}
+
+double Profiler::GetFrameTime() const
+{
+    return m_FrameTime;
+}
+
+unsigned int Profiler::GetDroppedRecordsCount() const
+{
+    return m_DroppedRecordsCount;
+}
+
+void Profiler::OutputFrame() const
+{
+    DEBUG_OUT("Frame:\t" << m_FrameTime << "\n");
+
+    const int zonesCount = m_ZonesCount.load(std::memory_order_acquire);
+    for (int i = 0; i < zonesCount; i++)
+    {
+        const ZoneStatistics& statistics = m_FrameStatistics[i];
+        if (statistics.m_Count == 0)
+            continue;
+
+        DEBUG_OUT(  std::string(2 * statistics.m_Depth, ' ').c_str() << statistics.m_Name << ":\t" << statistics.m_Time <<
+                    "\tself:\t" << statistics.m_ExclusiveTime << "\tcount:\t" << statistics.m_Count << "\n");
+
+        if (statistics.m_CountedCount > 0)
+        {
+            const long long *counters = statistics.m_Counters;
+            const long long cycles = counters[HardwareCounters::eCycles];
+            DEBUG_OUT(  std::string(2 * statistics.m_Depth + 2, ' ').c_str() << "cycles:\t" << cycles <<
+                        "\tIPC:\t" << (cycles > 0 ? static_cast<double>(counters[HardwareCounters::eInstructions]) / cycles : 0.0) <<
+                        "\tLLC misses:\t" << counters[HardwareCounters::eLastLevelCacheMisses] <<
+                        "\tbranch misses:\t" << counters[HardwareCounters::eBranchMisses] <<
+                        "\tGB/s:\t" << HardwareCounters::GetBandwidth(counters[HardwareCounters::eLastLevelCacheMisses], statistics.m_Time) << "\n");
+        }
+    }
+
+    std::unique_lock<std::mutex> lock(m_CountersMutex);
+    for (int i = 0; i < m_CountersCount; i++)
+    {
+        DEBUG_OUT(m_CounterNames[i] << ":\t" << m_CounterValues[i] << "\n");
+    }
+    lock.unlock();
+
+    if (m_DroppedRecordsCount > 0)
+    {
+        DEBUG_OUT("Dropped profiler records:\t" << m_DroppedRecordsCount << "\n");
+    }
+}
+
+bool Profiler::StartTrace(const char *fileName)
+{
+    assert(fileName != NULL);
+    StopTrace();
+
+    m_TraceFile = OpenFile(fileName, "w");
+    if (m_TraceFile == NULL)
+    {
+        DEBUG_OUT("Can't open the trace file " << fileName << "\n");
+        return false;
+    }
+
+    // Events are written at the end of the frames, a large buffer keeps the writes few
+    setvbuf(m_TraceFile, NULL, _IOFBF, 1 << 20);
+
+    m_TraceStart = GetTicks();
+    m_IsFirstTraceEvent = true;
+    fputs("[\n", m_TraceFile);
+    WriteTraceSeparator();
+    fputs("{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"ParticleEngine\"}}", m_TraceFile);
+
+    // Every track is named again in the new trace
+    const int buffersCount = m_ThreadBuffersCount.load(std::memory_order_acquire);
+    for (int i = 0; i < buffersCount; i++)
+    {
+        m_ThreadBuffers[i]->m_TracedNameGeneration = 0;
+    }
+
+    m_IsTracing.store(true, std::memory_order_release);
+    return true;
+}
+
+void Profiler::StopTrace()
+{
+    if (m_TraceFile == NULL)
+        return;
+
+    m_IsTracing.store(false, std::memory_order_release);
+    fputs("\n]\n", m_TraceFile);
+    fclose(m_TraceFile);
+    m_TraceFile = NULL;
+}
+
+bool Profiler::IsTracing() const
+{
+    return m_IsTracing.load(std::memory_order_acquire);
+}
+
+void Profiler::WriteTraceSeparator()
+{
+    if ( ! m_IsFirstTraceEvent)
+    {
+        fputs(",\n", m_TraceFile);
+    }
+    m_IsFirstTraceEvent = false;
+}
+
+void Profiler::WriteTrackName(int bufferIndex, const char *name)
+{
+    WriteTraceSeparator();
+    fprintf(m_TraceFile, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":", bufferIndex);
+    if (name[0] != '\0')
+    {
+        WriteJsonString(m_TraceFile, name);
+    }
+    else
+    {
+        fprintf(m_TraceFile, "\"Thread %d\"", bufferIndex);
+    }
+    fputs("}}", m_TraceFile);
+}
+
+bool Profiler::SetEnableHardwareCounters(bool isUsingHardwareCounters)
+{
+    ThreadBuffer *buffer = GetThreadBuffer();
+    ThreadBuffer *countingBuffer = m_CountingBuffer.load(std::memory_order_relaxed);
+    // The descriptors are only read by the counting thread, it is the only one to close them
+    assert((countingBuffer == NULL || countingBuffer == buffer) &&
+           "Profiler::SetEnableHardwareCounters failed, the counters are toggled by another thread.");
+    if (countingBuffer != NULL && countingBuffer != buffer)
+        return false;
+
+    if ( ! isUsingHardwareCounters)
+    {
+        m_CountingBuffer.store(NULL, std::memory_order_relaxed);
+        m_HardwareCounters.Close();
+        return true;
+    }
+
+    if (buffer == NULL)
+        return false;
+
+    if ( ! m_HardwareCounters.IsOpen() && ! m_HardwareCounters.Open())
+    {
+        DEBUG_OUT("Hardware counters are unavailable\n");
+        return false;
+    }
+    m_CountingBuffer.store(buffer, std::memory_order_relaxed);
+    return true;
+}
+
+bool Profiler::IsUsingHardwareCounters() const
+{
+    return m_CountingBuffer.load(std::memory_order_relaxed) != NULL;
+}
+
+const HardwareCounters& Profiler::GetHardwareCounters() const
+{
+    return m_HardwareCounters;
+}
+
+long long Profiler::GetTicks()
+{
+    return std::chrono::steady_clock::now().time_since_epoch().count();
+}
+
+double Profiler::GetTicksPerMillisecond()
+{
+    return static_cast<double>(std::chrono::steady_clock::period::den) /
+           (1000.0 * static_cast<double>(std::chrono::steady_clock::period::num));
+}
@@ -0,0 +1,199 @@
+#ifndef PROFILER
+#define PROFILER
+
+#include "HardwareCounters.h"
+
+#include <atomic>
+#include <mutex>
+#include <cstdio>
+
+// Hierarchical frame profiler. Each thread writes (zone, depth, start, end) records in its
+// own ring buffer, a zone costs two clock reads and no allocation nor lock. EndFrame
+// aggregates the records of every thread by zone, the statistics of the last frame
+// can then be queried. Records are dropped when a ring is full, never overwritten.
+// While a trace is started, EndFrame also streams the records and the counters to a
+// JSON trace file, opened by chrome://tracing and ui.perfetto.dev.
+// The hardware counters can also be sampled at the bounds of the zones of the thread which
+// enabled them, see HardwareCounters
+class Profiler
+{
+public:
+    static const int s_MaxZonesCount    = 256;
+    static const int s_MaxThreadsCount  = 64;
+    static const int s_MaxDepth         = 32;
+    static const int s_RecordsCount     = 4096;
+    static const int s_MaxCountersCount = 32;
+    static const int s_MaxTrackNameSize = 64;
+
+    // Times are in milliseconds
+    struct ZoneStatistics
+    {
+        const char  *m_Name;
+        // Depth of the first record, 0 for a root zone
+        int         m_Depth;
+        int         m_Count;
+        double      m_Time;
+        // Time without the nested zones
+        double      m_ExclusiveTime;
+        double      m_MaxTime;
+        // Sums of the records sampled with the hardware counters, with the nested zones
+        int         m_CountedCount;
+        long long   m_Counters[HardwareCounters::eCountersCount];
+    };
+
+    static Profiler* GetInstance();
+
+    // Zones of the same name share their id, the name must outlive the profiler
+    int RegisterZone(const char *name);
+    int FindZone(const char *name) const;
+    int GetZonesCount() const;
+    const char* GetZoneName(int zoneId) const;
+
+    // Begin and End are called by the same thread, End returns the zone duration
+    void Begin();
+    float End(int zoneId);
+
+    // Names the track of the calling thread in the trace, "Thread <index>" by default
+    void SetThreadName(const char *name);
+
+    // Track of records not measured by a thread, like the commands of an OpenCL queue.
+    // Records of a track are added by one thread at a time, a zone by record, no nesting.
+    // Returns -1 when there are too many tracks
+    int AcquireTrack(const char *name);
+    void ReleaseTrack(int trackId);
+    void AddRecord(int trackId, int zoneId, long long start, long long end);
+
+    // Value sampled at the end of the frame, the name must outlive the profiler
+    void SetCounter(const char *name, double value);
+
+    // Called once a frame by a single thread
+    void EndFrame();
+    const ZoneStatistics& GetFrameStatistics(int zoneId) const;
+    double GetFrameTime() const;
+    unsigned int GetDroppedRecordsCount() const;
+    void OutputFrame() const;
+
+    // Called by the thread of EndFrame. The trace is a JSON array of events,
+    // the records already waiting in the rings go to the first traced frame
+    bool StartTrace(const char *fileName);
+    void StopTrace();
+    bool IsTracing() const;
+
+    // Two reads of the counters by zone, a few microseconds. Enabled by the thread which
+    // starts the simulation threads, before it starts them, and disabled by the same thread
+    // between frames. Only its zones are counted: the counters of the process include the
+    // workers, the zones of the workers would count the other threads too.
+    // Returns false when the counters are unavailable
+    bool SetEnableHardwareCounters(bool isUsingHardwareCounters);
+    bool IsUsingHardwareCounters() const;
+    const HardwareCounters& GetHardwareCounters() const;
+
+    // Monotonic clock
+    static long long GetTicks();
+    static double GetTicksPerMillisecond();
+
+private:
+    struct Record
+    {
+        long long       m_Start;
+        long long       m_End;
+        unsigned short  m_ZoneId;
+        unsigned short  m_Depth;
+        // The counters of the record are in the counters ring of the buffer
+        bool            m_HasCounters;
+    };
+
+    struct ThreadBuffer;
+
+    Profiler();
+    ~Profiler();
+    Profiler(const Profiler&);
+    Profiler& operator=(const Profiler&);
+
+    ThreadBuffer* GetThreadBuffer();
+    // Returns NULL when there are too many buffers
+    ThreadBuffer* AcquireThreadBuffer(const char *name);
+    void WriteTraceSeparator();
+    void WriteTrackName(int bufferIndex, const char *name);
+
+    // Zones, a name is published before the count
+    const char              *m_ZoneNames[s_MaxZonesCount];
+    std::atomic<int>        m_ZonesCount;
+    mutable std::mutex      m_ZonesMutex;
+
+    ThreadBuffer            *m_ThreadBuffers[s_MaxThreadsCount];
+    std::atomic<int>        m_ThreadBuffersCount;
+    // Also guards the names of the buffers
+    std::mutex              m_ThreadBuffersMutex;
+
+    // Counters set since the last frame are traced
+    const char              *m_CounterNames[s_MaxCountersCount];
+    double                  m_CounterValues[s_MaxCountersCount];
+    bool                    m_IsCounterSet[s_MaxCountersCount];
+    int                     m_CountersCount;
+    mutable std::mutex      m_CountersMutex;
+
+    // Aggregation of the last frame, only touched by EndFrame
+    ZoneStatistics          m_FrameStatistics[s_MaxZonesCount];
+    long long               m_FrameStart;
+    double                  m_FrameTime;
+    unsigned int            m_DroppedRecordsCount;
+
+    HardwareCounters        m_HardwareCounters;
+    // Buffer of the thread which enabled the counters, NULL while they are disabled
+    std::atomic<ThreadBuffer*> m_CountingBuffer;
+
+    FILE                    *m_TraceFile;
+    long long               m_TraceStart;
+    bool                    m_IsFirstTraceEvent;
+    std::atomic<bool>       m_IsTracing;
+};
+
+// Zone of a scope, the zone is registered once by the static of its call site
+class ProfilerZone
+{
+public:
+    explicit ProfilerZone(const char *name) : m_Id(Profiler::GetInstance()->RegisterZone(name)) {}
+    int GetId() const { return m_Id; }
+
+private:
+    int m_Id;
+};
+
+class ProfilerScope
+{
+public:
+    explicit ProfilerScope(const ProfilerZone& zone) : m_ZoneId(zone.GetId()) { Profiler::GetInstance()->Begin(); }
+    ~ProfilerScope() { Profiler::GetInstance()->End(m_ZoneId); }
+
+private:
+    int m_ZoneId;
+};
+
+#define PROFILER_CONCATENATE_LINE(name, line) name##line
+#define PROFILER_CONCATENATE(name, line) PROFILER_CONCATENATE_LINE(name, line)
+
+// The zones are compiled out of the Release and Debug configurations, the Profile one keeps them
+#if (defined(RELEASE) || defined(DEBUG)) && !defined(PROFILER_DISABLED)
+    #define PROFILER_DISABLED
+#endif // RELEASE || DEBUG
+
+#ifndef PROFILER_DISABLED
+    #define PROFILE_SCOPE(name) \
+        static const ProfilerZone PROFILER_CONCATENATE(s_ProfilerZone, __LINE__)(name); \
+        const ProfilerScope PROFILER_CONCATENATE(profilerScope, __LINE__)(PROFILER_CONCATENATE(s_ProfilerZone, __LINE__))
+    // Zone between two statements of a thread, the id is a static of the PROFILE_END call site
+    #define PROFILE_BEGIN() Profiler::GetInstance()->Begin()
+    #define PROFILE_END(name) \
+        do \
+        { \
+            static const ProfilerZone s_ProfilerZone(name); \
+            Profiler::GetInstance()->End(s_ProfilerZone.GetId()); \
+        } while (false)
+#else // PROFILER_DISABLED
+    #define PROFILE_SCOPE(name)
+    #define PROFILE_BEGIN() ((void)0)
+    #define PROFILE_END(name) ((void)0)
+#endif // PROFILER_DISABLED
+
+#endif // PROFILER
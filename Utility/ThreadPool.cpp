@@ -0,0 +1,456 @@
+#include "ThreadPool.h"
+#include "Profiler.h"
+
+#include <assert.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#ifdef _WIN32
+    #include <windows.h>
+#else // _WIN32
+    #include <pthread.h>
+    #include <sched.h>
+#endif // _WIN32
+
+
+namespace
+{
+    thread_local int t_ThreadIndex = 0;
+
+#ifndef _WIN32
+    // Lists of the sysfs are ranges, like 0-7,16-23. Returns false when the file is missing
+    bool ReadList(const char *fileName, std::vector<int>& values)
+    {
+        FILE *file = fopen(fileName, "r");
+        if (file == NULL)
+            return false;
+
+        int first = 0;
+        while (fscanf(file, "%d", &first) == 1)
+        {
+            int last = first;
+            int separator = fgetc(file);
+            if (separator == '-')
+            {
+                if (fscanf(file, "%d", &last) != 1)
+                    break;
+                separator = fgetc(file);
+            }
+            for (int i = first; i <= last; i++)
+            {
+                values.push_back(i);
+            }
+            if (separator != ',')
+                break;
+        }
+        fclose(file);
+        return true;
+    }
+#endif // _WIN32
+}
+
+ThreadPool::ThreadPool() :  m_NodesCount(1),
+                            m_IsPinningThreads(false),
+                            m_Task(NULL),
+                            m_Function(NULL),
+                            m_Count(0),
+                            m_GrainSize(1),
+                            m_IsStatic(false),
+                            m_NextIndex(0),
+                            m_Generation(0),
+                            m_RunningWorkersCount(0),
+                            m_IsStopping(false),
+                            m_IsRunning(false)
+{
+}
+
+ThreadPool::~ThreadPool()
+{
+    Release();
+}
+
+void ThreadPool::Initialize(int threadsCount /*= 0*/)
+{
+    assert(threadsCount >= 0);
+    Release();
+
+    threadsCount = ResolveThreadsCount(threadsCount);
+
+    // Threads are given the processors of the nodes in turn, more threads than processors share them
+    m_NodesCount = 1;
+    m_ThreadProcessors.clear();
+    if (m_IsPinningThreads)
+    {
+        std::vector<Processor> processors;
+        GetProcessors(processors);
+        InterleaveNodes(processors);
+        for (int i = 0; i < threadsCount && ! processors.empty(); i++)
+        {
+            const Processor& processor = processors[i % processors.size()];
+            m_ThreadProcessors.push_back(processor);
+            m_NodesCount = std::max(m_NodesCount, processor.m_Node + 1);
+        }
+    }
+
+    // Given back by Release
+    if ( ! m_ThreadProcessors.empty())
+    {
+        GetCurrentThreadProcessors(m_CallingThreadProcessors);
+        PinCurrentThread(m_ThreadProcessors[0]);
+    }
+
+    m_IsStopping = false;
+    // The calling thread is the first one
+    for (int i = 1; i < threadsCount; i++)
+    {
+        m_Threads.push_back(std::thread(&ThreadPool::WorkerLoop, this, i));
+    }
+}
+
+void ThreadPool::SetIsPinningThreads(bool isPinningThreads)
+{
+    assert(m_Threads.empty() && "ThreadPool::SetIsPinningThreads failed.");
+    m_IsPinningThreads = isPinningThreads;
+}
+
+int ThreadPool::GetThreadIndex()
+{
+    return t_ThreadIndex;
+}
+
+int ThreadPool::ResolveThreadsCount(int threadsCount)
+{
+    assert(threadsCount >= 0);
+    if (threadsCount == 0)
+        return std::max(static_cast<int>(std::thread::hardware_concurrency()), 1);
+    return threadsCount;
+}
+
+bool ThreadPool::IsPinningThreads() const
+{
+    return m_IsPinningThreads;
+}
+
+int ThreadPool::GetThreadNode(int threadIndex) const
+{
+    assert(threadIndex >= 0 && threadIndex < GetThreadsCount());
+    if (m_ThreadProcessors.empty())
+        return 0;
+    return m_ThreadProcessors[threadIndex].m_Node;
+}
+
+int ThreadPool::GetNodesCount() const
+{
+    return m_NodesCount;
+}
+
+void ThreadPool::InterleaveNodes(std::vector<Processor>& processors)
+{
+    // Listed by node, the i-th processor of every node comes before the next ones
+    std::vector<std::vector<Processor> > nodes;
+    for (size_t i = 0; i < processors.size(); i++)
+    {
+        if (processors[i].m_Node >= static_cast<int>(nodes.size()))
+        {
+            nodes.resize(processors[i].m_Node + 1);
+        }
+        nodes[processors[i].m_Node].push_back(processors[i]);
+    }
+
+    processors.clear();
+    for (size_t rank = 0; ; rank++)
+    {
+        const size_t processorsCount = processors.size();
+        for (size_t node = 0; node < nodes.size(); node++)
+        {
+            if (rank < nodes[node].size())
+            {
+                processors.push_back(nodes[node][rank]);
+            }
+        }
+        if (processors.size() == processorsCount)
+            break;
+    }
+}
+
+#ifdef _WIN32
+void ThreadPool::GetProcessors(std::vector<Processor>& processors)
+{
+    ULONG highestNode = 0;
+    if ( ! GetNumaHighestNodeNumber(&highestNode))
+    {
+        highestNode = 0;
+    }
+
+    // Nodes without processors are skipped, the nodes of the threads stay contiguous
+    int nodesCount = 0;
+    for (ULONG node = 0; node <= highestNode; node++)
+    {
+        GROUP_AFFINITY affinity;
+        if ( ! GetNumaNodeProcessorMaskEx(static_cast<USHORT>(node), &affinity) || affinity.Mask == 0)
+            continue;
+
+        for (int i = 0; i < static_cast<int>(sizeof(KAFFINITY) * 8); i++)
+        {
+            if (affinity.Mask & (static_cast<KAFFINITY>(1) << i))
+            {
+                Processor processor = { affinity.Group, i, nodesCount };
+                processors.push_back(processor);
+            }
+        }
+        nodesCount++;
+    }
+}
+
+void ThreadPool::PinCurrentThread(const Processor& processor)
+{
+    GROUP_AFFINITY affinity;
+    memset(&affinity, 0, sizeof(affinity));
+    affinity.Group = static_cast<WORD>(processor.m_Group);
+    affinity.Mask = static_cast<KAFFINITY>(1) << processor.m_Number;
+    SetThreadGroupAffinity(GetCurrentThread(), &affinity, NULL);
+}
+
+void ThreadPool::GetCurrentThreadProcessors(std::vector<Processor>& processors)
+{
+    processors.clear();
+    GROUP_AFFINITY affinity;
+    if ( ! GetThreadGroupAffinity(GetCurrentThread(), &affinity))
+        return;
+
+    for (int i = 0; i < static_cast<int>(sizeof(KAFFINITY) * 8); i++)
+    {
+        if (affinity.Mask & (static_cast<KAFFINITY>(1) << i))
+        {
+            Processor processor = { affinity.Group, i, 0 };
+            processors.push_back(processor);
+        }
+    }
+}
+
+void ThreadPool::SetCurrentThreadProcessors(const std::vector<Processor>& processors)
+{
+    // A thread has the processors of a single group
+    GROUP_AFFINITY affinity;
+    memset(&affinity, 0, sizeof(affinity));
+    for (size_t i = 0; i < processors.size(); i++)
+    {
+        affinity.Group = static_cast<WORD>(processors[i].m_Group);
+        affinity.Mask |= static_cast<KAFFINITY>(1) << processors[i].m_Number;
+    }
+    SetThreadGroupAffinity(GetCurrentThread(), &affinity, NULL);
+}
+#else // _WIN32
+void ThreadPool::GetProcessors(std::vector<Processor>& processors)
+{
+    cpu_set_t allowedProcessors;
+    CPU_ZERO(&allowedProcessors);
+    sched_getaffinity(0, sizeof(allowedProcessors), &allowedProcessors);
+
+    // Node numbers can have holes, the nodes without allowed processors are skipped
+    std::vector<int> onlineNodes;
+    ReadList("/sys/devices/system/node/online", onlineNodes);
+
+    int nodesCount = 0;
+    for (size_t i = 0; i < onlineNodes.size(); i++)
+    {
+        char fileName[64];
+        snprintf(fileName, sizeof(fileName), "/sys/devices/system/node/node%d/cpulist", onlineNodes[i]);
+        std::vector<int> nodeProcessors;
+        ReadList(fileName, nodeProcessors);
+
+        const size_t processorsCount = processors.size();
+        for (size_t j = 0; j < nodeProcessors.size(); j++)
+        {
+            const int number = nodeProcessors[j];
+            if (number >= 0 && number < CPU_SETSIZE && CPU_ISSET(number, &allowedProcessors))
+            {
+                Processor processor = { 0, number, nodesCount };
+                processors.push_back(processor);
+            }
+        }
+
+        if (processors.size() > processorsCount)
+        {
+            nodesCount++;
+        }
+    }
+
+    // Without NUMA information all the processors are on one node
+    if (processors.empty())
+    {
+        for (int i = 0; i < CPU_SETSIZE; i++)
+        {
+            if (CPU_ISSET(i, &allowedProcessors))
+            {
+                Processor processor = { 0, i, 0 };
+                processors.push_back(processor);
+            }
+        }
+    }
+}
+
+void ThreadPool::PinCurrentThread(const Processor& processor)
+{
+    cpu_set_t processors;
+    CPU_ZERO(&processors);
+    CPU_SET(processor.m_Number, &processors);
+    pthread_setaffinity_np(pthread_self(), sizeof(processors), &processors);
+}
+
+void ThreadPool::GetCurrentThreadProcessors(std::vector<Processor>& processors)
+{
+    processors.clear();
+    cpu_set_t allowedProcessors;
+    CPU_ZERO(&allowedProcessors);
+    if (pthread_getaffinity_np(pthread_self(), sizeof(allowedProcessors), &allowedProcessors) != 0)
+        return;
+
+    for (int i = 0; i < CPU_SETSIZE; i++)
+    {
+        if (CPU_ISSET(i, &allowedProcessors))
+        {
+            Processor processor = { 0, i, 0 };
+            processors.push_back(processor);
+        }
+    }
+}
+
+void ThreadPool::SetCurrentThreadProcessors(const std::vector<Processor>& processors)
+{
+    cpu_set_t allowedProcessors;
+    CPU_ZERO(&allowedProcessors);
+    for (size_t i = 0; i < processors.size(); i++)
+    {
+        CPU_SET(processors[i].m_Number, &allowedProcessors);
+    }
+    pthread_setaffinity_np(pthread_self(), sizeof(allowedProcessors), &allowedProcessors);
+}
+#endif // _WIN32
+
+void ThreadPool::Release()
+{
+    {
+        std::unique_lock<std::mutex> lock(m_Mutex);
+        m_IsStopping = true;
+    }
+    m_WakeUp.notify_all();
+
+    for (size_t i = 0; i < m_Threads.size(); i++)
+    {
+        m_Threads[i].join();
+    }
+    m_Threads.clear();
+
+    if ( ! m_CallingThreadProcessors.empty())
+    {
+        SetCurrentThreadProcessors(m_CallingThreadProcessors);
+        m_CallingThreadProcessors.clear();
+    }
+}
+
+int ThreadPool::GetThreadsCount() const
+{
+    return static_cast<int>(m_Threads.size()) + 1;
+}
+
+void ThreadPool::Run(int count, int grainSize, bool isStatic, Task task, const void *function)
+{
+    assert(grainSize > 0);
+    assert( ! m_IsRunning && "Parallel loops can't be nested.");
+    if (count <= 0)
+        return;
+
+    // Not worth waking up the workers
+    if (m_Threads.empty() || ( ! isStatic && count <= grainSize))
+    {
+        task(function, 0, count);
+        return;
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(m_Mutex);
+        m_Task = task;
+        m_Function = function;
+        m_Count = count;
+        m_GrainSize = grainSize;
+        m_IsStatic = isStatic;
+        m_NextIndex = 0;
+        m_RunningWorkersCount = static_cast<int>(m_Threads.size());
+        m_IsRunning = true;
+        m_Generation++;
+    }
+    m_WakeUp.notify_all();
+
+    RunChunks(0);
+
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    while (m_RunningWorkersCount > 0)
+    {
+        m_Done.wait(lock);
+    }
+    m_IsRunning = false;
+}
+
+void ThreadPool::RunChunks(int threadIndex)
+{
+    if (m_IsStatic)
+    {
+        const int threadsCount = GetThreadsCount();
+        const int first = static_cast<int>(static_cast<long long>(m_Count) * threadIndex / threadsCount);
+        const int last = static_cast<int>(static_cast<long long>(m_Count) * (threadIndex + 1) / threadsCount);
+        if (first < last)
+        {
+            m_Task(m_Function, first, last);
+        }
+        return;
+    }
+
+    for (;;)
+    {
+        int first = m_NextIndex.fetch_add(m_GrainSize);
+        if (first >= m_Count)
+            break;
+
+        m_Task(m_Function, first, std::min(first + m_GrainSize, m_Count));
+    }
+}
+
+void ThreadPool::WorkerLoop(int threadIndex)
+{
+    t_ThreadIndex = threadIndex;
+    Profiler::GetInstance()->SetThreadName("Thread pool worker");
+    if ( ! m_ThreadProcessors.empty())
+    {
+        PinCurrentThread(m_ThreadProcessors[threadIndex]);
+    }
+
+    unsigned int generation = 0;
+    for (;;)
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_Mutex);
+            while ( ! m_IsStopping && m_Generation == generation)
+            {
+                m_WakeUp.wait(lock);
+            }
+            if (m_IsStopping)
+                return;
+
+            generation = m_Generation;
+        }
+
+        {
+            // Share of the loop run by each worker
+            PROFILE_SCOPE("Thread pool worker");
+            RunChunks(threadIndex);
+        }
+
+        std::unique_lock<std::mutex> lock(m_Mutex);
+        if (--m_RunningWorkersCount == 0)
+        {
+            m_Done.notify_one();
+        }
+    }
+}
@@ -0,0 +1,109 @@
+#ifndef THREAD_POOL
+#define THREAD_POOL
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+
+// Persistent worker threads running parallel loops.
+// The calling thread takes part in the loop, ParallelFor returns when every chunk is done.
+// Loops can't be nested.
+// Pinned threads take the NUMA nodes in turn, so fewer threads than processors still use
+// the memory bandwidth of every node. With ParallelForStatic a thread always gets the same
+// partition of a loop, so the pages it touches first are on its node and its next loops on
+// them stay local
+class ThreadPool
+{
+public:
+    ThreadPool();
+    ~ThreadPool();
+
+    // Each thread is pinned to a processor, the calling thread to the first one until
+    // Release gives its affinity back. Must be called before Initialize
+    void SetIsPinningThreads(bool isPinningThreads);
+    bool IsPinningThreads() const;
+
+    // 0 uses one thread by hardware thread, the calling thread included.
+    // Initialize and Release are called by the same thread
+    void Initialize(int threadsCount = 0);
+    void Release();
+    int GetThreadsCount() const;
+    // Index of the calling thread in the pool it works for, 0 for the threads which are not
+    // workers. Selects the scratch region of the thread, see MemoryArena
+    static int GetThreadIndex();
+    // Threads count Initialize starts for threadsCount, 0 is one by hardware thread
+    static int ResolveThreadsCount(int threadsCount);
+    // NUMA node of a thread, 0 when the threads aren't pinned
+    int GetThreadNode(int threadIndex) const;
+    int GetNodesCount() const;
+
+    // Calls function(first, last) on chunks of grainSize indices of [0; count[
+    template <class Function>
+    void ParallelFor(int count, const Function &function, int grainSize = 256)
+    {
+        Run(count, grainSize, false, &CallFunction<Function>, &function);
+    }
+
+    // Calls function(first, last) once by thread, the thread i gets the i-th of the
+    // equal partitions of [0; count[
+    template <class Function>
+    void ParallelForStatic(int count, const Function &function)
+    {
+        Run(count, 1, true, &CallFunction<Function>, &function);
+    }
+
+private:
+    typedef void (*Task)(const void *function, int first, int last);
+
+    // Processor of a pinned thread, the group is only used by Windows
+    struct Processor
+    {
+        int m_Group;
+        int m_Number;
+        int m_Node;
+    };
+
+    static void GetProcessors(std::vector<Processor>& processors);
+    static void InterleaveNodes(std::vector<Processor>& processors);
+    static void PinCurrentThread(const Processor& processor);
+    static void GetCurrentThreadProcessors(std::vector<Processor>& processors);
+    static void SetCurrentThreadProcessors(const std::vector<Processor>& processors);
+
+    template <class Function>
+    static void CallFunction(const void *function, int first, int last)
+    {
+        (*static_cast<const Function*>(function))(first, last);
+    }
+
+    void Run(int count, int grainSize, bool isStatic, Task task, const void *function);
+    void RunChunks(int threadIndex);
+    void WorkerLoop(int threadIndex);
+
+    std::vector<std::thread>    m_Threads;
+    // Processor of each thread, the calling thread first. Empty without pinning
+    std::vector<Processor>      m_ThreadProcessors;
+    // Affinity of the calling thread before it was pinned
+    std::vector<Processor>      m_CallingThreadProcessors;
+    int                         m_NodesCount;
+    bool                        m_IsPinningThreads;
+    std::mutex                  m_Mutex;
+    std::condition_variable     m_WakeUp;
+    std::condition_variable     m_Done;
+
+    // Current loop, written under the mutex before waking up the workers
+    Task                        m_Task;
+    const void                  *m_Function;
+    int                         m_Count;
+    int                         m_GrainSize;
+    bool                        m_IsStatic;
+    std::atomic<int>            m_NextIndex;
+
+    unsigned int                m_Generation;
+    int                         m_RunningWorkersCount;
+    bool                        m_IsStopping;
+    bool                        m_IsRunning;
+};
+
+#endif // THREAD_POOL
@@ -1,30 +0,0 @@
-#ifndef TIMER
-#define TIMER
-
-#include <windows.h>
-#include <vector>
-
-class Timer
-{
-
-public:
-    inline void StartTimerProfile();
-    inline float StopTimerProfile(char * timerDescription = NULL);
-    inline void StartTimer();
-    inline float StopTimer();
-    inline float Timer::GetTimer(size_t index) const;
-    void Initialize();
-    void Release();
-    static Timer* GetInstance();
-
-
-private:
-    static Timer *m_Timer;
-    std::vector<LARGE_INTEGER>  m_StartTimeProfileList;
-    std::vector<LARGE_INTEGER>  m_StartTimerList;
-
-};
-
-#include "Timer.inl"
-
-#endif // TIMER
\ No newline at end of file
@@ -5,13 +5,22 @@
 #include <iostream> 
 #include <sstream> 
 
+#ifdef _WIN32
+    #include <windows.h>
+#endif // _WIN32
+
 //#ifndef RELEASE
+#ifdef _WIN32
     #define DEBUG_OUT( s ) {std::wostringstream os_;    os_ << s;   OutputDebugStringW( os_.str().c_str() );} 
+#else // _WIN32
+    // No debugger output, the messages go to the error stream
+    #define DEBUG_OUT( s ) {std::wostringstream os_;    os_ << s;   std::wcerr << os_.str();} 
+#endif // _WIN32
 //#else //RELEASE
 //    #define DEBUG_OUT( s )
 //#endif //RELEASE
 
-#define UNUSED_PARAMETER( p ) {  p; }
+#define UNUSED_PARAMETER( p ) {  (void)(p); }
 
 
 #endif // UTILITY
\ No newline at end of file